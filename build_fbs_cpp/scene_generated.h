@@ -0,0 +1,148 @@
+#pragma once
+#include <flatbuffers/flatbuffers.h>
+namespace SceneFormat {
+enum VertexFormat : uint8_t {
+  VertexFormat_Float = 0,
+  VertexFormat_Quantized = 1,
+  VertexFormat_QuantizedSmall = 2,
+  VertexFormat_MIN = 0, VertexFormat_MAX = 2 };
+struct Vec3;
+struct Bounds;
+struct Range;
+struct Lod;
+struct Color;
+struct Mesh;
+struct Material;
+struct Node;
+struct Scene;
+struct Vec3 {
+ private:
+  float x_;
+  float y_;
+  float z_;
+ public:
+  Vec3() { memset( this, 0, sizeof( *this ) ); }
+  Vec3( float _x, float _y, float _z ) : x_( _x ), y_( _y ), z_( _z ) {}
+  float x() const { return x_; }
+  float y() const { return y_; }
+  float z() const { return z_; }
+};
+struct Bounds {
+ private:
+  Vec3 min_;
+  Vec3 max_;
+ public:
+  Bounds() { memset( this, 0, sizeof( *this ) ); }
+  Bounds( const Vec3& _min, const Vec3& _max ) : min_( _min ), max_( _max ) {}
+  const Vec3& min() const { return min_; }
+  const Vec3& max() const { return max_; }
+};
+struct Range {
+ private:
+  uint32_t offset_;
+  uint32_t size_;
+ public:
+  Range() { memset( this, 0, sizeof( *this ) ); }
+  Range( uint32_t _offset, uint32_t _size ) : offset_( _offset ), size_( _size ) {}
+  uint32_t offset() const { return offset_; }
+  uint32_t size() const { return size_; }
+};
+struct Lod {
+ private:
+  uint32_t first_index_;
+  uint32_t index_count_;
+  float error_;
+ public:
+  Lod() { memset( this, 0, sizeof( *this ) ); }
+  Lod( uint32_t _first_index, uint32_t _index_count, float _error ) : first_index_( _first_index ), index_count_( _index_count ), error_( _error ) {}
+  uint32_t first_index() const { return first_index_; }
+  uint32_t index_count() const { return index_count_; }
+  float error() const { return error_; }
+};
+struct Color {
+ private:
+  uint8_t r_;
+  uint8_t g_;
+  uint8_t b_;
+  uint8_t a_;
+ public:
+  Color() { memset( this, 0, sizeof( *this ) ); }
+  Color( uint8_t _r, uint8_t _g, uint8_t _b, uint8_t _a ) : r_( _r ), g_( _g ), b_( _b ), a_( _a ) {}
+  uint8_t r() const { return r_; }
+  uint8_t g() const { return g_; }
+  uint8_t b() const { return b_; }
+  uint8_t a() const { return a_; }
+};
+struct Mesh : private flatbuffers::Table {
+  enum { VT_NAME = 4, VT_FORMAT = 6, VT_DEQUANTIZE = 8, VT_VERTICES = 10, VT_INDICES = 12, VT_SHORT_INDICES = 14, VT_LODS = 16, VT_BOUNDS = 18 };
+  const flatbuffers::String* name() const { return GetPointer<const flatbuffers::String*>( VT_NAME ); }
+  VertexFormat format() const { return static_cast<VertexFormat>( GetField<uint8_t>( VT_FORMAT, static_cast<uint8_t>( VertexFormat(0) ) ) ); }
+  const flatbuffers::Vector<float>* dequantize() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_DEQUANTIZE ); }
+  const Range* vertices() const { return GetStruct<const Range*>( VT_VERTICES ); }
+  const Range* indices() const { return GetStruct<const Range*>( VT_INDICES ); }
+  bool short_indices() const { return GetField<uint8_t>( VT_SHORT_INDICES, false ) != 0; }
+  const flatbuffers::Vector<const Lod*>* lods() const { return GetPointer<const flatbuffers::Vector<const Lod*>*>( VT_LODS ); }
+  const Bounds* bounds() const { return GetStruct<const Bounds*>( VT_BOUNDS ); }
+};
+inline flatbuffers::Offset<Mesh> CreateMesh( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::String> name = 0, VertexFormat format = VertexFormat(0), flatbuffers::Offset<flatbuffers::Vector<float>> dequantize = 0, const Range* vertices = nullptr, const Range* indices = nullptr, bool short_indices = false, flatbuffers::Offset<flatbuffers::Vector<const Lod*>> lods = 0, const Bounds* bounds = nullptr ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddStruct( Mesh::VT_BOUNDS, bounds );
+  fbb.AddOffset( Mesh::VT_LODS, lods );
+  fbb.AddElement<uint8_t>( Mesh::VT_SHORT_INDICES, static_cast<uint8_t>( short_indices ), static_cast<uint8_t>( false ) );
+  fbb.AddStruct( Mesh::VT_INDICES, indices );
+  fbb.AddStruct( Mesh::VT_VERTICES, vertices );
+  fbb.AddOffset( Mesh::VT_DEQUANTIZE, dequantize );
+  fbb.AddElement<uint8_t>( Mesh::VT_FORMAT, static_cast<uint8_t>( format ), static_cast<uint8_t>( VertexFormat(0) ) );
+  fbb.AddOffset( Mesh::VT_NAME, name );
+  return flatbuffers::Offset<Mesh>( fbb.EndTable( start ) );
+}
+struct Material : private flatbuffers::Table {
+  enum { VT_NAME = 4, VT_COLOR = 6, VT_ALBEDO = 8 };
+  const flatbuffers::String* name() const { return GetPointer<const flatbuffers::String*>( VT_NAME ); }
+  const Color* color() const { return GetStruct<const Color*>( VT_COLOR ); }
+  const flatbuffers::String* albedo() const { return GetPointer<const flatbuffers::String*>( VT_ALBEDO ); }
+};
+inline flatbuffers::Offset<Material> CreateMaterial( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::String> name = 0, const Color* color = nullptr, flatbuffers::Offset<flatbuffers::String> albedo = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddOffset( Material::VT_ALBEDO, albedo );
+  fbb.AddStruct( Material::VT_COLOR, color );
+  fbb.AddOffset( Material::VT_NAME, name );
+  return flatbuffers::Offset<Material>( fbb.EndTable( start ) );
+}
+struct Node : private flatbuffers::Table {
+  enum { VT_NAME = 4, VT_PARENT = 6, VT_MATRIX = 8, VT_MESH = 10, VT_MATERIAL = 12 };
+  const flatbuffers::String* name() const { return GetPointer<const flatbuffers::String*>( VT_NAME ); }
+  int32_t parent() const { return GetField<int32_t>( VT_PARENT, -1 ); }
+  const flatbuffers::Vector<float>* matrix() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_MATRIX ); }
+  int32_t mesh() const { return GetField<int32_t>( VT_MESH, -1 ); }
+  int32_t material() const { return GetField<int32_t>( VT_MATERIAL, -1 ); }
+};
+inline flatbuffers::Offset<Node> CreateNode( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::String> name = 0, int32_t parent = -1, flatbuffers::Offset<flatbuffers::Vector<float>> matrix = 0, int32_t mesh = -1, int32_t material = -1 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddElement<int32_t>( Node::VT_MATERIAL, static_cast<int32_t>( material ), static_cast<int32_t>( -1 ) );
+  fbb.AddElement<int32_t>( Node::VT_MESH, static_cast<int32_t>( mesh ), static_cast<int32_t>( -1 ) );
+  fbb.AddOffset( Node::VT_MATRIX, matrix );
+  fbb.AddElement<int32_t>( Node::VT_PARENT, static_cast<int32_t>( parent ), static_cast<int32_t>( -1 ) );
+  fbb.AddOffset( Node::VT_NAME, name );
+  return flatbuffers::Offset<Node>( fbb.EndTable( start ) );
+}
+struct Scene : private flatbuffers::Table {
+  enum { VT_NODES = 4, VT_MESHES = 6, VT_MATERIALS = 8, VT_BLOB = 10 };
+  const flatbuffers::Vector<flatbuffers::Offset<Node>>* nodes() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Node>>*>( VT_NODES ); }
+  const flatbuffers::Vector<flatbuffers::Offset<Mesh>>* meshes() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Mesh>>*>( VT_MESHES ); }
+  const flatbuffers::Vector<flatbuffers::Offset<Material>>* materials() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Material>>*>( VT_MATERIALS ); }
+  const flatbuffers::Vector<uint8_t>* blob() const { return GetPointer<const flatbuffers::Vector<uint8_t>*>( VT_BLOB ); }
+};
+inline flatbuffers::Offset<Scene> CreateScene( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Node>>> nodes = 0, flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Mesh>>> meshes = 0, flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Material>>> materials = 0, flatbuffers::Offset<flatbuffers::Vector<uint8_t>> blob = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddOffset( Scene::VT_BLOB, blob );
+  fbb.AddOffset( Scene::VT_MATERIALS, materials );
+  fbb.AddOffset( Scene::VT_MESHES, meshes );
+  fbb.AddOffset( Scene::VT_NODES, nodes );
+  return flatbuffers::Offset<Scene>( fbb.EndTable( start ) );
+}
+inline const char* SceneIdentifier() { return "WVRS"; }
+inline const Scene* GetScene( const void* buf ) { return flatbuffers::GetRoot<Scene>( buf ); }
+inline bool VerifySceneBuffer( flatbuffers::Verifier& verifier ) { return verifier.VerifyBuffer<Scene>( "WVRS" ); }
+inline void FinishSceneBuffer( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<Scene> root ) { fbb.Finish( root, "WVRS" ); }
+}
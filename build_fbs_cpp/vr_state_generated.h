@@ -0,0 +1,96 @@
+#pragma once
+#include <flatbuffers/flatbuffers.h>
+namespace VR {
+struct GamepadButton;
+struct Pose;
+struct Gamepad;
+struct HMD;
+struct State;
+struct GamepadButton : private flatbuffers::Table {
+  enum { VT_PRESSED = 4, VT_TOUCHED = 6, VT_VALUE = 8 };
+  bool pressed() const { return GetField<uint8_t>( VT_PRESSED, false ) != 0; }
+  bool touched() const { return GetField<uint8_t>( VT_TOUCHED, false ) != 0; }
+  double value() const { return GetField<double>( VT_VALUE, 0 ); }
+};
+inline flatbuffers::Offset<GamepadButton> CreateGamepadButton( flatbuffers::FlatBufferBuilder& fbb, bool pressed = false, bool touched = false, double value = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddElement<double>( GamepadButton::VT_VALUE, static_cast<double>( value ), static_cast<double>( 0 ) );
+  fbb.AddElement<uint8_t>( GamepadButton::VT_TOUCHED, static_cast<uint8_t>( touched ), static_cast<uint8_t>( false ) );
+  fbb.AddElement<uint8_t>( GamepadButton::VT_PRESSED, static_cast<uint8_t>( pressed ), static_cast<uint8_t>( false ) );
+  return flatbuffers::Offset<GamepadButton>( fbb.EndTable( start ) );
+}
+struct Pose : private flatbuffers::Table {
+  enum { VT_POSITION = 4, VT_LINEARVELOCITY = 6, VT_LINEARACCELERATION = 8, VT_ORIENTATION = 10, VT_ANGULARVECLOCITY = 12, VT_ANGULARACCELERATION = 14 };
+  const flatbuffers::Vector<float>* position() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_POSITION ); }
+  const flatbuffers::Vector<float>* linearVelocity() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_LINEARVELOCITY ); }
+  const flatbuffers::Vector<float>* linearAcceleration() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_LINEARACCELERATION ); }
+  const flatbuffers::Vector<float>* orientation() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_ORIENTATION ); }
+  const flatbuffers::Vector<float>* angularVeclocity() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_ANGULARVECLOCITY ); }
+  const flatbuffers::Vector<float>* angularAcceleration() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_ANGULARACCELERATION ); }
+};
+inline flatbuffers::Offset<Pose> CreatePose( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::Vector<float>> position = 0, flatbuffers::Offset<flatbuffers::Vector<float>> linearVelocity = 0, flatbuffers::Offset<flatbuffers::Vector<float>> linearAcceleration = 0, flatbuffers::Offset<flatbuffers::Vector<float>> orientation = 0, flatbuffers::Offset<flatbuffers::Vector<float>> angularVeclocity = 0, flatbuffers::Offset<flatbuffers::Vector<float>> angularAcceleration = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddOffset( Pose::VT_ANGULARACCELERATION, angularAcceleration );
+  fbb.AddOffset( Pose::VT_ANGULARVECLOCITY, angularVeclocity );
+  fbb.AddOffset( Pose::VT_ORIENTATION, orientation );
+  fbb.AddOffset( Pose::VT_LINEARACCELERATION, linearAcceleration );
+  fbb.AddOffset( Pose::VT_LINEARVELOCITY, linearVelocity );
+  fbb.AddOffset( Pose::VT_POSITION, position );
+  return flatbuffers::Offset<Pose>( fbb.EndTable( start ) );
+}
+struct Gamepad : private flatbuffers::Table {
+  enum { VT_ID = 4, VT_INDEX = 6, VT_CONNECTED = 8, VT_MAPPING = 10, VT_AXES = 12, VT_BUTTONS = 14, VT_POSE = 16 };
+  const flatbuffers::String* id() const { return GetPointer<const flatbuffers::String*>( VT_ID ); }
+  int32_t index() const { return GetField<int32_t>( VT_INDEX, 0 ); }
+  bool connected() const { return GetField<uint8_t>( VT_CONNECTED, false ) != 0; }
+  const flatbuffers::String* mapping() const { return GetPointer<const flatbuffers::String*>( VT_MAPPING ); }
+  const flatbuffers::Vector<double>* axes() const { return GetPointer<const flatbuffers::Vector<double>*>( VT_AXES ); }
+  const flatbuffers::Vector<flatbuffers::Offset<GamepadButton>>* buttons() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<GamepadButton>>*>( VT_BUTTONS ); }
+  const Pose* pose() const { return GetPointer<const Pose*>( VT_POSE ); }
+};
+inline flatbuffers::Offset<Gamepad> CreateGamepad( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::String> id = 0, int32_t index = 0, bool connected = false, flatbuffers::Offset<flatbuffers::String> mapping = 0, flatbuffers::Offset<flatbuffers::Vector<double>> axes = 0, flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<GamepadButton>>> buttons = 0, flatbuffers::Offset<Pose> pose = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddOffset( Gamepad::VT_POSE, pose );
+  fbb.AddOffset( Gamepad::VT_BUTTONS, buttons );
+  fbb.AddOffset( Gamepad::VT_AXES, axes );
+  fbb.AddOffset( Gamepad::VT_MAPPING, mapping );
+  fbb.AddElement<uint8_t>( Gamepad::VT_CONNECTED, static_cast<uint8_t>( connected ), static_cast<uint8_t>( false ) );
+  fbb.AddElement<int32_t>( Gamepad::VT_INDEX, static_cast<int32_t>( index ), static_cast<int32_t>( 0 ) );
+  fbb.AddOffset( Gamepad::VT_ID, id );
+  return flatbuffers::Offset<Gamepad>( fbb.EndTable( start ) );
+}
+struct HMD : private flatbuffers::Table {
+  enum { VT_LEFTPROJECTIONMATRIX = 4, VT_LEFTVIEWMATRIX = 6, VT_RIGHTPROJECTIONMATRIX = 8, VT_RIGHTVIEWMATRIX = 10, VT_POSE = 12 };
+  const flatbuffers::Vector<float>* leftProjectionMatrix() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_LEFTPROJECTIONMATRIX ); }
+  const flatbuffers::Vector<float>* leftViewMatrix() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_LEFTVIEWMATRIX ); }
+  const flatbuffers::Vector<float>* rightProjectionMatrix() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_RIGHTPROJECTIONMATRIX ); }
+  const flatbuffers::Vector<float>* rightViewMatrix() const { return GetPointer<const flatbuffers::Vector<float>*>( VT_RIGHTVIEWMATRIX ); }
+  const Pose* pose() const { return GetPointer<const Pose*>( VT_POSE ); }
+};
+inline flatbuffers::Offset<HMD> CreateHMD( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<flatbuffers::Vector<float>> leftProjectionMatrix = 0, flatbuffers::Offset<flatbuffers::Vector<float>> leftViewMatrix = 0, flatbuffers::Offset<flatbuffers::Vector<float>> rightProjectionMatrix = 0, flatbuffers::Offset<flatbuffers::Vector<float>> rightViewMatrix = 0, flatbuffers::Offset<Pose> pose = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddOffset( HMD::VT_POSE, pose );
+  fbb.AddOffset( HMD::VT_RIGHTVIEWMATRIX, rightViewMatrix );
+  fbb.AddOffset( HMD::VT_RIGHTPROJECTIONMATRIX, rightProjectionMatrix );
+  fbb.AddOffset( HMD::VT_LEFTVIEWMATRIX, leftViewMatrix );
+  fbb.AddOffset( HMD::VT_LEFTPROJECTIONMATRIX, leftProjectionMatrix );
+  return flatbuffers::Offset<HMD>( fbb.EndTable( start ) );
+}
+struct State : private flatbuffers::Table {
+  enum { VT_TIMESTAMP = 4, VT_HMD = 6, VT_GAMEPADS = 8 };
+  double timestamp() const { return GetField<double>( VT_TIMESTAMP, 0 ); }
+  const HMD* hmd() const { return GetPointer<const HMD*>( VT_HMD ); }
+  const flatbuffers::Vector<flatbuffers::Offset<Gamepad>>* gamepads() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Gamepad>>*>( VT_GAMEPADS ); }
+};
+inline flatbuffers::Offset<State> CreateState( flatbuffers::FlatBufferBuilder& fbb, double timestamp = 0, flatbuffers::Offset<HMD> hmd = 0, flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Gamepad>>> gamepads = 0 ) {
+  const flatbuffers::uoffset_t start = fbb.StartTable();
+  fbb.AddOffset( State::VT_GAMEPADS, gamepads );
+  fbb.AddOffset( State::VT_HMD, hmd );
+  fbb.AddElement<double>( State::VT_TIMESTAMP, static_cast<double>( timestamp ), static_cast<double>( 0 ) );
+  return flatbuffers::Offset<State>( fbb.EndTable( start ) );
+}
+inline const char* StateIdentifier() { return nullptr; }
+inline const State* GetState( const void* buf ) { return flatbuffers::GetRoot<State>( buf ); }
+inline bool VerifyStateBuffer( flatbuffers::Verifier& verifier ) { return verifier.VerifyBuffer<State>( nullptr ); }
+inline void FinishStateBuffer( flatbuffers::FlatBufferBuilder& fbb, flatbuffers::Offset<State> root ) { fbb.Finish( root, nullptr ); }
+}
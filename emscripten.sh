@@ -9,10 +9,14 @@ mkdir -p build_fbs_js
 flatc -s -b -o build_fbs_js src_fbs/*.fbs
 cp $FLATBUFFERS/js/flatbuffers.js build_fbs_js
 
+# The native tests go first, so a frame that draws or uploads more than it should stops the build.
+./test.sh
+
 mkdir -p build_emscripten
 em++                                \
   --std=c++11                       \
   -Werror                           \
+  -msimd128                         \
   -s USE_WEBGL2=1                   \
   --preload-file src_asset          \
   -I $FLATBUFFERS/include           \
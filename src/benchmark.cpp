@@ -0,0 +1,263 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "camera.h"
+#include "clusters.h"
+#include "mesh.h"
+#include "particles.h"
+#include "raycast.h"
+#include "scene.h"
+#include "skinning.h"
+#include "util.h"
+
+namespace {
+    // Small deterministic generator so runs are comparable.
+    class Random {
+    public:
+        explicit Random( uint32_t seed )
+            : state_( seed ? seed : 1 ) {
+        }
+
+        uint32_t next() {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 17;
+            state_ ^= state_ << 5;
+            return state_;
+        }
+
+        // In [0, n).
+        uint32_t below( uint32_t n ) {
+            return n ? ( next() % n ) : 0;
+        }
+
+        // In [0, 1).
+        float unit() {
+            return static_cast<float>( next() >> 8 ) / static_cast<float>( 1 << 24 );
+        }
+
+    private:
+        uint32_t state_;
+    };
+
+    void touch( Scene& scene, int node, Random& random ) {
+        const float angle = random.unit() * 3.14159265f;
+        scene.set_rotation( node, cosf( angle ), 0.0f, sinf( angle ), 0.0f );
+    }
+
+    void time_scene_update( Scene& scene, int iterations, int touched_per_iteration, Random& random, const char* name ) {
+        const int     nodes      = static_cast<int>( scene.size() );
+        unsigned long recomputed = 0;
+        double        total_ms   = 0.0;
+        for( int i = 0; i < iterations; ++i ) {
+            for( int j = 0; j < touched_per_iteration; ++j ) {
+                touch( scene, random.below( nodes ), random );
+            }
+
+            const double begin_ms = emscripten_get_now();
+            recomputed += scene.update();
+            total_ms += emscripten_get_now() - begin_ms;
+        }
+
+        const double per_update_ms = total_ms / iterations;
+        const double per_node_ns   = recomputed ? ( total_ms * 1e6 / recomputed ) : 0.0;
+        STDOUT( "Scene update, %s: %.3lf ms per update, %lu matrices per update, %.2lf ns per matrix.",
+                name,
+                per_update_ms,
+                recomputed / iterations,
+                per_node_ns );
+    }
+}
+
+extern "C" {
+EMSCRIPTEN_KEEPALIVE void benchmark_scene_update( int nodes, int iterations ) {
+    if( ( nodes < 1 ) || ( iterations < 1 ) ) {
+        STDERR( "Need at least one node and one iteration." );
+        return;
+    }
+
+    Random random( 12345 );
+    Scene  scene;
+    scene.reserve( nodes );
+    for( int i = 0; i < nodes; ++i ) {
+        // Mostly attach to a recent node, which gives a mix of deep chains and wide fans.
+        const bool root   = ( i == 0 ) || ( random.below( 64 ) == 0 );
+        const int  parent = root ? Scene::NONE : i - 1 - static_cast<int>( random.below( std::min( i, 64 ) ) );
+        const int  node   = scene.add_node( parent );
+        scene.set_translation( node, random.unit(), random.unit(), random.unit() );
+        touch( scene, node, random );
+    }
+
+    STDOUT( "Benchmarking scene update with %d nodes over %d iterations.", nodes, iterations );
+    time_scene_update( scene, 1, 0, random, "first" );
+    time_scene_update( scene, iterations, nodes, random, "all changed" );
+    time_scene_update( scene, iterations, std::max( nodes / 100, 1 ), random, "1% changed" );
+    time_scene_update( scene, iterations, 0, random, "unchanged" );
+}
+
+EMSCRIPTEN_KEEPALIVE void benchmark_light_binning( int lights, int iterations ) {
+    if( ( lights < 1 ) || ( iterations < 1 ) ) {
+        STDERR( "Need at least one light and one iteration." );
+        return;
+    }
+
+    // Lights of up to a few metres scattered through a room sized box around the eyes.
+    Random                  random( 12345 );
+    std::vector<PointLight> scattered( lights );
+    for( PointLight& light : scattered ) {
+        light.position[0] = 20.0f * random.unit() - 10.0f;
+        light.position[1] = 6.0f * random.unit() - 3.0f;
+        light.position[2] = 20.0f * random.unit() - 10.0f;
+        light.radius      = 0.5f + 2.5f * random.unit();
+        light.color[0]    = random.unit();
+        light.color[1]    = random.unit();
+        light.color[2]    = random.unit();
+        light.intensity   = 1.0f;
+    }
+    LightClusters clusters;
+    clusters.set_lights( scattered );
+
+    // Two eyes 64 mm apart with a 100 degree field of view each, as column major WebVR matrices.
+    CameraMatrices cameras[2];
+    const GLfloat  NEAR_PLANE = 0.05f;
+    const GLfloat  FAR_PLANE  = 100.0f;
+    const GLfloat  focal      = 1.0f / tanf( 0.5f * 100.0f * 3.14159265f / 180.0f );
+    for( int eye = 0; eye < 2; ++eye ) {
+        camera_identity( cameras[eye] );
+        cameras[eye].view[12]       = eye ? -0.032f : 0.032f;
+        cameras[eye].projection[0]  = focal;
+        cameras[eye].projection[5]  = focal;
+        cameras[eye].projection[10] = ( FAR_PLANE + NEAR_PLANE ) / ( NEAR_PLANE - FAR_PLANE );
+        cameras[eye].projection[11] = -1.0f;
+        cameras[eye].projection[14] = 2.0f * FAR_PLANE * NEAR_PLANE / ( NEAR_PLANE - FAR_PLANE );
+        cameras[eye].projection[15] = 0.0f;
+    }
+
+    STDOUT( "Benchmarking light binning with %d lights over %d iterations.", lights, iterations );
+    for( int i = 0; i < iterations; ++i ) {
+        clusters.bin( cameras, 2 );
+    }
+    const ClusterStats& stats = clusters.stats();
+    STDOUT( "Light binning: %.3lf ms per frame, %lu light references, at most %u lights in a cluster, %.1lf ns per light.",
+            stats.bin_ms / stats.frames,
+            static_cast<unsigned long>( stats.last_references ),
+            stats.last_max_per_cluster,
+            stats.bin_ms * 1e6 / stats.frames / lights );
+}
+
+EMSCRIPTEN_KEEPALIVE void benchmark_skinning( int characters, int iterations ) {
+    if( ( characters < 1 ) || ( iterations < 1 ) ) {
+        STDERR( "Need at least one character and one iteration." );
+        return;
+    }
+
+    std::vector<Skeleton> skeletons( 1 );
+    std::vector<Mesh>     meshes( 1 );
+    skinned_create_avatar( skeletons[0], meshes[0] );
+    SkinningPalette palette;
+    for( int i = 0; i < characters; ++i ) {
+        palette.add( skeletons, 0, 0, 0.37f * i );
+    }
+
+    STDOUT( "Benchmarking skinning with %d characters of %lu bones over %d iterations.",
+            characters,
+            static_cast<unsigned long>( skeletons[0].bones() ),
+            iterations );
+    for( int i = 0; i < iterations; ++i ) {
+        palette.update( skeletons, meshes, i / 90.0 );
+    }
+    const SkinningStats& stats = palette.stats();
+    STDOUT( "Skinning: %.3lf ms per frame for %lu bones, %.1lf ns per bone.",
+            stats.update_ms / stats.frames,
+            static_cast<unsigned long>( stats.last_bones ),
+            stats.update_ms * 1e6 / stats.frames / stats.last_bones );
+}
+
+EMSCRIPTEN_KEEPALIVE void benchmark_particles( int particles, int iterations ) {
+    if( ( particles < 1 ) || ( iterations < 1 ) ) {
+        STDERR( "Need at least one particle and one iteration." );
+        return;
+    }
+
+    // Motes in a box, emitted as fast as they die so the count stays about where it starts.
+    ParticleSystem system;
+    system.set_capacity( PARTICLE_MOTE, particles );
+    const GLfloat MOTE_LIFE = 5.0f;
+    const int     emitter   = system.add_emitter( PARTICLE_MOTE, particles / MOTE_LIFE );
+    // clang-format off
+    const GLfloat box[4 * 4] = {
+        2.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 2.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f};
+    // clang-format on
+    system.set_emitter( emitter, box, nullptr, 1.0f );
+    system.emit( emitter, particles );
+
+    STDOUT( "Benchmarking particles with %d particles over %d iterations.", particles, iterations );
+    // At 90 Hz, the first update only starting the clock.
+    for( int i = 0; i <= iterations; ++i ) {
+        system.update( i * 1000.0 / 90.0 );
+    }
+    const ParticleStats& stats = system.stats();
+    STDOUT( "Particles: %.3lf ms per frame for %lu particles, %.0lf particles updated per ms.",
+            stats.update_ms / stats.frames,
+            static_cast<unsigned long>( stats.last_alive ),
+            stats.particles / stats.update_ms );
+}
+
+EMSCRIPTEN_KEEPALIVE void benchmark_raycast( int rings, int rays ) {
+    if( ( rings < 2 ) || ( rays < 1 ) ) {
+        STDERR( "Need at least two rings and one ray." );
+        return;
+    }
+
+    // The build is timed in the same slices as between frames, to show the longest one too.
+    const Mesh   sphere   = mesh_create_sphere( 1.0f, rings, 2 * rings );
+    const double SLICE_MS = 2.0;
+    TriangleBvh  tree;
+    tree.begin( sphere );
+    int    slices  = 0;
+    double longest = 0.0;
+    bool   built   = false;
+    while( !built ) {
+        const double begin_ms = emscripten_get_now();
+        built                 = tree.step( sphere, begin_ms + SLICE_MS );
+        longest               = std::max( longest, emscripten_get_now() - begin_ms );
+        ++slices;
+    }
+    STDOUT( "Benchmarking ray casts against %lu triangles: built in %.1lf ms over %d slices, the longest %.1lf ms, "
+            "into %lu nodes in %.1lf MB.",
+            static_cast<unsigned long>( tree.triangles() ),
+            tree.build_ms(),
+            slices,
+            longest,
+            static_cast<unsigned long>( tree.nodes() ),
+            tree.bytes() / ( 1024.0 * 1024.0 ) );
+
+    // From random points of a box around the sphere towards random points near its centre.
+    Random               random( 7 );
+    std::vector<GLfloat> origins( 3 * rays );
+    std::vector<GLfloat> directions( 3 * rays );
+    for( int i = 0; i < rays; ++i ) {
+        for( int k = 0; k < 3; ++k ) {
+            origins[3 * i + k]    = 4.0f * random.unit() - 2.0f;
+            directions[3 * i + k] = 2.0f * random.unit() - 1.0f - origins[3 * i + k];
+        }
+    }
+    int          hits     = 0;
+    const double begin_ms = emscripten_get_now();
+    for( int i = 0; i < rays; ++i ) {
+        GLfloat distance = HUGE_VALF;
+        int32_t triangle = -1;
+        GLfloat barycentric[2];
+        hits += tree.intersect( &origins[3 * i], &directions[3 * i], distance, triangle, barycentric ) ? 1 : 0;
+    }
+    const double cast_ms = emscripten_get_now() - begin_ms;
+    STDOUT( "Ray casts: %d rays, %d hits in %.3lf ms, %.0lf rays per second.", rays, hits, cast_ms, 1000.0 * rays / cast_ms );
+}
+}
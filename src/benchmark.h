@@ -0,0 +1,21 @@
+#ifndef WASMVR_BENCHMARK_H
+#define WASMVR_BENCHMARK_H
+
+// Micro benchmarks of the engine's hot paths. They are exported to JS so they can be run from
+// the browser console against the real build, e.g. Module._benchmark_scene_update( 100000, 100 ).
+extern "C" {
+// Times Scene::update() on a random hierarchy, with every node and with 1% of the nodes changed.
+void benchmark_scene_update( int nodes, int iterations );
+// Times binning random lights into the clusters of a pair of eyes, e.g. with 1000 and 10000 lights.
+void benchmark_light_binning( int lights, int iterations );
+// Times posing the bone palettes of a crowd of animated figures, e.g. with 10, 100 and 500 of them.
+// Only the CPU side, the GPU side shows in the scene's GPU time with that many figures in view (K).
+void benchmark_skinning( int characters, int iterations );
+// Times updating a steady field of particles, e.g. with 10000 and 100000 of them.
+void benchmark_particles( int particles, int iterations );
+// Times building a sphere's triangle BVH and casting random rays at it, e.g. with 200 and 1000 rings for
+// about 160 thousand and 4 million triangles.
+void benchmark_raycast( int rings, int rays );
+}
+
+#endif // WASMVR_BENCHMARK_H
@@ -0,0 +1,301 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <emscripten.h>
+
+#include "frustum.h"
+#include "jobs.h"
+#include "scene.h"
+#include "util.h"
+
+namespace {
+    // Deep enough for any tree this can build, since splits are at the median.
+    const int STACK_SIZE = 64;
+
+    void box_empty( GLfloat* box ) {
+        for( int i = 0; i < 3; ++i ) {
+            box[i]     = 1e30f;
+            box[3 + i] = -1e30f;
+        }
+    }
+
+    void box_grow( GLfloat* box, const GLfloat* other ) {
+        for( int i = 0; i < 3; ++i ) {
+            box[i]     = std::min( box[i], other[i] );
+            box[3 + i] = std::max( box[3 + i], other[3 + i] );
+        }
+    }
+
+    void cull_subtree( const Bvh& bvh, const Scene& scene, const Frustum& combined, const Frustum* eyes, int32_t root, CullResult& result ) {
+        const std::vector<BvhNode>& nodes = bvh.nodes();
+        const std::vector<int32_t>& items = bvh.items();
+
+        int32_t stack[STACK_SIZE];
+        int     top  = 0;
+        stack[top++] = root;
+        while( top > 0 ) {
+            const BvhNode& node = nodes[stack[--top]];
+            ++result.visited;
+            if( !frustum_intersects_box( combined, node.bounds ) ) {
+                result.culled += node.count;
+                continue;
+            }
+            if( node.left >= 0 ) {
+                stack[top++] = node.left + 1;
+                stack[top++] = node.left;
+                continue;
+            }
+
+            // Only leaves are worth testing against each eye on its own. Hidden items count as culled here
+            // as they do in a culled subtree, so the count doesn't depend on where the tree splits.
+            for( int32_t i = node.first; i < node.first + node.count; ++i ) {
+                const int32_t item = items[i];
+                if( !scene.visible( item ) ) {
+                    ++result.culled;
+                    continue;
+                }
+                const GLfloat* box  = scene.world_bounds( item );
+                const uint8_t  mask = ( frustum_intersects_box( eyes[0], box ) ? 1 : 0 ) |
+                                     ( frustum_intersects_box( eyes[1], box ) ? 2 : 0 );
+                if( mask ) {
+                    result.nodes.push_back( item );
+                    result.eyes.push_back( mask );
+                } else {
+                    ++result.culled;
+                }
+            }
+        }
+    }
+}
+
+BvhStats::BvhStats()
+    : builds( 0 )
+    , refits( 0 )
+    , refit_nodes( 0 ) {
+}
+
+Bvh::Bvh()
+    : built_( false )
+    , topology_version_( 0 ) {
+}
+
+void Bvh::build( const Scene& scene ) {
+    const size_t scene_size = scene.size();
+    nodes_.clear();
+    items_.clear();
+    leaf_of_.assign( scene_size, -1 );
+
+    std::vector<GLfloat> centroids( 3 * scene_size );
+    for( size_t i = 0; i < scene_size; ++i ) {
+        const int node = static_cast<int>( i );
+        if( !scene.has_bounds( node ) ) {
+            continue;
+        }
+        items_.push_back( node );
+        const GLfloat* box = scene.world_bounds( node );
+        for( int k = 0; k < 3; ++k ) {
+            centroids[3 * i + k] = 0.5f * ( box[k] + box[3 + k] );
+        }
+    }
+
+    if( !items_.empty() ) {
+        nodes_.resize( 1 );
+        nodes_[0].parent = -1;
+        build_node( scene, 0, 0, static_cast<int32_t>( items_.size() ), centroids );
+    }
+
+    dirty_.assign( nodes_.size(), 0 );
+    built_            = true;
+    topology_version_ = scene.topology_version();
+    ++stats_.builds;
+}
+
+void Bvh::build_node( const Scene& scene, int32_t index, int32_t first, int32_t count, const std::vector<GLfloat>& centroids ) {
+    nodes_[index].left  = -1;
+    nodes_[index].first = first;
+    nodes_[index].count = count;
+
+    if( count <= LEAF_SIZE ) {
+        for( int32_t i = first; i < first + count; ++i ) {
+            leaf_of_[items_[i]] = index;
+        }
+        fit_node( scene, index );
+        return;
+    }
+
+    // Split at the median along the axis the centroids spread the most.
+    GLfloat spread[6];
+    box_empty( spread );
+    for( int32_t i = first; i < first + count; ++i ) {
+        const GLfloat* c     = &centroids[3 * items_[i]];
+        const GLfloat  at[6] = {c[0], c[1], c[2], c[0], c[1], c[2]};
+        box_grow( spread, at );
+    }
+    int axis = 0;
+    for( int k = 1; k < 3; ++k ) {
+        if( spread[3 + k] - spread[k] > spread[3 + axis] - spread[axis] ) {
+            axis = k;
+        }
+    }
+
+    const int32_t middle = first + count / 2;
+    std::nth_element(
+        items_.begin() + first,
+        items_.begin() + middle,
+        items_.begin() + first + count,
+        [&]( int32_t a, int32_t b ) { return centroids[3 * a + axis] < centroids[3 * b + axis]; } );
+
+    const int32_t left = static_cast<int32_t>( nodes_.size() );
+    nodes_.resize( left + 2 );
+    nodes_[left].parent     = index;
+    nodes_[left + 1].parent = index;
+    nodes_[index].left      = left;
+
+    build_node( scene, left, first, middle - first, centroids );
+    build_node( scene, left + 1, middle, first + count - middle, centroids );
+    fit_node( scene, index );
+}
+
+void Bvh::fit_node( const Scene& scene, int32_t index ) {
+    BvhNode& node = nodes_[index];
+    box_empty( node.bounds );
+    if( node.left >= 0 ) {
+        box_grow( node.bounds, nodes_[node.left].bounds );
+        box_grow( node.bounds, nodes_[node.left + 1].bounds );
+    } else {
+        for( int32_t i = node.first; i < node.first + node.count; ++i ) {
+            box_grow( node.bounds, scene.world_bounds( items_[i] ) );
+        }
+    }
+}
+
+void Bvh::refit( const Scene& scene ) {
+    if( !built_ || ( topology_version_ != scene.topology_version() ) ) {
+        build( scene );
+        return;
+    }
+
+    const std::vector<int32_t>& changed = scene.changed();
+    if( changed.empty() || nodes_.empty() ) {
+        return;
+    }
+
+    // Mark the path from each moved item's leaf up to the first node that is already marked.
+    int32_t lowest = static_cast<int32_t>( nodes_.size() );
+    for( int32_t scene_node : changed ) {
+        for( int32_t i = leaf_of_[scene_node]; ( i >= 0 ) && !dirty_[i]; i = nodes_[i].parent ) {
+            dirty_[i] = 1;
+            lowest    = std::min( lowest, i );
+        }
+    }
+
+    // Children come after their parents, so a backwards sweep fits them first.
+    for( int32_t i = static_cast<int32_t>( nodes_.size() ) - 1; i >= lowest; --i ) {
+        if( dirty_[i] ) {
+            fit_node( scene, i );
+            dirty_[i] = 0;
+            ++stats_.refit_nodes;
+        }
+    }
+    ++stats_.refits;
+}
+
+const std::vector<BvhNode>& Bvh::nodes() const {
+    return nodes_;
+}
+
+const std::vector<int32_t>& Bvh::items() const {
+    return items_;
+}
+
+const BvhStats& Bvh::stats() const {
+    return stats_;
+}
+
+CullResult::CullResult()
+    : visited( 0 )
+    , culled( 0 ) {
+}
+
+void CullResult::clear() {
+    nodes.clear();
+    eyes.clear();
+    visited = 0;
+    culled  = 0;
+}
+
+CullStats::CullStats()
+    : frames( 0 )
+    , visited( 0 )
+    , culled( 0 )
+    , visible( 0 ) {
+}
+
+void BvhCuller::cull( const Bvh& bvh, const Scene& scene, const Frustum& combined, const Frustum* eyes ) {
+    const double begin_ms = emscripten_get_now();
+
+    const std::vector<BvhNode>& nodes = bvh.nodes();
+    subtrees_.clear();
+    if( !nodes.empty() ) {
+        subtrees_.push_back( 0 );
+    }
+    for( int depth = 0; depth < SPLIT_DEPTH; ++depth ) {
+        const size_t count = subtrees_.size();
+        for( size_t i = 0; i < count; ++i ) {
+            const BvhNode& node = nodes[subtrees_[i]];
+            if( node.left >= 0 ) {
+                subtrees_[i] = node.left;
+                subtrees_.push_back( node.left + 1 );
+            }
+        }
+    }
+
+    if( partials_.size() < subtrees_.size() ) {
+        partials_.resize( subtrees_.size() );
+    }
+    parallel_for( subtrees_.size(), [&]( size_t i ) {
+        partials_[i].clear();
+        cull_subtree( bvh, scene, combined, eyes, subtrees_[i], partials_[i] );
+    } );
+
+    result_.clear();
+    for( size_t i = 0; i < subtrees_.size(); ++i ) {
+        const CullResult& partial = partials_[i];
+        result_.nodes.insert( result_.nodes.end(), partial.nodes.begin(), partial.nodes.end() );
+        result_.eyes.insert( result_.eyes.end(), partial.eyes.begin(), partial.eyes.end() );
+        result_.visited += partial.visited;
+        result_.culled += partial.culled;
+    }
+
+    ++stats_.frames;
+    stats_.visited += result_.visited;
+    stats_.culled += result_.culled;
+    stats_.visible += result_.nodes.size();
+    stats_.ms.add( emscripten_get_now() - begin_ms );
+}
+
+const CullResult& BvhCuller::result() const {
+    return result_;
+}
+
+const CullStats& BvhCuller::stats() const {
+    return stats_;
+}
+
+void print_bvh_stats( const Bvh& bvh, const BvhCuller& culler ) {
+    const BvhStats&  tree   = bvh.stats();
+    const CullStats& cull   = culler.stats();
+    const double     frames = cull.frames ? static_cast<double>( cull.frames ) : 1.0;
+    STDOUT( "BVH: %lu nodes over %lu items, %u builds, %lu refits of %lu nodes.",
+            static_cast<unsigned long>( bvh.nodes().size() ),
+            static_cast<unsigned long>( bvh.items().size() ),
+            tree.builds,
+            tree.refits,
+            tree.refit_nodes );
+    STDOUT( "Culling per frame: %.1lf nodes visited, %.1lf items culled, %.1lf items visible, mean %.3lf ms, max %.3lf ms.",
+            cull.visited / frames,
+            cull.culled / frames,
+            cull.visible / frames,
+            cull.ms.mean(),
+            cull.ms.max );
+}
@@ -0,0 +1,101 @@
+#ifndef WASMVR_BVH_H
+#define WASMVR_BVH_H
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <vector>
+
+#include "frame.h"
+
+class Scene;
+struct Frustum;
+
+struct BvhNode {
+    GLfloat bounds[6]; // Min x, y, z followed by max x, y, z.
+    int32_t parent;
+    int32_t left;  // Internal nodes only, the right child always follows the left one. -1 for leaves.
+    int32_t first; // Items of the whole subtree are items[first, first + count).
+    int32_t count;
+};
+
+struct BvhStats {
+    unsigned int  builds;
+    unsigned long refits;
+    unsigned long refit_nodes;
+
+    BvhStats();
+};
+
+// Bounding volume hierarchy over the scene nodes that have bounds. Children are stored after their parents,
+// so a backwards sweep refits only the nodes above items that moved. The tree is rebuilt when nodes
+// are added or gain bounds, which the scene reports through its topology version.
+class Bvh {
+public:
+    static const int LEAF_SIZE = 4;
+
+    Bvh();
+
+    void build( const Scene& scene );
+    // Brings the boxes up to date after Scene::update(), rebuilding if the topology changed.
+    void refit( const Scene& scene );
+
+    const std::vector<BvhNode>& nodes() const;
+    const std::vector<int32_t>& items() const;
+    const BvhStats&             stats() const;
+
+private:
+    void build_node( const Scene& scene, int32_t index, int32_t first, int32_t count, const std::vector<GLfloat>& centroids );
+    void fit_node( const Scene& scene, int32_t index );
+
+    std::vector<BvhNode> nodes_;
+    std::vector<int32_t> items_;
+    std::vector<int32_t> leaf_of_; // By scene node, -1 if not in the tree.
+    std::vector<uint8_t> dirty_;
+    bool                 built_;
+    unsigned int         topology_version_;
+    BvhStats             stats_;
+};
+
+// Scene nodes that survived culling, with a bit per eye they are visible in.
+struct CullResult {
+    std::vector<int32_t> nodes;
+    std::vector<uint8_t> eyes;
+    unsigned int         visited; // BVH nodes tested.
+    unsigned int         culled;  // Items of the tree not returned, hidden ones included, so culled plus returned is every item.
+
+    CullResult();
+    void clear();
+};
+
+struct CullStats {
+    unsigned long frames;
+    unsigned long visited;
+    unsigned long culled;
+    unsigned long visible;
+    SampleStats   ms;
+
+    CullStats();
+};
+
+// Culls the tree against a frustum covering both eyes, refining against each eye only at the leaves.
+// The top of the tree is split into independent subtrees, each culled into its own partial result.
+class BvhCuller {
+public:
+    // Subtrees start this many levels below the root.
+    static const int SPLIT_DEPTH = 2;
+
+    void cull( const Bvh& bvh, const Scene& scene, const Frustum& combined, const Frustum* eyes );
+
+    const CullResult& result() const;
+    const CullStats&  stats() const;
+
+private:
+    std::vector<int32_t>    subtrees_;
+    std::vector<CullResult> partials_;
+    CullResult              result_;
+    CullStats               stats_;
+};
+
+void print_bvh_stats( const Bvh& bvh, const BvhCuller& culler );
+
+#endif // WASMVR_BVH_H
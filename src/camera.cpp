@@ -0,0 +1,75 @@
+#include "camera.h"
+
+#include <string.h>
+
+#include "residency.h"
+#include "user_context.h"
+#include "util.h"
+
+const GLuint CAMERA_BINDING = 0;
+const int    CAMERA_SLOTS   = 2;
+
+GLuint camera_block_bind( GLuint program ) {
+    const GLuint block = glGetUniformBlockIndex( program, "Camera" );
+    if( block == GL_INVALID_INDEX ) {
+        STDERR( "Failed to find Camera uniform block in program %u.", program );
+        return GL_INVALID_INDEX;
+    }
+    glUniformBlockBinding( program, block, CAMERA_BINDING );
+    return block;
+}
+
+bool camera_buffer_create( UserContext& user_context ) {
+    user_context.camera_block = camera_block_bind( user_context.program );
+    if( user_context.camera_block == GL_INVALID_INDEX ) {
+        return false;
+    }
+
+    // Each slot has to start at a multiple of the offset alignment to be bound with glBindBufferRange.
+    GLint alignment = 1;
+    glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+    const GLint size           = sizeof( CameraMatrices );
+    user_context.camera_stride = ( ( size + alignment - 1 ) / alignment ) * alignment;
+
+    glGenBuffers( 1, &user_context.camera_buffer );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    user_context.gl_state.bind_buffer( GL_UNIFORM_BUFFER, user_context.camera_buffer );
+    glBufferData( GL_UNIFORM_BUFFER, user_context.camera_stride * CAMERA_SLOTS, nullptr, GL_DYNAMIC_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, user_context.camera_buffer, user_context.camera_stride * CAMERA_SLOTS );
+
+    STDOUT( "camera_block    = %u", user_context.camera_block );
+    STDOUT( "camera_stride   = %d", user_context.camera_stride );
+    return true;
+}
+
+void camera_buffer_upload( UserContext& user_context, const CameraMatrices* cameras, int count ) {
+    user_context.gl_state.bind_buffer( GL_UNIFORM_BUFFER, user_context.camera_buffer );
+    for( int i = 0; ( i < count ) && ( i < CAMERA_SLOTS ); ++i ) {
+        glBufferSubData( GL_UNIFORM_BUFFER, i * user_context.camera_stride, sizeof( CameraMatrices ), &cameras[i] );
+        user_context.frame_budget.count_bytes_uploaded( sizeof( CameraMatrices ) );
+    }
+}
+
+void camera_buffer_bind( UserContext& user_context, int slot ) {
+    user_context.gl_state.bind_buffer_range(
+        GL_UNIFORM_BUFFER,
+        CAMERA_BINDING,
+        user_context.camera_buffer,
+        slot * user_context.camera_stride,
+        sizeof( CameraMatrices ) );
+}
+
+void camera_identity( CameraMatrices& camera ) {
+    memcpy( camera.view, identity4, sizeof( camera.view ) );
+    memcpy( camera.projection, identity4, sizeof( camera.projection ) );
+    const GLfloat no_clusters[4] = {-1.0f, 0.0f, 0.0f, 0.0f};
+    memcpy( camera.clusters, no_clusters, sizeof( camera.clusters ) );
+}
+
+void camera_position( const CameraMatrices& camera, GLfloat* position ) {
+    // The view matrix is [R t], so the camera sits at -R^T t.
+    const GLfloat* v = camera.view;
+    for( int i = 0; i < 3; ++i ) {
+        position[i] = -( v[4 * i + 0] * v[12] + v[4 * i + 1] * v[13] + v[4 * i + 2] * v[14] );
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef WASMVR_CAMERA_H
+#define WASMVR_CAMERA_H
+
+#include <GLES3/gl3.h>
+
+class UserContext;
+
+// Matches the std140 layout of the Camera uniform block in the shaders.
+struct CameraMatrices {
+    GLfloat view[4 * 4];
+    GLfloat projection[4 * 4];
+    // Which clustered light lists this camera uses and how its depth maps to slices, see LightClusters::bin().
+    // A negative first element turns clustered lights off.
+    GLfloat clusters[4];
+};
+
+extern const GLuint CAMERA_BINDING;
+extern const int    CAMERA_SLOTS;
+
+// Hooks a program's Camera block up to the camera buffer's binding and returns the block's index.
+GLuint camera_block_bind( GLuint program );
+// Creates the uniform buffer holding one camera per slot (i.e. per eye) and hooks up the program's block.
+bool camera_buffer_create( UserContext& user_context );
+void camera_buffer_upload( UserContext& user_context, const CameraMatrices* cameras, int count );
+void camera_buffer_bind( UserContext& user_context, int slot );
+
+void camera_identity( CameraMatrices& camera );
+// World space position of a camera with a rigid (column major) view matrix.
+void camera_position( const CameraMatrices& camera, GLfloat* position );
+
+#endif // WASMVR_CAMERA_H
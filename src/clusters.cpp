@@ -0,0 +1,317 @@
+#include "clusters.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "camera.h"
+#include "gles.h"
+#include "jobs.h"
+#include "residency.h"
+#include "simd.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    // Where the first slice starts for binning, keeping lights around the eye away from a division by zero.
+    const GLfloat MIN_DEPTH = 0.001f;
+
+    GLfloat slice_depth( int slice ) {
+        return LightClusters::NEAR * powf( LightClusters::FAR / LightClusters::NEAR, static_cast<GLfloat>( slice ) / LightClusters::SLICES );
+    }
+}
+
+const GLfloat LightClusters::NEAR = 0.1f;
+const GLfloat LightClusters::FAR  = 100.0f;
+
+ClusterStats::ClusterStats()
+    : frames( 0 )
+    , references( 0 )
+    , bin_ms( 0.0 )
+    , last_max_per_cluster( 0 )
+    , last_references( 0 ) {
+}
+
+LightClusters::LightClusters()
+    : lights_changed_( false )
+    , cameras_( 0 )
+    , cluster_texture_( 0 )
+    , index_texture_( 0 )
+    , light_texture_( 0 )
+    , index_rows_( 0 )
+    , light_rows_( 0 ) {
+}
+
+bool LightClusters::create( UserContext& user_context ) {
+    // A row per slice of each camera, with a texel per tile.
+    cluster_texture_ = gles_create_data_texture( CLUSTER_UNIT, GL_RG32UI, TILES, 2 * SLICES );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    if( !cluster_texture_ ||
+        !grow_texture( user_context, index_texture_, LIGHT_INDEX_UNIT, GL_R16UI, index_rows_, 1 ) ||
+        !grow_texture( user_context, light_texture_, LIGHT_UNIT, GL_RGBA32F, light_rows_, 1 ) ) {
+        STDERR( "Failed to create light cluster textures." );
+        return false;
+    }
+
+    GLState&     gl          = user_context.gl_state;
+    const GLuint programs[2] = {user_context.program, user_context.skinned_program};
+    for( GLuint program : programs ) {
+        gl.use_program( program );
+        gl.uniform_1i( glGetUniformLocation( program, "usampler2D_clusters" ), CLUSTER_UNIT );
+        gl.uniform_1i( glGetUniformLocation( program, "usampler2D_light_indices" ), LIGHT_INDEX_UNIT );
+        gl.uniform_1i( glGetUniformLocation( program, "sampler2D_lights" ), LIGHT_UNIT );
+    }
+    lights_changed_ = true;
+    return true;
+}
+
+void LightClusters::release() {
+    GLuint textures[3] = {cluster_texture_, index_texture_, light_texture_};
+    for( GLuint texture : textures ) {
+        gpu_memory_freed( GPU_MEMORY_TEXTURE, texture );
+    }
+    glDeleteTextures( 3, textures );
+    cluster_texture_ = 0;
+    index_texture_   = 0;
+    light_texture_   = 0;
+    index_rows_      = 0;
+    light_rows_      = 0;
+}
+
+void LightClusters::set_lights( const std::vector<PointLight>& lights ) {
+    lights_ = lights;
+    if( lights_.size() > static_cast<size_t>( MAX_LIGHTS ) ) {
+        STDERR( "Only using %d of %lu lights.", MAX_LIGHTS, static_cast<unsigned long>( lights_.size() ) );
+        lights_.resize( MAX_LIGHTS );
+    }
+    const size_t padded = ( lights_.size() + 3 ) & ~static_cast<size_t>( 3 );
+    for( int i = 0; i < 3; ++i ) {
+        world_[i].assign( padded, 0.0f );
+    }
+    // A negative radius makes a light's depth range empty, so padding is never binned.
+    world_[3].assign( padded, -1.0f );
+    for( size_t i = 0; i < lights_.size(); ++i ) {
+        for( int j = 0; j < 3; ++j ) {
+            world_[j][i] = lights_[i].position[j];
+        }
+        world_[3][i] = lights_[i].radius;
+    }
+    lights_changed_ = true;
+}
+
+const std::vector<PointLight>& LightClusters::lights() const {
+    return lights_;
+}
+
+void LightClusters::bin( CameraMatrices* cameras, int count ) {
+    const double begin_ms = emscripten_get_now();
+    cameras_              = std::min( std::max( count, 0 ), 2 );
+
+    const GLfloat scale  = SLICES / logf( FAR / NEAR );
+    const size_t  padded = world_[0].size();
+    for( int camera = 0; camera < cameras_; ++camera ) {
+        // Into view space, four lights at a time.
+        const GLfloat* v = cameras[camera].view;
+        for( int i = 0; i < 3; ++i ) {
+            view_[camera][i].resize( padded );
+        }
+        parallel_for( padded / 4, [&]( size_t group ) {
+            const size_t first = 4 * group;
+            const float4 x     = float4_load( &world_[0][first] );
+            const float4 y     = float4_load( &world_[1][first] );
+            const float4 z     = float4_load( &world_[2][first] );
+            // Column major, and the camera looks down -z.
+            float4_store( &view_[camera][0][first], float4_splat( v[0] ) * x + float4_splat( v[4] ) * y + float4_splat( v[8] ) * z + float4_splat( v[12] ) );
+            float4_store( &view_[camera][1][first], float4_splat( v[1] ) * x + float4_splat( v[5] ) * y + float4_splat( v[9] ) * z + float4_splat( v[13] ) );
+            float4_store( &view_[camera][2][first], -( float4_splat( v[2] ) * x + float4_splat( v[6] ) * y + float4_splat( v[10] ) * z + float4_splat( v[14] ) ) );
+        } );
+
+        // The shader finds its slice as log( depth ) * scale + bias.
+        GLfloat* clusters = cameras[camera].clusters;
+        clusters[0]       = static_cast<GLfloat>( camera );
+        clusters[1]       = scale;
+        clusters[2]       = -logf( NEAR ) * scale;
+        clusters[3]       = 0.0f;
+    }
+
+    // Every slice of every camera only writes its own job.
+    jobs_.resize( cameras_ * SLICES );
+    parallel_for( jobs_.size(), [&]( size_t job ) {
+        const int camera = static_cast<int>( job ) / SLICES;
+        bin_slice( camera, static_cast<int>( job ) % SLICES, cameras[camera], jobs_[job] );
+    } );
+
+    // Then all lists go back to back, in the order the cluster texture has their slices.
+    clusters_.resize( 2 * cameras_ * SLICES * TILES );
+    indices_.clear();
+    uint32_t max_per_cluster = 0;
+    for( size_t job = 0; job < jobs_.size(); ++job ) {
+        const SliceJob& sliced = jobs_[job];
+        const uint32_t  base   = static_cast<uint32_t>( indices_.size() );
+        for( int tile = 0; tile < TILES; ++tile ) {
+            uint32_t* cluster = &clusters_[2 * ( job * TILES + tile )];
+            cluster[0]        = base + sliced.first[tile];
+            cluster[1]        = sliced.count[tile];
+            max_per_cluster   = std::max( max_per_cluster, sliced.count[tile] );
+        }
+        indices_.insert( indices_.end(), sliced.indices.begin(), sliced.indices.end() );
+    }
+
+    ++stats_.frames;
+    stats_.references += indices_.size();
+    stats_.bin_ms += emscripten_get_now() - begin_ms;
+    stats_.last_references      = indices_.size();
+    stats_.last_max_per_cluster = max_per_cluster;
+}
+
+void LightClusters::bin_slice( int camera, int slice, const CameraMatrices& matrices, SliceJob& job ) {
+    const float4 near = float4_splat( slice ? slice_depth( slice ) : MIN_DEPTH );
+    const float4 far  = float4_splat( ( slice + 1 < SLICES ) ? slice_depth( slice + 1 ) : FLT_MAX );
+
+    // With a symmetric or off axis perspective projection, ndc x = scale * x / depth - offset, and the same for y.
+    const GLfloat* p        = matrices.projection;
+    const float4   scale_x  = float4_splat( p[0] );
+    const float4   offset_x = float4_splat( p[8] );
+    const float4   scale_y  = float4_splat( p[5] );
+    const float4   offset_y = float4_splat( p[9] );
+    const float4   zero     = float4_splat( 0.0f );
+    const float4   one      = float4_splat( 1.0f );
+    const float4   tiles_x  = float4_splat( 0.5f * TILES_X );
+    const float4   tiles_y  = float4_splat( 0.5f * TILES_Y );
+    const float4   last_x   = float4_splat( TILES_X - 1 );
+    const float4   last_y   = float4_splat( TILES_Y - 1 );
+
+    const std::vector<GLfloat>* view = view_[camera];
+    job.ranges.clear();
+    for( size_t first = 0; first < world_[3].size(); first += 4 ) {
+        const float4 radius = float4_load( &world_[3][first] );
+        const float4 depth  = float4_load( &view[2][first] );
+        // Where each light's sphere is within the slice, in depth.
+        const float4 d0  = float4_max( depth - radius, near );
+        const float4 d1  = float4_min( depth + radius, far );
+        int4         hit = d0 <= d1;
+        if( !int4_any( hit ) ) {
+            continue;
+        }
+
+        // The extremes of x / depth and y / depth over the sphere's box cut down to that depth range.
+        const float4 x      = float4_load( &view[0][first] );
+        const float4 y      = float4_load( &view[1][first] );
+        const float4 x0     = x - radius;
+        const float4 x1     = x + radius;
+        const float4 y0     = y - radius;
+        const float4 y1     = y + radius;
+        const float4 left   = scale_x * float4_select( x0 >= zero, x0 / d1, x0 / d0 ) - offset_x;
+        const float4 right  = scale_x * float4_select( x1 >= zero, x1 / d0, x1 / d1 ) - offset_x;
+        const float4 bottom = scale_y * float4_select( y0 >= zero, y0 / d1, y0 / d0 ) - offset_y;
+        const float4 top    = scale_y * float4_select( y1 >= zero, y1 / d0, y1 / d1 ) - offset_y;
+        hit                 = hit & ( right >= -one ) & ( left <= one ) & ( top >= -one ) & ( bottom <= one );
+        if( !int4_any( hit ) ) {
+            continue;
+        }
+
+        const float4 tile_x0 = float4_min( float4_max( ( left + one ) * tiles_x, zero ), last_x );
+        const float4 tile_x1 = float4_min( float4_max( ( right + one ) * tiles_x, zero ), last_x );
+        const float4 tile_y0 = float4_min( float4_max( ( bottom + one ) * tiles_y, zero ), last_y );
+        const float4 tile_y1 = float4_min( float4_max( ( top + one ) * tiles_y, zero ), last_y );
+        for( int lane = 0; lane < 4; ++lane ) {
+            if( hit[lane] ) {
+                SliceJob::Range range = {
+                    static_cast<uint32_t>( first + lane ),
+                    static_cast<uint8_t>( tile_x0[lane] ),
+                    static_cast<uint8_t>( tile_x1[lane] ),
+                    static_cast<uint8_t>( tile_y0[lane] ),
+                    static_cast<uint8_t>( tile_y1[lane] )};
+                job.ranges.push_back( range );
+            }
+        }
+    }
+
+    // A counting sort of the lights into the slice's tiles, which keeps each tile's lights in index order.
+    memset( job.count, 0, sizeof( job.count ) );
+    for( const SliceJob::Range& range : job.ranges ) {
+        for( int y = range.y0; y <= range.y1; ++y ) {
+            for( int x = range.x0; x <= range.x1; ++x ) {
+                ++job.count[y * TILES_X + x];
+            }
+        }
+    }
+    uint32_t total = 0;
+    for( int tile = 0; tile < TILES; ++tile ) {
+        job.first[tile] = total;
+        total += job.count[tile];
+        job.count[tile] = 0;
+    }
+    job.indices.resize( total );
+    for( const SliceJob::Range& range : job.ranges ) {
+        for( int y = range.y0; y <= range.y1; ++y ) {
+            for( int x = range.x0; x <= range.x1; ++x ) {
+                const int tile                                    = y * TILES_X + x;
+                job.indices[job.first[tile] + job.count[tile]++] = static_cast<uint16_t>( range.light );
+            }
+        }
+    }
+}
+
+bool LightClusters::grow_texture( UserContext& user_context, GLuint& texture, GLint unit, GLenum format, GLsizei& rows, GLsizei needed ) {
+    if( texture && ( needed <= rows ) ) {
+        return true;
+    }
+    // Storage is immutable, so a bigger texture replaces the old one. Doubling keeps that rare.
+    if( texture ) {
+        gpu_memory_freed( GPU_MEMORY_TEXTURE, texture );
+        glDeleteTextures( 1, &texture );
+        texture = 0;
+    }
+    rows    = std::max( needed, 2 * rows );
+    texture = gles_create_data_texture( unit, format, TEXTURE_WIDTH, rows );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    return texture != 0;
+}
+
+void LightClusters::upload( UserContext& user_context ) {
+    if( !cluster_texture_ || !cameras_ ) {
+        return;
+    }
+
+    gles_upload_data_rows( CLUSTER_UNIT, TILES, clusters_.size() / 2, GL_RG_INTEGER, GL_UNSIGNED_INT, clusters_.data(), 2 * sizeof( uint32_t ) );
+    user_context.frame_budget.count_bytes_uploaded( clusters_.size() * sizeof( uint32_t ) );
+
+    const GLsizei index_rows = static_cast<GLsizei>( ( indices_.size() + TEXTURE_WIDTH - 1 ) / TEXTURE_WIDTH );
+    if( !grow_texture( user_context, index_texture_, LIGHT_INDEX_UNIT, GL_R16UI, index_rows_, index_rows ) ) {
+        STDERR( "Failed to grow light index texture to %d rows.", index_rows );
+        return;
+    }
+    gles_upload_data_rows( LIGHT_INDEX_UNIT, TEXTURE_WIDTH, indices_.size(), GL_RED_INTEGER, GL_UNSIGNED_SHORT, indices_.data(), sizeof( uint16_t ) );
+    user_context.frame_budget.count_bytes_uploaded( indices_.size() * sizeof( uint16_t ) );
+
+    if( lights_changed_ ) {
+        // Two texels per light: position and radius, then colour and intensity.
+        const size_t  texels     = 2 * lights_.size();
+        const GLsizei light_rows = static_cast<GLsizei>( ( texels + TEXTURE_WIDTH - 1 ) / TEXTURE_WIDTH );
+        if( !grow_texture( user_context, light_texture_, LIGHT_UNIT, GL_RGBA32F, light_rows_, light_rows ) ) {
+            STDERR( "Failed to grow light texture to %d rows.", light_rows );
+            return;
+        }
+        gles_upload_data_rows( LIGHT_UNIT, TEXTURE_WIDTH, texels, GL_RGBA, GL_FLOAT, lights_.data(), 4 * sizeof( GLfloat ) );
+        user_context.frame_budget.count_bytes_uploaded( lights_.size() * sizeof( PointLight ) );
+        lights_changed_ = false;
+    }
+}
+
+const ClusterStats& LightClusters::stats() const {
+    return stats_;
+}
+
+void print_cluster_stats( const LightClusters& clusters ) {
+    const ClusterStats& stats  = clusters.stats();
+    const double        frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "Clustered lighting: %lu lights, %.3lf ms binning and %.1lf light references per frame, %lu references and at most %u lights in a cluster in the last frame.",
+            static_cast<unsigned long>( clusters.lights().size() ),
+            stats.bin_ms / frames,
+            stats.references / frames,
+            static_cast<unsigned long>( stats.last_references ),
+            stats.last_max_per_cluster );
+}
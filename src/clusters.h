@@ -0,0 +1,107 @@
+#ifndef WASMVR_CLUSTERS_H
+#define WASMVR_CLUSTERS_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class UserContext;
+struct CameraMatrices;
+
+// Lays out as the two texels the scene shader reads per light.
+struct PointLight {
+    GLfloat position[3]; // World space.
+    GLfloat radius;      // Where its light falls off to nothing.
+    GLfloat color[3];
+    GLfloat intensity;
+};
+
+struct ClusterStats {
+    unsigned long frames;
+    unsigned long references; // Light indices in all clusters together.
+    double        bin_ms;
+    unsigned int  last_max_per_cluster;
+    size_t        last_references;
+
+    ClusterStats();
+};
+
+// Clustered forward lighting. Each camera's view frustum is split into tiles on screen and slices in depth,
+// exponentially spaced so clusters stay roughly cubic, and every light is listed in the clusters its sphere
+// may touch. The scene shader then only loops over the lights of the cluster a fragment is in.
+// Lists are built on the CPU, a group of four lights at a time, and read by the shader from textures.
+class LightClusters {
+public:
+    static const int     TILES_X = 16;
+    static const int     TILES_Y = 8;
+    static const int     SLICES  = 24;
+    static const int     TILES   = TILES_X * TILES_Y;
+    static const GLfloat NEAR; // Slices are spaced from here to FAR, the first and last one reaching
+    static const GLfloat FAR;  // all the way to the eye and to infinity.
+    static const int     MAX_LIGHTS = 65535; // Lists hold 16-bit light indices.
+
+    // Texture units the scene shader samples the clusters, light indices and lights from.
+    static const GLint CLUSTER_UNIT     = 2;
+    static const GLint LIGHT_INDEX_UNIT = 3;
+    static const GLint LIGHT_UNIT       = 4;
+    // Light indices and lights are laid out in rows this long.
+    static const GLsizei TEXTURE_WIDTH = 1024;
+
+    LightClusters();
+
+    // Creates the textures and points the scene programs' samplers at them.
+    bool create( UserContext& user_context );
+    void release();
+
+    void                           set_lights( const std::vector<PointLight>& lights );
+    const std::vector<PointLight>& lights() const;
+
+    // Bins the lights into the clusters of up to two cameras, whose cluster parameters are set to
+    // match so the shader finds them. Only touches the CPU, so it can run without GL.
+    void bin( CameraMatrices* cameras, int count );
+    // Uploads the lists of the last bin(), and the lights if they changed.
+    void upload( UserContext& user_context );
+
+    const ClusterStats& stats() const;
+
+private:
+    // What one camera's slice found, written only by the job binning that slice.
+    struct SliceJob {
+        struct Range {
+            uint32_t light;
+            uint8_t  x0, x1, y0, y1; // Inclusive tiles.
+        };
+        std::vector<Range>    ranges;
+        std::vector<uint16_t> indices;
+        uint32_t              first[TILES];
+        uint32_t              count[TILES];
+    };
+
+    void bin_slice( int camera, int slice, const CameraMatrices& matrices, SliceJob& job );
+    bool grow_texture( UserContext& user_context, GLuint& texture, GLint unit, GLenum format, GLsizei& rows, GLsizei needed );
+
+    std::vector<PointLight> lights_;
+    bool                    lights_changed_;
+
+    // Lights in groups of four, padded with lights that reach nowhere.
+    std::vector<GLfloat> world_[4];   // x, y, z and radius.
+    std::vector<GLfloat> view_[2][3]; // Per camera x, y and distance in front of it.
+
+    std::vector<SliceJob> jobs_;
+    std::vector<uint32_t> clusters_; // First light index and count per cluster, for each camera in turn.
+    std::vector<uint16_t> indices_;
+    int                   cameras_;
+
+    GLuint  cluster_texture_;
+    GLuint  index_texture_;
+    GLuint  light_texture_;
+    GLsizei index_rows_;
+    GLsizei light_rows_;
+
+    ClusterStats stats_;
+};
+
+void print_cluster_stats( const LightClusters& clusters );
+
+#endif // WASMVR_CLUSTERS_H
@@ -29,9 +29,9 @@ bool egl_initialize( UserContext& user_context ) {
         EGL_GREEN_SIZE, 6,
         EGL_BLUE_SIZE, 5,
         EGL_ALPHA_SIZE, EGL_DONT_CARE,   // or 8
-        EGL_DEPTH_SIZE, EGL_DONT_CARE,   // or 8
+        EGL_DEPTH_SIZE, 24,              // Only drawn into if no offscreen render target could be made.
         EGL_STENCIL_SIZE, EGL_DONT_CARE, // or 8
-        EGL_SAMPLE_BUFFERS, 0,           // or 1?
+        EGL_SAMPLE_BUFFERS, 0,           // Multisampling is done in offscreen render targets.
         EGL_NONE};
     EGLConfig config;
     EGLint    num_config;
@@ -61,10 +61,11 @@ bool egl_initialize( UserContext& user_context ) {
     STDOUT( "Created EGL window." );
     user_context.surface = surface;
 
-    // Create a GLES2 rendering context (EGLContext) by calling eglCreateContext, followed by a call to eglMakeCurrent to activate the rendering context.
-    // When creating the context, specify the context attribute EGL_CONTEXT_CLIENT_VERSION == 2.
+    // Create a GLES3 rendering context (EGLContext) by calling eglCreateContext, followed by a call to eglMakeCurrent to activate the rendering context.
+    // When creating the context, specify the context attribute EGL_CONTEXT_CLIENT_VERSION == 3.
+    // GLES3 (WebGL2) is needed for multisampled renderbuffers and glBlitFramebuffer.
     EGLint const attrib_list_create_context[] = {
-        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_CONTEXT_CLIENT_VERSION, 3,
         EGL_NONE, EGL_NONE};
     EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT, attrib_list_create_context );
     if( EGL_NO_CONTEXT == context ) {
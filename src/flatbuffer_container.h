@@ -2,9 +2,14 @@
 #define WASMVR_FLATBUFFER_CONTAINER_H
 
 #include <functional>
+#include <stdlib.h>
 
 #include <flatbuffers/flatbuffers.h>
 
+#ifdef __EMSCRIPTEN__
+#include "trace.h"
+#endif
+
 template <typename T>
 class FlatbufferContainer {
 public:
@@ -14,30 +19,54 @@ public:
     typedef std::function<int( uint8_t** )>               SlabInit;
     typedef std::function<const T*( const void* )>        ViewGet;
     typedef std::function<bool( flatbuffers::Verifier& )> ViewVerifier;
+    // Gives back a slab and its length, for slabs not from malloc(), e.g. mapped files.
+    typedef std::function<void( uint8_t*, int )> SlabRelease;
 
+    // Takes ownership of the slab, releasing any the target had, and reads it in place.
     static bool slab(
         FlatbufferContainer<T>* target,
         SlabInit                slab_init,
         ViewVerifier            view_verifier,
-        ViewGet                 view_get );
+        ViewGet                 view_get,
+        SlabRelease             slab_release = SlabRelease() );
     const T* view() const;
+    int      length() const;
+    void     release();
 
 private:
-    uint8_t* slab_;
-    const T* view_;
+    FlatbufferContainer( const FlatbufferContainer& ) = delete;
+    FlatbufferContainer& operator=( const FlatbufferContainer& ) = delete;
+
+    uint8_t*    slab_;
+    int         length_;
+    const T*    view_;
+    SlabRelease slab_release_;
 };
 
 template <typename T>
 FlatbufferContainer<T>::FlatbufferContainer()
     : slab_( nullptr )
+    , length_( 0 )
     , view_( nullptr ) {
 }
 
 template <typename T>
 FlatbufferContainer<T>::~FlatbufferContainer() {
+    release();
+}
+
+template <typename T>
+void FlatbufferContainer<T>::release() {
     if( slab_ ) {
-        free( slab_ );
+        if( slab_release_ ) {
+            slab_release_( slab_, length_ );
+        } else {
+            free( slab_ );
+        }
     }
+    slab_   = nullptr;
+    length_ = 0;
+    view_   = nullptr;
 }
 
 template <typename T>
@@ -45,13 +74,20 @@ bool FlatbufferContainer<T>::slab(
     FlatbufferContainer<T>* target,
     SlabInit                slab_init,
     ViewVerifier            view_verifier,
-    ViewGet                 view_get ) {
-    int length = slab_init( &( target->slab_ ) );
+    ViewGet                 view_get,
+    SlabRelease             slab_release ) {
+    target->release();
+    target->slab_release_ = slab_release;
+    int length            = slab_init( &( target->slab_ ) );
     if( length <= 0 ) {
         return false;
     }
+    target->length_ = length;
 
     // Verify that the buffer is properly formed.
+#ifdef __EMSCRIPTEN__
+    TraceScope trace( "verify" );
+#endif
     flatbuffers::Verifier verifier( target->slab_, length );
     if( !view_verifier( verifier ) ) {
         return false;
@@ -66,4 +102,9 @@ const T* FlatbufferContainer<T>::view() const {
     return view_;
 }
 
+template <typename T>
+int FlatbufferContainer<T>::length() const {
+    return length_;
+}
+
 #endif // WASMVR_FLATBUFFER_CONTAINER_H
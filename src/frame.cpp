@@ -0,0 +1,205 @@
+#include "frame.h"
+
+#include <emscripten.h>
+
+#include "scene.h"
+#include "trace.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const unsigned int STATS_PRINT_INTERVAL = 600;
+
+    // Weight of the newest sample in the exponential moving averages.
+    const double SMOOTHING = 0.1;
+    // Fraction of the display interval a frame may use before it counts as late.
+    const double DEADLINE_FRACTION = 0.9;
+}
+
+SampleStats::SampleStats()
+    : count( 0 )
+    , total( 0.0 )
+    , max( 0.0 ) {
+}
+
+void SampleStats::add( double sample ) {
+    if( ( count == 0 ) || ( sample > max ) ) {
+        max = sample;
+    }
+    total += sample;
+    ++count;
+}
+
+double SampleStats::mean() const {
+    return count ? ( total / count ) : 0.0;
+}
+
+FrameTimer::FrameTimer()
+    : begin_ms_( 0.0 )
+    , last_begin_ms_( 0.0 )
+    , refresh_ms_( 1000.0 / 90.0 )
+    , render_cost_ms_( 0.0 ) {
+}
+
+void FrameTimer::begin( double now_ms ) {
+    last_begin_ms_ = begin_ms_;
+    begin_ms_      = now_ms;
+    if( last_begin_ms_ <= 0.0 ) {
+        return;
+    }
+
+    // Intervals much longer than the estimate are missed frames, not the display's refresh rate.
+    const double interval = begin_ms_ - last_begin_ms_;
+    if( ( interval > 0.0 ) && ( interval < 1.5 * refresh_ms_ ) ) {
+        refresh_ms_ += SMOOTHING * ( interval - refresh_ms_ );
+    } else if( interval > 0.0 ) {
+        // Let the estimate drift up slowly in case the display really did slow down.
+        refresh_ms_ *= 1.0 + SMOOTHING * 0.1;
+    }
+}
+
+void FrameTimer::end( double now_ms, bool rendered ) {
+    if( rendered ) {
+        render_cost_ms_ += SMOOTHING * ( ( now_ms - begin_ms_ ) - render_cost_ms_ );
+    }
+}
+
+double FrameTimer::begin_ms() const {
+    return begin_ms_;
+}
+
+double FrameTimer::refresh_ms() const {
+    return refresh_ms_;
+}
+
+double FrameTimer::render_cost_ms() const {
+    return render_cost_ms_;
+}
+
+bool FrameTimer::predict_miss( double now_ms ) const {
+    return ( now_ms - begin_ms_ ) + render_cost_ms_ > DEADLINE_FRACTION * refresh_ms_;
+}
+
+RedrawTracker::RedrawTracker()
+    : enabled_( true )
+    , requested_( true )
+    , width_( 0 )
+    , height_( 0 )
+    , topology_version_( 0 )
+    , recomputed_( 0 )
+    , drawn_( 0 )
+    , skipped_( 0 ) {
+}
+
+void RedrawTracker::set_enabled( bool enabled ) {
+    enabled_   = enabled;
+    requested_ = true;
+}
+
+bool RedrawTracker::enabled() const {
+    return enabled_;
+}
+
+void RedrawTracker::request() {
+    requested_ = true;
+}
+
+bool RedrawTracker::needed( GLint width, GLint height, const Scene& scene ) {
+    // Any node moved since the last frame drawn shows up as world matrices recomputed by whoever updated.
+    const bool changed = requested_ || ( width != width_ ) || ( height != height_ ) ||
+                         ( scene.topology_version() != topology_version_ ) || ( scene.stats().recomputed != recomputed_ );
+    if( enabled_ && !changed ) {
+        ++skipped_;
+        return false;
+    }
+    requested_        = false;
+    width_            = width;
+    height_           = height;
+    topology_version_ = scene.topology_version();
+    recomputed_       = scene.stats().recomputed;
+    ++drawn_;
+    return true;
+}
+
+unsigned long RedrawTracker::drawn() const {
+    return drawn_;
+}
+
+unsigned long RedrawTracker::skipped() const {
+    return skipped_;
+}
+
+void frame_begin( UserContext& user_context ) {
+    user_context.frame_timer.begin( emscripten_get_now() );
+    user_context.frame_budget.begin_frame();
+    user_context.reprojection.active = false;
+    user_context.gl_state.begin_frame();
+    user_context.framebuffer_pool.begin_frame();
+}
+
+void frame_end( UserContext& user_context, bool drawn ) {
+    user_context.frame_timer.end( emscripten_get_now(), drawn && !user_context.reprojection.active );
+    user_context.frame_budget.end_frame( user_context.frame_count );
+    user_context.residency.end_frame();
+    if( drawn ) {
+        user_context.hud.end_frame( user_context );
+    }
+
+    if( !( ++user_context.frame_count % STATS_PRINT_INTERVAL ) ) {
+        print_frame_stats( user_context );
+    }
+}
+
+void print_frame_stats( UserContext& user_context ) {
+    STDOUT( "Frame %u:", user_context.frame_count );
+    print_gl_state_stats( user_context.gl_state );
+    print_framebuffer_pool_stats( user_context.framebuffer_pool );
+    print_residency_stats( user_context.residency );
+    STDOUT( "Scene commands: %u commands in %lu bytes.",
+            user_context.scene_commands.commands(),
+            static_cast<unsigned long>( user_context.scene_commands.bytes() ) );
+    print_simulation_stats( user_context.simulation );
+    print_scene_stats( user_context.scene );
+    print_scene_file_stats( user_context.scene_file );
+    print_bvh_stats( user_context.bvh, user_context.culler );
+    print_occlusion_stats( user_context.occlusion );
+    print_lod_stats( user_context.lod, user_context.meshes );
+    print_instance_stats( user_context.instance_ring, user_context.instance_batcher );
+    print_cluster_stats( user_context.light_clusters );
+    print_skinning_stats( user_context.skinning );
+    print_texture_stats( user_context.textures );
+    print_particle_stats( user_context.particles );
+    print_point_cloud_stats( user_context.point_cloud );
+    print_raycast_stats( user_context.ray_caster );
+    print_hud_stats( user_context.hud );
+    print_trace_stats();
+    STDOUT( "Frame timer: display interval %.3lf ms, render cost %.3lf ms.",
+            user_context.frame_timer.refresh_ms(),
+            user_context.frame_timer.render_cost_ms() );
+    print_frame_budget_stats( user_context.frame_budget );
+    print_reprojection_stats( user_context.reprojection );
+    STDOUT( "Redraw on demand %s: %lu frames drawn, %lu skipped.",
+            user_context.redraw.enabled() ? "on" : "off",
+            user_context.redraw.drawn(),
+            user_context.redraw.skipped() );
+    for( int prepass = 0; prepass < 2; ++prepass ) {
+        const SampleStats& scene = user_context.scene_gpu_ms[prepass];
+        if( scene.count ) {
+            STDOUT( "Scene GPU time with depth pre-pass %s: mean %.3lf ms, max %.3lf ms over %u frames.",
+                    prepass ? "on" : "off",
+                    scene.mean(),
+                    scene.max,
+                    scene.count );
+        }
+    }
+    for( int latched = 0; latched < 2; ++latched ) {
+        const SampleStats& latency = user_context.pose_to_submit_ms[latched];
+        if( latency.count ) {
+            STDOUT( "Pose to submit latency with late latch %s: mean %.3lf ms, max %.3lf ms over %u frames.",
+                    latched ? "on" : "off",
+                    latency.mean(),
+                    latency.max,
+                    latency.count );
+        }
+    }
+}
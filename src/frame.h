@@ -0,0 +1,80 @@
+#ifndef WASMVR_FRAME_H
+#define WASMVR_FRAME_H
+
+#include <GLES3/gl3.h>
+
+class Scene;
+class UserContext;
+
+// Running count, mean and maximum of a series of samples, e.g. durations in milliseconds.
+struct SampleStats {
+    unsigned int count;
+    double       total;
+    double       max;
+
+    SampleStats();
+    void   add( double sample );
+    double mean() const;
+};
+
+// Estimates the display interval and the cost of a fully rendered frame
+// to predict whether the frame being started will make its deadline.
+class FrameTimer {
+public:
+    FrameTimer();
+
+    void begin( double now_ms );
+    // Only fully rendered frames feed the render cost estimate.
+    void end( double now_ms, bool rendered );
+
+    // When the frame being drawn began.
+    double begin_ms() const;
+    double refresh_ms() const;
+    double render_cost_ms() const;
+    bool   predict_miss( double now_ms ) const;
+
+private:
+    double begin_ms_;
+    double last_begin_ms_;
+    double refresh_ms_;
+    double render_cost_ms_;
+};
+
+// Decides whether the normal render loop has anything new to show, so an idle page stops redrawing
+// the same picture. The canvas keeps showing the last frame drawn into it until the next one is.
+// A frame is drawn when the canvas size or the scene changed, or when one was requested, e.g. on input
+// or by an animation for each of its steps.
+class RedrawTracker {
+public:
+    RedrawTracker();
+
+    // While disabled every frame is drawn.
+    void set_enabled( bool enabled );
+    bool enabled() const;
+
+    // Draws the next frame, for changes that aren't tracked.
+    void request();
+    // Whether this frame has to be drawn, counting it as drawn or skipped.
+    bool needed( GLint width, GLint height, const Scene& scene );
+
+    unsigned long drawn() const;
+    unsigned long skipped() const;
+
+private:
+    bool          enabled_;
+    bool          requested_;
+    GLint         width_;
+    GLint         height_;
+    unsigned int  topology_version_;
+    unsigned long recomputed_; // The scene's world matrices recomputed as of the last frame drawn.
+    unsigned long drawn_;
+    unsigned long skipped_;
+};
+
+// Bookkeeping shared by the normal and the VR render loops. Frames the normal loop skipped aren't drawn.
+void frame_begin( UserContext& user_context );
+void frame_end( UserContext& user_context, bool drawn = true );
+
+void print_frame_stats( UserContext& user_context );
+
+#endif // WASMVR_FRAME_H
@@ -0,0 +1,116 @@
+#include "frame_budget.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace {
+    // Report the first few frames over budget, then only every so often to keep the console usable.
+    const unsigned int REPORT_FIRST = 10;
+    const unsigned int REPORT_EVERY = 100;
+
+    // The scene is a handful of triangles per eye, so anything near these is a regression.
+    const unsigned int DEFAULT_DRAW_CALLS         = 64;
+    const unsigned int DEFAULT_BUFFER_ALLOCATIONS = 0;
+    const size_t       DEFAULT_BYTES_UPLOADED     = 64 * 1024;
+}
+
+GLWork::GLWork()
+    : draw_calls( 0 )
+    , buffer_allocations( 0 )
+    , bytes_uploaded( 0 ) {
+}
+
+GLWork::GLWork( unsigned int draw_calls, unsigned int buffer_allocations, size_t bytes_uploaded )
+    : draw_calls( draw_calls )
+    , buffer_allocations( buffer_allocations )
+    , bytes_uploaded( bytes_uploaded ) {
+}
+
+FrameBudget::FrameBudget()
+    : limit_( DEFAULT_DRAW_CALLS, DEFAULT_BUFFER_ALLOCATIONS, DEFAULT_BYTES_UPLOADED )
+    , in_frame_( false )
+    , frames_over_budget_( 0 ) {
+}
+
+void FrameBudget::set_limit( const GLWork& limit ) {
+    limit_ = limit;
+}
+
+const GLWork& FrameBudget::limit() const {
+    return limit_;
+}
+
+void FrameBudget::begin_frame() {
+    frame_    = GLWork();
+    in_frame_ = true;
+}
+
+bool FrameBudget::end_frame( unsigned int frame ) {
+    if( !in_frame_ ) {
+        return true;
+    }
+    in_frame_ = false;
+
+    peak_.draw_calls         = std::max( peak_.draw_calls, frame_.draw_calls );
+    peak_.buffer_allocations = std::max( peak_.buffer_allocations, frame_.buffer_allocations );
+    peak_.bytes_uploaded     = std::max( peak_.bytes_uploaded, frame_.bytes_uploaded );
+
+    const bool over = ( frame_.draw_calls > limit_.draw_calls ) ||
+                      ( frame_.buffer_allocations > limit_.buffer_allocations ) ||
+                      ( frame_.bytes_uploaded > limit_.bytes_uploaded );
+    if( !over ) {
+        return true;
+    }
+
+    ++frames_over_budget_;
+    if( ( frames_over_budget_ <= REPORT_FIRST ) || !( frames_over_budget_ % REPORT_EVERY ) ) {
+        STDERR( "Frame %u over budget (%u frames so far): %u/%u draw calls, %u/%u buffer allocations, %lu/%lu bytes uploaded.",
+                frame,
+                frames_over_budget_,
+                frame_.draw_calls,
+                limit_.draw_calls,
+                frame_.buffer_allocations,
+                limit_.buffer_allocations,
+                static_cast<unsigned long>( frame_.bytes_uploaded ),
+                static_cast<unsigned long>( limit_.bytes_uploaded ) );
+    }
+    return false;
+}
+
+void FrameBudget::count_draw_calls( unsigned int count ) {
+    frame_.draw_calls += count;
+}
+
+void FrameBudget::count_buffer_allocations( unsigned int count ) {
+    frame_.buffer_allocations += count;
+}
+
+void FrameBudget::count_bytes_uploaded( size_t bytes ) {
+    frame_.bytes_uploaded += bytes;
+}
+
+const GLWork& FrameBudget::frame() const {
+    return frame_;
+}
+
+const GLWork& FrameBudget::peak() const {
+    return peak_;
+}
+
+unsigned int FrameBudget::frames_over_budget() const {
+    return frames_over_budget_;
+}
+
+void print_frame_budget_stats( const FrameBudget& budget ) {
+    const GLWork& peak  = budget.peak();
+    const GLWork& limit = budget.limit();
+    STDOUT( "Frame budget: %u frames over, peak %u/%u draw calls, %u/%u buffer allocations, %lu/%lu bytes uploaded.",
+            budget.frames_over_budget(),
+            peak.draw_calls,
+            limit.draw_calls,
+            peak.buffer_allocations,
+            limit.buffer_allocations,
+            static_cast<unsigned long>( peak.bytes_uploaded ),
+            static_cast<unsigned long>( limit.bytes_uploaded ) );
+}
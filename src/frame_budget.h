@@ -0,0 +1,48 @@
+#ifndef WASMVR_FRAME_BUDGET_H
+#define WASMVR_FRAME_BUDGET_H
+
+#include <stddef.h>
+
+// GL work done in a frame, also used as the limit that work is checked against.
+struct GLWork {
+    unsigned int draw_calls;
+    unsigned int buffer_allocations;
+    size_t       bytes_uploaded;
+
+    GLWork();
+    GLWork( unsigned int draw_calls, unsigned int buffer_allocations, size_t bytes_uploaded );
+};
+
+// Counts the GL work of each frame and reports frames that go over budget, so regressions like
+// allocating GL objects every frame show up in the console instead of as a slow leak.
+// Work done outside of a frame, e.g. while loading, is counted but never checked.
+class FrameBudget {
+public:
+    FrameBudget();
+
+    void          set_limit( const GLWork& limit );
+    const GLWork& limit() const;
+
+    void begin_frame();
+    // Returns false, after reporting it, if the frame went over budget.
+    bool end_frame( unsigned int frame );
+
+    void count_draw_calls( unsigned int count );
+    void count_buffer_allocations( unsigned int count );
+    void count_bytes_uploaded( size_t bytes );
+
+    const GLWork& frame() const;
+    const GLWork& peak() const;
+    unsigned int  frames_over_budget() const;
+
+private:
+    GLWork       limit_;
+    GLWork       frame_;
+    GLWork       peak_;
+    bool         in_frame_;
+    unsigned int frames_over_budget_;
+};
+
+void print_frame_budget_stats( const FrameBudget& budget );
+
+#endif // WASMVR_FRAME_BUDGET_H
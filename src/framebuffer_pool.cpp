@@ -0,0 +1,275 @@
+#include "framebuffer_pool.h"
+
+#include <algorithm>
+
+#include "residency.h"
+#include "util.h"
+
+namespace {
+    size_t bytes_per_pixel( GLenum format ) {
+        switch( format ) {
+        case GL_NONE: return 0;
+        case GL_RGB565: return 2;
+        case GL_RGBA4: return 2;
+        case GL_RGB5_A1: return 2;
+        case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RGBA16F: return 8;
+        case GL_RGBA32F: return 16;
+        default: return 4; // GL_RGBA8, GL_DEPTH_COMPONENT24, GL_DEPTH24_STENCIL8, ...
+        }
+    }
+
+    GLenum depth_attachment( GLenum format ) {
+        return ( ( format == GL_DEPTH24_STENCIL8 ) || ( format == GL_DEPTH32F_STENCIL8 ) )
+                   ? GL_DEPTH_STENCIL_ATTACHMENT
+                   : GL_DEPTH_ATTACHMENT;
+    }
+
+    bool is_depth( GLenum format ) {
+        switch( format ) {
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8: return true;
+        default: return false;
+        }
+    }
+
+    GLuint create_attachment( GLenum format, GLenum attachment, GLsizei width, GLsizei height, GLsizei samples ) {
+        GLuint name = 0;
+        if( samples > 0 ) {
+            glGenRenderbuffers( 1, &name );
+            glBindRenderbuffer( GL_RENDERBUFFER, name );
+            glRenderbufferStorageMultisample( GL_RENDERBUFFER, samples, format, width, height );
+            glFramebufferRenderbuffer( GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, name );
+            glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+        } else {
+            glGenTextures( 1, &name );
+            glBindTexture( GL_TEXTURE_2D, name );
+            glTexStorage2D( GL_TEXTURE_2D, 1, format, width, height );
+            // Depth textures are not filterable in GLES3.
+            const GLint filter = is_depth( format ) ? GL_NEAREST : GL_LINEAR;
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+            glFramebufferTexture2D( GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, name, 0 );
+            glBindTexture( GL_TEXTURE_2D, 0 );
+        }
+        return name;
+    }
+
+    void delete_attachment( GLuint name, bool multisampled ) {
+        if( !name ) {
+            return;
+        }
+        if( multisampled ) {
+            glDeleteRenderbuffers( 1, &name );
+        } else {
+            glDeleteTextures( 1, &name );
+        }
+    }
+}
+
+RenderTargetDesc::RenderTargetDesc()
+    : width( 0 )
+    , height( 0 )
+    , color_format( GL_NONE )
+    , depth_format( GL_NONE )
+    , samples( 0 ) {
+}
+
+RenderTargetDesc::RenderTargetDesc( GLsizei width, GLsizei height, GLenum color_format, GLenum depth_format, GLsizei samples )
+    : width( width )
+    , height( height )
+    , color_format( color_format )
+    , depth_format( depth_format )
+    , samples( samples ) {
+}
+
+bool operator==( const RenderTargetDesc& a, const RenderTargetDesc& b ) {
+    return ( a.width == b.width ) &&
+           ( a.height == b.height ) &&
+           ( a.color_format == b.color_format ) &&
+           ( a.depth_format == b.depth_format ) &&
+           ( a.samples == b.samples );
+}
+
+bool RenderTarget::multisampled() const {
+    return desc.samples > 0;
+}
+
+FramebufferPoolStats::FramebufferPoolStats()
+    : hits( 0 )
+    , misses( 0 )
+    , evictions( 0 )
+    , bytes( 0 )
+    , targets( 0 ) {
+}
+
+const unsigned int FramebufferPool::EVICT_AFTER_FRAMES = 120;
+
+FramebufferPool::FramebufferPool()
+    : frame_( 0 )
+    , max_samples_( -1 ) {
+}
+
+FramebufferPool::~FramebufferPool() {
+    clear();
+}
+
+void FramebufferPool::begin_frame() {
+    ++frame_;
+
+    // Free targets that nobody asked for in a while, e.g. after a resize.
+    for( size_t i = 0; i < targets_.size(); ) {
+        RenderTarget* target = targets_[i];
+        if( !target->in_use && ( frame_ - target->last_used_frame > EVICT_AFTER_FRAMES ) ) {
+            destroy( target );
+            targets_[i] = targets_.back();
+            targets_.pop_back();
+            ++stats_.evictions;
+        } else {
+            ++i;
+        }
+    }
+}
+
+RenderTarget* FramebufferPool::acquire( const RenderTargetDesc& requested ) {
+    if( max_samples_ < 0 ) {
+        glGetIntegerv( GL_MAX_SAMPLES, &max_samples_ );
+    }
+
+    RenderTargetDesc desc = requested;
+    desc.samples          = std::min( desc.samples, static_cast<GLsizei>( max_samples_ ) );
+
+    for( RenderTarget* target : targets_ ) {
+        if( !target->in_use && ( target->desc == desc ) ) {
+            target->in_use          = true;
+            target->last_used_frame = frame_;
+            ++stats_.hits;
+            return target;
+        }
+    }
+
+    RenderTarget* target = create( desc );
+    if( !target ) {
+        return nullptr;
+    }
+    ++stats_.misses;
+    targets_.push_back( target );
+    return target;
+}
+
+void FramebufferPool::release( RenderTarget* target ) {
+    if( target ) {
+        target->in_use = false;
+    }
+}
+
+void FramebufferPool::clear() {
+    for( RenderTarget* target : targets_ ) {
+        destroy( target );
+    }
+    targets_.clear();
+}
+
+const FramebufferPoolStats& FramebufferPool::stats() const {
+    return stats_;
+}
+
+RenderTarget* FramebufferPool::create( const RenderTargetDesc& desc ) {
+    RenderTarget* target    = new RenderTarget();
+    target->desc            = desc;
+    target->framebuffer     = 0;
+    target->color           = 0;
+    target->depth           = 0;
+    target->bytes           = 0;
+    target->last_used_frame = frame_;
+    target->in_use          = true;
+
+    GLint previous_framebuffer = 0;
+    glGetIntegerv( GL_FRAMEBUFFER_BINDING, &previous_framebuffer );
+
+    glGenFramebuffers( 1, &target->framebuffer );
+    glBindFramebuffer( GL_FRAMEBUFFER, target->framebuffer );
+
+    const size_t pixels = static_cast<size_t>( desc.width ) * desc.height * std::max( desc.samples, 1 );
+    if( desc.color_format != GL_NONE ) {
+        target->color = create_attachment( desc.color_format, GL_COLOR_ATTACHMENT0, desc.width, desc.height, desc.samples );
+        target->bytes += pixels * bytes_per_pixel( desc.color_format );
+    }
+    if( desc.depth_format != GL_NONE ) {
+        target->depth = create_attachment( desc.depth_format, depth_attachment( desc.depth_format ), desc.width, desc.height, desc.samples );
+        target->bytes += pixels * bytes_per_pixel( desc.depth_format );
+    }
+
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, previous_framebuffer );
+    if( status != GL_FRAMEBUFFER_COMPLETE ) {
+        STDERR( "Failed to create %dx%d render target with %d samples, status 0x%x.", desc.width, desc.height, desc.samples, status );
+        target->bytes = 0;
+        destroy( target );
+        return nullptr;
+    }
+
+    stats_.bytes += target->bytes;
+    ++stats_.targets;
+    gpu_memory_allocated( GPU_MEMORY_RENDER_TARGET, target->framebuffer, target->bytes );
+    return target;
+}
+
+void FramebufferPool::destroy( RenderTarget* target ) {
+    delete_attachment( target->color, target->multisampled() );
+    delete_attachment( target->depth, target->multisampled() );
+    if( target->framebuffer ) {
+        gpu_memory_freed( GPU_MEMORY_RENDER_TARGET, target->framebuffer );
+        glDeleteFramebuffers( 1, &target->framebuffer );
+    }
+    if( target->bytes ) {
+        stats_.bytes -= target->bytes;
+        --stats_.targets;
+    }
+    delete target;
+}
+
+void render_target_resolve( const RenderTarget& source, GLuint framebuffer ) {
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, source.framebuffer );
+    glBindFramebuffer( GL_DRAW_FRAMEBUFFER, framebuffer );
+    glBlitFramebuffer(
+        0, 0, source.desc.width, source.desc.height, // Source rectangle.
+        0, 0, source.desc.width, source.desc.height, // Destination rectangle.
+        GL_COLOR_BUFFER_BIT,
+        GL_NEAREST ); // Multisampled sources require matching sizes and nearest filtering.
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, 0 );
+    glBindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+}
+
+void render_target_invalidate( const RenderTarget& target, bool color, bool depth ) {
+    GLenum  attachments[2];
+    GLsizei count = 0;
+    if( color && target.color ) {
+        attachments[count++] = GL_COLOR_ATTACHMENT0;
+    }
+    if( depth && target.depth ) {
+        attachments[count++] = depth_attachment( target.desc.depth_format );
+    }
+    if( count == 0 ) {
+        return;
+    }
+
+    glBindFramebuffer( GL_FRAMEBUFFER, target.framebuffer );
+    glInvalidateFramebuffer( GL_FRAMEBUFFER, count, attachments );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void print_framebuffer_pool_stats( const FramebufferPool& pool ) {
+    const FramebufferPoolStats& stats = pool.stats();
+    STDOUT( "Framebuffer pool: %u hits, %u misses, %u evictions, %lu targets holding %lu bytes.",
+            stats.hits,
+            stats.misses,
+            stats.evictions,
+            static_cast<unsigned long>( stats.targets ),
+            static_cast<unsigned long>( stats.bytes ) );
+}
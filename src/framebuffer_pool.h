@@ -0,0 +1,85 @@
+#ifndef WASMVR_FRAMEBUFFER_POOL_H
+#define WASMVR_FRAMEBUFFER_POOL_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <vector>
+
+struct RenderTargetDesc {
+    GLsizei width;
+    GLsizei height;
+    GLenum  color_format; // GL_NONE for no color attachment.
+    GLenum  depth_format; // GL_NONE for no depth attachment.
+    GLsizei samples;      // 0 for a single sampled target.
+
+    RenderTargetDesc();
+    RenderTargetDesc( GLsizei width, GLsizei height, GLenum color_format, GLenum depth_format, GLsizei samples );
+};
+
+bool operator==( const RenderTargetDesc& a, const RenderTargetDesc& b );
+
+// Single sampled targets use textures for their attachments so they can be sampled later.
+// Multisampled targets use renderbuffers and need to be resolved with a blit.
+struct RenderTarget {
+    RenderTargetDesc desc;
+    GLuint           framebuffer;
+    GLuint           color;
+    GLuint           depth;
+    size_t           bytes;
+    unsigned int     last_used_frame;
+    bool             in_use;
+
+    bool multisampled() const;
+};
+
+struct FramebufferPoolStats {
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    size_t       bytes;
+    size_t       targets;
+
+    FramebufferPoolStats();
+};
+
+class FramebufferPool {
+public:
+    FramebufferPool();
+    ~FramebufferPool();
+
+    // Advances the frame counter and frees targets that have not been used for a while.
+    void begin_frame();
+
+    RenderTarget* acquire( const RenderTargetDesc& desc );
+    void          release( RenderTarget* target );
+
+    // Drops every target, e.g. because the context is gone.
+    void clear();
+
+    const FramebufferPoolStats& stats() const;
+
+    static const unsigned int EVICT_AFTER_FRAMES;
+
+private:
+    FramebufferPool( const FramebufferPool& );
+    FramebufferPool& operator=( const FramebufferPool& );
+
+    RenderTarget* create( const RenderTargetDesc& desc );
+    void          destroy( RenderTarget* target );
+
+    std::vector<RenderTarget*> targets_;
+    FramebufferPoolStats       stats_;
+    unsigned int               frame_;
+    GLint                      max_samples_;
+};
+
+// Blits the color of a (usually multisampled) target into another framebuffer of the same size.
+void render_target_resolve( const RenderTarget& source, GLuint framebuffer );
+
+// Tells the driver that the attachments' contents are no longer needed,
+// so tile-based GPUs can skip writing them back to memory.
+void render_target_invalidate( const RenderTarget& target, bool color, bool depth );
+
+void print_framebuffer_pool_stats( const FramebufferPool& pool );
+
+#endif // WASMVR_FRAMEBUFFER_POOL_H
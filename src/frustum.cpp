@@ -0,0 +1,171 @@
+#include "frustum.h"
+
+#include <math.h>
+
+#include "simd.h"
+#include "util.h"
+
+namespace {
+    const int REAL_PLANES = 6;
+    const int CORNERS     = 8;
+
+    void set_plane( Frustum& frustum, int i, GLfloat a, GLfloat b, GLfloat c, GLfloat d ) {
+        const GLfloat length = sqrtf( a * a + b * b + c * c );
+        const GLfloat scale  = ( length > 0.0f ) ? 1.0f / length : 0.0f;
+        frustum.nx[i]        = a * scale;
+        frustum.ny[i]        = b * scale;
+        frustum.nz[i]        = c * scale;
+        frustum.d[i]         = ( length > 0.0f ) ? d * scale : 1.0f;
+        frustum.ax[i]        = fabsf( frustum.nx[i] );
+        frustum.ay[i]        = fabsf( frustum.ny[i] );
+        frustum.az[i]        = fabsf( frustum.nz[i] );
+    }
+
+    // Left, right, bottom, top, near and far planes of a column major clip matrix (Gribb and Hartmann).
+    void clip_planes( const GLfloat* clip, GLfloat planes[REAL_PLANES][4] ) {
+        for( int c = 0; c < 4; ++c ) {
+            const GLfloat row0 = clip[4 * c + 0];
+            const GLfloat row1 = clip[4 * c + 1];
+            const GLfloat row2 = clip[4 * c + 2];
+            const GLfloat row3 = clip[4 * c + 3];
+            planes[0][c]       = row3 + row0;
+            planes[1][c]       = row3 - row0;
+            planes[2][c]       = row3 + row1;
+            planes[3][c]       = row3 - row1;
+            planes[4][c]       = row3 + row2;
+            planes[5][c]       = row3 - row2;
+        }
+    }
+
+    // World space corners of the frustum, from the corners of the clip space cube.
+    bool clip_corners( const GLfloat* clip, GLfloat corners[CORNERS][3] ) {
+        GLfloat inverse[4 * 4];
+        if( !gl_matrix4x4_invert( inverse, clip ) ) {
+            return false;
+        }
+        for( int i = 0; i < CORNERS; ++i ) {
+            const GLfloat ndc[4] = {( i & 1 ) ? 1.0f : -1.0f, ( i & 2 ) ? 1.0f : -1.0f, ( i & 4 ) ? 1.0f : -1.0f, 1.0f};
+            GLfloat       p[4]   = {0.0f, 0.0f, 0.0f, 0.0f};
+            for( int c = 0; c < 4; ++c ) {
+                for( int r = 0; r < 4; ++r ) {
+                    p[r] += inverse[4 * c + r] * ndc[c];
+                }
+            }
+            if( fabsf( p[3] ) < 1e-12f ) {
+                return false;
+            }
+            for( int r = 0; r < 3; ++r ) {
+                corners[i][r] = p[r] / p[3];
+            }
+        }
+        return true;
+    }
+}
+
+Frustum::Frustum() {
+    for( int i = 0; i < PLANES; ++i ) {
+        nx[i] = ny[i] = nz[i] = 0.0f;
+        ax[i] = ay[i] = az[i] = 0.0f;
+        d[i]                  = 1.0f;
+    }
+}
+
+void frustum_from_view_projection( const GLfloat* view, const GLfloat* projection, Frustum& frustum ) {
+    GLfloat clip[4 * 4];
+    gl_matrix4x4_multiply( clip, projection, view );
+
+    GLfloat planes[REAL_PLANES][4];
+    clip_planes( clip, planes );
+    frustum = Frustum();
+    for( int i = 0; i < REAL_PLANES; ++i ) {
+        set_plane( frustum, i, planes[i][0], planes[i][1], planes[i][2], planes[i][3] );
+    }
+}
+
+bool frustum_combine( const GLfloat* view_left, const GLfloat* projection_left,
+                      const GLfloat* view_right, const GLfloat* projection_right,
+                      Frustum& frustum ) {
+    frustum = Frustum();
+
+    GLfloat clip[2][4 * 4];
+    gl_matrix4x4_multiply( clip[0], projection_left, view_left );
+    gl_matrix4x4_multiply( clip[1], projection_right, view_right );
+
+    GLfloat planes[2][REAL_PLANES][4];
+    GLfloat corners[2][CORNERS][3];
+    for( int eye = 0; eye < 2; ++eye ) {
+        clip_planes( clip[eye], planes[eye] );
+        if( !clip_corners( clip[eye], corners[eye] ) ) {
+            return false;
+        }
+    }
+
+    for( int i = 0; i < REAL_PLANES; ++i ) {
+        // Try each eye's plane, pushed out until both frusta are entirely on its inner side,
+        // and keep the one that leaves the least room around the corners.
+        int     best       = -1;
+        GLfloat best_d     = 0.0f;
+        GLfloat best_slack = 0.0f;
+        for( int candidate = 0; candidate < 2; ++candidate ) {
+            const GLfloat* p      = planes[candidate][i];
+            const GLfloat  length = sqrtf( p[0] * p[0] + p[1] * p[1] + p[2] * p[2] );
+            if( length <= 0.0f ) {
+                continue;
+            }
+            const GLfloat n[3] = {p[0] / length, p[1] / length, p[2] / length};
+
+            GLfloat min_distance = 0.0f;
+            GLfloat sum_distance = 0.0f;
+            for( int eye = 0; eye < 2; ++eye ) {
+                for( int c = 0; c < CORNERS; ++c ) {
+                    const GLfloat* corner   = corners[eye][c];
+                    const GLfloat  distance = n[0] * corner[0] + n[1] * corner[1] + n[2] * corner[2];
+                    if( ( ( eye == 0 ) && ( c == 0 ) ) || ( distance < min_distance ) ) {
+                        min_distance = distance;
+                    }
+                    sum_distance += distance;
+                }
+            }
+            const GLfloat slack = sum_distance - 2 * CORNERS * min_distance;
+            if( ( best < 0 ) || ( slack < best_slack ) ) {
+                best       = candidate;
+                best_d     = -min_distance;
+                best_slack = slack;
+            }
+        }
+        if( best < 0 ) {
+            return false;
+        }
+
+        const GLfloat* p      = planes[best][i];
+        const GLfloat  length = sqrtf( p[0] * p[0] + p[1] * p[1] + p[2] * p[2] );
+        set_plane( frustum, i, p[0] / length, p[1] / length, p[2] / length, best_d );
+    }
+    return true;
+}
+
+bool frustum_intersects_box( const Frustum& frustum, const GLfloat* box ) {
+    const float4 cx   = float4_splat( 0.5f * ( box[0] + box[3] ) );
+    const float4 cy   = float4_splat( 0.5f * ( box[1] + box[4] ) );
+    const float4 cz   = float4_splat( 0.5f * ( box[2] + box[5] ) );
+    const float4 ex   = float4_splat( 0.5f * ( box[3] - box[0] ) );
+    const float4 ey   = float4_splat( 0.5f * ( box[4] - box[1] ) );
+    const float4 ez   = float4_splat( 0.5f * ( box[5] - box[2] ) );
+    const float4 zero = float4_splat( 0.0f );
+
+    // The box is outside if it is entirely behind any one plane.
+    for( int i = 0; i < Frustum::PLANES; i += 4 ) {
+        const float4 distance = float4_load( frustum.nx + i ) * cx +
+                                float4_load( frustum.ny + i ) * cy +
+                                float4_load( frustum.nz + i ) * cz +
+                                float4_load( frustum.d + i );
+        const float4 radius = float4_load( frustum.ax + i ) * ex +
+                              float4_load( frustum.ay + i ) * ey +
+                              float4_load( frustum.az + i ) * ez;
+        const int4 outside = ( distance + radius ) < zero;
+        if( int4_any( outside ) ) {
+            return false;
+        }
+    }
+    return true;
+}
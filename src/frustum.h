@@ -0,0 +1,37 @@
+#ifndef WASMVR_FRUSTUM_H
+#define WASMVR_FRUSTUM_H
+
+#include <GLES3/gl3.h>
+
+// Planes stored as structure of arrays so a box is tested against four of them at once.
+// A point p is inside when nx * p.x + ny * p.y + nz * p.z + d >= 0 for every plane.
+// The six real planes are padded to eight with planes that accept everything.
+struct Frustum {
+    static const int PLANES = 8;
+
+    GLfloat nx[PLANES];
+    GLfloat ny[PLANES];
+    GLfloat nz[PLANES];
+    GLfloat d[PLANES];
+    // Absolute values of the normals, used to project box extents onto them.
+    GLfloat ax[PLANES];
+    GLfloat ay[PLANES];
+    GLfloat az[PLANES];
+
+    Frustum();
+};
+
+// Extracts the world space planes from a (column major) view and projection matrix, e.g. as WebVR reports them.
+void frustum_from_view_projection( const GLfloat* view, const GLfloat* projection, Frustum& frustum );
+
+// A single frustum that contains both eyes' frusta. Each plane is one of the eyes' matching planes, pushed out
+// until every corner of both frusta is inside it, so it is conservative for any pair of eyes. Returns false,
+// leaving frustum accepting everything, if a matrix can't be inverted.
+bool frustum_combine( const GLfloat* view_left, const GLfloat* projection_left,
+                      const GLfloat* view_right, const GLfloat* projection_right,
+                      Frustum& frustum );
+
+// Whether the box, given as min x, y, z followed by max x, y, z, is at least partially inside.
+bool frustum_intersects_box( const Frustum& frustum, const GLfloat* box );
+
+#endif // WASMVR_FRUSTUM_H
@@ -0,0 +1,416 @@
+#include "gl_command_buffer.h"
+
+#include <string.h>
+
+#include "camera.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const uint32_t OPCODE_BITS = 8;
+    const uint32_t OPCODE_MASK = ( 1u << OPCODE_BITS ) - 1;
+
+    const char* OPCODE_NAMES[GLCMD_OPCODES] = {
+        "UseProgram",
+        "BindBuffer",
+        "BufferData",
+        "BufferSubData",
+        "BindVertexArray",
+        "EnableVertexAttribArray",
+        "DisableVertexAttribArray",
+        "VertexAttribPointer",
+        "VertexAttribDivisor",
+        "Viewport",
+        "Enable",
+        "Disable",
+        "BlendFunc",
+        "DepthFunc",
+        "DepthMask",
+        "ColorMask",
+        "Clear",
+        "Uniform1i",
+        "Uniform1f",
+        "Uniform4f",
+        "UniformMatrix4fv",
+        "BindCamera",
+        "CameraMask",
+        "DrawArrays",
+        "DrawElements",
+        "DrawArraysInstanced",
+        "DrawElementsInstanced",
+    };
+
+    size_t words_for_bytes( size_t bytes ) {
+        return ( bytes + sizeof( uint32_t ) - 1 ) / sizeof( uint32_t );
+    }
+
+    uint32_t from_float( GLfloat value ) {
+        uint32_t word;
+        memcpy( &word, &value, sizeof( word ) );
+        return word;
+    }
+
+    GLfloat to_float( uint32_t word ) {
+        GLfloat value;
+        memcpy( &value, &word, sizeof( value ) );
+        return value;
+    }
+
+    GLint to_int( uint32_t word ) {
+        return static_cast<GLint>( word );
+    }
+}
+
+GLCommandBuffer::GLCommandBuffer()
+    : commands_( 0 ) {
+}
+
+void GLCommandBuffer::reset() {
+    words_.clear();
+    commands_ = 0;
+}
+
+uint32_t* GLCommandBuffer::push( GLOpcode opcode, size_t argument_words ) {
+    const size_t at = words_.size();
+    words_.resize( at + 1 + argument_words );
+    words_[at] = static_cast<uint32_t>( opcode ) | static_cast<uint32_t>( argument_words << OPCODE_BITS );
+    ++commands_;
+    return &words_[at + 1];
+}
+
+void GLCommandBuffer::push_bytes( uint32_t* destination, const void* data, size_t size ) {
+    if( data ) {
+        memcpy( destination, data, size );
+    }
+}
+
+void GLCommandBuffer::use_program( GLuint program ) {
+    uint32_t* args = push( GLCMD_USE_PROGRAM, 1 );
+    args[0]        = program;
+}
+
+void GLCommandBuffer::bind_buffer( GLenum target, GLuint buffer ) {
+    uint32_t* args = push( GLCMD_BIND_BUFFER, 2 );
+    args[0]        = target;
+    args[1]        = buffer;
+}
+
+void GLCommandBuffer::buffer_data( GLenum target, GLsizeiptr size, const void* data, GLenum usage ) {
+    // A null data pointer only sizes the buffer, so there is nothing to copy.
+    const size_t data_words = data ? words_for_bytes( size ) : 0;
+    uint32_t*    args       = push( GLCMD_BUFFER_DATA, 4 + data_words );
+    args[0]                 = target;
+    args[1]                 = static_cast<uint32_t>( size );
+    args[2]                 = usage;
+    args[3]                 = data ? 1 : 0;
+    push_bytes( args + 4, data, size );
+}
+
+void GLCommandBuffer::buffer_sub_data( GLenum target, GLintptr offset, GLsizeiptr size, const void* data ) {
+    uint32_t* args = push( GLCMD_BUFFER_SUB_DATA, 3 + words_for_bytes( size ) );
+    args[0]        = target;
+    args[1]        = static_cast<uint32_t>( offset );
+    args[2]        = static_cast<uint32_t>( size );
+    push_bytes( args + 3, data, size );
+}
+
+void GLCommandBuffer::bind_vertex_array( GLuint array ) {
+    uint32_t* args = push( GLCMD_BIND_VERTEX_ARRAY, 1 );
+    args[0]        = array;
+}
+
+void GLCommandBuffer::enable_vertex_attrib_array( GLuint index ) {
+    uint32_t* args = push( GLCMD_ENABLE_VERTEX_ATTRIB_ARRAY, 1 );
+    args[0]        = index;
+}
+
+void GLCommandBuffer::disable_vertex_attrib_array( GLuint index ) {
+    uint32_t* args = push( GLCMD_DISABLE_VERTEX_ATTRIB_ARRAY, 1 );
+    args[0]        = index;
+}
+
+void GLCommandBuffer::vertex_attrib_pointer( GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset ) {
+    uint32_t* args = push( GLCMD_VERTEX_ATTRIB_POINTER, 6 );
+    args[0]        = index;
+    args[1]        = static_cast<uint32_t>( size );
+    args[2]        = type;
+    args[3]        = normalized;
+    args[4]        = static_cast<uint32_t>( stride );
+    args[5]        = static_cast<uint32_t>( offset );
+}
+
+void GLCommandBuffer::vertex_attrib_divisor( GLuint index, GLuint divisor ) {
+    uint32_t* args = push( GLCMD_VERTEX_ATTRIB_DIVISOR, 2 );
+    args[0]        = index;
+    args[1]        = divisor;
+}
+
+void GLCommandBuffer::viewport( GLint x, GLint y, GLsizei width, GLsizei height ) {
+    uint32_t* args = push( GLCMD_VIEWPORT, 4 );
+    args[0]        = static_cast<uint32_t>( x );
+    args[1]        = static_cast<uint32_t>( y );
+    args[2]        = static_cast<uint32_t>( width );
+    args[3]        = static_cast<uint32_t>( height );
+}
+
+void GLCommandBuffer::enable( GLenum capability ) {
+    uint32_t* args = push( GLCMD_ENABLE, 1 );
+    args[0]        = capability;
+}
+
+void GLCommandBuffer::disable( GLenum capability ) {
+    uint32_t* args = push( GLCMD_DISABLE, 1 );
+    args[0]        = capability;
+}
+
+void GLCommandBuffer::blend_func( GLenum source, GLenum destination ) {
+    uint32_t* args = push( GLCMD_BLEND_FUNC, 2 );
+    args[0]        = source;
+    args[1]        = destination;
+}
+
+void GLCommandBuffer::depth_func( GLenum func ) {
+    uint32_t* args = push( GLCMD_DEPTH_FUNC, 1 );
+    args[0]        = func;
+}
+
+void GLCommandBuffer::depth_mask( GLboolean flag ) {
+    uint32_t* args = push( GLCMD_DEPTH_MASK, 1 );
+    args[0]        = flag;
+}
+
+void GLCommandBuffer::color_mask( GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha ) {
+    uint32_t* args = push( GLCMD_COLOR_MASK, 4 );
+    args[0]        = red;
+    args[1]        = green;
+    args[2]        = blue;
+    args[3]        = alpha;
+}
+
+void GLCommandBuffer::clear( GLbitfield mask ) {
+    uint32_t* args = push( GLCMD_CLEAR, 1 );
+    args[0]        = mask;
+}
+
+void GLCommandBuffer::uniform_1i( GLint location, GLint value ) {
+    uint32_t* args = push( GLCMD_UNIFORM_1I, 2 );
+    args[0]        = static_cast<uint32_t>( location );
+    args[1]        = static_cast<uint32_t>( value );
+}
+
+void GLCommandBuffer::uniform_1f( GLint location, GLfloat value ) {
+    uint32_t* args = push( GLCMD_UNIFORM_1F, 2 );
+    args[0]        = static_cast<uint32_t>( location );
+    args[1]        = from_float( value );
+}
+
+void GLCommandBuffer::uniform_4f( GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w ) {
+    uint32_t* args = push( GLCMD_UNIFORM_4F, 5 );
+    args[0]        = static_cast<uint32_t>( location );
+    args[1]        = from_float( x );
+    args[2]        = from_float( y );
+    args[3]        = from_float( z );
+    args[4]        = from_float( w );
+}
+
+void GLCommandBuffer::uniform_matrix4fv( GLint location, GLboolean transpose, const GLfloat* value ) {
+    uint32_t* args = push( GLCMD_UNIFORM_MATRIX4FV, 2 + 16 );
+    args[0]        = static_cast<uint32_t>( location );
+    args[1]        = transpose;
+    push_bytes( args + 2, value, 16 * sizeof( GLfloat ) );
+}
+
+void GLCommandBuffer::bind_camera() {
+    push( GLCMD_BIND_CAMERA, 0 );
+}
+
+void GLCommandBuffer::camera_mask( uint32_t mask ) {
+    uint32_t* args = push( GLCMD_CAMERA_MASK, 1 );
+    args[0]        = mask;
+}
+
+void GLCommandBuffer::draw_arrays( GLenum mode, GLint first, GLsizei count ) {
+    uint32_t* args = push( GLCMD_DRAW_ARRAYS, 3 );
+    args[0]        = mode;
+    args[1]        = static_cast<uint32_t>( first );
+    args[2]        = static_cast<uint32_t>( count );
+}
+
+void GLCommandBuffer::draw_elements( GLenum mode, GLsizei count, GLenum type, GLintptr offset ) {
+    uint32_t* args = push( GLCMD_DRAW_ELEMENTS, 4 );
+    args[0]        = mode;
+    args[1]        = static_cast<uint32_t>( count );
+    args[2]        = type;
+    args[3]        = static_cast<uint32_t>( offset );
+}
+
+void GLCommandBuffer::draw_arrays_instanced( GLenum mode, GLint first, GLsizei count, GLsizei instances ) {
+    uint32_t* args = push( GLCMD_DRAW_ARRAYS_INSTANCED, 4 );
+    args[0]        = mode;
+    args[1]        = static_cast<uint32_t>( first );
+    args[2]        = static_cast<uint32_t>( count );
+    args[3]        = static_cast<uint32_t>( instances );
+}
+
+void GLCommandBuffer::draw_elements_instanced( GLenum mode, GLsizei count, GLenum type, GLintptr offset, GLsizei instances ) {
+    uint32_t* args = push( GLCMD_DRAW_ELEMENTS_INSTANCED, 5 );
+    args[0]        = mode;
+    args[1]        = static_cast<uint32_t>( count );
+    args[2]        = type;
+    args[3]        = static_cast<uint32_t>( offset );
+    args[4]        = static_cast<uint32_t>( instances );
+}
+
+const uint32_t* GLCommandBuffer::data() const {
+    return words_.empty() ? nullptr : &words_[0];
+}
+
+size_t GLCommandBuffer::words() const {
+    return words_.size();
+}
+
+size_t GLCommandBuffer::bytes() const {
+    return words_.size() * sizeof( uint32_t );
+}
+
+unsigned int GLCommandBuffer::commands() const {
+    return commands_;
+}
+
+const char* gl_opcode_name( GLOpcode opcode ) {
+    return ( opcode < GLCMD_OPCODES ) ? OPCODE_NAMES[opcode] : "Unknown";
+}
+
+void gl_command_buffer_replay( UserContext& user_context, const GLCommandBuffer& buffer, int camera_slot ) {
+    GLState&        gl     = user_context.gl_state;
+    FrameBudget&    budget = user_context.frame_budget;
+    const uint32_t* word   = buffer.data();
+    const uint32_t* end    = word + buffer.words();
+    const uint32_t  camera = 1u << camera_slot;
+    uint32_t        mask   = ~0u;
+
+    while( word < end ) {
+        const uint32_t  header = *word++;
+        const uint32_t* args   = word;
+        word += header >> OPCODE_BITS;
+
+        const GLOpcode opcode = static_cast<GLOpcode>( header & OPCODE_MASK );
+        if( ( opcode >= GLCMD_DRAW_ARRAYS ) && ( opcode <= GLCMD_DRAW_ELEMENTS_INSTANCED ) && !( mask & camera ) ) {
+            continue;
+        }
+
+        switch( opcode ) {
+        case GLCMD_USE_PROGRAM: gl.use_program( args[0] ); break;
+        case GLCMD_BIND_BUFFER: gl.bind_buffer( args[0], args[1] ); break;
+        case GLCMD_BUFFER_DATA:
+            glBufferData( args[0], args[1], args[3] ? args + 4 : nullptr, args[2] );
+            budget.count_bytes_uploaded( args[3] ? args[1] : 0 );
+            break;
+        case GLCMD_BUFFER_SUB_DATA:
+            glBufferSubData( args[0], args[1], args[2], args + 3 );
+            budget.count_bytes_uploaded( args[2] );
+            break;
+        case GLCMD_BIND_VERTEX_ARRAY: gl.bind_vertex_array( args[0] ); break;
+        case GLCMD_ENABLE_VERTEX_ATTRIB_ARRAY: gl.enable_vertex_attrib_array( args[0] ); break;
+        case GLCMD_DISABLE_VERTEX_ATTRIB_ARRAY: gl.disable_vertex_attrib_array( args[0] ); break;
+        case GLCMD_VERTEX_ATTRIB_POINTER:
+            gl.vertex_attrib_pointer(
+                args[0],
+                to_int( args[1] ),
+                args[2],
+                static_cast<GLboolean>( args[3] ),
+                to_int( args[4] ),
+                reinterpret_cast<const GLvoid*>( static_cast<uintptr_t>( args[5] ) ) );
+            break;
+        case GLCMD_VERTEX_ATTRIB_DIVISOR: gl.vertex_attrib_divisor( args[0], args[1] ); break;
+        case GLCMD_VIEWPORT: gl.viewport( to_int( args[0] ), to_int( args[1] ), to_int( args[2] ), to_int( args[3] ) ); break;
+        case GLCMD_ENABLE: gl.enable( args[0] ); break;
+        case GLCMD_DISABLE: gl.disable( args[0] ); break;
+        case GLCMD_BLEND_FUNC: gl.blend_func( args[0], args[1] ); break;
+        case GLCMD_DEPTH_FUNC: gl.depth_func( args[0] ); break;
+        case GLCMD_DEPTH_MASK: gl.depth_mask( static_cast<GLboolean>( args[0] ) ); break;
+        case GLCMD_COLOR_MASK:
+            gl.color_mask(
+                static_cast<GLboolean>( args[0] ),
+                static_cast<GLboolean>( args[1] ),
+                static_cast<GLboolean>( args[2] ),
+                static_cast<GLboolean>( args[3] ) );
+            break;
+        case GLCMD_CLEAR: glClear( args[0] ); break;
+        case GLCMD_UNIFORM_1I: gl.uniform_1i( to_int( args[0] ), to_int( args[1] ) ); break;
+        case GLCMD_UNIFORM_1F: gl.uniform_1f( to_int( args[0] ), to_float( args[1] ) ); break;
+        case GLCMD_UNIFORM_4F: gl.uniform_4f( to_int( args[0] ), to_float( args[1] ), to_float( args[2] ), to_float( args[3] ), to_float( args[4] ) ); break;
+        case GLCMD_UNIFORM_MATRIX4FV: {
+            GLfloat matrix[4 * 4];
+            memcpy( matrix, args + 2, sizeof( matrix ) );
+            gl.uniform_matrix4fv( to_int( args[0] ), static_cast<GLboolean>( args[1] ), matrix );
+            break;
+        }
+        case GLCMD_BIND_CAMERA: camera_buffer_bind( user_context, camera_slot ); break;
+        case GLCMD_CAMERA_MASK: mask = args[0]; break;
+        case GLCMD_DRAW_ARRAYS:
+            glDrawArrays( args[0], to_int( args[1] ), to_int( args[2] ) );
+            budget.count_draw_calls( 1 );
+            break;
+        case GLCMD_DRAW_ELEMENTS:
+            glDrawElements( args[0], to_int( args[1] ), args[2], reinterpret_cast<const GLvoid*>( static_cast<uintptr_t>( args[3] ) ) );
+            budget.count_draw_calls( 1 );
+            break;
+        case GLCMD_DRAW_ARRAYS_INSTANCED:
+            glDrawArraysInstanced( args[0], to_int( args[1] ), to_int( args[2] ), to_int( args[3] ) );
+            budget.count_draw_calls( 1 );
+            break;
+        case GLCMD_DRAW_ELEMENTS_INSTANCED:
+            glDrawElementsInstanced( args[0], to_int( args[1] ), args[2], reinterpret_cast<const GLvoid*>( static_cast<uintptr_t>( args[3] ) ), to_int( args[4] ) );
+            budget.count_draw_calls( 1 );
+            break;
+        default:
+            STDERR( "Unknown GL command 0x%x.", header & OPCODE_MASK );
+            return;
+        }
+    }
+}
+
+void print_gl_command_buffer( const GLCommandBuffer& buffer ) {
+    STDOUT( "GLCommandBuffer { commands: %u, bytes: %lu }", buffer.commands(), static_cast<unsigned long>( buffer.bytes() ) );
+
+    const uint32_t* word = buffer.data();
+    const uint32_t* end  = word + buffer.words();
+    for( unsigned int i = 0; word < end; ++i ) {
+        const uint32_t  header = *word++;
+        const uint32_t  count  = header >> OPCODE_BITS;
+        const uint32_t* args   = word;
+        word += count;
+
+        const GLOpcode opcode = static_cast<GLOpcode>( header & OPCODE_MASK );
+        printf( "  %4u %s(", i, gl_opcode_name( opcode ) );
+        switch( opcode ) {
+        case GLCMD_BUFFER_DATA:
+            printf( " target: 0x%x, size: %u, usage: 0x%x, data: %s ", args[0], args[1], args[2], args[3] ? "inline" : "null" );
+            break;
+        case GLCMD_BUFFER_SUB_DATA:
+            printf( " target: 0x%x, offset: %u, size: %u ", args[0], args[1], args[2] );
+            break;
+        case GLCMD_UNIFORM_1F:
+            printf( " %d, %f ", to_int( args[0] ), to_float( args[1] ) );
+            break;
+        case GLCMD_UNIFORM_4F:
+            printf( " %d, %f, %f, %f, %f ", to_int( args[0] ), to_float( args[1] ), to_float( args[2] ), to_float( args[3] ), to_float( args[4] ) );
+            break;
+        case GLCMD_UNIFORM_MATRIX4FV:
+            printf( " %d, transpose: %u, [", to_int( args[0] ), args[1] );
+            for( int j = 0; j < 16; ++j ) {
+                printf( "%s%+6f", j ? ", " : " ", to_float( args[2 + j] ) );
+            }
+            printf( " ] " );
+            break;
+        default:
+            for( uint32_t j = 0; j < count; ++j ) {
+                printf( "%s%d", j ? ", " : " ", to_int( args[j] ) );
+            }
+            printf( count ? " " : "" );
+            break;
+        }
+        printf( ")\n" );
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef WASMVR_GL_COMMAND_BUFFER_H
+#define WASMVR_GL_COMMAND_BUFFER_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class UserContext;
+
+enum GLOpcode {
+    GLCMD_USE_PROGRAM,
+    GLCMD_BIND_BUFFER,
+    GLCMD_BUFFER_DATA,
+    GLCMD_BUFFER_SUB_DATA,
+    GLCMD_BIND_VERTEX_ARRAY,
+    GLCMD_ENABLE_VERTEX_ATTRIB_ARRAY,
+    GLCMD_DISABLE_VERTEX_ATTRIB_ARRAY,
+    GLCMD_VERTEX_ATTRIB_POINTER,
+    GLCMD_VERTEX_ATTRIB_DIVISOR,
+    GLCMD_VIEWPORT,
+    GLCMD_ENABLE,
+    GLCMD_DISABLE,
+    GLCMD_BLEND_FUNC,
+    GLCMD_DEPTH_FUNC,
+    GLCMD_DEPTH_MASK,
+    GLCMD_COLOR_MASK,
+    GLCMD_CLEAR,
+    GLCMD_UNIFORM_1I,
+    GLCMD_UNIFORM_1F,
+    GLCMD_UNIFORM_4F,
+    GLCMD_UNIFORM_MATRIX4FV,
+    GLCMD_BIND_CAMERA,
+    GLCMD_CAMERA_MASK,
+    GLCMD_DRAW_ARRAYS,
+    GLCMD_DRAW_ELEMENTS,
+    GLCMD_DRAW_ARRAYS_INSTANCED,
+    GLCMD_DRAW_ELEMENTS_INSTANCED,
+    GLCMD_OPCODES
+};
+
+// A compact recording of GL work: each command is a header word (opcode and argument word count)
+// followed by its arguments inline, including any buffer data, in one growable arena.
+// Recording makes no GL calls, so it can happen on any thread as long as each buffer has one writer.
+// The arena keeps its capacity across reset(), so steady state recording does not allocate.
+class GLCommandBuffer {
+public:
+    GLCommandBuffer();
+
+    void reset();
+
+    void use_program( GLuint program );
+    void bind_buffer( GLenum target, GLuint buffer );
+    void buffer_data( GLenum target, GLsizeiptr size, const void* data, GLenum usage );
+    void buffer_sub_data( GLenum target, GLintptr offset, GLsizeiptr size, const void* data );
+    void bind_vertex_array( GLuint array );
+    void enable_vertex_attrib_array( GLuint index );
+    void disable_vertex_attrib_array( GLuint index );
+    // offset is into the buffer bound to GL_ARRAY_BUFFER at replay.
+    void vertex_attrib_pointer( GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset );
+    void vertex_attrib_divisor( GLuint index, GLuint divisor );
+    void viewport( GLint x, GLint y, GLsizei width, GLsizei height );
+    void enable( GLenum capability );
+    void disable( GLenum capability );
+    void blend_func( GLenum source, GLenum destination );
+    void depth_func( GLenum func );
+    void depth_mask( GLboolean flag );
+    void color_mask( GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha );
+    void clear( GLbitfield mask );
+    void uniform_1i( GLint location, GLint value );
+    void uniform_1f( GLint location, GLfloat value );
+    void uniform_4f( GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w );
+    void uniform_matrix4fv( GLint location, GLboolean transpose, const GLfloat* value );
+    // Binds whichever camera the buffer is replayed with, so one recording serves both eyes.
+    void bind_camera();
+    // Draws after this only run when replayed with a camera slot whose bit is set in mask,
+    // e.g. for objects that were culled for one eye only.
+    void camera_mask( uint32_t mask );
+    void draw_arrays( GLenum mode, GLint first, GLsizei count );
+    void draw_elements( GLenum mode, GLsizei count, GLenum type, GLintptr offset );
+    void draw_arrays_instanced( GLenum mode, GLint first, GLsizei count, GLsizei instances );
+    void draw_elements_instanced( GLenum mode, GLsizei count, GLenum type, GLintptr offset, GLsizei instances );
+
+    const uint32_t* data() const;
+    size_t          words() const;
+    size_t          bytes() const;
+    unsigned int    commands() const;
+
+private:
+    uint32_t* push( GLOpcode opcode, size_t argument_words );
+    void      push_bytes( uint32_t* destination, const void* data, size_t size );
+
+    std::vector<uint32_t> words_;
+    unsigned int          commands_;
+};
+
+const char* gl_opcode_name( GLOpcode opcode );
+
+// Issues the recorded commands against the current context through the GL state cache,
+// binding camera_slot wherever the recording asked for the camera.
+void gl_command_buffer_replay( UserContext& user_context, const GLCommandBuffer& buffer, int camera_slot );
+
+// Prints every recorded command and its arguments, for offline analysis of a frame.
+void print_gl_command_buffer( const GLCommandBuffer& buffer );
+
+#endif // WASMVR_GL_COMMAND_BUFFER_H
@@ -0,0 +1,588 @@
+#include "gl_state.h"
+
+#include <string.h>
+
+#include "util.h"
+
+namespace {
+    const GLenum BUFFER_BINDING_QUERIES[] = {
+        GL_ARRAY_BUFFER_BINDING,
+        GL_ELEMENT_ARRAY_BUFFER_BINDING,
+        GL_UNIFORM_BUFFER_BINDING,
+        GL_COPY_READ_BUFFER_BINDING,
+        GL_COPY_WRITE_BUFFER_BINDING,
+        GL_PIXEL_PACK_BUFFER_BINDING,
+        GL_PIXEL_UNPACK_BUFFER_BINDING,
+        GL_TRANSFORM_FEEDBACK_BUFFER_BINDING,
+    };
+
+    GLint get_integer( GLenum name ) {
+        GLint value = 0;
+        glGetIntegerv( name, &value );
+        return value;
+    }
+
+    uint64_t uniform_key( GLuint program, GLint location ) {
+        return ( static_cast<uint64_t>( program ) << 32 ) | static_cast<uint32_t>( location );
+    }
+}
+
+GLStateStats::GLStateStats()
+    : issued( 0 )
+    , elided( 0 )
+    , mismatches( 0 )
+    , frame_issued( 0 )
+    , frame_elided( 0 ) {
+}
+
+bool GLState::AttribPointer::operator==( const AttribPointer& other ) const {
+    return ( buffer == other.buffer ) &&
+           ( size == other.size ) &&
+           ( type == other.type ) &&
+           ( normalized == other.normalized ) &&
+           ( stride == other.stride ) &&
+           ( pointer == other.pointer );
+}
+
+bool GLState::Viewport::operator==( const Viewport& other ) const {
+    return ( x == other.x ) && ( y == other.y ) && ( width == other.width ) && ( height == other.height );
+}
+
+bool GLState::BufferRange::operator==( const BufferRange& other ) const {
+    return ( buffer == other.buffer ) && ( offset == other.offset ) && ( size == other.size );
+}
+
+GLState::GLState()
+    : debug_( false ) {
+}
+
+void GLState::reset() {
+    program_.known = false;
+    for( int i = 0; i < BUFFER_TARGETS; ++i ) {
+        buffers_[i].known = false;
+    }
+    for( int i = 0; i < MAX_UNIFORM_INDICES; ++i ) {
+        uniform_ranges_[i].known = false;
+    }
+    vertex_array_.known = false;
+    forget_vertex_array_state();
+    viewport_.known = false;
+    scissor_.known  = false;
+    for( int i = 0; i < CAPABILITIES; ++i ) {
+        capabilities_[i].known = false;
+    }
+    blend_source_.known      = false;
+    blend_destination_.known = false;
+    depth_func_.known        = false;
+    depth_mask_.known        = false;
+    color_mask_.known        = false;
+    uniforms_.clear();
+}
+
+void GLState::forget_program( GLuint program ) {
+    for( auto it = uniforms_.begin(); it != uniforms_.end(); ) {
+        if( ( it->first >> 32 ) == program ) {
+            it = uniforms_.erase( it );
+        } else {
+            ++it;
+        }
+    }
+    if( program_.is( program ) ) {
+        program_.known = false;
+    }
+}
+
+void GLState::forget_buffer( GLuint buffer ) {
+    if( !buffer ) {
+        return;
+    }
+    for( int i = 0; i < BUFFER_TARGETS; ++i ) {
+        if( buffers_[i].is( buffer ) ) {
+            buffers_[i].known = false;
+        }
+    }
+    for( int i = 0; i < MAX_UNIFORM_INDICES; ++i ) {
+        if( uniform_ranges_[i].known && ( uniform_ranges_[i].value.buffer == buffer ) ) {
+            uniform_ranges_[i].known = false;
+        }
+    }
+    // Only the bound vertex array's attributes are known, and GL detaches the buffer from them.
+    for( int i = 0; i < MAX_ATTRIBS; ++i ) {
+        if( attrib_pointers_[i].known && ( attrib_pointers_[i].value.buffer == buffer ) ) {
+            attrib_pointers_[i].known = false;
+        }
+    }
+}
+
+void GLState::forget_vertex_array( GLuint array ) {
+    if( array && vertex_array_.is( array ) ) {
+        vertex_array_.known = false;
+        forget_vertex_array_state();
+    }
+}
+
+void GLState::set_debug( bool debug ) {
+    debug_ = debug;
+}
+
+bool GLState::debug() const {
+    return debug_;
+}
+
+void GLState::begin_frame() {
+    stats_.frame_issued = 0;
+    stats_.frame_elided = 0;
+}
+
+const GLStateStats& GLState::stats() const {
+    return stats_;
+}
+
+void GLState::use_program( GLuint program ) {
+    if( program_.is( program ) ) {
+        if( !debug_ || ( static_cast<GLuint>( get_integer( GL_CURRENT_PROGRAM ) ) == program ) ) {
+            elide();
+            return;
+        }
+        mismatch( "program" );
+    }
+    issue();
+    glUseProgram( program );
+    program_.set( program );
+}
+
+void GLState::bind_buffer( GLenum target, GLuint buffer ) {
+    int index = buffer_target_index( target );
+    if( index < 0 ) {
+        issue();
+        glBindBuffer( target, buffer );
+        return;
+    }
+
+    if( buffers_[index].is( buffer ) ) {
+        if( !debug_ || ( static_cast<GLuint>( get_integer( BUFFER_BINDING_QUERIES[index] ) ) == buffer ) ) {
+            elide();
+            return;
+        }
+        mismatch( "buffer binding" );
+    }
+    issue();
+    glBindBuffer( target, buffer );
+    buffers_[index].set( buffer );
+}
+
+void GLState::bind_buffer_range( GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size ) {
+    BufferRange range = {buffer, offset, size};
+    if( ( target == GL_UNIFORM_BUFFER ) && ( index < MAX_UNIFORM_INDICES ) ) {
+        if( uniform_ranges_[index].is( range ) ) {
+            if( !debug_ ) {
+                elide();
+                return;
+            }
+            GLint   bound_buffer = 0;
+            GLint64 bound_offset = 0;
+            GLint64 bound_size   = 0;
+            glGetIntegeri_v( GL_UNIFORM_BUFFER_BINDING, index, &bound_buffer );
+            glGetInteger64i_v( GL_UNIFORM_BUFFER_START, index, &bound_offset );
+            glGetInteger64i_v( GL_UNIFORM_BUFFER_SIZE, index, &bound_size );
+            if( ( static_cast<GLuint>( bound_buffer ) == buffer ) && ( bound_offset == offset ) && ( bound_size == size ) ) {
+                elide();
+                return;
+            }
+            mismatch( "uniform buffer range" );
+        }
+        uniform_ranges_[index].set( range );
+    }
+
+    issue();
+    glBindBufferRange( target, index, buffer, offset, size );
+
+    // Binding a range also changes the generic binding point of the target.
+    int target_index = buffer_target_index( target );
+    if( target_index >= 0 ) {
+        buffers_[target_index].set( buffer );
+    }
+}
+
+void GLState::bind_vertex_array( GLuint array ) {
+    if( vertex_array_.is( array ) ) {
+        if( !debug_ || ( static_cast<GLuint>( get_integer( GL_VERTEX_ARRAY_BINDING ) ) == array ) ) {
+            elide();
+            return;
+        }
+        mismatch( "vertex array" );
+    }
+    issue();
+    glBindVertexArray( array );
+    vertex_array_.set( array );
+
+    // The element array binding and the attributes belong to the vertex array.
+    forget_vertex_array_state();
+}
+
+void GLState::enable_vertex_attrib_array( GLuint index ) {
+    set_attrib_array( index, true );
+}
+
+void GLState::disable_vertex_attrib_array( GLuint index ) {
+    set_attrib_array( index, false );
+}
+
+void GLState::vertex_attrib_pointer( GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer ) {
+    // The pointer is an offset into whatever is bound to GL_ARRAY_BUFFER, so that is part of the state.
+    AttribPointer attrib = {buffers_[BUFFER_ARRAY].value, size, type, normalized, stride, pointer};
+    if( buffers_[BUFFER_ARRAY].known && ( index < MAX_ATTRIBS ) ) {
+        if( attrib_pointers_[index].is( attrib ) ) {
+            if( !debug_ ) {
+                elide();
+                return;
+            }
+            GLint bound_buffer = 0;
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &bound_buffer );
+            if( static_cast<GLuint>( bound_buffer ) == attrib.buffer ) {
+                elide();
+                return;
+            }
+            mismatch( "vertex attribute pointer" );
+        }
+        attrib_pointers_[index].set( attrib );
+    }
+    issue();
+    glVertexAttribPointer( index, size, type, normalized, stride, pointer );
+}
+
+void GLState::vertex_attrib_divisor( GLuint index, GLuint divisor ) {
+    if( index < MAX_ATTRIBS ) {
+        if( attrib_divisors_[index].is( divisor ) ) {
+            GLint bound = divisor;
+            if( debug_ ) {
+                glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &bound );
+            }
+            if( static_cast<GLuint>( bound ) == divisor ) {
+                elide();
+                return;
+            }
+            mismatch( "vertex attribute divisor" );
+        }
+        attrib_divisors_[index].set( divisor );
+    }
+    issue();
+    glVertexAttribDivisor( index, divisor );
+}
+
+void GLState::viewport( GLint x, GLint y, GLsizei width, GLsizei height ) {
+    Viewport viewport = {x, y, width, height};
+    if( viewport_.is( viewport ) ) {
+        if( !debug_ ) {
+            elide();
+            return;
+        }
+        GLint bound[4];
+        glGetIntegerv( GL_VIEWPORT, bound );
+        if( ( bound[0] == x ) && ( bound[1] == y ) && ( bound[2] == width ) && ( bound[3] == height ) ) {
+            elide();
+            return;
+        }
+        mismatch( "viewport" );
+    }
+    issue();
+    glViewport( x, y, width, height );
+    viewport_.set( viewport );
+}
+
+void GLState::scissor( GLint x, GLint y, GLsizei width, GLsizei height ) {
+    Viewport scissor = {x, y, width, height};
+    if( scissor_.is( scissor ) ) {
+        if( !debug_ ) {
+            elide();
+            return;
+        }
+        GLint bound[4];
+        glGetIntegerv( GL_SCISSOR_BOX, bound );
+        if( ( bound[0] == x ) && ( bound[1] == y ) && ( bound[2] == width ) && ( bound[3] == height ) ) {
+            elide();
+            return;
+        }
+        mismatch( "scissor" );
+    }
+    issue();
+    glScissor( x, y, width, height );
+    scissor_.set( scissor );
+}
+
+void GLState::enable( GLenum capability ) {
+    set_capability( capability, true );
+}
+
+void GLState::disable( GLenum capability ) {
+    set_capability( capability, false );
+}
+
+void GLState::blend_func( GLenum source, GLenum destination ) {
+    if( blend_source_.is( source ) && blend_destination_.is( destination ) ) {
+        if( !debug_ ||
+            ( ( static_cast<GLenum>( get_integer( GL_BLEND_SRC_RGB ) ) == source ) &&
+              ( static_cast<GLenum>( get_integer( GL_BLEND_DST_RGB ) ) == destination ) ) ) {
+            elide();
+            return;
+        }
+        mismatch( "blend function" );
+    }
+    issue();
+    glBlendFunc( source, destination );
+    blend_source_.set( source );
+    blend_destination_.set( destination );
+}
+
+void GLState::depth_func( GLenum func ) {
+    if( depth_func_.is( func ) ) {
+        if( !debug_ || ( static_cast<GLenum>( get_integer( GL_DEPTH_FUNC ) ) == func ) ) {
+            elide();
+            return;
+        }
+        mismatch( "depth function" );
+    }
+    issue();
+    glDepthFunc( func );
+    depth_func_.set( func );
+}
+
+void GLState::depth_mask( GLboolean flag ) {
+    if( depth_mask_.is( flag ) ) {
+        GLboolean bound = flag;
+        if( debug_ ) {
+            glGetBooleanv( GL_DEPTH_WRITEMASK, &bound );
+        }
+        if( bound == flag ) {
+            elide();
+            return;
+        }
+        mismatch( "depth mask" );
+    }
+    issue();
+    glDepthMask( flag );
+    depth_mask_.set( flag );
+}
+
+void GLState::color_mask( GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha ) {
+    const GLuint mask = ( red ? 1 : 0 ) | ( green ? 2 : 0 ) | ( blue ? 4 : 0 ) | ( alpha ? 8 : 0 );
+    if( color_mask_.is( mask ) ) {
+        GLboolean bound[4] = {red, green, blue, alpha};
+        if( debug_ ) {
+            glGetBooleanv( GL_COLOR_WRITEMASK, bound );
+        }
+        if( ( bound[0] == red ) && ( bound[1] == green ) && ( bound[2] == blue ) && ( bound[3] == alpha ) ) {
+            elide();
+            return;
+        }
+        mismatch( "color mask" );
+    }
+    issue();
+    glColorMask( red, green, blue, alpha );
+    color_mask_.set( mask );
+}
+
+void GLState::uniform_1i( GLint location, GLint value ) {
+    Uniform uniform;
+    uniform.type      = GL_INT;
+    uniform.transpose = GL_FALSE;
+    uniform.i         = value;
+    if( uniform_cached( location, uniform, 0 ) ) {
+        return;
+    }
+    glUniform1i( location, value );
+}
+
+void GLState::uniform_1f( GLint location, GLfloat value ) {
+    Uniform uniform;
+    uniform.type      = GL_FLOAT;
+    uniform.transpose = GL_FALSE;
+    uniform.i         = 0;
+    uniform.f[0]      = value;
+    if( uniform_cached( location, uniform, 1 ) ) {
+        return;
+    }
+    glUniform1f( location, value );
+}
+
+void GLState::uniform_4f( GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w ) {
+    Uniform uniform;
+    uniform.type      = GL_FLOAT_VEC4;
+    uniform.transpose = GL_FALSE;
+    uniform.i         = 0;
+    uniform.f[0]      = x;
+    uniform.f[1]      = y;
+    uniform.f[2]      = z;
+    uniform.f[3]      = w;
+    if( uniform_cached( location, uniform, 4 ) ) {
+        return;
+    }
+    glUniform4f( location, x, y, z, w );
+}
+
+void GLState::uniform_matrix4fv( GLint location, GLboolean transpose, const GLfloat* value ) {
+    Uniform uniform;
+    uniform.type      = GL_FLOAT_MAT4;
+    uniform.transpose = transpose;
+    uniform.i         = 0;
+    memcpy( uniform.f, value, sizeof( uniform.f ) );
+    if( uniform_cached( location, uniform, 16 ) ) {
+        return;
+    }
+    glUniformMatrix4fv( location, 1, transpose, value );
+}
+
+GLuint GLState::program() const {
+    return program_.known ? program_.value : 0;
+}
+
+int GLState::buffer_target_index( GLenum target ) {
+    switch( target ) {
+    case GL_ARRAY_BUFFER: return BUFFER_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT_ARRAY;
+    case GL_UNIFORM_BUFFER: return BUFFER_UNIFORM;
+    case GL_COPY_READ_BUFFER: return BUFFER_COPY_READ;
+    case GL_COPY_WRITE_BUFFER: return BUFFER_COPY_WRITE;
+    case GL_PIXEL_PACK_BUFFER: return BUFFER_PIXEL_PACK;
+    case GL_PIXEL_UNPACK_BUFFER: return BUFFER_PIXEL_UNPACK;
+    case GL_TRANSFORM_FEEDBACK_BUFFER: return BUFFER_TRANSFORM_FEEDBACK;
+    default: return -1;
+    }
+}
+
+int GLState::capability_index( GLenum capability ) {
+    switch( capability ) {
+    case GL_BLEND: return CAP_BLEND;
+    case GL_CULL_FACE: return CAP_CULL_FACE;
+    case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+    case GL_POLYGON_OFFSET_FILL: return CAP_POLYGON_OFFSET_FILL;
+    case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+    case GL_STENCIL_TEST: return CAP_STENCIL_TEST;
+    case GL_RASTERIZER_DISCARD: return CAP_RASTERIZER_DISCARD;
+    case GL_SAMPLE_ALPHA_TO_COVERAGE: return CAP_SAMPLE_ALPHA_TO_COVERAGE;
+    default: return -1;
+    }
+}
+
+void GLState::elide() {
+    ++stats_.elided;
+    ++stats_.frame_elided;
+}
+
+void GLState::issue() {
+    ++stats_.issued;
+    ++stats_.frame_issued;
+}
+
+void GLState::mismatch( const char* what ) {
+    ++stats_.mismatches;
+    STDERR( "GL state cache is out of sync for %s.", what );
+}
+
+void GLState::forget_vertex_array_state() {
+    buffers_[BUFFER_ELEMENT_ARRAY].known = false;
+    for( int i = 0; i < MAX_ATTRIBS; ++i ) {
+        attrib_enabled_[i].known  = false;
+        attrib_pointers_[i].known = false;
+        attrib_divisors_[i].known = false;
+    }
+}
+
+void GLState::set_capability( GLenum capability, bool enabled ) {
+    int index = capability_index( capability );
+    if( index >= 0 ) {
+        if( capabilities_[index].is( enabled ) ) {
+            if( !debug_ || ( ( glIsEnabled( capability ) == GL_TRUE ) == enabled ) ) {
+                elide();
+                return;
+            }
+            mismatch( "capability" );
+        }
+        capabilities_[index].set( enabled );
+    }
+    issue();
+    if( enabled ) {
+        glEnable( capability );
+    } else {
+        glDisable( capability );
+    }
+}
+
+void GLState::set_attrib_array( GLuint index, bool enabled ) {
+    if( index < MAX_ATTRIBS ) {
+        if( attrib_enabled_[index].is( enabled ) ) {
+            GLint bound = enabled;
+            if( debug_ ) {
+                glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &bound );
+            }
+            if( ( bound != 0 ) == enabled ) {
+                elide();
+                return;
+            }
+            mismatch( "vertex attribute array" );
+        }
+        attrib_enabled_[index].set( enabled );
+    }
+    issue();
+    if( enabled ) {
+        glEnableVertexAttribArray( index );
+    } else {
+        glDisableVertexAttribArray( index );
+    }
+}
+
+bool GLState::uniform_cached( GLint location, const Uniform& value, int floats ) {
+    if( ( location < 0 ) || !program_.known ) {
+        issue();
+        return false;
+    }
+
+    const uint64_t key = uniform_key( program_.value, location );
+    auto           it  = uniforms_.find( key );
+    if( ( it != uniforms_.end() ) &&
+        ( it->second.type == value.type ) &&
+        ( it->second.transpose == value.transpose ) &&
+        ( it->second.i == value.i ) &&
+        !memcmp( it->second.f, value.f, floats * sizeof( GLfloat ) ) ) {
+        if( !debug_ || uniform_matches_gl( location, value, floats ) ) {
+            elide();
+            return true;
+        }
+        mismatch( "uniform" );
+    }
+
+    uniforms_[key] = value;
+    issue();
+    return false;
+}
+
+bool GLState::uniform_matches_gl( GLint location, const Uniform& value, int floats ) {
+    if( floats == 0 ) {
+        GLint bound = 0;
+        glGetUniformiv( program_.value, location, &bound );
+        return bound == value.i;
+    }
+
+    GLfloat bound[4 * 4];
+    glGetUniformfv( program_.value, location, bound );
+    for( int i = 0; i < floats; ++i ) {
+        // GL stores matrices column-major, so a transposed upload reads back transposed.
+        int j = ( value.transpose && ( floats == 16 ) ) ? ( 4 * ( i % 4 ) + i / 4 ) : i;
+        if( bound[i] != value.f[j] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_gl_state_stats( const GLState& gl_state ) {
+    const GLStateStats& stats = gl_state.stats();
+    STDOUT( "GL state: %u issued and %u elided calls this frame, %lu issued and %lu elided in total.",
+            stats.frame_issued,
+            stats.frame_elided,
+            stats.issued,
+            stats.elided );
+    if( gl_state.debug() ) {
+        STDOUT( "GL state: %lu mismatches against glGet*.", stats.mismatches );
+    }
+}
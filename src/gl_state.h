@@ -0,0 +1,187 @@
+#ifndef WASMVR_GL_STATE_H
+#define WASMVR_GL_STATE_H
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <unordered_map>
+
+struct GLStateStats {
+    unsigned long issued;
+    unsigned long elided;
+    unsigned long mismatches; // Only counted in debug mode.
+
+    unsigned int frame_issued;
+    unsigned int frame_elided;
+
+    GLStateStats();
+};
+
+// Shadows the GL state the renderer touches and drops calls that would set state to its current value.
+// Under WebGL every GL call is a validated crossing into JS, so this is worth it even for cheap calls.
+// Anything changed with raw GL calls behind its back has to be followed by reset().
+class GLState {
+public:
+    GLState();
+
+    // Forgets everything, so the next call of every kind is issued.
+    void reset();
+    // Forgets the cached uniform values of a program, e.g. after it was relinked or deleted.
+    void forget_program( GLuint program );
+    // Forgets every binding of a buffer or vertex array about to be deleted. Deleting unbinds them, and the
+    // name may be handed out again for something else.
+    void forget_buffer( GLuint buffer );
+    void forget_vertex_array( GLuint array );
+
+    // In debug mode every elided call is cross-checked against glGet*, and reissued on a mismatch.
+    void set_debug( bool debug );
+    bool debug() const;
+
+    void                begin_frame();
+    const GLStateStats& stats() const;
+
+    void use_program( GLuint program );
+    void bind_buffer( GLenum target, GLuint buffer );
+    void bind_buffer_range( GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size );
+    void bind_vertex_array( GLuint array );
+
+    void enable_vertex_attrib_array( GLuint index );
+    void disable_vertex_attrib_array( GLuint index );
+    void vertex_attrib_pointer( GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer );
+    void vertex_attrib_divisor( GLuint index, GLuint divisor );
+
+    void viewport( GLint x, GLint y, GLsizei width, GLsizei height );
+    void scissor( GLint x, GLint y, GLsizei width, GLsizei height ); // Only applies with GL_SCISSOR_TEST enabled.
+    void enable( GLenum capability );
+    void disable( GLenum capability );
+    void blend_func( GLenum source, GLenum destination );
+    void depth_func( GLenum func );
+    void depth_mask( GLboolean flag );
+    void color_mask( GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha );
+
+    // Uniforms of the current program, by location.
+    void uniform_1i( GLint location, GLint value );
+    void uniform_1f( GLint location, GLfloat value );
+    void uniform_4f( GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w );
+    void uniform_matrix4fv( GLint location, GLboolean transpose, const GLfloat* value );
+
+    GLuint program() const;
+
+    static const int MAX_ATTRIBS         = 16;
+    static const int MAX_UNIFORM_INDICES = 16;
+
+private:
+    template <typename T>
+    struct Cached {
+        T    value;
+        bool known;
+
+        Cached()
+            : value()
+            , known( false ) {
+        }
+        bool is( const T& other ) const { return known && ( value == other ); }
+        void set( const T& other ) {
+            value = other;
+            known = true;
+        }
+    };
+
+    struct AttribPointer {
+        GLuint        buffer;
+        GLint         size;
+        GLenum        type;
+        GLboolean     normalized;
+        GLsizei       stride;
+        const GLvoid* pointer;
+
+        bool operator==( const AttribPointer& other ) const;
+    };
+
+    struct Viewport {
+        GLint   x;
+        GLint   y;
+        GLsizei width;
+        GLsizei height;
+
+        bool operator==( const Viewport& other ) const;
+    };
+
+    struct BufferRange {
+        GLuint     buffer;
+        GLintptr   offset;
+        GLsizeiptr size;
+
+        bool operator==( const BufferRange& other ) const;
+    };
+
+    struct Uniform {
+        GLenum    type;
+        GLboolean transpose;
+        GLint     i;
+        GLfloat   f[4 * 4];
+    };
+
+    enum BufferTarget {
+        BUFFER_ARRAY,
+        BUFFER_ELEMENT_ARRAY,
+        BUFFER_UNIFORM,
+        BUFFER_COPY_READ,
+        BUFFER_COPY_WRITE,
+        BUFFER_PIXEL_PACK,
+        BUFFER_PIXEL_UNPACK,
+        BUFFER_TRANSFORM_FEEDBACK,
+        BUFFER_TARGETS
+    };
+
+    enum Capability {
+        CAP_BLEND,
+        CAP_CULL_FACE,
+        CAP_DEPTH_TEST,
+        CAP_POLYGON_OFFSET_FILL,
+        CAP_SCISSOR_TEST,
+        CAP_STENCIL_TEST,
+        CAP_RASTERIZER_DISCARD,
+        CAP_SAMPLE_ALPHA_TO_COVERAGE,
+        CAPABILITIES
+    };
+
+    static int buffer_target_index( GLenum target );
+    static int capability_index( GLenum capability );
+
+    void elide();
+    void issue();
+    void mismatch( const char* what );
+
+    void forget_vertex_array_state();
+    void set_capability( GLenum capability, bool enabled );
+    void set_attrib_array( GLuint index, bool enabled );
+
+    // Returns true if the uniform already holds value, and records it as the current value otherwise.
+    bool uniform_cached( GLint location, const Uniform& value, int floats );
+    bool uniform_matches_gl( GLint location, const Uniform& value, int floats );
+
+    bool         debug_;
+    GLStateStats stats_;
+
+    Cached<GLuint>        program_;
+    Cached<GLuint>        buffers_[BUFFER_TARGETS];
+    Cached<BufferRange>   uniform_ranges_[MAX_UNIFORM_INDICES];
+    Cached<GLuint>        vertex_array_;
+    Cached<bool>          attrib_enabled_[MAX_ATTRIBS];
+    Cached<AttribPointer> attrib_pointers_[MAX_ATTRIBS];
+    Cached<GLuint>        attrib_divisors_[MAX_ATTRIBS];
+    Cached<Viewport>      viewport_;
+    Cached<Viewport>      scissor_; // Same shape as a viewport.
+    Cached<bool>          capabilities_[CAPABILITIES];
+    Cached<GLenum>        blend_source_;
+    Cached<GLenum>        blend_destination_;
+    Cached<GLenum>        depth_func_;
+    Cached<GLboolean>     depth_mask_;
+    Cached<GLuint>        color_mask_; // One bit per channel.
+
+    std::unordered_map<uint64_t, Uniform> uniforms_;
+};
+
+void print_gl_state_stats( const GLState& gl_state );
+
+#endif // WASMVR_GL_STATE_H
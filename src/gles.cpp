@@ -1,5 +1,12 @@
 #include "gles.h"
 
+#include <emscripten.h>
+
+#include "camera.h"
+#include "framebuffer_pool.h"
+#include "gl_command_buffer.h"
+#include "residency.h"
+#include "trace.h"
 #include "user_context.h"
 #include "util.h"
 
@@ -46,33 +53,41 @@ GLuint gles_load_shader( GLenum type, const char* shader_source, const char* nam
     return shader;
 }
 
-bool gles_load_shaders( UserContext& user_context ) {
+GLuint gles_load_program( const char* vert_path, const char* frag_path, const char* defines ) {
     std::string vert_glsl;
-    if( !get_file_contents( "src_asset/stl.vert", vert_glsl ) ) {
-        STDERR( "Failed to get vertex shader." );
-        return false;
+    if( !get_file_contents( vert_path, vert_glsl ) ) {
+        STDERR( "Failed to get vertex shader %s.", vert_path );
+        return 0;
     }
-    STDOUT( "Got vertex shader." );
+    STDOUT( "Got vertex shader %s.", vert_path );
 
     std::string frag_glsl;
-    if( !get_file_contents( "src_asset/stl.frag", frag_glsl ) ) {
-        STDERR( "Failed to get fragment shader." );
-        return false;
+    if( !get_file_contents( frag_path, frag_glsl ) ) {
+        STDERR( "Failed to get fragment shader %s.", frag_path );
+        return 0;
+    }
+    STDOUT( "Got fragment shader %s.", frag_path );
+
+    if( defines ) {
+        for( std::string* glsl : {&vert_glsl, &frag_glsl} ) {
+            const size_t line_end = glsl->find( '\n' );
+            glsl->insert( ( line_end == std::string::npos ) ? glsl->size() : line_end + 1, defines );
+        }
     }
-    STDOUT( "Got fragment shader." );
 
     // Load the vertex/fragment shaders
-    GLuint vertex_shader = gles_load_shader( GL_VERTEX_SHADER, vert_glsl.c_str(), "vertex" );
+    GLuint vertex_shader = gles_load_shader( GL_VERTEX_SHADER, vert_glsl.c_str(), vert_path );
     if( !vertex_shader ) {
         STDERR( "Failed to compile vertex shader." );
-        return false;
+        return 0;
     }
     STDOUT( "Compiled vertex shader." );
 
-    GLuint fragment_shader = gles_load_shader( GL_FRAGMENT_SHADER, frag_glsl.c_str(), "fragment" );
+    GLuint fragment_shader = gles_load_shader( GL_FRAGMENT_SHADER, frag_glsl.c_str(), frag_path );
     if( !fragment_shader ) {
         STDERR( "Failed to compile fragment shader." );
-        return false;
+        glDeleteShader( vertex_shader );
+        return 0;
     }
     STDOUT( "Compiled fragment shader." );
 
@@ -80,7 +95,7 @@ bool gles_load_shaders( UserContext& user_context ) {
     GLuint program = glCreateProgram();
     if( !program ) {
         STDERR( "Failed to create program." );
-        return false;
+        return 0;
     }
 
     glAttachShader( program, vertex_shader );
@@ -89,24 +104,123 @@ bool gles_load_shaders( UserContext& user_context ) {
     // Link the program
     glLinkProgram( program );
 
+    // The program keeps the shaders alive for as long as they are attached.
+    glDeleteShader( vertex_shader );
+    glDeleteShader( fragment_shader );
+
     // Check the link status
     GLint linked;
     glGetProgramiv( program, GL_LINK_STATUS, &linked );
     if( !linked ) {
         STDERR( "Failed to link." );
+        glDeleteProgram( program );
+        return 0;
+    }
+
+    return program;
+}
+
+bool gles_load_shaders( UserContext& user_context ) {
+    GLuint program = gles_load_program( "src_asset/stl.vert", "src_asset/stl.frag" );
+    if( !program ) {
+        STDERR( "Failed to load scene program." );
         return false;
     }
 
     user_context.program         = program;
     user_context.vec4_position   = glGetAttribLocation( user_context.program, "vec4_position" );
+    user_context.vec4_normal     = glGetAttribLocation( user_context.program, "vec4_normal" );
+    user_context.vec2_uv         = glGetAttribLocation( user_context.program, "vec2_uv" );
     user_context.mat4_model      = glGetUniformLocation( user_context.program, "mat4_model" );
-    user_context.mat4_view       = glGetUniformLocation( user_context.program, "mat4_view" );
-    user_context.mat4_projection = glGetUniformLocation( user_context.program, "mat4_projection" );
+    user_context.bool_octahedral = glGetUniformLocation( user_context.program, "bool_octahedral" );
+    const char* instance_rows[3] = {"vec4_instance_row0", "vec4_instance_row1", "vec4_instance_row2"};
+    for( int i = 0; i < 3; ++i ) {
+        user_context.vec4_instance_rows[i] = glGetAttribLocation( user_context.program, instance_rows[i] );
+    }
+    user_context.vec4_instance_color = glGetAttribLocation( user_context.program, "vec4_instance_color" );
+    user_context.bool_instanced      = glGetUniformLocation( user_context.program, "bool_instanced" );
     STDOUT( "program         = %d", user_context.program );
     STDOUT( "vec4_position   = %d", user_context.vec4_position );
+    STDOUT( "vec4_normal     = %d", user_context.vec4_normal );
+    STDOUT( "vec2_uv         = %d", user_context.vec2_uv );
     STDOUT( "mat4_model      = %d", user_context.mat4_model );
-    STDOUT( "mat4_view       = %d", user_context.mat4_view );
-    STDOUT( "mat4_projection = %d", user_context.mat4_projection );
+    STDOUT( "bool_octahedral = %d", user_context.bool_octahedral );
+    STDOUT( "instance rows   = %d, %d, %d", user_context.vec4_instance_rows[0], user_context.vec4_instance_rows[1], user_context.vec4_instance_rows[2] );
+    STDOUT( "instance color  = %d", user_context.vec4_instance_color );
+    STDOUT( "bool_instanced  = %d", user_context.bool_instanced );
+
+    user_context.depth_program = gles_load_program( "src_asset/stl.vert", "src_asset/depth.frag" );
+    if( !user_context.depth_program ) {
+        STDERR( "Failed to load depth program." );
+        return false;
+    }
+    user_context.depth_bool_instanced = glGetUniformLocation( user_context.depth_program, "bool_instanced" );
+    STDOUT( "depth_program   = %d", user_context.depth_program );
+
+    // The skinned variants share the attribute locations the shader fixes, and add the bone attributes.
+    const char* SKINNED = "#define SKINNED\n";
+    user_context.skinned_program       = gles_load_program( "src_asset/stl.vert", "src_asset/stl.frag", SKINNED );
+    user_context.depth_skinned_program = gles_load_program( "src_asset/stl.vert", "src_asset/depth.frag", SKINNED );
+    if( !user_context.skinned_program || !user_context.depth_skinned_program ) {
+        STDERR( "Failed to load skinned programs." );
+        return false;
+    }
+    user_context.vec4_bone_indices            = glGetAttribLocation( user_context.skinned_program, "vec4_bone_indices" );
+    user_context.vec4_bone_weights            = glGetAttribLocation( user_context.skinned_program, "vec4_bone_weights" );
+    user_context.float_instance_palette       = glGetAttribLocation( user_context.skinned_program, "float_instance_palette" );
+    user_context.skinned_bool_instanced       = glGetUniformLocation( user_context.skinned_program, "bool_instanced" );
+    user_context.skinned_bool_octahedral      = glGetUniformLocation( user_context.skinned_program, "bool_octahedral" );
+    user_context.depth_skinned_bool_instanced = glGetUniformLocation( user_context.depth_skinned_program, "bool_instanced" );
+    STDOUT( "skinned_program = %d", user_context.skinned_program );
+    STDOUT( "bone attributes = %d, %d, palette %d", user_context.vec4_bone_indices, user_context.vec4_bone_weights, user_context.float_instance_palette );
+
+    // Created once: the vertices drawn without VR are streamed into the same buffer every frame.
+    glGenBuffers( 1, &user_context.vertex_buffer );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    STDOUT( "vertex_buffer   = %u", user_context.vertex_buffer );
+
+    // Sized for the default scene, it grows if a frame needs more.
+    if( !user_context.instance_ring.create( user_context, 1024 ) ) {
+        STDERR( "Failed to create instance buffer." );
+        return false;
+    }
+
+    if( !camera_buffer_create( user_context ) ) {
+        STDERR( "Failed to create camera buffer." );
+        return false;
+    }
+    for( GLuint program : {user_context.depth_program, user_context.skinned_program, user_context.depth_skinned_program} ) {
+        if( camera_block_bind( program ) == GL_INVALID_INDEX ) {
+            return false;
+        }
+    }
+
+    if( !user_context.light_clusters.create( user_context ) ) {
+        STDERR( "Failed to create light clusters." );
+        return false;
+    }
+    if( !user_context.skinning.create( user_context ) ) {
+        STDERR( "Failed to create bone palettes." );
+        return false;
+    }
+    if( !user_context.textures.create( user_context ) ) {
+        STDERR( "Failed to create textures." );
+        return false;
+    }
+    if( !user_context.particles.create( user_context ) ) {
+        STDERR( "Failed to create particles." );
+        return false;
+    }
+    if( !user_context.point_cloud.create( user_context ) ) {
+        STDERR( "Failed to create the point cloud." );
+        return false;
+    }
+
+    // Optional, without it there are just no GPU times.
+    user_context.gpu_timer.create();
+    if( !user_context.hud.create( user_context ) ) {
+        STDERR( "Continuing without the HUD." );
+    }
 
     return true;
 }
@@ -115,6 +229,81 @@ void gles_update( UserContext& user_context ) {
     user_context.width  = get_canvas_client_width();
     user_context.height = get_canvas_client_height();
     set_canvas_size( user_context.width, user_context.height );
+
+    user_context.simulation.advance( emscripten_get_now() );
+
+    // Textures are prepared a slice per frame, ahead of the frame's draw.
+    const double TEXTURE_PREPARE_MS = 4.0;
+    user_context.textures.update( user_context, TEXTURE_PREPARE_MS );
+
+    // The HUD's numbers change every frame, which on demand redraw can't see.
+    if( user_context.hud.enabled() ) {
+        user_context.redraw.request();
+    }
+}
+
+RenderTarget* gles_begin_offscreen( UserContext& user_context ) {
+    RenderTarget* target = user_context.framebuffer_pool.acquire( RenderTargetDesc(
+        user_context.width,
+        user_context.height,
+        GL_RGBA8,
+        GL_DEPTH_COMPONENT24,
+        user_context.msaa_samples ) );
+    glBindFramebuffer( GL_FRAMEBUFFER, target ? target->framebuffer : 0 );
+
+    // Set the viewport.
+    user_context.gl_state.viewport( 0, 0, user_context.width, user_context.height );
+
+    // Recordings clear what they draw into themselves, see gles_record_clear().
+    return target;
+}
+
+GLuint gles_create_data_texture( GLint unit, GLenum format, GLsizei width, GLsizei height ) {
+    GLuint texture = 0;
+    glGenTextures( 1, &texture );
+    glActiveTexture( GL_TEXTURE0 + unit );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glTexStorage2D( GL_TEXTURE_2D, 1, format, width, height );
+    gpu_memory_allocated( GPU_MEMORY_TEXTURE, texture, static_cast<size_t>( width ) * height * gpu_memory_texel_bytes( format ) );
+    // Integer and 32-bit float textures can't be filtered, and are only read with texelFetch.
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glActiveTexture( GL_TEXTURE0 );
+    return texture;
+}
+
+void gles_upload_data_rows( GLint unit, GLsizei width, size_t count, GLenum format, GLenum type, const void* data, size_t element_size ) {
+    const GLsizei full = static_cast<GLsizei>( count / width );
+    const GLsizei rest = static_cast<GLsizei>( count % width );
+    glActiveTexture( GL_TEXTURE0 + unit );
+    if( full ) {
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, full, format, type, data );
+    }
+    if( rest ) {
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, full, rest, 1, format, type, static_cast<const uint8_t*>( data ) + full * width * element_size );
+    }
+    glActiveTexture( GL_TEXTURE0 );
+}
+
+void gles_record_clear( GLCommandBuffer& commands ) {
+    // The clear is subject to the masks, so they are opened up first.
+    commands.color_mask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+    commands.depth_mask( GL_TRUE );
+    commands.clear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    commands.enable( GL_DEPTH_TEST );
+    commands.depth_func( GL_LESS );
+}
+
+void gles_end_offscreen( UserContext& user_context, RenderTarget* target ) {
+    if( !target ) {
+        return;
+    }
+
+    render_target_resolve( *target, 0 );
+
+    // Nothing reads the multisampled attachments after the resolve.
+    render_target_invalidate( *target, true, true );
+    user_context.framebuffer_pool.release( target );
 }
 
 void gles_draw( UserContext& user_context ) {
@@ -124,58 +313,67 @@ void gles_draw( UserContext& user_context ) {
                                               -0.5f, -0.5f, 0.0f,
                                               0.5f, -0.5f, 0.0f};
 
-    // Get a list of buffers to bind shader attributes to.
-    const GLsizei vertex_shader_buffer_count = 2;
-    GLuint        vertex_shader_buffers[vertex_shader_buffer_count];
-    glGenBuffers( vertex_shader_buffer_count, vertex_shader_buffers );
-    const GLuint vbuf_position = vertex_shader_buffers[0];
-    const GLuint vbuf_model    = vertex_shader_buffers[1];
-
-    // Load vertices into vertex shader buffer for vertices.
-    glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-    glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_STATIC_DRAW );
-
-    // Set the viewport.
-    glViewport( 0, 0, user_context.width, user_context.height );
+    const GLuint vbuf_position = user_context.vertex_buffer;
 
-    // Clear the color output buffer.
-    glClear( GL_COLOR_BUFFER_BIT );
+    // Record the scene, then replay it with the camera in place.
+    GLCommandBuffer& commands = user_context.scene_commands;
+    commands.reset();
+    gles_record_clear( commands );
 
     // Use this shader program.
-    glUseProgram( user_context.program );
+    commands.use_program( user_context.program );
+    commands.bind_camera();
+    // The attribute setup below goes into the default vertex array, not the last mesh's.
+    commands.bind_vertex_array( 0 );
+    commands.uniform_1i( user_context.bool_instanced, 0 );
+
+    // Load vertices into vertex shader buffer for vertices.
+    commands.bind_buffer( GL_ARRAY_BUFFER, vbuf_position );
+    commands.buffer_data( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_STATIC_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, vbuf_position, sizeof( vertices ) );
 
     // Point the shader attribute for position at the shader buffer for position.
-    glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-    glVertexAttribPointer(
+    commands.vertex_attrib_pointer(
         user_context.vec4_position, // GLuint index
         DIMENSION,                  // GLint size (in number of vertex dimensions)
         GL_FLOAT,                   // GLenum type
         0,                          // GLboolean normalized (i.e. is-fixed-point)
         0,                          // GLsizei stride (i.e. byte offset between consecutive elements)
-        0 );                        // const GLvoid * pointer (because GL_ARRAY_BUFFER is bound this is an offset into that bound buffer)
-    glEnableVertexAttribArray( user_context.vec4_position );
-
-    glUniformMatrix4fv(
-        user_context.mat4_model, // GLint location
-        1,                       // GLsizei count
-        GL_FALSE,                // GLboolean transpose
-        identity4 );             // const GLfloat* value
-
-    glUniformMatrix4fv(
-        user_context.mat4_view, // GLint location
-        1,                      // GLsizei count
-        GL_FALSE,               // GLboolean transpose
-        identity4 );            // const GLfloat* value
-
-    glUniformMatrix4fv(
-        user_context.mat4_projection, // GLint location
-        1,                            // GLsizei count
-        GL_FALSE,                     // GLboolean transpose
-        identity4 );                  // const GLfloat* value
+        0 );                        // GLintptr offset (into the buffer bound to GL_ARRAY_BUFFER)
+    commands.enable_vertex_attrib_array( user_context.vec4_position );
+
+    commands.uniform_matrix4fv( user_context.mat4_model, GL_FALSE, identity4 );
 
     // Draw.
-    glDrawArrays(
+    commands.draw_arrays(
         GL_TRIANGLES, // GLenum mode
         0,            // GLint first
         VERTICES );   // GLsizei count (in number of vertices in this case)
+
+    // The identity camera draws in clip space, where the HUD goes in a corner.
+    if( user_context.hud.enabled() ) {
+        GLfloat model[4 * 4];
+        user_context.hud.upload( user_context );
+        user_context.hud.screen_matrix( user_context.width, user_context.height, model );
+        user_context.hud.record( commands, model );
+    }
+
+    if( user_context.dump_scene_commands ) {
+        user_context.dump_scene_commands = false;
+        print_gl_command_buffer( commands );
+    }
+
+    CameraMatrices camera;
+    camera_identity( camera );
+    camera_buffer_upload( user_context, &camera, 1 );
+
+    user_context.textures.bind( user_context );
+    user_context.gpu_timer.poll( user_context.scene_gpu_ms );
+    RenderTarget* target = gles_begin_offscreen( user_context );
+    user_context.gpu_timer.begin( 0 );
+    trace_begin( "gl_submit" );
+    gl_command_buffer_replay( user_context, commands, 0 );
+    trace_end( "gl_submit" );
+    user_context.gpu_timer.end();
+    gles_end_offscreen( user_context, target );
 }
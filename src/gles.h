@@ -2,12 +2,30 @@
 #define WASMVR_GLES_H
 
 #include <GLES3/gl3.h>
+#include <stddef.h>
 
+class GLCommandBuffer;
 class UserContext;
+struct RenderTarget;
 
 GLuint gles_load_shader( GLenum type, const char* shader_source, const char* name );
+// Defines, if any, go right after the shaders' #version line.
+GLuint gles_load_program( const char* vert_path, const char* frag_path, const char* defines = nullptr );
 bool gles_load_shaders( UserContext& user_context );
 void gles_update( UserContext& user_context );
 void gles_draw( UserContext& user_context );
 
+// Binds a pooled (multisampled) render target of the canvas size, without clearing it.
+// Returns nullptr, leaving the default framebuffer bound, if no target could be made.
+RenderTarget* gles_begin_offscreen( UserContext& user_context );
+// A texture of raw data for a shader to texelFetch from, left bound to the texture unit (an index, not GL_TEXTUREi).
+GLuint gles_create_data_texture( GLint unit, GLenum format, GLsizei width, GLsizei height );
+// Uploads count elements into the texture bound to unit as rows of width, the last one possibly partial.
+void gles_upload_data_rows( GLint unit, GLsizei width, size_t count, GLenum format, GLenum type, const void* data, size_t element_size );
+// Records clearing colour and depth and turning on the depth test, to start a scene recording with.
+// Replayed per eye with the scissor test on, it only clears that eye's viewport.
+void gles_record_clear( GLCommandBuffer& commands );
+// Resolves the target into the default framebuffer and returns it to the pool.
+void gles_end_offscreen( UserContext& user_context, RenderTarget* target );
+
 #endif // WASMVR_GLES_H
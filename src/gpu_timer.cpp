@@ -0,0 +1,96 @@
+#include "gpu_timer.h"
+
+#include <GLES2/gl2ext.h>
+#include <emscripten/html5.h>
+
+#include "frame.h"
+#include "util.h"
+
+namespace {
+    // From EXT_disjoint_timer_query, which WebGL2 exposes on its regular query objects.
+    const GLenum TIME_ELAPSED = GL_TIME_ELAPSED_EXT;
+    const GLenum GPU_DISJOINT = GL_GPU_DISJOINT_EXT;
+}
+
+GpuTimer::GpuTimer()
+    : first_( 0 )
+    , pending_( 0 )
+    , running_( false )
+    , available_( false ) {
+    for( int i = 0; i < QUERIES; ++i ) {
+        queries_[i] = 0;
+        tags_[i]    = 0;
+    }
+}
+
+bool GpuTimer::create() {
+    if( !emscripten_webgl_enable_extension( emscripten_webgl_get_current_context(), "EXT_disjoint_timer_query_webgl2" ) ) {
+        STDOUT( "No EXT_disjoint_timer_query_webgl2, GPU times won't be measured." );
+        available_ = false;
+        return false;
+    }
+    glGenQueries( QUERIES, queries_ );
+    first_     = 0;
+    pending_   = 0;
+    running_   = false;
+    available_ = true;
+    // Clears the disjoint flag, so only events from here on count.
+    GLint disjoint = 0;
+    glGetIntegerv( GPU_DISJOINT, &disjoint );
+    return true;
+}
+
+void GpuTimer::release() {
+    if( available_ ) {
+        glDeleteQueries( QUERIES, queries_ );
+    }
+    available_ = false;
+    pending_   = 0;
+    running_   = false;
+}
+
+bool GpuTimer::available() const {
+    return available_;
+}
+
+void GpuTimer::begin( int tag ) {
+    if( !available_ || running_ || ( pending_ == QUERIES ) ) {
+        return;
+    }
+    const int query = ( first_ + pending_ ) % QUERIES;
+    tags_[query]    = tag;
+    glBeginQuery( TIME_ELAPSED, queries_[query] );
+    running_ = true;
+}
+
+void GpuTimer::end() {
+    if( !running_ ) {
+        return;
+    }
+    glEndQuery( TIME_ELAPSED );
+    running_ = false;
+    ++pending_;
+}
+
+void GpuTimer::poll( SampleStats* stats ) {
+    if( !available_ ) {
+        return;
+    }
+    GLint disjoint = 0;
+    glGetIntegerv( GPU_DISJOINT, &disjoint );
+    // Queries finish in order, so the first one not done yet ends the poll.
+    while( pending_ > 0 ) {
+        GLuint done = GL_FALSE;
+        glGetQueryObjectuiv( queries_[first_], GL_QUERY_RESULT_AVAILABLE, &done );
+        if( !done && !disjoint ) {
+            break;
+        }
+        if( !disjoint ) {
+            GLuint nanoseconds = 0;
+            glGetQueryObjectuiv( queries_[first_], GL_QUERY_RESULT, &nanoseconds );
+            stats[tags_[first_]].add( nanoseconds / 1000000.0 );
+        }
+        first_ = ( first_ + 1 ) % QUERIES;
+        --pending_;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef WASMVR_GPU_TIMER_H
+#define WASMVR_GPU_TIMER_H
+
+#include <GLES3/gl3.h>
+
+struct SampleStats;
+
+// Times GPU work with EXT_disjoint_timer_query_webgl2. Results arrive a few frames late, so each
+// query is tagged when it begins and its time goes to that tag's stats once the GPU is done with it.
+// Does nothing where the extension isn't available.
+class GpuTimer {
+public:
+    GpuTimer();
+
+    bool create();
+    void release();
+    bool available() const;
+
+    // Only one query can be running at a time. Skipped if all queries are still waiting for results.
+    void begin( int tag );
+    void end();
+    // Adds the milliseconds of every finished query to stats[tag], without waiting for the GPU.
+    // Queries spanning a disjoint event, e.g. a clock change, are dropped.
+    void poll( SampleStats* stats );
+
+    static const int QUERIES = 8;
+
+private:
+    GLuint queries_[QUERIES];
+    int    tags_[QUERIES];
+    int    first_; // Oldest query waiting for its result.
+    int    pending_;
+    bool   running_;
+    bool   available_;
+};
+
+#endif // WASMVR_GPU_TIMER_H
@@ -0,0 +1,459 @@
+#include "hud.h"
+
+#include <emscripten.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "camera.h"
+#include "gl_command_buffer.h"
+#include "gles.h"
+#include "residency.h"
+#include "simd.h"
+#include "user_context.h"
+#include "util.h"
+
+// clang-format off
+EM_JS( int, rasterize_glyphs, ( int first, int count, int size, uint8_t* coverage ), { return impl_rasterize_glyphs( first, count, size, coverage ); } );
+// clang-format on
+
+namespace {
+    // Printable ASCII, then one solid cell the panel and the graph are drawn with.
+    const int FIRST_CHARACTER = 32;
+    const int CHARACTERS      = 95;
+    const int SOLID           = CHARACTERS;
+
+    // Glyphs are rasterized at twice the atlas' resolution, so the distances averaged down land between pixels.
+    const int   RASTER        = 64;
+    const int   CELL          = 32;
+    const int   ATLAS_COLUMNS = 16;
+    const int   ATLAS_WIDTH   = ATLAS_COLUMNS * CELL;
+    const int   ATLAS_HEIGHT  = ( ( CHARACTERS + 1 + ATLAS_COLUMNS - 1 ) / ATLAS_COLUMNS ) * CELL;
+    const float SPREAD        = 4.0f; // Atlas texels from the edge to where the distance saturates.
+    const float FAR           = 1e20f;
+
+    const size_t MAX_QUADS = 1024;
+
+    // Layout, in glyph cells.
+    const float LINE         = 0.85f;
+    const float MARGIN       = 0.5f;
+    const int   TEXT_COLUMNS = 48;
+    const int   GRAPH_LINES  = 4;
+    const int   LINES        = 1 + GRAPH_LINES + 6;
+
+    const GLfloat CELL_METRES   = 0.01f;
+    const GLfloat HEAD_DISTANCE = 0.7f;
+    const GLfloat HEAD_DROP     = 0.05f;
+    const GLfloat CELL_PIXELS   = 20.0f;
+
+    const GLubyte PANEL[4]       = {0, 0, 0, 170};
+    const GLubyte TEXT[4]        = {235, 235, 235, 255};
+    const GLubyte GOOD[4]        = {90, 200, 90, 255};
+    const GLubyte LATE[4]        = {230, 80, 60, 255};
+    const GLubyte REPROJECTED[4] = {80, 140, 240, 255};
+    const GLubyte DEADLINE[4]    = {255, 255, 255, 140};
+
+    const double MB = 1024.0 * 1024.0;
+
+    // Squared distance from each of n samples, stride apart, to the nearest sample whose value is 0, in place.
+    // The lower envelope of the parabolas rooted at every sample, after Felzenszwalb and Huttenlocher, so run
+    // along rows then columns it gives the exact Euclidean distance.
+    void distance_transform( float* f, int n, int stride, float* d, int* v, float* z ) {
+        int k = 0;
+        v[0]  = 0;
+        z[0]  = -FAR;
+        z[1]  = FAR;
+        for( int q = 1; q < n; ++q ) {
+            const float fq = f[q * stride] + static_cast<float>( q * q );
+            float       s;
+            for( ;; ) {
+                const int p = v[k];
+                s           = ( fq - ( f[p * stride] + static_cast<float>( p * p ) ) ) / static_cast<float>( 2 * ( q - p ) );
+                if( s > z[k] ) {
+                    break;
+                }
+                --k;
+            }
+            ++k;
+            v[k]     = q;
+            z[k]     = s;
+            z[k + 1] = FAR;
+        }
+        k = 0;
+        for( int q = 0; q < n; ++q ) {
+            while( z[k + 1] < q ) {
+                ++k;
+            }
+            const int p = v[k];
+            d[q]        = static_cast<float>( ( q - p ) * ( q - p ) ) + f[p * stride];
+        }
+        for( int q = 0; q < n; ++q ) {
+            f[q * stride] = d[q];
+        }
+    }
+
+    void distance_transform_2d( float* f, float* d, int* v, float* z ) {
+        for( int y = 0; y < RASTER; ++y ) {
+            distance_transform( f + y * RASTER, RASTER, 1, d, v, z );
+        }
+        for( int x = 0; x < RASTER; ++x ) {
+            distance_transform( f + x, RASTER, RASTER, d, v, z );
+        }
+    }
+
+    GLushort atlas_u( float texels ) {
+        return static_cast<GLushort>( texels * 65535.0f / ATLAS_WIDTH + 0.5f );
+    }
+
+    GLushort atlas_v( float texels ) {
+        return static_cast<GLushort>( texels * 65535.0f / ATLAS_HEIGHT + 0.5f );
+    }
+}
+
+HudStats::HudStats()
+    : frames( 0 )
+    , quads( 0 )
+    , build_ms( 0.0 )
+    , atlas_ms( 0.0 ) {
+}
+
+Hud::Hud()
+    : enabled_( false )
+    , advance_( 0.5f )
+    , width_( 0.0f )
+    , height_( 0.0f )
+    , next_( 0 )
+    , samples_( 0 )
+    , frame_( 0 )
+    , quads_( 0 )
+    , program_( 0 )
+    , mat4_model_( -1 )
+    , texture_( 0 )
+    , vertex_buffer_( 0 )
+    , index_buffer_( 0 )
+    , vertex_array_( 0 ) {
+}
+
+bool Hud::create( UserContext& user_context ) {
+    if( atlas_.empty() && !build_atlas() ) {
+        STDERR( "Failed to rasterize the HUD's glyphs." );
+        return false;
+    }
+
+    program_ = gles_load_program( "src_asset/hud.vert", "src_asset/hud.frag" );
+    if( !program_ || ( camera_block_bind( program_ ) == GL_INVALID_INDEX ) ) {
+        STDERR( "Failed to load HUD program." );
+        return false;
+    }
+    mat4_model_ = glGetUniformLocation( program_, "mat4_model" );
+    GLState& gl = user_context.gl_state;
+    gl.use_program( program_ );
+    gl.uniform_1i( glGetUniformLocation( program_, "sampler2D_atlas" ), ATLAS_UNIT );
+
+    // Nothing else uses the unit, so the atlas is bound once.
+    glGenTextures( 1, &texture_ );
+    glActiveTexture( GL_TEXTURE0 + ATLAS_UNIT );
+    glBindTexture( GL_TEXTURE_2D, texture_ );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, ATLAS_WIDTH, ATLAS_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, atlas_.data() );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glActiveTexture( GL_TEXTURE0 );
+    gpu_memory_allocated( GPU_MEMORY_TEXTURE, texture_, atlas_.size() );
+
+    // Every quad is two triangles of its four vertices, so the indices never change.
+    std::vector<GLushort> indices( 6 * MAX_QUADS );
+    for( size_t i = 0; i < MAX_QUADS; ++i ) {
+        const GLushort first   = static_cast<GLushort>( 4 * i );
+        const GLushort quad[6] = {first, static_cast<GLushort>( first + 1 ), static_cast<GLushort>( first + 2 ),
+                                  static_cast<GLushort>( first + 2 ), static_cast<GLushort>( first + 1 ), static_cast<GLushort>( first + 3 )};
+        memcpy( &indices[6 * i], quad, sizeof( quad ) );
+    }
+    const size_t vertex_bytes = 4 * MAX_QUADS * sizeof( Vertex );
+    const size_t index_bytes  = indices.size() * sizeof( GLushort );
+
+    glGenBuffers( 1, &vertex_buffer_ );
+    glGenBuffers( 1, &index_buffer_ );
+    glGenVertexArrays( 1, &vertex_array_ );
+    user_context.frame_budget.count_buffer_allocations( 2 );
+    gl.bind_vertex_array( vertex_array_ );
+    gl.bind_buffer( GL_ARRAY_BUFFER, vertex_buffer_ );
+    glBufferData( GL_ARRAY_BUFFER, vertex_bytes, nullptr, GL_STREAM_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, vertex_buffer_, vertex_bytes );
+    gl.vertex_attrib_pointer( 0, 2, GL_FLOAT, GL_FALSE, sizeof( Vertex ), reinterpret_cast<const GLvoid*>( offsetof( Vertex, position ) ) );
+    gl.enable_vertex_attrib_array( 0 );
+    gl.vertex_attrib_pointer( 1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof( Vertex ), reinterpret_cast<const GLvoid*>( offsetof( Vertex, uv ) ) );
+    gl.enable_vertex_attrib_array( 1 );
+    gl.vertex_attrib_pointer( 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( Vertex ), reinterpret_cast<const GLvoid*>( offsetof( Vertex, color ) ) );
+    gl.enable_vertex_attrib_array( 2 );
+    gl.bind_buffer( GL_ELEMENT_ARRAY_BUFFER, index_buffer_ );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, index_bytes, indices.data(), GL_STATIC_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, index_buffer_, index_bytes );
+    gl.bind_vertex_array( 0 );
+    user_context.frame_budget.count_bytes_uploaded( atlas_.size() + index_bytes );
+    return true;
+}
+
+void Hud::release( GLState& gl ) {
+    gpu_memory_freed( GPU_MEMORY_TEXTURE, texture_ );
+    gpu_memory_freed( GPU_MEMORY_BUFFER, vertex_buffer_ );
+    gpu_memory_freed( GPU_MEMORY_BUFFER, index_buffer_ );
+    gl.forget_buffer( vertex_buffer_ );
+    gl.forget_buffer( index_buffer_ );
+    gl.forget_vertex_array( vertex_array_ );
+    gl.forget_program( program_ );
+    glDeleteTextures( 1, &texture_ );
+    const GLuint buffers[2] = {vertex_buffer_, index_buffer_};
+    glDeleteBuffers( 2, buffers );
+    glDeleteVertexArrays( 1, &vertex_array_ );
+    glDeleteProgram( program_ );
+    texture_       = 0;
+    vertex_buffer_ = 0;
+    index_buffer_  = 0;
+    vertex_array_  = 0;
+    program_       = 0;
+    quads_         = 0;
+}
+
+void Hud::set_enabled( bool enabled ) {
+    enabled_ = enabled;
+}
+
+bool Hud::enabled() const {
+    return enabled_;
+}
+
+void Hud::end_frame( const UserContext& user_context ) {
+    Sample& sample     = history_[next_];
+    sample.cpu_ms      = static_cast<float>( emscripten_get_now() - user_context.frame_timer.begin_ms() );
+    sample.reprojected = user_context.reprojection.active;
+    next_              = ( next_ + 1 ) % HISTORY;
+    samples_           = ( samples_ < HISTORY ) ? samples_ + 1 : HISTORY;
+    work_              = user_context.frame_budget.frame();
+    frame_             = user_context.frame_count;
+}
+
+void Hud::upload( UserContext& user_context ) {
+    if( !vertex_array_ ) {
+        return;
+    }
+    const double begin_ms = emscripten_get_now();
+
+    const float         refresh_ms = static_cast<float>( user_context.frame_timer.refresh_ms() );
+    const Sample*       last       = samples_ ? &history_[( next_ + HISTORY - 1 ) % HISTORY] : nullptr;
+    const FrameBudget&  budget     = user_context.frame_budget;
+    const GpuResidency& residency  = user_context.residency;
+
+    vertices_.clear();
+    width_  = 2.0f * MARGIN + TEXT_COLUMNS * advance_;
+    height_ = 2.0f * MARGIN + LINES * LINE;
+    quad( 0.0f, 0.0f, width_, height_, 0, PANEL );
+
+    char  line[128];
+    float y = MARGIN;
+    snprintf( line, sizeof( line ), "Frame %u  CPU %5.2f ms  display %5.2f ms", frame_, last ? last->cpu_ms : 0.0f, refresh_ms );
+    text( MARGIN, y, line, TEXT );
+    y += LINE;
+
+    // The last frames' CPU times, newest on the right, against twice the display interval so the deadline is halfway up.
+    const float graph_height = GRAPH_LINES * LINE - 0.25f;
+    const float bottom       = y + graph_height;
+    const float bar_width    = ( width_ - 2.0f * MARGIN ) / HISTORY;
+    for( int i = 0; i < samples_; ++i ) {
+        const Sample&  sample = history_[( next_ - samples_ + i + HISTORY ) % HISTORY];
+        const float    x      = MARGIN + ( HISTORY - samples_ + i ) * bar_width;
+        const float    height = fminf( sample.cpu_ms / ( 2.0f * refresh_ms ), 1.0f ) * graph_height;
+        const GLubyte* color  = sample.reprojected ? REPROJECTED : ( sample.cpu_ms > refresh_ms ) ? LATE : GOOD;
+        quad( x, bottom - height, x + 0.8f * bar_width, bottom, 0, color );
+    }
+    const float deadline = bottom - 0.5f * graph_height;
+    quad( MARGIN, deadline - 0.03f, width_ - MARGIN, deadline + 0.03f, 0, DEADLINE );
+    y += GRAPH_LINES * LINE;
+
+    const GLWork& limit = budget.limit();
+    const bool    over  = ( work_.draw_calls > limit.draw_calls ) || ( work_.buffer_allocations > limit.buffer_allocations ) ||
+                      ( work_.bytes_uploaded > limit.bytes_uploaded );
+    snprintf( line, sizeof( line ), "Draws %u  uploaded %.1f KB  allocations %u", work_.draw_calls, work_.bytes_uploaded / 1024.0, work_.buffer_allocations );
+    text( MARGIN, y, line, over ? LATE : TEXT );
+    y += LINE;
+    snprintf( line, sizeof( line ), "Over budget %u frames", budget.frames_over_budget() );
+    text( MARGIN, y, line, TEXT );
+    y += LINE;
+    snprintf( line, sizeof( line ), "GPU memory %.1f MB, assets %.1f of %.1f MB", gpu_memory_total() / MB, residency.asset_bytes() / MB, residency.budget() / MB );
+    text( MARGIN, y, line, TEXT );
+    y += LINE;
+    const ResidencyStats& residency_stats = residency.stats();
+    snprintf( line, sizeof( line ), "Evicted %lu  reloaded %lu  deferred %lu", residency_stats.evictions, residency_stats.reloads, residency_stats.last_deferred );
+    text( MARGIN, y, line, TEXT );
+    y += LINE;
+    snprintf( line, sizeof( line ), "Reprojected %u frames, %s", user_context.reprojection.reprojected_frames, user_context.reprojection.enabled ? "on" : "off" );
+    text( MARGIN, y, line, ( last && last->reprojected ) ? REPROJECTED : TEXT );
+    y += LINE;
+    const SampleStats& scene_gpu = user_context.scene_gpu_ms[user_context.depth_prepass ? 1 : 0];
+    snprintf( line, sizeof( line ), "Scene GPU %.2f ms  HUD CPU %.3f ms", scene_gpu.mean(), stats_.frames ? stats_.build_ms / stats_.frames : 0.0 );
+    text( MARGIN, y, line, TEXT );
+
+    // Quads past the buffer's end are dropped. Orphaning the old storage keeps the GPU reading the last frame's from waiting.
+    if( vertices_.size() > 4 * MAX_QUADS ) {
+        vertices_.resize( 4 * MAX_QUADS );
+    }
+    quads_ = static_cast<GLsizei>( vertices_.size() / 4 );
+
+    const size_t bytes = vertices_.size() * sizeof( Vertex );
+    GLState&     gl    = user_context.gl_state;
+    gl.bind_buffer( GL_ARRAY_BUFFER, vertex_buffer_ );
+    glBufferData( GL_ARRAY_BUFFER, 4 * MAX_QUADS * sizeof( Vertex ), nullptr, GL_STREAM_DRAW );
+    glBufferSubData( GL_ARRAY_BUFFER, 0, bytes, vertices_.data() );
+    user_context.frame_budget.count_bytes_uploaded( bytes );
+
+    ++stats_.frames;
+    stats_.quads += quads_;
+    stats_.build_ms += emscripten_get_now() - begin_ms;
+}
+
+void Hud::record( GLCommandBuffer& commands, const GLfloat* model ) const {
+    if( !quads_ ) {
+        return;
+    }
+    commands.use_program( program_ );
+    commands.bind_vertex_array( vertex_array_ );
+    commands.uniform_matrix4fv( mat4_model_, GL_TRUE, model );
+    commands.disable( GL_DEPTH_TEST );
+    commands.enable( GL_BLEND );
+    commands.blend_func( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    commands.draw_elements( GL_TRIANGLES, 6 * quads_, GL_UNSIGNED_SHORT, 0 );
+    commands.disable( GL_BLEND );
+    commands.enable( GL_DEPTH_TEST );
+}
+
+void Hud::head_matrix( const GLfloat* head, GLfloat* model ) const {
+    // Centred, its top a little below the eyes, y down like the layout.
+    // clang-format off
+    const GLfloat panel[4 * 4] = {
+        CELL_METRES, 0.0f,         0.0f, -0.5f * width_ * CELL_METRES,
+        0.0f,        -CELL_METRES, 0.0f, -HEAD_DROP,
+        0.0f,        0.0f,         1.0f, -HEAD_DISTANCE,
+        0.0f,        0.0f,         0.0f, 1.0f,
+    };
+    // clang-format on
+    float4x4_multiply( model, head, panel );
+}
+
+void Hud::screen_matrix( GLint width, GLint height, GLfloat* model ) const {
+    const GLfloat x = 2.0f * CELL_PIXELS / ( width > 0 ? width : 1 );
+    const GLfloat y = 2.0f * CELL_PIXELS / ( height > 0 ? height : 1 );
+    // clang-format off
+    const GLfloat screen[4 * 4] = {
+        x,    0.0f, 0.0f, -1.0f + 0.5f * x,
+        0.0f, -y,   0.0f, 1.0f - 0.5f * y,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    // clang-format on
+    memcpy( model, screen, sizeof( screen ) );
+}
+
+const HudStats& Hud::stats() const {
+    return stats_;
+}
+
+bool Hud::build_atlas() {
+    const double         begin_ms = emscripten_get_now();
+    std::vector<uint8_t> coverage( CHARACTERS * RASTER * RASTER );
+    const int            advance = rasterize_glyphs( FIRST_CHARACTER, CHARACTERS, RASTER, coverage.data() );
+    if( advance <= 0 ) {
+        return false;
+    }
+    advance_ = static_cast<float>( advance ) / RASTER;
+
+    // Each raster pixel's distance to the nearest pixel on the other side of the edge, the edge itself being
+    // half a pixel from both, then averaged down to the atlas and mapped so the edge is at one half.
+    atlas_.assign( ATLAS_WIDTH * ATLAS_HEIGHT, 0 );
+    std::vector<float> to_inside( RASTER * RASTER );
+    std::vector<float> to_outside( RASTER * RASTER );
+    std::vector<float> d( RASTER );
+    std::vector<int>   v( RASTER );
+    std::vector<float> z( RASTER + 1 );
+    const int          SCALE = RASTER / CELL;
+    for( int glyph = 0; glyph < CHARACTERS; ++glyph ) {
+        const uint8_t* pixels = &coverage[glyph * RASTER * RASTER];
+        for( int p = 0; p < RASTER * RASTER; ++p ) {
+            const bool inside = pixels[p] >= 128;
+            to_inside[p]      = inside ? 0.0f : FAR;
+            to_outside[p]     = inside ? FAR : 0.0f;
+        }
+        distance_transform_2d( to_inside.data(), d.data(), v.data(), z.data() );
+        distance_transform_2d( to_outside.data(), d.data(), v.data(), z.data() );
+
+        uint8_t* cell = &atlas_[( glyph / ATLAS_COLUMNS ) * CELL * ATLAS_WIDTH + ( glyph % ATLAS_COLUMNS ) * CELL];
+        for( int y = 0; y < CELL; ++y ) {
+            for( int x = 0; x < CELL; ++x ) {
+                float distance = 0.0f;
+                for( int sy = 0; sy < SCALE; ++sy ) {
+                    for( int sx = 0; sx < SCALE; ++sx ) {
+                        const int p = ( y * SCALE + sy ) * RASTER + x * SCALE + sx;
+                        distance += ( pixels[p] >= 128 ) ? sqrtf( to_outside[p] ) - 0.5f : 0.5f - sqrtf( to_inside[p] );
+                    }
+                }
+                distance /= static_cast<float>( SCALE * SCALE * SCALE );
+                const float value         = fminf( fmaxf( 0.5f + distance / ( 2.0f * SPREAD ), 0.0f ), 1.0f );
+                cell[y * ATLAS_WIDTH + x] = static_cast<uint8_t>( value * 255.0f + 0.5f );
+            }
+        }
+    }
+    uint8_t* solid = &atlas_[( SOLID / ATLAS_COLUMNS ) * CELL * ATLAS_WIDTH + ( SOLID % ATLAS_COLUMNS ) * CELL];
+    for( int y = 0; y < CELL; ++y ) {
+        memset( solid + y * ATLAS_WIDTH, 255, CELL );
+    }
+    stats_.atlas_ms = emscripten_get_now() - begin_ms;
+    STDOUT( "HUD atlas: %d glyphs in %dx%d texels, built in %.1lf ms.", CHARACTERS, ATLAS_WIDTH, ATLAS_HEIGHT, stats_.atlas_ms );
+    return true;
+}
+
+void Hud::quad( float x0, float y0, float x1, float y1, int character, const GLubyte* color ) {
+    // The solid cell is sampled at its centre, far from the glyphs around it.
+    const int slot = character ? character - FIRST_CHARACTER : SOLID;
+    float     u0   = static_cast<float>( ( slot % ATLAS_COLUMNS ) * CELL );
+    float     v0   = static_cast<float>( ( slot / ATLAS_COLUMNS ) * CELL );
+    float     u1   = u0 + CELL;
+    float     v1   = v0 + CELL;
+    if( !character ) {
+        u0 = u1 = u0 + 0.5f * CELL;
+        v0 = v1 = v0 + 0.5f * CELL;
+    }
+    const Vertex corners[4] = {
+        {{x0, y0}, {atlas_u( u0 ), atlas_v( v0 )}, {color[0], color[1], color[2], color[3]}},
+        {{x1, y0}, {atlas_u( u1 ), atlas_v( v0 )}, {color[0], color[1], color[2], color[3]}},
+        {{x0, y1}, {atlas_u( u0 ), atlas_v( v1 )}, {color[0], color[1], color[2], color[3]}},
+        {{x1, y1}, {atlas_u( u1 ), atlas_v( v1 )}, {color[0], color[1], color[2], color[3]}},
+    };
+    vertices_.insert( vertices_.end(), corners, corners + 4 );
+}
+
+void Hud::text( float x, float y, const char* text, const GLubyte* color ) {
+    // Glyphs are centred in their cells, which are wider than the advance and overlap their neighbours.
+    const float inset = 0.5f * ( 1.0f - advance_ );
+    for( const char* c = text; *c; ++c, x += advance_ ) {
+        int character = static_cast<unsigned char>( *c );
+        if( character == ' ' ) {
+            continue;
+        }
+        if( ( character < FIRST_CHARACTER ) || ( character >= FIRST_CHARACTER + CHARACTERS ) ) {
+            character = '?';
+        }
+        quad( x - inset, y, x - inset + 1.0f, y + 1.0f, character, color );
+    }
+}
+
+void print_hud_stats( const Hud& hud ) {
+    const HudStats& stats  = hud.stats();
+    const double    frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "HUD %s: %lu frames shown, %.1lf quads and %.3lf ms laying out and uploading per frame, atlas built in %.1lf ms.",
+            hud.enabled() ? "on" : "off",
+            stats.frames,
+            stats.quads / frames,
+            stats.build_ms / frames,
+            stats.atlas_ms );
+}
@@ -0,0 +1,103 @@
+#ifndef WASMVR_HUD_H
+#define WASMVR_HUD_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "frame_budget.h"
+
+class GLCommandBuffer;
+class GLState;
+class UserContext;
+
+struct HudStats {
+    unsigned long frames; // Laid out and uploaded.
+    unsigned long quads;  // Summed over frames.
+    double        build_ms;
+    double        atlas_ms;
+
+    HudStats();
+};
+
+// Frame times, GL work, GPU memory and reprojection from the instrumentation, shown on a panel for when the
+// console can't be seen, like in the headset. Text comes from a signed distance field atlas of the browser's
+// monospace font, rasterized once, so it stays sharp however large the panel ends up on screen. The panel,
+// the frame time graph's bars and every glyph are quads of one vertex buffer streamed each frame and drawn
+// with a single draw call.
+class Hud {
+public:
+    // Frames the graph shows.
+    static const int HISTORY = 120;
+    // Texture unit the atlas stays bound to.
+    static const GLint ATLAS_UNIT = 7;
+
+    Hud();
+
+    // Builds the atlas the first time, then loads the program and creates the atlas texture and the buffers.
+    bool create( UserContext& user_context );
+    void release( GLState& gl );
+
+    void set_enabled( bool enabled );
+    bool enabled() const;
+
+    // Keeps the CPU time and GL work of a frame drawn for the graph and the text.
+    void end_frame( const UserContext& user_context );
+    // Lays out the panel from the last frames and uploads it.
+    void upload( UserContext& user_context );
+    // Records drawing the panel placed by a row major matrix, over everything and blended.
+    void record( GLCommandBuffer& commands, const GLfloat* model ) const;
+
+    // Places the panel in front of and below the eyes of a head with a row major world matrix, in metres.
+    void head_matrix( const GLfloat* head, GLfloat* model ) const;
+    // Places the panel in the top left corner of a width by height viewport drawn with an identity camera.
+    void screen_matrix( GLint width, GLint height, GLfloat* model ) const;
+
+    const HudStats& stats() const;
+
+private:
+    struct Sample {
+        float cpu_ms;
+        bool  reprojected;
+    };
+
+    struct Vertex {
+        GLfloat  position[2]; // In glyph cells, y down.
+        GLushort uv[2];
+        GLubyte  color[4];
+    };
+
+    bool build_atlas();
+    // A quad of the atlas cell of the character, or of its solid cell for 0.
+    void quad( float x0, float y0, float x1, float y1, int character, const GLubyte* color );
+    void text( float x, float y, const char* text, const GLubyte* color );
+
+    bool                 enabled_;
+    std::vector<uint8_t> atlas_;
+    float                advance_; // Of every glyph, in cells.
+    float                width_;   // Of the panel, in cells.
+    float                height_;
+
+    Sample       history_[HISTORY];
+    int          next_;
+    int          samples_;
+    GLWork       work_; // Of the last frame drawn.
+    unsigned int frame_;
+
+    std::vector<Vertex> vertices_;
+    GLsizei             quads_; // Uploaded last.
+
+    GLuint program_;
+    GLint  mat4_model_;
+    GLuint texture_;
+    GLuint vertex_buffer_;
+    GLuint index_buffer_;
+    GLuint vertex_array_;
+
+    HudStats stats_;
+};
+
+void print_hud_stats( const Hud& hud );
+
+#endif // WASMVR_HUD_H
@@ -0,0 +1,172 @@
+#include "input.h"
+
+#include <string.h>
+
+#include "trace.h"
+#include "user_context.h"
+#include "util.h"
+
+bool input_initialize( UserContext& user_context ) {
+    if( EMSCRIPTEN_RESULT_SUCCESS != emscripten_set_keydown_callback( EMSCRIPTEN_EVENT_TARGET_WINDOW, static_cast<void*>( &user_context ), false, on_keydown ) ) {
+        STDERR( "Failed to attach keyboard callback." );
+        return false;
+    }
+    return true;
+}
+
+EM_BOOL on_keydown( int, const EmscriptenKeyboardEvent* event, void* arg ) {
+    UserContext& user_context = *( reinterpret_cast<UserContext*>( arg ) );
+    if( event->repeat ) {
+        return false;
+    }
+    // Most keys change what is drawn, and the rest are too rare to be worth telling apart.
+    user_context.redraw.request();
+
+    if( !strcmp( event->code, "KeyL" ) ) {
+        user_context.late_latch = !user_context.late_latch;
+        STDOUT( "Late latch %s.", user_context.late_latch ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyG" ) ) {
+        user_context.gl_state.set_debug( !user_context.gl_state.debug() );
+        STDOUT( "GL state cross-checking %s.", user_context.gl_state.debug() ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyR" ) ) {
+        user_context.reprojection.enabled = !user_context.reprojection.enabled;
+        STDOUT( "Reprojection %s.", user_context.reprojection.enabled ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyP" ) ) {
+        user_context.reprojection.positional = !user_context.reprojection.positional;
+        STDOUT( "Reprojection is %s.", user_context.reprojection.positional ? "positional" : "rotational" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyD" ) ) {
+        user_context.dump_scene_commands = true;
+        STDOUT( "Dumping the next recorded frame." );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyO" ) ) {
+        user_context.occlusion.set_enabled( !user_context.occlusion.enabled() );
+        STDOUT( "Occlusion culling %s.", user_context.occlusion.enabled() ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyH" ) ) {
+        user_context.occlusion.set_debug( !user_context.occlusion.debug() );
+        STDOUT( "Occlusion cross-checking %s.", user_context.occlusion.debug() ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyM" ) ) {
+        user_context.lod.set_enabled( !user_context.lod.enabled() );
+        STDOUT( "Mesh LOD selection %s.", user_context.lod.enabled() ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyQ" ) ) {
+        user_context.mesh_format = static_cast<MeshVertexFormat>( ( user_context.mesh_format + 1 ) % MESH_VERTEX_FORMATS );
+        STDOUT( "Uploading meshes as %s.", mesh_vertex_format_name( user_context.mesh_format ) );
+        scene_build_default( user_context );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyI" ) ) {
+        user_context.instance_grid = user_context.instance_grid ? 0 : SCENE_INSTANCE_GRID_NODES;
+        STDOUT( "Instance grid of %d nodes.", user_context.instance_grid );
+        scene_build_default( user_context );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyZ" ) ) {
+        user_context.depth_prepass = !user_context.depth_prepass;
+        STDOUT( "Depth pre-pass %s.", user_context.depth_prepass ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyX" ) ) {
+        user_context.particle_motes = ( user_context.particle_motes >= 50000 ) ? 0 : user_context.particle_motes ? 50000 : 10000;
+        STDOUT( "%d particle motes.", user_context.particle_motes );
+        scene_build_default( user_context );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyK" ) ) {
+        const int counts[] = {0, 10, 100, 500};
+        int       next     = 0;
+        while( ( next < 3 ) && ( counts[next] <= user_context.skinned_characters ) ) {
+            ++next;
+        }
+        user_context.skinned_characters = ( counts[next] > user_context.skinned_characters ) ? counts[next] : 0;
+        STDOUT( "%d skinned characters.", user_context.skinned_characters );
+        scene_build_default( user_context );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyC" ) ) {
+        PointCloud& cloud = user_context.point_cloud;
+        if( cloud.opened() ) {
+            cloud.close( user_context.gl_state );
+            STDOUT( "Point cloud closed." );
+        } else {
+            cloud.open( user_context.gl_state, "pointcloud" );
+        }
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyA" ) ) {
+        TextureCache& textures = user_context.textures;
+        const int     file     = textures.load( "albedo.ktx2" );
+        textures.set_albedo( ( textures.albedo() == file ) ? textures.checker() : file );
+        STDOUT( "Albedo is %s.", ( textures.albedo() == file ) ? "albedo.ktx2" : "the checker" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyU" ) ) {
+        user_context.hud.set_enabled( !user_context.hud.enabled() );
+        STDOUT( "HUD %s.", user_context.hud.enabled() ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyW" ) ) {
+        SceneFile& file = user_context.scene_file;
+        if( file.opened() ) {
+            file.close();
+            STDOUT( "Scene file closed." );
+            scene_build_default( user_context );
+        } else {
+            file.open( user_context, "scene.wvrs" );
+        }
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyS" ) ) {
+        scene_file_save( user_context, "scene.wvrs" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyF" ) ) {
+        user_context.redraw.set_enabled( !user_context.redraw.enabled() );
+        STDOUT( "Redraw on demand %s.", user_context.redraw.enabled() ? "on" : "off" );
+        return true;
+    }
+
+    if( !strcmp( event->code, "KeyT" ) ) {
+        if( trace_capturing() ) {
+            trace_capture_save();
+            STDOUT( "Trace capture stopped and saved." );
+        } else {
+            trace_start();
+            STDOUT( "Trace capture started." );
+        }
+        return true;
+    }
+
+    return false;
+}
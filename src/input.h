@@ -0,0 +1,13 @@
+#ifndef WASMVR_INPUT_H
+#define WASMVR_INPUT_H
+
+#include <emscripten/html5.h>
+
+class UserContext;
+
+// Keyboard shortcuts for switching renderer modes at runtime.
+bool input_initialize( UserContext& user_context );
+
+EM_BOOL on_keydown( int, const EmscriptenKeyboardEvent* event, void* arg );
+
+#endif // WASMVR_INPUT_H
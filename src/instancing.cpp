@@ -0,0 +1,232 @@
+#include "instancing.h"
+
+#include <stddef.h>
+
+#include "gl_command_buffer.h"
+#include "residency.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const size_t FRAMES_IN_RING = 3;
+
+    const GLfloat DEPTH_STEPS = 65535.0f;
+}
+
+const GLfloat InstanceBatcher::SORT_DISTANCE = 64.0f;
+
+void InstanceBatcher::clear() {
+    batches_.clear();
+    added_.clear();
+    added_nodes_.clear();
+    added_depths_.clear();
+    batch_of_key_.clear();
+}
+
+void InstanceBatcher::add( int mesh, int lod, uint8_t eyes, int node, GLfloat distance ) {
+    // Runs of nodes sharing a batch are common, so the last batch is checked before the map.
+    int32_t batch;
+    if( !batches_.empty() && ( batches_.back().mesh == mesh ) && ( batches_.back().lod == lod ) && ( batches_.back().eyes == eyes ) ) {
+        batch = static_cast<int32_t>( batches_.size() ) - 1;
+    } else {
+        const uint64_t key = ( static_cast<uint64_t>( mesh ) << 16 ) | ( static_cast<uint64_t>( lod ) << 8 ) | eyes;
+        auto           found = batch_of_key_.find( key );
+        if( found != batch_of_key_.end() ) {
+            batch = found->second;
+        } else {
+            batch              = static_cast<int32_t>( batches_.size() );
+            batch_of_key_[key] = batch;
+            InstanceBatch added = {mesh, lod, eyes, 0, 0};
+            batches_.push_back( added );
+        }
+    }
+    ++batches_[batch].count;
+    added_.push_back( batch );
+    added_nodes_.push_back( node );
+
+    const GLfloat depth = distance / SORT_DISTANCE * DEPTH_STEPS;
+    added_depths_.push_back( ( depth <= 0.0f ) ? 0 : ( depth >= DEPTH_STEPS ) ? 0xffff : static_cast<uint16_t>( depth ) );
+}
+
+void InstanceBatcher::build() {
+    // Front to back, with a stable radix sort by distance a byte at a time.
+    const size_t added = added_nodes_.size();
+    order_.resize( added );
+    scratch_.resize( added );
+    for( size_t i = 0; i < added; ++i ) {
+        order_[i] = static_cast<uint32_t>( i );
+    }
+    for( int shift = 0; shift < 16; shift += 8 ) {
+        uint32_t offsets[256] = {};
+        for( uint32_t index : order_ ) {
+            ++offsets[( added_depths_[index] >> shift ) & 0xff];
+        }
+        uint32_t sum = 0;
+        for( uint32_t& offset : offsets ) {
+            const uint32_t count = offset;
+            offset               = sum;
+            sum += count;
+        }
+        for( uint32_t index : order_ ) {
+            scratch_[offsets[( added_depths_[index] >> shift ) & 0xff]++] = index;
+        }
+        order_.swap( scratch_ );
+    }
+
+    // Batches go in the order of their nearest node.
+    rank_.assign( batches_.size(), -1 );
+    sorted_batches_.clear();
+    for( uint32_t index : order_ ) {
+        int32_t& rank = rank_[added_[index]];
+        if( rank < 0 ) {
+            rank = static_cast<int32_t>( sorted_batches_.size() );
+            sorted_batches_.push_back( batches_[added_[index]] );
+        }
+    }
+    batches_.swap( sorted_batches_ );
+
+    // Then a counting sort by batch, which keeps the nodes of each front to back.
+    uint32_t first = 0;
+    for( InstanceBatch& batch : batches_ ) {
+        batch.first = first;
+        first += batch.count;
+        batch.count = 0;
+    }
+    nodes_.resize( added );
+    for( uint32_t index : order_ ) {
+        InstanceBatch& batch                = batches_[rank_[added_[index]]];
+        nodes_[batch.first + batch.count++] = added_nodes_[index];
+    }
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::batches() const {
+    return batches_;
+}
+
+const std::vector<int32_t>& InstanceBatcher::nodes() const {
+    return nodes_;
+}
+
+InstanceStats::InstanceStats()
+    : frames( 0 )
+    , instances( 0 )
+    , bytes( 0 )
+    , wraps( 0 )
+    , grows( 0 ) {
+}
+
+InstanceRing::InstanceRing()
+    : buffer_( 0 )
+    , capacity_( 0 )
+    , head_( 0 )
+    , first_( 0 )
+    , orphan_( false ) {
+}
+
+bool InstanceRing::create( UserContext& user_context, size_t capacity ) {
+    glGenBuffers( 1, &buffer_ );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    if( !buffer_ ) {
+        STDERR( "Failed to create instance buffer." );
+        return false;
+    }
+    capacity_ = capacity;
+    head_     = 0;
+    user_context.gl_state.bind_buffer( GL_ARRAY_BUFFER, buffer_ );
+    glBufferData( GL_ARRAY_BUFFER, capacity_ * sizeof( InstanceData ), nullptr, GL_STREAM_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, buffer_, capacity_ * sizeof( InstanceData ) );
+    return true;
+}
+
+void InstanceRing::release( GLState& gl ) {
+    gpu_memory_freed( GPU_MEMORY_BUFFER, buffer_ );
+    gl.forget_buffer( buffer_ );
+    glDeleteBuffers( 1, &buffer_ );
+    buffer_   = 0;
+    capacity_ = 0;
+}
+
+InstanceData* InstanceRing::begin( UserContext& user_context, size_t count ) {
+    if( FRAMES_IN_RING * count > capacity_ ) {
+        capacity_ = FRAMES_IN_RING * count;
+        head_     = 0;
+        user_context.gl_state.bind_buffer( GL_ARRAY_BUFFER, buffer_ );
+        glBufferData( GL_ARRAY_BUFFER, capacity_ * sizeof( InstanceData ), nullptr, GL_STREAM_DRAW );
+        gpu_memory_allocated( GPU_MEMORY_BUFFER, buffer_, capacity_ * sizeof( InstanceData ) );
+        user_context.frame_budget.count_buffer_allocations( 1 );
+        ++stats_.grows;
+    } else if( head_ + count > capacity_ ) {
+        head_   = 0;
+        orphan_ = true;
+        ++stats_.wraps;
+    }
+    first_ = head_;
+    head_ += count;
+    staging_.resize( count );
+    return staging_.data();
+}
+
+void InstanceRing::end( UserContext& user_context ) {
+    const size_t bytes = staging_.size() * sizeof( InstanceData );
+    ++stats_.frames;
+    stats_.instances += staging_.size();
+    stats_.bytes += bytes;
+    if( !bytes ) {
+        return;
+    }
+    user_context.gl_state.bind_buffer( GL_ARRAY_BUFFER, buffer_ );
+    if( orphan_ ) {
+        glBufferData( GL_ARRAY_BUFFER, capacity_ * sizeof( InstanceData ), nullptr, GL_STREAM_DRAW );
+        orphan_ = false;
+    }
+    glBufferSubData( GL_ARRAY_BUFFER, offset(), bytes, staging_.data() );
+    user_context.frame_budget.count_bytes_uploaded( bytes );
+}
+
+GLuint InstanceRing::buffer() const {
+    return buffer_;
+}
+
+GLintptr InstanceRing::offset() const {
+    return first_ * sizeof( InstanceData );
+}
+
+const InstanceStats& InstanceRing::stats() const {
+    return stats_;
+}
+
+void instance_record_attributes( const UserContext& user_context, GLCommandBuffer& commands, GLintptr offset, bool skinned ) {
+    commands.bind_buffer( GL_ARRAY_BUFFER, user_context.instance_ring.buffer() );
+    for( int i = 0; i < 3; ++i ) {
+        const GLint row = user_context.vec4_instance_rows[i];
+        if( row < 0 ) {
+            continue;
+        }
+        commands.vertex_attrib_pointer( row, 4, GL_FLOAT, GL_FALSE, sizeof( InstanceData ), offset + i * 4 * sizeof( GLfloat ) );
+        commands.vertex_attrib_divisor( row, 1 );
+        commands.enable_vertex_attrib_array( row );
+    }
+    const GLint color = user_context.vec4_instance_color;
+    if( color >= 0 ) {
+        commands.vertex_attrib_pointer( color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( InstanceData ), offset + offsetof( InstanceData, color ) );
+        commands.vertex_attrib_divisor( color, 1 );
+        commands.enable_vertex_attrib_array( color );
+    }
+    const GLint palette = user_context.float_instance_palette;
+    if( skinned && ( palette >= 0 ) ) {
+        commands.vertex_attrib_pointer( palette, 1, GL_FLOAT, GL_FALSE, sizeof( InstanceData ), offset + offsetof( InstanceData, palette ) );
+        commands.vertex_attrib_divisor( palette, 1 );
+        commands.enable_vertex_attrib_array( palette );
+    }
+}
+
+void print_instance_stats( const InstanceRing& ring, const InstanceBatcher& batcher ) {
+    const InstanceStats& stats  = ring.stats();
+    const double         frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "Instancing: %.1lf instances per frame, %lu batches in the last frame, %.1lf KiB streamed per frame, %u wraps, %u grows.",
+            stats.instances / frames,
+            static_cast<unsigned long>( batcher.batches().size() ),
+            stats.bytes / frames / 1024.0,
+            stats.wraps,
+            stats.grows );
+}
@@ -0,0 +1,108 @@
+#ifndef WASMVR_INSTANCING_H
+#define WASMVR_INSTANCING_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+class GLCommandBuffer;
+class GLState;
+class UserContext;
+
+// What each instance feeds the scene shader: the top three rows of its (row major) model matrix,
+// its colour as RGBA bytes and, for skinned meshes, where its bone palette starts.
+struct InstanceData {
+    GLfloat model_rows[3 * 4];
+    GLubyte color[4];
+    GLfloat palette;
+};
+
+// Draws of one mesh level for the same eyes, as a range of the frame's instances.
+struct InstanceBatch {
+    int      mesh;
+    int      lod;
+    uint8_t  eyes;
+    uint32_t first;
+    uint32_t count;
+};
+
+// Gathers the nodes drawn in a frame into batches that can each be one instanced draw.
+// For early depth rejection, batches are ordered by their nearest node and nodes front to back within them.
+class InstanceBatcher {
+public:
+    // Distances are sorted by at this resolution up to this far, anything further is sorted as this far.
+    static const GLfloat SORT_DISTANCE;
+
+    void clear();
+    void add( int mesh, int lod, uint8_t eyes, int node, GLfloat distance );
+    // Groups everything added since clear(), after which nodes() lists them batch by batch.
+    void build();
+
+    const std::vector<InstanceBatch>& batches() const;
+    const std::vector<int32_t>&       nodes() const;
+
+private:
+    std::vector<InstanceBatch>            batches_;
+    std::vector<int32_t>                  added_; // Per node added, its batch.
+    std::vector<int32_t>                  added_nodes_;
+    std::vector<uint16_t>                 added_depths_; // Quantized distances.
+    std::vector<uint32_t>                 order_;        // Of the nodes added, front to back.
+    std::vector<uint32_t>                 scratch_;
+    std::vector<int32_t>                  rank_; // Per batch as added, its place in the sorted batches.
+    std::vector<InstanceBatch>            sorted_batches_;
+    std::vector<int32_t>                  nodes_;
+    std::unordered_map<uint64_t, int32_t> batch_of_key_;
+};
+
+struct InstanceStats {
+    unsigned long frames;
+    unsigned long instances;
+    unsigned long bytes;
+    unsigned int  wraps;
+    unsigned int  grows;
+
+    InstanceStats();
+};
+
+// One GL buffer that instance data is streamed through, created once and reused every frame.
+// Each frame writes the next range after the previous frame's. When the end is reached the storage
+// is orphaned and writing starts over at the front, so the GPU can keep reading what earlier frames wrote.
+class InstanceRing {
+public:
+    InstanceRing();
+
+    bool create( UserContext& user_context, size_t capacity );
+    void release( GLState& gl );
+
+    // Reserves the frame's count instances and returns where to write them. Grows the buffer if a frame
+    // doesn't fit in a third of it.
+    InstanceData* begin( UserContext& user_context, size_t count );
+    // Uploads what was written since begin().
+    void end( UserContext& user_context );
+
+    GLuint buffer() const;
+    // Byte offset of the frame's first instance in the buffer.
+    GLintptr offset() const;
+
+    const InstanceStats& stats() const;
+
+private:
+    GLuint                    buffer_;
+    size_t                    capacity_; // In instances.
+    size_t                    head_;
+    size_t                    first_;
+    bool                      orphan_;
+    std::vector<InstanceData> staging_;
+    InstanceStats             stats_;
+};
+
+// Records pointing the scene program's instance attributes of the bound vertex array at the instances
+// starting offset bytes into the ring's buffer. WebGL has no base instance, so each batch does this.
+// Only skinned meshes' vertex arrays get the palette attribute.
+void instance_record_attributes( const UserContext& user_context, GLCommandBuffer& commands, GLintptr offset, bool skinned );
+
+void print_instance_stats( const InstanceRing& ring, const InstanceBatcher& batcher );
+
+#endif // WASMVR_INSTANCING_H
@@ -0,0 +1,16 @@
+#ifndef WASMVR_JOBS_H
+#define WASMVR_JOBS_H
+
+#include <stddef.h>
+
+// Runs body( i ) for every i in [0, count). The build has no pthreads, so for now this runs in order on
+// the calling thread, but bodies must only write to state owned by their own index, so the loop can be
+// spread over workers once the build has them without changing any caller.
+template <typename Body>
+void parallel_for( size_t count, const Body& body ) {
+    for( size_t i = 0; i < count; ++i ) {
+        body( i );
+    }
+}
+
+#endif // WASMVR_JOBS_H
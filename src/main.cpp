@@ -1,22 +1,38 @@
 // https://emscripten.org/docs/porting/multimedia_and_graphics/OpenGL-support.html#webgl-friendly-subset-of-opengl-es-2-0-3-0
 
 #include "egl.h"
+#include "frame.h"
 #include "gles.h"
+#include "input.h"
+#include "reprojection.h"
+#include "scene.h"
+#include "trace.h"
 #include "user_context.h"
 #include "util.h"
 #include "vr.h"
 
 void init_loop( void* arg ) {
     UserContext& user_context = *( reinterpret_cast<UserContext*>( arg ) );
+    TraceScope   trace( "init_loop" );
+    frame_begin( user_context );
     if( user_context.update_func != nullptr ) {
+        TraceScope trace_update( "update" );
         user_context.update_func( user_context );
     }
 
-    // Draw normally.
-    if( user_context.draw_func != nullptr ) {
-        user_context.draw_func( user_context );
+    // Draw normally, unless nothing changed since the last frame drawn or there is no context to draw with.
+    const bool drawn = !user_context.residency.lost() &&
+                       user_context.redraw.needed( user_context.width, user_context.height, user_context.scene );
+    if( drawn ) {
+        if( user_context.draw_func != nullptr ) {
+            TraceScope trace_draw( "draw" );
+            user_context.draw_func( user_context );
+        }
+        trace_begin( "swap_buffers" );
+        eglSwapBuffers( user_context.display, user_context.surface );
+        trace_end( "swap_buffers" );
     }
-    eglSwapBuffers( user_context.display, user_context.surface );
+    frame_end( user_context, drawn );
 
     // Prepare use of VR.
     if( user_context.use_vr && ( user_context.vr_display == VR_NOT_SET ) ) {
@@ -35,6 +51,20 @@ int main() {
     }
     STDOUT( "Set up program." );
 
+    scene_build_default( user_context );
+
+    if( !reprojection_load_shaders( user_context ) ) {
+        STDERR( "Continuing without reprojection." );
+    }
+
+    if( !input_initialize( user_context ) ) {
+        STDERR( "Continuing without keyboard shortcuts." );
+    }
+
+    if( !residency_initialize( user_context ) ) {
+        STDERR( "Continuing without context restore." );
+    }
+
     user_context.update_func = gles_update;
     user_context.draw_func   = gles_draw;
 
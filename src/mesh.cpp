@@ -0,0 +1,212 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "residency.h"
+#include "scene.h"
+#include "user_context.h"
+#include "util.h"
+
+bool mesh_upload_packed( UserContext& user_context, Mesh& mesh, const void* vertices, size_t vertex_bytes, const void* indices, size_t index_bytes ) {
+    GLState&                gl          = user_context.gl_state;
+    const MeshVertexLayout& layout      = mesh_vertex_layout( mesh.format );
+    const bool              skinned     = mesh.skinned();
+    const GLsizei           skin_offset = layout.stride;
+    const GLsizei           stride      = layout.stride + ( skinned ? 8 : 0 );
+
+    glGenVertexArrays( 1, &mesh.vertex_array );
+    GLuint buffers[2] = {0, 0};
+    glGenBuffers( 2, buffers );
+    user_context.frame_budget.count_buffer_allocations( 2 );
+    mesh.vertex_buffer = buffers[0];
+    mesh.index_buffer  = buffers[1];
+    if( !mesh.vertex_array || !mesh.vertex_buffer || !mesh.index_buffer ) {
+        STDERR( "Failed to create mesh buffers." );
+        mesh_release( gl, mesh );
+        return false;
+    }
+
+    // The index buffer binding and the attribute setup are recorded in the vertex array.
+    gl.bind_vertex_array( mesh.vertex_array );
+    gl.bind_buffer( GL_ARRAY_BUFFER, mesh.vertex_buffer );
+    glBufferData( GL_ARRAY_BUFFER, vertex_bytes, vertices, GL_STATIC_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, mesh.vertex_buffer, vertex_bytes );
+    gl.vertex_attrib_pointer( user_context.vec4_position, 3, layout.position_type, layout.normalized, stride, 0 );
+    gl.enable_vertex_attrib_array( user_context.vec4_position );
+    // Attributes the shader doesn't use have no location.
+    if( user_context.vec4_normal >= 0 ) {
+        gl.vertex_attrib_pointer( user_context.vec4_normal, layout.normal_size, layout.normal_type, layout.normalized, stride, reinterpret_cast<const GLvoid*>( layout.normal_offset ) );
+        gl.enable_vertex_attrib_array( user_context.vec4_normal );
+    }
+    if( user_context.vec2_uv >= 0 ) {
+        gl.vertex_attrib_pointer( user_context.vec2_uv, 2, layout.uv_type, GL_FALSE, stride, reinterpret_cast<const GLvoid*>( layout.uv_offset ) );
+        gl.enable_vertex_attrib_array( user_context.vec2_uv );
+    }
+    // Bone indices go to the shader as whole numbers in floats, weights normalized.
+    if( skinned && ( user_context.vec4_bone_indices >= 0 ) && ( user_context.vec4_bone_weights >= 0 ) ) {
+        gl.vertex_attrib_pointer( user_context.vec4_bone_indices, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, reinterpret_cast<const GLvoid*>( static_cast<GLintptr>( skin_offset ) ) );
+        gl.enable_vertex_attrib_array( user_context.vec4_bone_indices );
+        gl.vertex_attrib_pointer( user_context.vec4_bone_weights, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast<const GLvoid*>( static_cast<GLintptr>( skin_offset + 4 ) ) );
+        gl.enable_vertex_attrib_array( user_context.vec4_bone_weights );
+    }
+    gl.bind_buffer( GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, index_bytes, indices, GL_STATIC_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, mesh.index_buffer, index_bytes );
+    gl.bind_vertex_array( 0 );
+    user_context.frame_budget.count_bytes_uploaded( vertex_bytes + index_bytes );
+    return true;
+}
+
+bool mesh_upload( UserContext& user_context, Mesh& mesh, MeshVertexFormat format ) {
+    const size_t vertex_count = mesh.positions.size() / 3;
+    MeshPacked   packed;
+    mesh_pack( mesh, format, packed );
+    mesh.format = packed.format;
+    memcpy( mesh.dequantize, packed.dequantize, sizeof( mesh.dequantize ) );
+    mesh.index_type = packed.index_type;
+    if( !mesh_upload_packed( user_context, mesh, packed.vertices.data(), packed.vertices.size(), packed.indices.data(), packed.indices.size() ) ) {
+        return false;
+    }
+
+    const size_t float_bytes = vertex_count * ( mesh_vertex_size( MESH_VERTEX_FLOAT ) + ( mesh.skinned() ? 8 : 0 ) ) + mesh.indices.size() * sizeof( uint32_t );
+    STDOUT( "Mesh uploaded: %lu vertices, %lu indices over %lu levels, %lu bytes as %s instead of %lu bytes as floats (%.0lf%%).",
+            static_cast<unsigned long>( vertex_count ),
+            static_cast<unsigned long>( mesh.indices.size() ),
+            static_cast<unsigned long>( mesh.lods.size() ),
+            static_cast<unsigned long>( packed.vertices.size() + packed.indices.size() ),
+            mesh_vertex_format_name( format ),
+            static_cast<unsigned long>( float_bytes ),
+            float_bytes ? 100.0 * ( packed.vertices.size() + packed.indices.size() ) / float_bytes : 100.0 );
+    return true;
+}
+
+void mesh_release( GLState& gl, Mesh& mesh ) {
+    if( mesh.vertex_array ) {
+        gl.forget_vertex_array( mesh.vertex_array );
+        glDeleteVertexArrays( 1, &mesh.vertex_array );
+    }
+    const GLuint buffers[2] = {mesh.vertex_buffer, mesh.index_buffer};
+    gpu_memory_freed( GPU_MEMORY_BUFFER, mesh.vertex_buffer );
+    gpu_memory_freed( GPU_MEMORY_BUFFER, mesh.index_buffer );
+    gl.forget_buffer( mesh.vertex_buffer );
+    gl.forget_buffer( mesh.index_buffer );
+    glDeleteBuffers( 2, buffers );
+    mesh.vertex_array  = 0;
+    mesh.vertex_buffer = 0;
+    mesh.index_buffer  = 0;
+}
+
+LodStats::LodStats()
+    : frames( 0 )
+    , triangles_full( 0 )
+    , triangles_drawn( 0 )
+    , switches( 0 )
+    , last_triangles_full( 0 )
+    , last_triangles_drawn( 0 ) {
+}
+
+const GLfloat LodSelector::HYSTERESIS = 0.75f;
+
+LodSelector::LodSelector()
+    : threshold_( 1.0f )
+    , enabled_( true ) {
+}
+
+void LodSelector::set_enabled( bool enabled ) {
+    enabled_ = enabled;
+}
+
+bool LodSelector::enabled() const {
+    return enabled_;
+}
+
+void LodSelector::set_threshold( GLfloat pixels ) {
+    threshold_ = pixels;
+}
+
+GLfloat LodSelector::threshold() const {
+    return threshold_;
+}
+
+void LodSelector::begin_frame() {
+    stats_.last_triangles_full  = 0;
+    stats_.last_triangles_drawn = 0;
+}
+
+int LodSelector::select( const Scene& scene, int node, const Mesh& mesh, GLfloat distance, GLfloat pixels_per_unit ) {
+    if( static_cast<size_t>( node ) >= current_.size() ) {
+        current_.resize( node + 1, 0 );
+    }
+    const int levels  = static_cast<int>( mesh.lods.size() );
+    int       current = std::min<int>( current_[node], levels - 1 );
+
+    int lod = 0;
+    if( enabled_ ) {
+        // How far a model unit reaches in the world, along the axis the node is stretched the most.
+        const GLfloat* world       = scene.world_matrix( node );
+        GLfloat        world_scale = 0.0f;
+        for( int i = 0; i < 3; ++i ) {
+            world_scale = std::max( world_scale, sqrtf( world[i] * world[i] + world[4 + i] * world[4 + i] + world[8 + i] * world[8 + i] ) );
+        }
+        const GLfloat scale = world_scale * pixels_per_unit / distance;
+        // Errors only grow with each level, so the first one over the threshold ends the search.
+        while( ( lod + 1 < levels ) && ( mesh.lods[lod + 1].error * scale <= threshold_ ) ) {
+            ++lod;
+        }
+        // Going coarser takes a margin, going finer happens right away.
+        while( ( lod > current ) && ( mesh.lods[lod].error * scale > HYSTERESIS * threshold_ ) ) {
+            --lod;
+        }
+    }
+
+    if( lod != current ) {
+        ++stats_.switches;
+    }
+    current_[node] = static_cast<int8_t>( lod );
+    stats_.last_triangles_full += mesh.triangles( 0 );
+    stats_.last_triangles_drawn += mesh.triangles( lod );
+    return lod;
+}
+
+void LodSelector::end_frame() {
+    ++stats_.frames;
+    stats_.triangles_full += stats_.last_triangles_full;
+    stats_.triangles_drawn += stats_.last_triangles_drawn;
+}
+
+const LodStats& LodSelector::stats() const {
+    return stats_;
+}
+
+GLfloat lod_distance( const Scene& scene, int node, const GLfloat* point, GLfloat near ) {
+    const GLfloat* box      = scene.world_bounds( node );
+    GLfloat        center   = 0.0f;
+    GLfloat        diagonal = 0.0f;
+    for( int i = 0; i < 3; ++i ) {
+        const GLfloat c = 0.5f * ( box[i] + box[3 + i] ) - point[i];
+        const GLfloat e = 0.5f * ( box[3 + i] - box[i] );
+        center += c * c;
+        diagonal += e * e;
+    }
+    return std::max( sqrtf( center ) - sqrtf( diagonal ), near );
+}
+
+void print_lod_stats( const LodSelector& selector, const std::vector<Mesh>& meshes ) {
+    const LodStats& stats  = selector.stats();
+    const double    frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    size_t          levels = 0;
+    for( const Mesh& mesh : meshes ) {
+        levels += mesh.lods.size();
+    }
+    STDOUT( "LOD %s: %lu meshes with %lu levels, %.1lf triangles per frame instead of %.1lf, %lu in the last frame instead of %lu, %lu switches.",
+            selector.enabled() ? "on" : "off",
+            static_cast<unsigned long>( meshes.size() ),
+            static_cast<unsigned long>( levels ),
+            stats.triangles_drawn / frames,
+            stats.triangles_full / frames,
+            static_cast<unsigned long>( stats.last_triangles_drawn ),
+            static_cast<unsigned long>( stats.last_triangles_full ),
+            stats.switches );
+}
@@ -0,0 +1,163 @@
+#ifndef WASMVR_MESH_H
+#define WASMVR_MESH_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class GLState;
+class Scene;
+class UserContext;
+
+// How a mesh's vertices are laid out in its vertex buffer. Every layout interleaves position, normal and UV.
+enum MeshVertexFormat {
+    MESH_VERTEX_FLOAT,           // 32-bit float positions, normals and UVs, 32 bytes.
+    MESH_VERTEX_QUANTIZED,       // 16-bit positions, 2x16-bit octahedral normals and half float UVs, 16 bytes.
+    MESH_VERTEX_QUANTIZED_SMALL, // 16-bit positions, 2x8-bit octahedral normals and half float UVs, 12 bytes.
+    MESH_VERTEX_FORMATS
+};
+
+// Where each attribute sits in an interleaved vertex of a layout.
+struct MeshVertexLayout {
+    GLsizei   stride;
+    GLenum    position_type;
+    GLint     normal_size; // Three for a plain normal, two for an octahedral one.
+    GLenum    normal_type;
+    GLintptr  normal_offset;
+    GLenum    uv_type;
+    GLintptr  uv_offset;
+    GLboolean normalized;
+};
+
+const char*             mesh_vertex_format_name( MeshVertexFormat format );
+GLsizei                 mesh_vertex_size( MeshVertexFormat format );
+const MeshVertexLayout& mesh_vertex_layout( MeshVertexFormat format );
+
+// A range of a mesh's index buffer drawing the whole mesh at one level of detail.
+struct MeshLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    GLfloat  error; // How far, in model units, this level may stray from the full mesh.
+};
+
+// An indexed triangle mesh whose levels of detail all share one vertex buffer and sit back to back,
+// finest first, in one index buffer, so switching level only changes the range drawn.
+struct Mesh {
+    std::vector<GLfloat>  positions; // Three per vertex.
+    std::vector<GLfloat>  normals;   // Three per vertex, unit length.
+    std::vector<GLfloat>  uvs;       // Two per vertex.
+    // Only skinned meshes have these, four bones per vertex and their weights, which add up to one.
+    std::vector<uint8_t>  bone_indices;
+    std::vector<GLfloat>  bone_weights;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod>  lods;
+    GLfloat               bounds[6]; // Local, min x, y, z followed by max x, y, z.
+
+    // Set by mesh_upload(). Quantized positions are in [-1, 1] and dequantize is the (row major) matrix
+    // taking them back to model space, to be applied before the model matrix.
+    MeshVertexFormat format;
+    GLfloat          dequantize[4 * 4];
+    GLenum           index_type; // GL_UNSIGNED_SHORT whenever the vertices fit.
+
+    GLuint vertex_array;
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+
+    // Asset of the GpuResidency that may evict and reload the buffers, -1 if they are never evicted.
+    int residency;
+
+    Mesh();
+
+    bool     skinned() const;
+    size_t   triangles( int lod ) const;
+    GLintptr index_offset( int lod ) const; // Bytes into the index buffer.
+};
+
+// A mesh with a single level from an unindexed triangle list of three floats per vertex.
+// Normals are the triangles' and UVs are planar over the bounds in x and y.
+Mesh mesh_from_triangles( const GLfloat* vertices, int vertex_count );
+// A UV sphere around the origin with rings + 1 rows of segments + 1 vertices, the last column
+// repeating the first with U at 1 so the texture wraps.
+Mesh mesh_create_sphere( GLfloat radius, int rings, int segments );
+
+// Appends coarser levels to a mesh that has only its full level so far, each simplified from the one before
+// by collapsing the edges with the smallest quadric error (Garland and Heckbert) until about ratio of its
+// triangles are left. Vertices are never moved, only merged, so every level uses the original vertex buffer.
+// Stops early at max_lods levels or when a level can't be simplified any further.
+void mesh_build_lods( Mesh& mesh, int max_lods, GLfloat ratio );
+
+// Reorders each level's triangles for the post-transform vertex cache (Tipsify, Sander et al.) and then the
+// vertices in the order the triangles first use them, so vertex fetches walk the buffer front to back.
+void mesh_optimize( Mesh& mesh );
+
+// A mesh's vertices and indices as they go into its buffers.
+struct MeshPacked {
+    MeshVertexFormat     format;
+    GLfloat              dequantize[4 * 4];
+    GLenum               index_type;
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+
+    MeshPacked();
+};
+
+// Lays a mesh's vertices out in the given layout and its indices out as 16-bit whenever every vertex can be
+// addressed. Skinned meshes append their bone indices and weights to each vertex, four bytes each.
+void mesh_pack( const Mesh& mesh, MeshVertexFormat format, MeshPacked& packed );
+// Creates the vertex array, vertex buffer and index buffer of a mesh and uploads vertices already in the
+// layout of mesh.format and indices of mesh.index_type as they are, e.g. straight from a scene file.
+bool mesh_upload_packed( UserContext& user_context, Mesh& mesh, const void* vertices, size_t vertex_bytes, const void* indices, size_t index_bytes );
+// Packs a mesh in the given layout and uploads it, reporting how much memory that takes compared to 32-bit
+// floats and indices.
+bool mesh_upload( UserContext& user_context, Mesh& mesh, MeshVertexFormat format );
+void mesh_release( GLState& gl, Mesh& mesh );
+
+struct LodStats {
+    unsigned long frames;
+    unsigned long triangles_full;  // Triangles the drawn meshes have at their full level.
+    unsigned long triangles_drawn; // Triangles at the levels actually chosen.
+    unsigned long switches;
+    size_t        last_triangles_full;
+    size_t        last_triangles_drawn;
+
+    LodStats();
+};
+
+// Picks each node's level of detail from the size of the level's error on screen, keeping the
+// coarsest level whose error stays below a threshold in pixels. A node only moves to a coarser level
+// once that level is well below the threshold, so it doesn't flicker between two levels near the boundary.
+class LodSelector {
+public:
+    // Fraction of the threshold a coarser level's error has to be under before the node switches to it.
+    static const GLfloat HYSTERESIS;
+
+    LodSelector();
+
+    void    set_enabled( bool enabled );
+    bool    enabled() const;
+    void    set_threshold( GLfloat pixels );
+    GLfloat threshold() const;
+
+    void begin_frame();
+    // pixels_per_unit is how many pixels a unit at distance one covers, i.e. the projection's
+    // vertical scale times half the viewport height. The levels' errors are in model units, so they are
+    // scaled by the largest axis scale of the node's world matrix first.
+    int  select( const Scene& scene, int node, const Mesh& mesh, GLfloat distance, GLfloat pixels_per_unit );
+    void end_frame();
+
+    const LodStats& stats() const;
+
+private:
+    std::vector<int8_t> current_; // Per scene node.
+    LodStats            stats_;
+    GLfloat             threshold_;
+    bool                enabled_;
+};
+
+// Distance from the point to the sphere around the node's world bounds, at least near.
+GLfloat lod_distance( const Scene& scene, int node, const GLfloat* point, GLfloat near );
+
+void print_lod_stats( const LodSelector& selector, const std::vector<Mesh>& meshes );
+
+#endif // WASMVR_MESH_H
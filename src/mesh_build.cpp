@@ -0,0 +1,725 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <queue>
+#include <string.h>
+#include <unordered_map>
+
+#include "util.h"
+
+namespace {
+    // Levels with fewer triangles than this aren't worth a draw call of their own.
+    const uint32_t MIN_LOD_INDICES = 3 * 16;
+    // Boundary edges are held in place much more strongly than interior ones, so open meshes keep their outline.
+    const double BOUNDARY_WEIGHT = 100.0;
+
+    // util.cpp's identity4, repeated so this file builds natively without it, see src_tool/mesh_lod.cpp.
+    const GLfloat IDENTITY[4 * 4] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f};
+
+    // Symmetric 4x4 matrix of the sum of squared distances to a set of planes, upper triangle row by row.
+    struct Quadric {
+        double q[10];
+
+        Quadric() {
+            std::fill( q, q + 10, 0.0 );
+        }
+
+        void add_plane( double a, double b, double c, double d, double weight ) {
+            q[0] += weight * a * a;
+            q[1] += weight * a * b;
+            q[2] += weight * a * c;
+            q[3] += weight * a * d;
+            q[4] += weight * b * b;
+            q[5] += weight * b * c;
+            q[6] += weight * b * d;
+            q[7] += weight * c * c;
+            q[8] += weight * c * d;
+            q[9] += weight * d * d;
+        }
+
+        void add( const Quadric& other ) {
+            for( int i = 0; i < 10; ++i ) {
+                q[i] += other.q[i];
+            }
+        }
+
+        double error( const GLfloat* p ) const {
+            const double x = p[0];
+            const double y = p[1];
+            const double z = p[2];
+            return x * x * q[0] + 2 * x * y * q[1] + 2 * x * z * q[2] + 2 * x * q[3] +
+                   y * y * q[4] + 2 * y * z * q[5] + 2 * y * q[6] +
+                   z * z * q[7] + 2 * z * q[8] +
+                   q[9];
+        }
+    };
+
+    struct Collapse {
+        double   cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t from_version;
+        uint32_t to_version;
+
+        // Orders the priority queue cheapest first.
+        bool operator<( const Collapse& other ) const {
+            return cost > other.cost;
+        }
+    };
+
+    void triangle_normal( const GLfloat* a, const GLfloat* b, const GLfloat* c, double* n ) {
+        const double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const double v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        n[0]              = u[1] * v[2] - u[2] * v[1];
+        n[1]              = u[2] * v[0] - u[0] * v[2];
+        n[2]              = u[0] * v[1] - u[1] * v[0];
+    }
+
+    uint64_t edge_key( uint32_t a, uint32_t b ) {
+        return ( static_cast<uint64_t>( std::min( a, b ) ) << 32 ) | std::max( a, b );
+    }
+
+    // Simplifies a triangle list by edge collapses until at most target_index_count indices are left
+    // or nothing more can collapse without flipping a triangle. Returns the largest error of any collapse.
+    GLfloat simplify( const std::vector<GLfloat>& positions,
+                      const uint32_t*             indices,
+                      size_t                      index_count,
+                      size_t                      target_index_count,
+                      std::vector<uint32_t>&      simplified ) {
+        const size_t          vertex_count = positions.size() / 3;
+        const size_t          triangles    = index_count / 3;
+        std::vector<uint32_t> tris( indices, indices + 3 * triangles );
+        const GLfloat*        p = positions.data();
+
+        std::vector<Quadric>               quadrics( vertex_count );
+        std::vector<std::vector<uint32_t>> vertex_tris( vertex_count );
+        std::unordered_map<uint64_t, int>  edge_uses;
+        for( size_t t = 0; t < triangles; ++t ) {
+            const uint32_t* v = &tris[3 * t];
+            double          n[3];
+            triangle_normal( p + 3 * v[0], p + 3 * v[1], p + 3 * v[2], n );
+            const double length = sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+            for( int k = 0; k < 3; ++k ) {
+                if( length > 0.0 ) {
+                    const GLfloat* a = p + 3 * v[0];
+                    quadrics[v[k]].add_plane( n[0] / length, n[1] / length, n[2] / length,
+                                              -( n[0] * a[0] + n[1] * a[1] + n[2] * a[2] ) / length, 1.0 );
+                }
+                vertex_tris[v[k]].push_back( static_cast<uint32_t>( t ) );
+                ++edge_uses[edge_key( v[k], v[( k + 1 ) % 3] )];
+            }
+        }
+
+        // A plane through each boundary edge, perpendicular to its triangle, keeps the boundary from shrinking.
+        for( size_t t = 0; t < triangles; ++t ) {
+            const uint32_t* v = &tris[3 * t];
+            double          n[3];
+            triangle_normal( p + 3 * v[0], p + 3 * v[1], p + 3 * v[2], n );
+            for( int k = 0; k < 3; ++k ) {
+                const uint32_t a = v[k];
+                const uint32_t b = v[( k + 1 ) % 3];
+                if( edge_uses[edge_key( a, b )] != 1 ) {
+                    continue;
+                }
+                const GLfloat* pa     = p + 3 * a;
+                const GLfloat* pb     = p + 3 * b;
+                const double   e[3]   = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+                double         m[3]   = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0]};
+                const double   length = sqrt( m[0] * m[0] + m[1] * m[1] + m[2] * m[2] );
+                if( length <= 0.0 ) {
+                    continue;
+                }
+                for( int i = 0; i < 3; ++i ) {
+                    m[i] /= length;
+                }
+                const double d = -( m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2] );
+                quadrics[a].add_plane( m[0], m[1], m[2], d, BOUNDARY_WEIGHT );
+                quadrics[b].add_plane( m[0], m[1], m[2], d, BOUNDARY_WEIGHT );
+            }
+        }
+
+        // Vertices that collapse are marked by pointing somewhere else, and any change around a vertex
+        // bumps its version so queued collapses computed before it are skipped.
+        std::vector<uint32_t>         remap( vertex_count );
+        std::vector<uint32_t>         versions( vertex_count, 0 );
+        std::vector<uint8_t>          alive( triangles, 1 );
+        std::priority_queue<Collapse> queue;
+        for( size_t i = 0; i < vertex_count; ++i ) {
+            remap[i] = static_cast<uint32_t>( i );
+        }
+
+        auto push_collapse = [&]( uint32_t a, uint32_t b ) {
+            Quadric sum = quadrics[a];
+            sum.add( quadrics[b] );
+            const double onto_a = sum.error( p + 3 * a );
+            const double onto_b = sum.error( p + 3 * b );
+            Collapse     collapse;
+            collapse.from         = ( onto_a <= onto_b ) ? b : a;
+            collapse.to           = ( onto_a <= onto_b ) ? a : b;
+            collapse.cost         = std::min( onto_a, onto_b );
+            collapse.from_version = versions[collapse.from];
+            collapse.to_version   = versions[collapse.to];
+            queue.push( collapse );
+        };
+        for( const auto& edge : edge_uses ) {
+            push_collapse( static_cast<uint32_t>( edge.first >> 32 ), static_cast<uint32_t>( edge.first & 0xffffffffu ) );
+        }
+
+        size_t                live      = triangles;
+        double                max_error = 0.0;
+        std::vector<uint32_t> neighbors;
+        while( ( 3 * live > target_index_count ) && !queue.empty() ) {
+            const Collapse collapse = queue.top();
+            queue.pop();
+            const uint32_t from = collapse.from;
+            const uint32_t to   = collapse.to;
+            if( ( remap[from] != from ) || ( remap[to] != to ) ||
+                ( versions[from] != collapse.from_version ) || ( versions[to] != collapse.to_version ) ) {
+                continue;
+            }
+
+            // Moving from onto to must not turn any of the triangles that survive inside out.
+            bool flips = false;
+            for( uint32_t t : vertex_tris[from] ) {
+                const uint32_t* v = &tris[3 * t];
+                if( !alive[t] || ( v[0] == to ) || ( v[1] == to ) || ( v[2] == to ) ) {
+                    continue;
+                }
+                const GLfloat* corners[3];
+                const GLfloat* moved[3];
+                for( int k = 0; k < 3; ++k ) {
+                    corners[k] = p + 3 * v[k];
+                    moved[k]   = p + 3 * ( ( v[k] == from ) ? to : v[k] );
+                }
+                double before[3];
+                double after[3];
+                triangle_normal( corners[0], corners[1], corners[2], before );
+                triangle_normal( moved[0], moved[1], moved[2], after );
+                if( before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0 ) {
+                    flips = true;
+                    break;
+                }
+            }
+            if( flips ) {
+                continue;
+            }
+
+            max_error   = std::max( max_error, collapse.cost );
+            remap[from] = to;
+            quadrics[to].add( quadrics[from] );
+            ++versions[from];
+            ++versions[to];
+            for( uint32_t t : vertex_tris[from] ) {
+                if( !alive[t] ) {
+                    continue;
+                }
+                uint32_t* v = &tris[3 * t];
+                for( int k = 0; k < 3; ++k ) {
+                    if( v[k] == from ) {
+                        v[k] = to;
+                    }
+                }
+                if( ( v[0] == v[1] ) || ( v[1] == v[2] ) || ( v[2] == v[0] ) ) {
+                    alive[t] = 0;
+                    --live;
+                } else {
+                    vertex_tris[to].push_back( t );
+                }
+            }
+
+            // Every edge around the merged vertex has a new cost.
+            neighbors.clear();
+            for( uint32_t t : vertex_tris[to] ) {
+                if( !alive[t] ) {
+                    continue;
+                }
+                for( int k = 0; k < 3; ++k ) {
+                    const uint32_t v = tris[3 * t + k];
+                    if( ( v != to ) && ( std::find( neighbors.begin(), neighbors.end(), v ) == neighbors.end() ) ) {
+                        neighbors.push_back( v );
+                    }
+                }
+            }
+            for( uint32_t v : neighbors ) {
+                push_collapse( to, v );
+            }
+        }
+
+        simplified.clear();
+        for( size_t t = 0; t < triangles; ++t ) {
+            if( alive[t] ) {
+                simplified.insert( simplified.end(), &tris[3 * t], &tris[3 * t] + 3 );
+            }
+        }
+        return static_cast<GLfloat>( sqrt( std::max( max_error, 0.0 ) ) );
+    }
+
+    const MeshVertexLayout VERTEX_LAYOUTS[MESH_VERTEX_FORMATS] = {
+        {32, GL_FLOAT, 3, GL_FLOAT, 12, GL_FLOAT, 24, GL_FALSE},
+        // Positions leave two bytes of padding so the normals start 4 byte aligned.
+        {16, GL_SHORT, 2, GL_SHORT, 8, GL_HALF_FLOAT, 12, GL_TRUE},
+        {12, GL_SHORT, 2, GL_BYTE, 6, GL_HALF_FLOAT, 8, GL_TRUE},
+    };
+
+    const int VERTEX_CACHE_SIZE = 16;
+
+    // Moves the vertices' components of an attribute to where remap says, dropping vertices mapped nowhere.
+    template <typename T>
+    void reorder_attribute( std::vector<T>& attribute, size_t components, const std::vector<uint32_t>& remap, uint32_t used ) {
+        const size_t vertex_count = remap.size();
+        if( attribute.size() != components * vertex_count ) {
+            return;
+        }
+        std::vector<T> reordered( components * used );
+        for( size_t v = 0; v < vertex_count; ++v ) {
+            if( remap[v] != UINT32_MAX ) {
+                std::copy( &attribute[components * v], &attribute[components * v] + components, &reordered[components * remap[v]] );
+            }
+        }
+        attribute.swap( reordered );
+    }
+
+    uint16_t float_to_half( GLfloat value ) {
+        uint32_t bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        const uint16_t sign     = static_cast<uint16_t>( ( bits >> 16 ) & 0x8000u );
+        const int      exponent = static_cast<int>( ( bits >> 23 ) & 0xff ) - 127 + 15;
+        const uint32_t mantissa = bits & 0x7fffffu;
+        if( exponent <= 0 ) {
+            return sign; // Too small for a normal half, flushed to zero.
+        }
+        if( exponent >= 31 ) {
+            return static_cast<uint16_t>( sign | 0x7c00u ); // Infinity, NaNs don't occur in UVs.
+        }
+        // Round to nearest, a carry out of the mantissa correctly bumps the exponent.
+        return static_cast<uint16_t>( sign + ( ( ( exponent << 10 ) | ( mantissa >> 13 ) ) + ( ( mantissa >> 12 ) & 1 ) ) );
+    }
+
+    // Maps a unit vector onto the octahedron |x| + |y| + |z| = 1 and unfolds its lower half over the
+    // corners of the square, giving two coordinates in [-1, 1] (Cigolle et al.).
+    void octahedral_encode( const GLfloat* n, GLfloat* e ) {
+        const GLfloat length = fabsf( n[0] ) + fabsf( n[1] ) + fabsf( n[2] );
+        const GLfloat x      = ( length > 0.0f ) ? n[0] / length : 0.0f;
+        const GLfloat y      = ( length > 0.0f ) ? n[1] / length : 0.0f;
+        if( n[2] >= 0.0f ) {
+            e[0] = x;
+            e[1] = y;
+        } else {
+            e[0] = ( 1.0f - fabsf( y ) ) * ( ( x >= 0.0f ) ? 1.0f : -1.0f );
+            e[1] = ( 1.0f - fabsf( x ) ) * ( ( y >= 0.0f ) ? 1.0f : -1.0f );
+        }
+    }
+
+    template <typename T>
+    T snorm( GLfloat value ) {
+        const GLfloat scale = static_cast<GLfloat>( std::numeric_limits<T>::max() );
+        return static_cast<T>( lrintf( std::max( -1.0f, std::min( 1.0f, value ) ) * scale ) );
+    }
+
+    // Average cache misses per triangle for a FIFO post-transform cache, 0.5 at best and 3 at worst.
+    GLfloat vertex_cache_acmr( const uint32_t* indices, size_t index_count, size_t vertex_count ) {
+        if( index_count < 3 ) {
+            return 0.0f;
+        }
+        std::vector<size_t> inserted( vertex_count, 0 ); // Miss count when each vertex entered the cache, plus one.
+        size_t              misses = 0;
+        for( size_t i = 0; i < index_count; ++i ) {
+            const uint32_t v = indices[i];
+            if( !inserted[v] || ( misses + 1 - inserted[v] >= static_cast<size_t>( VERTEX_CACHE_SIZE ) ) ) {
+                ++misses;
+                inserted[v] = misses;
+            }
+        }
+        return static_cast<GLfloat>( misses ) / ( index_count / 3 );
+    }
+
+    // Tipsify: fans out around one vertex at a time, moving on to the neighbor that is still in the
+    // cache and has the fewest triangles left, or back to an earlier vertex when it hits a dead end.
+    void vertex_cache_optimize( uint32_t* indices, size_t index_count, size_t vertex_count ) {
+        const size_t triangles = index_count / 3;
+
+        std::vector<uint32_t> live( vertex_count, 0 );
+        for( size_t i = 0; i < 3 * triangles; ++i ) {
+            ++live[indices[i]];
+        }
+        std::vector<uint32_t> first( vertex_count + 1, 0 );
+        for( size_t v = 0; v < vertex_count; ++v ) {
+            first[v + 1] = first[v] + live[v];
+        }
+        std::vector<uint32_t> adjacency( 3 * triangles );
+        std::vector<uint32_t> fill( first.begin(), first.end() - 1 );
+        for( size_t i = 0; i < 3 * triangles; ++i ) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>( i / 3 );
+        }
+
+        std::vector<int>      cache_time( vertex_count, 0 );
+        std::vector<uint8_t>  emitted( triangles, 0 );
+        std::vector<uint32_t> dead_end;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> output;
+        output.reserve( 3 * triangles );
+        int    time   = VERTEX_CACHE_SIZE + 1;
+        size_t cursor = 0;
+        long   fan    = triangles ? static_cast<long>( indices[0] ) : -1;
+        while( fan >= 0 ) {
+            candidates.clear();
+            for( uint32_t a = first[fan]; a < first[fan + 1]; ++a ) {
+                const uint32_t t = adjacency[a];
+                if( emitted[t] ) {
+                    continue;
+                }
+                emitted[t] = 1;
+                for( int k = 0; k < 3; ++k ) {
+                    const uint32_t v = indices[3 * t + k];
+                    output.push_back( v );
+                    dead_end.push_back( v );
+                    candidates.push_back( v );
+                    --live[v];
+                    if( time - cache_time[v] > VERTEX_CACHE_SIZE ) {
+                        cache_time[v] = time++;
+                    }
+                }
+            }
+
+            // The candidate that stays in the cache while its remaining triangles are emitted,
+            // and has been in it the longest.
+            fan               = -1;
+            int best_priority = -1;
+            for( uint32_t v : candidates ) {
+                if( !live[v] ) {
+                    continue;
+                }
+                const int age      = time - cache_time[v];
+                const int priority = ( age + 2 * static_cast<int>( live[v] ) <= VERTEX_CACHE_SIZE ) ? age : 0;
+                if( priority > best_priority ) {
+                    best_priority = priority;
+                    fan           = v;
+                }
+            }
+            while( ( fan < 0 ) && !dead_end.empty() ) {
+                const uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                if( live[v] ) {
+                    fan = v;
+                }
+            }
+            while( ( fan < 0 ) && ( cursor < vertex_count ) ) {
+                if( live[cursor] ) {
+                    fan = static_cast<long>( cursor );
+                }
+                ++cursor;
+            }
+        }
+        std::copy( output.begin(), output.end(), indices );
+    }
+
+    void mesh_fit_bounds( Mesh& mesh ) {
+        for( int i = 0; i < 3; ++i ) {
+            mesh.bounds[i]     = mesh.positions.empty() ? 0.0f : 1e30f;
+            mesh.bounds[3 + i] = mesh.positions.empty() ? 0.0f : -1e30f;
+        }
+        for( size_t v = 0; v < mesh.positions.size(); v += 3 ) {
+            for( int i = 0; i < 3; ++i ) {
+                mesh.bounds[i]     = std::min( mesh.bounds[i], mesh.positions[v + i] );
+                mesh.bounds[3 + i] = std::max( mesh.bounds[3 + i], mesh.positions[v + i] );
+            }
+        }
+    }
+
+    // Planar UVs over the bounds in x and y.
+    void mesh_planar_uvs( Mesh& mesh ) {
+        const GLfloat width  = std::max( mesh.bounds[3] - mesh.bounds[0], 1e-6f );
+        const GLfloat height = std::max( mesh.bounds[4] - mesh.bounds[1], 1e-6f );
+        mesh.uvs.clear();
+        for( size_t v = 0; v < mesh.positions.size(); v += 3 ) {
+            mesh.uvs.push_back( ( mesh.positions[v + 0] - mesh.bounds[0] ) / width );
+            mesh.uvs.push_back( ( mesh.positions[v + 1] - mesh.bounds[1] ) / height );
+        }
+    }
+
+    void mesh_single_lod( Mesh& mesh ) {
+        MeshLod lod;
+        lod.first_index = 0;
+        lod.index_count = static_cast<uint32_t>( mesh.indices.size() );
+        lod.error       = 0.0f;
+        mesh.lods.assign( 1, lod );
+    }
+}
+
+Mesh::Mesh()
+    : bounds{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f}
+    , format( MESH_VERTEX_FLOAT )
+    , index_type( GL_UNSIGNED_INT )
+    , vertex_array( 0 )
+    , vertex_buffer( 0 )
+    , index_buffer( 0 )
+    , residency( -1 ) {
+    memcpy( dequantize, IDENTITY, sizeof( dequantize ) );
+}
+
+bool Mesh::skinned() const {
+    return !bone_indices.empty();
+}
+
+size_t Mesh::triangles( int lod ) const {
+    return lods[lod].index_count / 3;
+}
+
+GLintptr Mesh::index_offset( int lod ) const {
+    return lods[lod].first_index * ( ( index_type == GL_UNSIGNED_SHORT ) ? sizeof( uint16_t ) : sizeof( uint32_t ) );
+}
+
+const char* mesh_vertex_format_name( MeshVertexFormat format ) {
+    switch( format ) {
+    case MESH_VERTEX_FLOAT: return "float";
+    case MESH_VERTEX_QUANTIZED: return "quantized";
+    case MESH_VERTEX_QUANTIZED_SMALL: return "quantized with 8-bit normals";
+    default: return "unknown";
+    }
+}
+
+GLsizei mesh_vertex_size( MeshVertexFormat format ) {
+    return VERTEX_LAYOUTS[format].stride;
+}
+
+const MeshVertexLayout& mesh_vertex_layout( MeshVertexFormat format ) {
+    return VERTEX_LAYOUTS[format];
+}
+
+Mesh mesh_from_triangles( const GLfloat* vertices, int vertex_count ) {
+    Mesh mesh;
+    mesh.positions.assign( vertices, vertices + 3 * vertex_count );
+    for( int i = 0; i < vertex_count; ++i ) {
+        mesh.indices.push_back( static_cast<uint32_t>( i ) );
+    }
+    for( int t = 0; t + 3 <= vertex_count; t += 3 ) {
+        double normal[3];
+        triangle_normal( vertices + 3 * t, vertices + 3 * ( t + 1 ), vertices + 3 * ( t + 2 ), normal );
+        const double length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+        for( int k = 0; k < 3; ++k ) {
+            for( int i = 0; i < 3; ++i ) {
+                mesh.normals.push_back( ( length > 0.0 ) ? static_cast<GLfloat>( normal[i] / length ) : ( ( i == 2 ) ? 1.0f : 0.0f ) );
+            }
+        }
+    }
+    mesh_fit_bounds( mesh );
+    mesh_planar_uvs( mesh );
+    mesh_single_lod( mesh );
+    return mesh;
+}
+
+Mesh mesh_create_sphere( GLfloat radius, int rings, int segments ) {
+    Mesh mesh;
+    rings    = std::max( rings, 2 );
+    segments = std::max( segments, 3 );
+
+    for( int r = 0; r <= rings; ++r ) {
+        const double theta = M_PI * r / rings;
+        for( int s = 0; s <= segments; ++s ) {
+            const double  phi       = 2.0 * M_PI * s / segments;
+            const GLfloat normal[3] = {
+                static_cast<GLfloat>( sin( theta ) * cos( phi ) ),
+                static_cast<GLfloat>( cos( theta ) ),
+                static_cast<GLfloat>( -sin( theta ) * sin( phi ) )};
+            for( int i = 0; i < 3; ++i ) {
+                mesh.positions.push_back( radius * normal[i] );
+                mesh.normals.push_back( normal[i] );
+            }
+            mesh.uvs.push_back( static_cast<GLfloat>( s ) / segments );
+            mesh.uvs.push_back( static_cast<GLfloat>( r ) / rings );
+        }
+    }
+
+    // Counter clockwise seen from outside, leaving out the triangles that would be degenerate at the poles.
+    auto vertex = [&]( int r, int s ) {
+        return static_cast<uint32_t>( r * ( segments + 1 ) + s );
+    };
+    for( int r = 0; r < rings; ++r ) {
+        for( int s = 0; s < segments; ++s ) {
+            if( r > 0 ) {
+                mesh.indices.insert( mesh.indices.end(), {vertex( r, s ), vertex( r + 1, s + 1 ), vertex( r, s + 1 )} );
+            }
+            if( r < rings - 1 ) {
+                mesh.indices.insert( mesh.indices.end(), {vertex( r, s ), vertex( r + 1, s ), vertex( r + 1, s + 1 )} );
+            }
+        }
+    }
+
+    mesh_fit_bounds( mesh );
+    mesh_single_lod( mesh );
+    return mesh;
+}
+
+void mesh_build_lods( Mesh& mesh, int max_lods, GLfloat ratio ) {
+    if( mesh.lods.empty() ) {
+        mesh_single_lod( mesh );
+    }
+
+    std::vector<uint32_t> simplified;
+    while( static_cast<int>( mesh.lods.size() ) < max_lods ) {
+        const MeshLod  previous = mesh.lods.back();
+        const uint32_t target   = 3 * static_cast<uint32_t>( ratio * previous.index_count / 3 );
+        if( target < MIN_LOD_INDICES ) {
+            break;
+        }
+
+        const GLfloat error = simplify( mesh.positions, &mesh.indices[previous.first_index], previous.index_count, target, simplified );
+        // Nothing left to collapse, e.g. every remaining edge would flip a triangle.
+        if( simplified.size() * 10 > previous.index_count * 9 ) {
+            break;
+        }
+
+        MeshLod lod;
+        lod.first_index = static_cast<uint32_t>( mesh.indices.size() );
+        lod.index_count = static_cast<uint32_t>( simplified.size() );
+        // Each level is simplified from the one before, so errors only add up.
+        lod.error = previous.error + error;
+        mesh.indices.insert( mesh.indices.end(), simplified.begin(), simplified.end() );
+        mesh.lods.push_back( lod );
+    }
+}
+
+void mesh_optimize( Mesh& mesh ) {
+    const size_t vertex_count = mesh.positions.size() / 3;
+    GLfloat      acmr_before  = 0.0f;
+    GLfloat      acmr_after   = 0.0f;
+    for( size_t l = 0; l < mesh.lods.size(); ++l ) {
+        uint32_t* indices = &mesh.indices[mesh.lods[l].first_index];
+        if( l == 0 ) {
+            acmr_before = vertex_cache_acmr( indices, mesh.lods[l].index_count, vertex_count );
+        }
+        vertex_cache_optimize( indices, mesh.lods[l].index_count, vertex_count );
+        if( l == 0 ) {
+            acmr_after = vertex_cache_acmr( indices, mesh.lods[l].index_count, vertex_count );
+        }
+    }
+
+    // The full level uses every vertex the coarser ones do, so its order decides the buffer's.
+    // Vertices no level uses are dropped.
+    std::vector<uint32_t> remap( vertex_count, UINT32_MAX );
+    uint32_t              used = 0;
+    for( uint32_t& index : mesh.indices ) {
+        if( remap[index] == UINT32_MAX ) {
+            remap[index] = used++;
+        }
+        index = remap[index];
+    }
+    reorder_attribute( mesh.positions, 3, remap, used );
+    reorder_attribute( mesh.normals, 3, remap, used );
+    reorder_attribute( mesh.uvs, 2, remap, used );
+    reorder_attribute( mesh.bone_indices, 4, remap, used );
+    reorder_attribute( mesh.bone_weights, 4, remap, used );
+
+    STDOUT( "Mesh optimized: %lu vertices kept of %lu, vertex cache misses per triangle %.3f before and %.3f after.",
+            static_cast<unsigned long>( used ),
+            static_cast<unsigned long>( vertex_count ),
+            acmr_before,
+            acmr_after );
+}
+
+MeshPacked::MeshPacked()
+    : format( MESH_VERTEX_FLOAT )
+    , index_type( GL_UNSIGNED_INT ) {
+    memcpy( dequantize, IDENTITY, sizeof( dequantize ) );
+}
+
+void mesh_pack( const Mesh& mesh, MeshVertexFormat format, MeshPacked& packed ) {
+    const MeshVertexLayout& layout       = VERTEX_LAYOUTS[format];
+    const size_t            vertex_count = mesh.positions.size() / 3;
+    const bool              has_normals  = mesh.normals.size() == 3 * vertex_count;
+    const bool              has_uvs      = mesh.uvs.size() == 2 * vertex_count;
+    const bool              skinned      = mesh.skinned();
+    const GLsizei           skin_offset  = layout.stride;
+    const GLsizei           stride       = layout.stride + ( skinned ? 8 : 0 );
+
+    // Quantized positions are relative to the center of the bounds, scaled by their largest half extent.
+    // The scale is uniform so normals only need renormalizing after the model matrix.
+    packed.format = format;
+    memcpy( packed.dequantize, IDENTITY, sizeof( packed.dequantize ) );
+    GLfloat center[3];
+    GLfloat scale = 0.0f;
+    for( int i = 0; i < 3; ++i ) {
+        center[i] = 0.5f * ( mesh.bounds[i] + mesh.bounds[3 + i] );
+        scale     = std::max( scale, 0.5f * ( mesh.bounds[3 + i] - mesh.bounds[i] ) );
+    }
+    if( scale <= 0.0f ) {
+        scale = 1.0f;
+    }
+    if( format != MESH_VERTEX_FLOAT ) {
+        for( int i = 0; i < 3; ++i ) {
+            packed.dequantize[5 * i]     = scale;
+            packed.dequantize[4 * i + 3] = center[i];
+        }
+    }
+
+    std::vector<uint8_t>& vertices = packed.vertices;
+    vertices.assign( stride * vertex_count, 0 );
+    for( size_t v = 0; v < vertex_count; ++v ) {
+        uint8_t* out = &vertices[stride * v];
+        if( skinned ) {
+            // Weights as bytes that still add up to one, the rounding error going to the largest.
+            const GLfloat* weights = &mesh.bone_weights[4 * v];
+            uint8_t        bytes[4];
+            int            sum     = 0;
+            int            largest = 0;
+            for( int i = 0; i < 4; ++i ) {
+                bytes[i] = static_cast<uint8_t>( std::min( std::max( weights[i], 0.0f ), 1.0f ) * 255.0f + 0.5f );
+                sum += bytes[i];
+                largest = ( weights[i] > weights[largest] ) ? i : largest;
+            }
+            bytes[largest] = static_cast<uint8_t>( bytes[largest] + 255 - sum );
+            memcpy( out + skin_offset, &mesh.bone_indices[4 * v], 4 );
+            memcpy( out + skin_offset + 4, bytes, 4 );
+        }
+
+        const GLfloat* position = &mesh.positions[3 * v];
+        const GLfloat  up[3]    = {0.0f, 0.0f, 1.0f};
+        const GLfloat* normal   = has_normals ? &mesh.normals[3 * v] : up;
+        const GLfloat  zero[2]  = {0.0f, 0.0f};
+        const GLfloat* uv       = has_uvs ? &mesh.uvs[2 * v] : zero;
+        if( format == MESH_VERTEX_FLOAT ) {
+            memcpy( out, position, 3 * sizeof( GLfloat ) );
+            memcpy( out + layout.normal_offset, normal, 3 * sizeof( GLfloat ) );
+            memcpy( out + layout.uv_offset, uv, 2 * sizeof( GLfloat ) );
+            continue;
+        }
+
+        int16_t quantized[3];
+        for( int i = 0; i < 3; ++i ) {
+            quantized[i] = snorm<int16_t>( ( position[i] - center[i] ) / scale );
+        }
+        memcpy( out, quantized, sizeof( quantized ) );
+
+        GLfloat octahedral[2];
+        octahedral_encode( normal, octahedral );
+        if( layout.normal_type == GL_BYTE ) {
+            const int8_t encoded[2] = {snorm<int8_t>( octahedral[0] ), snorm<int8_t>( octahedral[1] )};
+            memcpy( out + layout.normal_offset, encoded, sizeof( encoded ) );
+        } else {
+            const int16_t encoded[2] = {snorm<int16_t>( octahedral[0] ), snorm<int16_t>( octahedral[1] )};
+            memcpy( out + layout.normal_offset, encoded, sizeof( encoded ) );
+        }
+
+        const uint16_t halves[2] = {float_to_half( uv[0] ), float_to_half( uv[1] )};
+        memcpy( out + layout.uv_offset, halves, sizeof( halves ) );
+    }
+
+    // 16-bit indices whenever every vertex can be addressed.
+    packed.index_type = ( vertex_count <= 0x10000 ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if( packed.index_type == GL_UNSIGNED_SHORT ) {
+        packed.indices.resize( mesh.indices.size() * sizeof( uint16_t ) );
+        uint16_t* out = reinterpret_cast<uint16_t*>( packed.indices.data() );
+        for( size_t i = 0; i < mesh.indices.size(); ++i ) {
+            out[i] = static_cast<uint16_t>( mesh.indices[i] );
+        }
+    } else {
+        packed.indices.resize( mesh.indices.size() * sizeof( uint32_t ) );
+        memcpy( packed.indices.data(), mesh.indices.data(), packed.indices.size() );
+    }
+}
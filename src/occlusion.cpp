@@ -0,0 +1,359 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <math.h>
+#include <string.h>
+
+#include "camera.h"
+#include "scene.h"
+#include "simd.h"
+#include "util.h"
+
+namespace {
+    // Clip space w below this counts as crossing the near plane.
+    const GLfloat MIN_W = 1e-4f;
+
+    void transform_point( const GLfloat* column_major, const GLfloat* point, GLfloat* out ) {
+        for( int r = 0; r < 4; ++r ) {
+            out[r] = column_major[r] * point[0] +
+                     column_major[4 + r] * point[1] +
+                     column_major[8 + r] * point[2] +
+                     column_major[12 + r];
+        }
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer() {
+    memcpy( view_projection_, identity4, sizeof( view_projection_ ) );
+    for( int width = WIDTH, height = HEIGHT; ( width > 0 ) && ( height > 0 ); width /= 2, height /= 2 ) {
+        levels_.push_back( std::vector<GLfloat>( width * height, 1.0f ) );
+    }
+}
+
+void OcclusionBuffer::begin( const GLfloat* view_projection ) {
+    memcpy( view_projection_, view_projection, sizeof( view_projection_ ) );
+    std::fill( levels_[0].begin(), levels_[0].end(), 1.0f );
+}
+
+bool OcclusionBuffer::project( const GLfloat* world, GLfloat* window ) const {
+    GLfloat clip[4];
+    transform_point( view_projection_, world, clip );
+    if( clip[3] < MIN_W ) {
+        return false;
+    }
+    const GLfloat inverse_w = 1.0f / clip[3];
+    window[0]               = ( clip[0] * inverse_w * 0.5f + 0.5f ) * WIDTH;
+    window[1]               = ( clip[1] * inverse_w * 0.5f + 0.5f ) * HEIGHT;
+    window[2]               = clip[2] * inverse_w * 0.5f + 0.5f;
+    return true;
+}
+
+int OcclusionBuffer::rasterize( const GLfloat* vertices, int vertex_count, const GLfloat* model_matrix ) {
+    int rasterized = 0;
+    for( int i = 0; i + 2 < vertex_count; i += 3 ) {
+        GLfloat window[3][3];
+        bool    in_front = true;
+        for( int k = 0; k < 3; ++k ) {
+            // Model matrices are row major.
+            const GLfloat* v        = vertices + 3 * ( i + k );
+            GLfloat        world[3] = {0.0f, 0.0f, 0.0f};
+            for( int r = 0; r < 3; ++r ) {
+                world[r] = model_matrix[4 * r + 0] * v[0] +
+                           model_matrix[4 * r + 1] * v[1] +
+                           model_matrix[4 * r + 2] * v[2] +
+                           model_matrix[4 * r + 3];
+            }
+            in_front = in_front && project( world, window[k] );
+        }
+        if( in_front ) {
+            fill_triangle( window[0], window[1], window[2] );
+            ++rasterized;
+        }
+    }
+    return rasterized;
+}
+
+void OcclusionBuffer::fill_triangle( const GLfloat* a, const GLfloat* b, const GLfloat* c ) {
+    // Occluders are two sided, so wind every triangle the same way.
+    GLfloat area = ( b[0] - a[0] ) * ( c[1] - a[1] ) - ( b[1] - a[1] ) * ( c[0] - a[0] );
+    if( fabsf( area ) < 1e-6f ) {
+        return;
+    }
+    if( area < 0.0f ) {
+        std::swap( b, c );
+    }
+
+    const GLfloat depth = std::max( a[2], std::max( b[2], c[2] ) );
+    if( depth > 1.0f ) {
+        return;
+    }
+
+    const int x_min = std::max( 0, static_cast<int>( floorf( std::min( a[0], std::min( b[0], c[0] ) ) ) ) ) & ~3;
+    const int x_max = std::min( WIDTH - 1, static_cast<int>( ceilf( std::max( a[0], std::max( b[0], c[0] ) ) ) ) );
+    const int y_min = std::max( 0, static_cast<int>( floorf( std::min( a[1], std::min( b[1], c[1] ) ) ) ) );
+    const int y_max = std::min( HEIGHT - 1, static_cast<int>( ceilf( std::max( a[1], std::max( b[1], c[1] ) ) ) ) );
+    if( ( x_min > x_max ) || ( y_min > y_max ) ) {
+        return;
+    }
+
+    // Edge functions, each non-negative on the inner side of one edge, evaluated at pixel centers.
+    const GLfloat* from[3] = {a, b, c};
+    const GLfloat* to[3]   = {b, c, a};
+    float4         edge_dx[3];
+    GLfloat        edge_dy[3];
+    GLfloat        edge_0[3];
+    for( int e = 0; e < 3; ++e ) {
+        const GLfloat dx = to[e][0] - from[e][0];
+        const GLfloat dy = to[e][1] - from[e][1];
+        edge_dx[e]       = float4_splat( -dy );
+        edge_dy[e]       = dx;
+        edge_0[e]        = dy * from[e][0] - dx * from[e][1];
+    }
+
+    const float4 zero    = float4_splat( 0.0f );
+    const float4 depth4  = float4_splat( depth );
+    const float4 offsets = float4_make( 0.5f, 1.5f, 2.5f, 3.5f );
+    GLfloat*     pixels  = levels_[0].data();
+    for( int y = y_min; y <= y_max; ++y ) {
+        const GLfloat py = y + 0.5f;
+        float4        row[3];
+        for( int e = 0; e < 3; ++e ) {
+            row[e] = float4_splat( edge_0[e] + edge_dy[e] * py );
+        }
+        GLfloat* line = pixels + y * WIDTH;
+        for( int x = x_min; x <= x_max; x += 4 ) {
+            const float4 px     = float4_splat( static_cast<GLfloat>( x ) ) + offsets;
+            const int4   inside = ( ( row[0] + edge_dx[0] * px ) >= zero ) &
+                                ( ( row[1] + edge_dx[1] * px ) >= zero ) &
+                                ( ( row[2] + edge_dx[2] * px ) >= zero );
+            if( !int4_any( inside ) ) {
+                continue;
+            }
+            const float4 current = float4_load( line + x );
+            float4_store( line + x, float4_select( inside, float4_min( current, depth4 ), current ) );
+        }
+    }
+}
+
+void OcclusionBuffer::build_pyramid() {
+    int width  = WIDTH;
+    int height = HEIGHT;
+    for( size_t l = 1; l < levels_.size(); ++l ) {
+        const GLfloat* below = levels_[l - 1].data();
+        GLfloat*       above = levels_[l].data();
+        const int      w     = width / 2;
+        const int      h     = height / 2;
+        for( int y = 0; y < h; ++y ) {
+            const GLfloat* row0 = below + ( 2 * y ) * width;
+            const GLfloat* row1 = row0 + width;
+            for( int x = 0; x < w; ++x ) {
+                above[y * w + x] = std::max( std::max( row0[2 * x], row0[2 * x + 1] ), std::max( row1[2 * x], row1[2 * x + 1] ) );
+            }
+        }
+        width  = w;
+        height = h;
+    }
+}
+
+void OcclusionBuffer::screen_rect( const GLfloat* box, ScreenRect& rect ) const {
+    GLfloat min_x = 1e30f;
+    GLfloat min_y = 1e30f;
+    GLfloat max_x = -1e30f;
+    GLfloat max_y = -1e30f;
+    rect.nearest      = 1.0f;
+    rect.conservative = false;
+    for( int i = 0; i < 8; ++i ) {
+        const GLfloat corner[3] = {box[( i & 1 ) ? 3 : 0], box[( i & 2 ) ? 4 : 1], box[( i & 4 ) ? 5 : 2]};
+        GLfloat       window[3];
+        if( !project( corner, window ) ) {
+            rect.conservative = true;
+            return;
+        }
+        min_x        = std::min( min_x, window[0] );
+        min_y        = std::min( min_y, window[1] );
+        max_x        = std::max( max_x, window[0] );
+        max_y        = std::max( max_y, window[1] );
+        rect.nearest = std::min( rect.nearest, window[2] );
+    }
+
+    // Nothing is known about the parts of the box off screen.
+    if( ( min_x < 0.0f ) || ( min_y < 0.0f ) || ( max_x >= WIDTH ) || ( max_y >= HEIGHT ) || ( rect.nearest < 0.0f ) ) {
+        rect.conservative = true;
+        return;
+    }
+    rect.x0 = static_cast<int>( min_x );
+    rect.y0 = static_cast<int>( min_y );
+    rect.x1 = static_cast<int>( max_x );
+    rect.y1 = static_cast<int>( max_y );
+}
+
+bool OcclusionBuffer::box_visible( const GLfloat* box ) const {
+    ScreenRect rect;
+    screen_rect( box, rect );
+    if( rect.conservative ) {
+        return true;
+    }
+
+    int l = 0;
+    while( ( l + 1 < levels() ) && ( ( ( rect.x1 >> l ) - ( rect.x0 >> l ) > 1 ) || ( ( rect.y1 >> l ) - ( rect.y0 >> l ) > 1 ) ) ) {
+        ++l;
+    }
+    int            width  = 0;
+    int            height = 0;
+    const GLfloat* depths = level( l, width, height );
+    for( int y = rect.y0 >> l; y <= ( rect.y1 >> l ); ++y ) {
+        for( int x = rect.x0 >> l; x <= ( rect.x1 >> l ); ++x ) {
+            if( rect.nearest <= depths[y * width + x] ) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool OcclusionBuffer::box_visible_reference( const GLfloat* box ) const {
+    ScreenRect rect;
+    screen_rect( box, rect );
+    if( rect.conservative ) {
+        return true;
+    }
+
+    const GLfloat* depths = levels_[0].data();
+    for( int y = rect.y0; y <= rect.y1; ++y ) {
+        for( int x = rect.x0; x <= rect.x1; ++x ) {
+            if( rect.nearest <= depths[y * WIDTH + x] ) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int OcclusionBuffer::levels() const {
+    return static_cast<int>( levels_.size() );
+}
+
+const GLfloat* OcclusionBuffer::level( int index, int& width, int& height ) const {
+    width  = WIDTH >> index;
+    height = HEIGHT >> index;
+    return levels_[index].data();
+}
+
+OcclusionStats::OcclusionStats()
+    : frames( 0 )
+    , tested( 0 )
+    , rejected( 0 )
+    , eyes_rejected( 0 )
+    , triangles( 0 )
+    , mismatches( 0 ) {
+}
+
+OcclusionCuller::OcclusionCuller()
+    : enabled_( true )
+    , debug_( false ) {
+}
+
+void OcclusionCuller::add_occluder( int node, const GLfloat* vertices, int vertex_count ) {
+    Occluder occluder;
+    occluder.node         = node;
+    occluder.vertices     = vertices;
+    occluder.vertex_count = vertex_count;
+    occluders_.push_back( occluder );
+}
+
+void OcclusionCuller::clear_occluders() {
+    occluders_.clear();
+}
+
+void OcclusionCuller::set_enabled( bool enabled ) {
+    enabled_ = enabled;
+}
+
+bool OcclusionCuller::enabled() const {
+    return enabled_;
+}
+
+void OcclusionCuller::set_debug( bool debug ) {
+    debug_ = debug;
+}
+
+bool OcclusionCuller::debug() const {
+    return debug_;
+}
+
+void OcclusionCuller::cull( const Scene& scene, const CameraMatrices* eyes, const CullResult& input ) {
+    result_ = input;
+    if( !enabled_ || occluders_.empty() ) {
+        return;
+    }
+
+    const double begin_ms = emscripten_get_now();
+    for( int eye = 0; eye < 2; ++eye ) {
+        GLfloat view_projection[4 * 4];
+        gl_matrix4x4_multiply( view_projection, eyes[eye].projection, eyes[eye].view );
+        buffers_[eye].begin( view_projection );
+        for( const Occluder& occluder : occluders_ ) {
+            if( scene.visible( occluder.node ) ) {
+                stats_.triangles += buffers_[eye].rasterize( occluder.vertices, occluder.vertex_count, scene.world_matrix( occluder.node ) );
+            }
+        }
+        buffers_[eye].build_pyramid();
+    }
+
+    result_.nodes.clear();
+    result_.eyes.clear();
+    for( size_t i = 0; i < input.nodes.size(); ++i ) {
+        const GLfloat* box  = scene.world_bounds( input.nodes[i] );
+        uint8_t        mask = input.eyes[i];
+        for( int eye = 0; eye < 2; ++eye ) {
+            const uint8_t bit = static_cast<uint8_t>( 1 << eye );
+            if( !( mask & bit ) || buffers_[eye].box_visible( box ) ) {
+                continue;
+            }
+            if( debug_ && buffers_[eye].box_visible_reference( box ) ) {
+                ++stats_.mismatches;
+                STDERR( "Occlusion pyramid rejected node %d for eye %d that the reference sees.", input.nodes[i], eye );
+            }
+            mask &= ~bit;
+        }
+        if( mask ) {
+            stats_.eyes_rejected += ( mask != input.eyes[i] ) ? 1 : 0;
+            result_.nodes.push_back( input.nodes[i] );
+            result_.eyes.push_back( mask );
+        } else {
+            ++result_.culled;
+            ++stats_.rejected;
+        }
+    }
+
+    ++stats_.frames;
+    stats_.tested += input.nodes.size();
+    stats_.ms.add( emscripten_get_now() - begin_ms );
+}
+
+const CullResult& OcclusionCuller::result() const {
+    return result_;
+}
+
+const OcclusionStats& OcclusionCuller::stats() const {
+    return stats_;
+}
+
+const OcclusionBuffer& OcclusionCuller::buffer( int eye ) const {
+    return buffers_[eye];
+}
+
+void print_occlusion_stats( const OcclusionCuller& occlusion ) {
+    const OcclusionStats& stats  = occlusion.stats();
+    const double          frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "Occlusion culling %s: per frame %.1lf triangles, %.1lf of %.1lf objects rejected and %.1lf for one eye, mean %.3lf ms, max %.3lf ms, %lu mismatches.",
+            occlusion.enabled() ? "on" : "off",
+            stats.triangles / frames,
+            stats.rejected / frames,
+            stats.tested / frames,
+            stats.eyes_rejected / frames,
+            stats.ms.mean(),
+            stats.ms.max,
+            stats.mismatches );
+}
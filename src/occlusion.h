@@ -0,0 +1,110 @@
+#ifndef WASMVR_OCCLUSION_H
+#define WASMVR_OCCLUSION_H
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <vector>
+
+#include "bvh.h"
+#include "frame.h"
+
+class Scene;
+struct CameraMatrices;
+
+// A low resolution depth buffer rasterized on the CPU, with a hierarchical-Z pyramid on top
+// where every texel holds the farthest depth of the four below it.
+// Depths are window depths in [0, 1], larger is farther.
+class OcclusionBuffer {
+public:
+    static const int WIDTH  = 256; // Multiple of 4, the rasterizer fills 4 pixels at a time.
+    static const int HEIGHT = 128;
+
+    OcclusionBuffer();
+
+    // Clears to the far plane and sets the (column major) view projection used from now on.
+    void begin( const GLfloat* view_projection );
+    // Rasterizes a world space triangle list. Every triangle is written at the farthest depth of its
+    // vertices, so the buffer never claims something is nearer than it is.
+    // Triangles crossing the near plane are skipped, since leaving out an occluder is always safe.
+    // Returns the number of triangles rasterized.
+    int  rasterize( const GLfloat* vertices, int vertex_count, const GLfloat* model_matrix );
+    void build_pyramid();
+
+    // Whether any part of the box could be in front of the buffer, tested against the smallest pyramid level
+    // that covers its screen rectangle with at most 2x2 texels.
+    bool box_visible( const GLfloat* box ) const;
+    // Same answer from scanning every pixel of level 0, to check the pyramid against.
+    bool box_visible_reference( const GLfloat* box ) const;
+
+    int            levels() const;
+    const GLfloat* level( int index, int& width, int& height ) const;
+
+private:
+    struct ScreenRect {
+        int     x0, y0, x1, y1; // Inclusive pixels.
+        GLfloat nearest;
+        bool    conservative; // The box can't be tested, e.g. because it crosses the near plane.
+    };
+
+    bool project( const GLfloat* world, GLfloat* window ) const;
+    void screen_rect( const GLfloat* box, ScreenRect& rect ) const;
+    void fill_triangle( const GLfloat* a, const GLfloat* b, const GLfloat* c );
+
+    GLfloat                           view_projection_[4 * 4];
+    std::vector<std::vector<GLfloat>> levels_;
+};
+
+struct OcclusionStats {
+    unsigned long frames;
+    unsigned long tested;
+    unsigned long rejected;      // Objects hidden from both eyes.
+    unsigned long eyes_rejected; // Objects hidden from one eye that the other still sees.
+    unsigned long triangles;
+    unsigned long mismatches; // Eyes the pyramid rejected an object for that the reference says see it, in debug mode.
+    SampleStats   ms;
+
+    OcclusionStats();
+};
+
+// Rejects frustum culling survivors hidden behind a few registered occluders. The occluders are rasterized
+// once for each eye, since a buffer from anywhere else sees around their edges differently and could hide
+// what an eye sees. An object is dropped for each eye whose buffer hides it, and dropped altogether only
+// when hidden from both.
+class OcclusionCuller {
+public:
+    OcclusionCuller();
+
+    void add_occluder( int node, const GLfloat* vertices, int vertex_count );
+    void clear_occluders();
+
+    void set_enabled( bool enabled );
+    bool enabled() const;
+    // In debug mode every test is repeated against the brute force reference.
+    void set_debug( bool debug );
+    bool debug() const;
+
+    // eyes are the left and right cameras input was culled for.
+    void cull( const Scene& scene, const CameraMatrices* eyes, const CullResult& input );
+
+    const CullResult&      result() const;
+    const OcclusionStats&  stats() const;
+    const OcclusionBuffer& buffer( int eye ) const;
+
+private:
+    struct Occluder {
+        int            node;
+        const GLfloat* vertices;
+        int            vertex_count;
+    };
+
+    std::vector<Occluder> occluders_;
+    OcclusionBuffer       buffers_[2];
+    CullResult            result_;
+    OcclusionStats        stats_;
+    bool                  enabled_;
+    bool                  debug_;
+};
+
+void print_occlusion_stats( const OcclusionCuller& occlusion );
+
+#endif // WASMVR_OCCLUSION_H
@@ -0,0 +1,389 @@
+#include "particles.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <math.h>
+#include <string.h>
+
+#include "camera.h"
+#include "gl_command_buffer.h"
+#include "gles.h"
+#include "jobs.h"
+#include "residency.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    struct ParticleTypeDesc {
+        GLfloat life[2]; // Shortest and longest, in seconds.
+        GLfloat speed;   // At birth, along the emitter's direction.
+        GLfloat spread;  // Random speed added in every direction, relative to speed.
+        GLfloat gravity; // Downwards acceleration, negative to rise.
+        GLfloat drag;    // Fraction of velocity lost per second.
+        GLfloat size[2]; // Half the quad's width at birth and death.
+        GLubyte color[4];
+        size_t  capacity;
+    };
+
+    // clang-format off
+    const ParticleTypeDesc PARTICLE_TYPE_DESCS[PARTICLE_TYPES] = {
+        {{0.4f, 0.9f}, 2.5f, 0.4f, 9.81f, 0.8f, {0.008f, 0.002f}, {255, 190, 90, 255}, 16384},  // Spark.
+        {{4.0f, 6.0f}, 0.05f, 1.0f, -0.02f, 0.3f, {0.012f, 0.004f}, {90, 160, 255, 160}, 65536}, // Mote.
+    };
+    // clang-format on
+
+    // Lanes of particles past the end are moved too, so every array is a whole number of vectors long.
+    size_t round_to_vectors( size_t count ) {
+        return ( count + 3 ) & ~static_cast<size_t>( 3 );
+    }
+
+    uint32_t pack_color( const GLubyte* color ) {
+        GLubyte  bytes[4] = {color[0], color[1], color[2], color[3]};
+        uint32_t packed;
+        memcpy( &packed, bytes, sizeof( packed ) );
+        return packed;
+    }
+}
+
+ParticleStats::ParticleStats()
+    : frames( 0 )
+    , particles( 0 )
+    , spawned( 0 )
+    , update_ms( 0.0 )
+    , last_alive( 0 ) {
+}
+
+GLfloat* ParticleSystem::Pool::array( Array a ) {
+    return reinterpret_cast<GLfloat*>( arena.data() ) + a * capacity;
+}
+
+uint32_t* ParticleSystem::Pool::colors() {
+    return reinterpret_cast<uint32_t*>( array( ARRAY_COLOR ) );
+}
+
+ParticleSystem::ParticleSystem()
+    : random_( 12345 )
+    , last_ms_( -1.0 )
+    , program_( 0 )
+    , vec4_size_( -1 ) {
+    for( int type = 0; type < PARTICLE_TYPES; ++type ) {
+        pools_[type].capacity     = 0;
+        pools_[type].count        = 0;
+        pools_[type].buffer       = 0;
+        pools_[type].buffer_size  = 0;
+        pools_[type].vertex_array = 0;
+        set_capacity( static_cast<ParticleType>( type ), PARTICLE_TYPE_DESCS[type].capacity );
+    }
+}
+
+bool ParticleSystem::create( UserContext& user_context ) {
+    program_ = gles_load_program( "src_asset/particle.vert", "src_asset/particle.frag" );
+    if( !program_ || ( camera_block_bind( program_ ) == GL_INVALID_INDEX ) ) {
+        STDERR( "Failed to load particle program." );
+        return false;
+    }
+    vec4_size_ = glGetUniformLocation( program_, "vec4_size" );
+
+    // The arrays only change place when the capacity does, but are pointed at every frame like the
+    // scene's instances, so only which attributes are per instance is set up here.
+    GLState& gl = user_context.gl_state;
+    for( Pool& pool : pools_ ) {
+        glGenBuffers( 1, &pool.buffer );
+        glGenVertexArrays( 1, &pool.vertex_array );
+        user_context.frame_budget.count_buffer_allocations( 1 );
+        gl.bind_vertex_array( pool.vertex_array );
+        for( GLuint location = 0; location < ARRAYS_DRAWN; ++location ) {
+            gl.vertex_attrib_divisor( location, 1 );
+            gl.enable_vertex_attrib_array( location );
+        }
+    }
+    gl.bind_vertex_array( 0 );
+    return true;
+}
+
+void ParticleSystem::release( GLState& gl ) {
+    for( Pool& pool : pools_ ) {
+        gpu_memory_freed( GPU_MEMORY_BUFFER, pool.buffer );
+        gl.forget_buffer( pool.buffer );
+        gl.forget_vertex_array( pool.vertex_array );
+        glDeleteBuffers( 1, &pool.buffer );
+        glDeleteVertexArrays( 1, &pool.vertex_array );
+        pool.buffer       = 0;
+        pool.buffer_size  = 0;
+        pool.vertex_array = 0;
+    }
+    gl.forget_program( program_ );
+    glDeleteProgram( program_ );
+    program_ = 0;
+}
+
+void ParticleSystem::set_capacity( ParticleType type, size_t capacity ) {
+    Pool& pool    = pools_[type];
+    pool.capacity = round_to_vectors( capacity );
+    pool.count    = 0;
+    pool.arena.assign( ARRAYS * pool.capacity / 4, float4_splat( 0.0f ) );
+    pool.died.assign( ( pool.capacity + CHUNK - 1 ) / CHUNK, 0 );
+}
+
+size_t ParticleSystem::capacity( ParticleType type ) const {
+    return pools_[type].capacity;
+}
+
+size_t ParticleSystem::alive( ParticleType type ) const {
+    return pools_[type].count;
+}
+
+void ParticleSystem::clear_emitters() {
+    emitters_.clear();
+}
+
+int ParticleSystem::add_emitter( ParticleType type, GLfloat rate ) {
+    Emitter emitter;
+    emitter.type      = type;
+    emitter.rate      = rate;
+    emitter.intensity = 0.0f;
+    memcpy( emitter.matrix, identity4, sizeof( emitter.matrix ) );
+    memset( emitter.velocity, 0, sizeof( emitter.velocity ) );
+    emitter.owed = 0.0;
+    emitters_.push_back( emitter );
+    return static_cast<int>( emitters_.size() ) - 1;
+}
+
+void ParticleSystem::set_emitter( int emitter, const GLfloat* matrix, const GLfloat* velocity, GLfloat intensity ) {
+    Emitter& e = emitters_[emitter];
+    memcpy( e.matrix, matrix, sizeof( e.matrix ) );
+    if( velocity ) {
+        memcpy( e.velocity, velocity, sizeof( e.velocity ) );
+    } else {
+        memset( e.velocity, 0, sizeof( e.velocity ) );
+    }
+    e.intensity = intensity;
+}
+
+size_t ParticleSystem::emit( int emitter, size_t count ) {
+    return spawn( emitters_[emitter], count, true );
+}
+
+float ParticleSystem::random_unit() {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    return static_cast<float>( random_ >> 8 ) / static_cast<float>( 1 << 24 );
+}
+
+size_t ParticleSystem::spawn( const Emitter& emitter, size_t count, bool aged ) {
+    const ParticleTypeDesc& desc  = PARTICLE_TYPE_DESCS[emitter.type];
+    Pool&                   pool  = pools_[emitter.type];
+    const size_t            first = pool.count;
+    count                         = std::min( count, pool.capacity - first );
+    pool.count += count;
+
+    GLfloat*       x      = pool.array( ARRAY_X );
+    GLfloat*       y      = pool.array( ARRAY_Y );
+    GLfloat*       z      = pool.array( ARRAY_Z );
+    GLfloat*       age    = pool.array( ARRAY_AGE );
+    GLfloat*       life   = pool.array( ARRAY_LIFE );
+    GLfloat*       vx     = pool.array( ARRAY_VX );
+    GLfloat*       vy     = pool.array( ARRAY_VY );
+    GLfloat*       vz     = pool.array( ARRAY_VZ );
+    uint32_t*      colors = pool.colors();
+    const GLfloat* m      = emitter.matrix;
+    const bool     volume = emitter.type == PARTICLE_MOTE;
+    // Motes drift up in world space, sparks fly along the emitter's -z.
+    GLfloat direction[3] = {0.0f, 1.0f, 0.0f};
+    if( !volume ) {
+        for( int i = 0; i < 3; ++i ) {
+            direction[i] = -m[4 * i + 2];
+        }
+    }
+
+    for( size_t p = first; p < first + count; ++p ) {
+        GLfloat local[3] = {0.0f, 0.0f, 0.0f};
+        if( volume ) {
+            for( GLfloat& l : local ) {
+                l = 2.0f * random_unit() - 1.0f;
+            }
+        }
+        x[p] = m[0] * local[0] + m[1] * local[1] + m[2] * local[2] + m[3];
+        y[p] = m[4] * local[0] + m[5] * local[1] + m[6] * local[2] + m[7];
+        z[p] = m[8] * local[0] + m[9] * local[1] + m[10] * local[2] + m[11];
+
+        const GLfloat speed = desc.speed * ( 0.5f + 0.5f * random_unit() );
+        GLfloat       v[3];
+        for( int i = 0; i < 3; ++i ) {
+            v[i] = emitter.velocity[i] + speed * direction[i] + desc.speed * desc.spread * ( 2.0f * random_unit() - 1.0f );
+        }
+        vx[p]   = v[0];
+        vy[p]   = v[1];
+        vz[p]   = v[2];
+        life[p] = desc.life[0] + ( desc.life[1] - desc.life[0] ) * random_unit();
+        age[p]  = aged ? life[p] * random_unit() : 0.0f;
+
+        // Some variation in brightness, so overlapping particles don't blend into one flat colour.
+        const GLfloat shade    = 0.7f + 0.3f * random_unit();
+        const GLubyte color[4] = {static_cast<GLubyte>( desc.color[0] * shade ), static_cast<GLubyte>( desc.color[1] * shade ),
+                                  static_cast<GLubyte>( desc.color[2] * shade ), desc.color[3]};
+        colors[p] = pack_color( color );
+    }
+    stats_.spawned += count;
+    return count;
+}
+
+void ParticleSystem::move_chunk( Pool& pool, size_t chunk, GLfloat dt ) const {
+    const ParticleTypeDesc& desc  = PARTICLE_TYPE_DESCS[&pool - pools_];
+    const size_t            begin = chunk * CHUNK;
+    const size_t            end   = std::min( begin + CHUNK, round_to_vectors( pool.count ) );
+
+    GLfloat*     x       = pool.array( ARRAY_X );
+    GLfloat*     y       = pool.array( ARRAY_Y );
+    GLfloat*     z       = pool.array( ARRAY_Z );
+    GLfloat*     age     = pool.array( ARRAY_AGE );
+    const float* life    = pool.array( ARRAY_LIFE );
+    GLfloat*     vx      = pool.array( ARRAY_VX );
+    GLfloat*     vy      = pool.array( ARRAY_VY );
+    GLfloat*     vz      = pool.array( ARRAY_VZ );
+    const float4 step    = float4_splat( dt );
+    const float4 fall    = float4_splat( desc.gravity * dt );
+    const float4 damping = float4_splat( std::max( 1.0f - desc.drag * dt, 0.0f ) );
+    int4         died    = {0, 0, 0, 0};
+    for( size_t p = begin; p < end; p += 4 ) {
+        const float4 velocity_x = float4_load( vx + p ) * damping;
+        const float4 velocity_y = ( float4_load( vy + p ) - fall ) * damping;
+        const float4 velocity_z = float4_load( vz + p ) * damping;
+        const float4 aged       = float4_load( age + p ) + step;
+        float4_store( vx + p, velocity_x );
+        float4_store( vy + p, velocity_y );
+        float4_store( vz + p, velocity_z );
+        float4_store( x + p, float4_load( x + p ) + velocity_x * step );
+        float4_store( y + p, float4_load( y + p ) + velocity_y * step );
+        float4_store( z + p, float4_load( z + p ) + velocity_z * step );
+        float4_store( age + p, aged );
+        died |= aged >= float4_load( life + p );
+    }
+    // Lanes past the last particle may hold anything, the compaction only looks at the ones alive.
+    pool.died[chunk] = int4_any( died );
+}
+
+void ParticleSystem::compact( Pool& pool ) {
+    // The dead are replaced by the last particle alive, which may be dead too and is checked again.
+    GLfloat* arrays[ARRAYS];
+    for( int a = 0; a < ARRAYS; ++a ) {
+        arrays[a] = pool.array( static_cast<Array>( a ) );
+    }
+    const GLfloat* age  = arrays[ARRAY_AGE];
+    const GLfloat* life = arrays[ARRAY_LIFE];
+    for( size_t chunk = 0; ( chunk < pool.died.size() ) && ( chunk * CHUNK < pool.count ); ++chunk ) {
+        if( !pool.died[chunk] ) {
+            continue;
+        }
+        for( size_t p = chunk * CHUNK; p < std::min( ( chunk + 1 ) * CHUNK, pool.count ); ) {
+            if( age[p] < life[p] ) {
+                ++p;
+                continue;
+            }
+            const size_t last = --pool.count;
+            for( GLfloat* array : arrays ) {
+                array[p] = array[last];
+            }
+        }
+    }
+}
+
+void ParticleSystem::update( double now_ms ) {
+    const double begin_ms = emscripten_get_now();
+    const GLfloat dt      = ( last_ms_ < 0.0 ) ? 0.0f : static_cast<GLfloat>( std::min( ( now_ms - last_ms_ ) / 1000.0, 0.1 ) );
+    last_ms_              = now_ms;
+
+    for( Pool& pool : pools_ ) {
+        const size_t chunks = ( pool.count + CHUNK - 1 ) / CHUNK;
+        parallel_for( chunks, [&]( size_t chunk ) {
+            move_chunk( pool, chunk, dt );
+        } );
+        compact( pool );
+    }
+
+    for( Emitter& emitter : emitters_ ) {
+        emitter.owed += emitter.rate * emitter.intensity * dt;
+        const size_t count = static_cast<size_t>( emitter.owed );
+        emitter.owed -= count;
+        spawn( emitter, count, false );
+    }
+
+    size_t alive = 0;
+    for( const Pool& pool : pools_ ) {
+        alive += pool.count;
+    }
+    ++stats_.frames;
+    stats_.particles += alive;
+    stats_.last_alive = alive;
+    stats_.update_ms += emscripten_get_now() - begin_ms;
+}
+
+void ParticleSystem::upload( UserContext& user_context ) {
+    GLState& gl = user_context.gl_state;
+    for( Pool& pool : pools_ ) {
+        if( !pool.count || !pool.buffer ) {
+            continue;
+        }
+        // Each drawn array keeps its place in the arena, so it goes into the buffer with a single copy.
+        // Orphaning the old storage every frame keeps the GPU reading the last frame's from waiting.
+        const GLsizeiptr size = ARRAYS_DRAWN * pool.capacity * sizeof( GLfloat );
+        gl.bind_buffer( GL_ARRAY_BUFFER, pool.buffer );
+        glBufferData( GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW );
+        if( size != pool.buffer_size ) {
+            pool.buffer_size = size;
+            gpu_memory_allocated( GPU_MEMORY_BUFFER, pool.buffer, size );
+            user_context.frame_budget.count_buffer_allocations( 1 );
+        }
+        for( int a = 0; a < ARRAYS_DRAWN; ++a ) {
+            glBufferSubData( GL_ARRAY_BUFFER, a * pool.capacity * sizeof( GLfloat ), pool.count * sizeof( GLfloat ), pool.array( static_cast<Array>( a ) ) );
+        }
+        user_context.frame_budget.count_bytes_uploaded( ARRAYS_DRAWN * pool.count * sizeof( GLfloat ) );
+    }
+}
+
+void ParticleSystem::record( GLCommandBuffer& commands ) const {
+    bool started = false;
+    for( int type = 0; type < PARTICLE_TYPES; ++type ) {
+        const Pool& pool = pools_[type];
+        if( !pool.count || !pool.vertex_array ) {
+            continue;
+        }
+        if( !started ) {
+            started = true;
+            commands.use_program( program_ );
+            commands.depth_mask( GL_FALSE );
+            commands.enable( GL_BLEND );
+            commands.blend_func( GL_ONE, GL_ONE );
+        }
+        commands.bind_vertex_array( pool.vertex_array );
+        commands.bind_buffer( GL_ARRAY_BUFFER, pool.buffer );
+        for( int a = 0; a < ARRAY_COLOR; ++a ) {
+            commands.vertex_attrib_pointer( a, 1, GL_FLOAT, GL_FALSE, 0, a * pool.capacity * sizeof( GLfloat ) );
+        }
+        commands.vertex_attrib_pointer( ARRAY_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, ARRAY_COLOR * pool.capacity * sizeof( GLfloat ) );
+        const ParticleTypeDesc& desc = PARTICLE_TYPE_DESCS[type];
+        commands.uniform_4f( vec4_size_, desc.size[0], desc.size[1], 0.0f, 0.0f );
+        // A quad per particle as a strip of four vertices the shader places from gl_VertexID.
+        commands.draw_arrays_instanced( GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>( pool.count ) );
+    }
+    if( started ) {
+        commands.disable( GL_BLEND );
+        commands.depth_mask( GL_TRUE );
+    }
+}
+
+const ParticleStats& ParticleSystem::stats() const {
+    return stats_;
+}
+
+void print_particle_stats( const ParticleSystem& particles ) {
+    const ParticleStats& stats  = particles.stats();
+    const double         frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "Particles: %lu sparks and %lu motes alive, %.1lf particles and %.3lf ms updating per frame, %.0lf particles updated per ms.",
+            static_cast<unsigned long>( particles.alive( PARTICLE_SPARK ) ),
+            static_cast<unsigned long>( particles.alive( PARTICLE_MOTE ) ),
+            stats.particles / frames,
+            stats.update_ms / frames,
+            stats.update_ms > 0.0 ? stats.particles / stats.update_ms : 0.0 );
+}
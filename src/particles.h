@@ -0,0 +1,126 @@
+#ifndef WASMVR_PARTICLES_H
+#define WASMVR_PARTICLES_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "simd.h"
+
+class GLCommandBuffer;
+class GLState;
+class UserContext;
+
+enum ParticleType {
+    PARTICLE_SPARK, // Short lived and falling, thrown from a point.
+    PARTICLE_MOTE,  // Long lived and drifting up, filling a volume.
+    PARTICLE_TYPES,
+};
+
+struct ParticleStats {
+    unsigned long frames;
+    unsigned long particles; // Alive after each update, summed.
+    unsigned long spawned;
+    double        update_ms;
+    size_t        last_alive;
+
+    ParticleStats();
+};
+
+// Particles kept as structure of arrays, each type's in one arena, and moved four at a time.
+// Every type is drawn as camera facing quads with one instanced draw, whose instance attributes read the
+// arrays straight from a buffer they are copied to as they are, so one recording serves both eyes.
+class ParticleSystem {
+public:
+    // Particles are moved by jobs of this many.
+    static const size_t CHUNK = 4096;
+
+    ParticleSystem();
+
+    // Loads the particle program and creates each type's buffer and vertex array.
+    bool create( UserContext& user_context );
+    void release( GLState& gl );
+
+    // Most particles of the type alive at once, dropping those alive. Emitters stop emitting at this many.
+    void   set_capacity( ParticleType type, size_t capacity );
+    size_t capacity( ParticleType type ) const;
+    size_t alive( ParticleType type ) const;
+
+    void clear_emitters();
+    // Returns the new emitter, which emits nothing until set.
+    int add_emitter( ParticleType type, GLfloat rate );
+    // Places an emitter with a row major matrix. Sparks leave its origin along -z, motes fill the cube from
+    // -1 to 1 it maps to. Particles inherit velocity, and intensity scales the rate, 0 stopping the emitter.
+    void set_emitter( int emitter, const GLfloat* matrix, const GLfloat* velocity, GLfloat intensity );
+    // Spawns count particles from the emitter right away, at random points of their lives, so a field can
+    // start out full without them all dying together. Returns how many fit.
+    size_t emit( int emitter, size_t count );
+
+    // Ages, moves and emits particles for the time since the last update, at most a tenth of a second.
+    void update( double now_ms );
+    // Uploads the particles alive into each type's buffer.
+    void upload( UserContext& user_context );
+    // Records drawing them with additive blending over the depth tested scene, without writing depth.
+    void record( GLCommandBuffer& commands ) const;
+
+    const ParticleStats& stats() const;
+
+private:
+    // Arrays of each type's arena, the ones the shader reads first.
+    enum Array {
+        ARRAY_X,
+        ARRAY_Y,
+        ARRAY_Z,
+        ARRAY_AGE,
+        ARRAY_LIFE,
+        ARRAY_COLOR, // RGBA bytes.
+        ARRAY_VX,
+        ARRAY_VY,
+        ARRAY_VZ,
+        ARRAYS,
+        ARRAYS_DRAWN = ARRAY_VX,
+    };
+
+    struct Pool {
+        std::vector<float4>  arena;    // Every array, capacity rounded up to whole vectors apart.
+        size_t               capacity; // A multiple of four.
+        size_t               count;
+        std::vector<uint8_t> died; // Per chunk, whether the last update killed any.
+
+        GLuint     buffer;
+        GLsizeiptr buffer_size;
+        GLuint     vertex_array;
+
+        GLfloat*  array( Array a );
+        uint32_t* colors();
+    };
+
+    struct Emitter {
+        ParticleType type;
+        GLfloat      rate; // Per second at full intensity.
+        GLfloat      intensity;
+        GLfloat      matrix[4 * 4];
+        GLfloat      velocity[3];
+        double       owed; // Fraction of a particle carried over to the next update.
+    };
+
+    void   move_chunk( Pool& pool, size_t chunk, GLfloat dt ) const;
+    void   compact( Pool& pool );
+    float  random_unit();
+    size_t spawn( const Emitter& emitter, size_t count, bool aged );
+
+    Pool                 pools_[PARTICLE_TYPES];
+    std::vector<Emitter> emitters_;
+    uint32_t             random_;
+    double               last_ms_;
+
+    GLuint program_;
+    GLint  vec4_size_; // Size at birth and death.
+
+    ParticleStats stats_;
+};
+
+void print_particle_stats( const ParticleSystem& particles );
+
+#endif // WASMVR_PARTICLES_H
@@ -0,0 +1,469 @@
+#include "pointcloud.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <math.h>
+#include <queue>
+#include <stddef.h>
+#include <string.h>
+
+#include "camera.h"
+#include "frustum.h"
+#include "gl_command_buffer.h"
+#include "gles.h"
+#include "residency.h"
+#include "simd.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    // Fetches beyond these would only queue up behind each other in the browser.
+    const size_t MAX_REQUESTS = 4;
+    // Uploads of arrived nodes per frame stop past this many bytes, at least one node is always uploaded.
+    const size_t UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+    // Nodes whose points would be closer together than this many pixels add nothing a parent doesn't show.
+    const GLfloat MIN_SPACING_PIXELS = 1.0f;
+
+    const size_t DEFAULT_POINT_BUDGET  = 2000000;
+    const size_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+    struct Candidate {
+        GLfloat priority; // Size of the node's grid cells on screen, in pixels.
+        int     node;
+
+        bool operator<( const Candidate& other ) const {
+            return priority < other.priority;
+        }
+    };
+
+    // The node's cube in the scene, as the box around its placed center and extents.
+    void placed_box( const GLfloat* placement, const PointCloudNode& node, GLfloat* box ) {
+        for( int row = 0; row < 3; ++row ) {
+            const GLfloat* m      = placement + row * 4;
+            const GLfloat  center = m[0] * node.center[0] + m[1] * node.center[1] + m[2] * node.center[2] + m[3];
+            const GLfloat  extent = ( fabsf( m[0] ) + fabsf( m[1] ) + fabsf( m[2] ) ) * node.half_size;
+            box[row]              = center - extent;
+            box[3 + row]          = center + extent;
+        }
+    }
+
+    GLfloat distance_to_box( const GLfloat* point, const GLfloat* box ) {
+        GLfloat squared = 0.0f;
+        for( int i = 0; i < 3; ++i ) {
+            const GLfloat d = std::max( std::max( box[i] - point[i], point[i] - box[3 + i] ), 0.0f );
+            squared += d * d;
+        }
+        return sqrtf( squared );
+    }
+}
+
+PointCloudStats::PointCloudStats()
+    : frames( 0 )
+    , points( 0 )
+    , nodes( 0 )
+    , bytes_streamed( 0 )
+    , requests( 0 )
+    , evictions( 0 )
+    , failures( 0 ) {
+}
+
+PointCloud::PointCloud()
+    : index_request_( -1 )
+    , placement_scale_( 1.0f )
+    , point_budget_( DEFAULT_POINT_BUDGET )
+    , memory_budget_( DEFAULT_MEMORY_BUDGET )
+    , resident_bytes_( 0 )
+    , resident_nodes_( 0 )
+    , last_points_( 0 )
+    , pixels_per_unit_( 0.0f )
+    , program_( 0 )
+    , mat4_model_( -1 )
+    , vec4_point_( -1 ) {
+    memset( &header_, 0, sizeof( header_ ) );
+    memcpy( placement_, identity4, sizeof( placement_ ) );
+}
+
+bool PointCloud::create( UserContext& ) {
+    program_ = gles_load_program( "src_asset/pointcloud.vert", "src_asset/pointcloud.frag" );
+    if( !program_ || ( camera_block_bind( program_ ) == GL_INVALID_INDEX ) ) {
+        STDERR( "Failed to load point cloud program." );
+        return false;
+    }
+    mat4_model_ = glGetUniformLocation( program_, "mat4_model" );
+    vec4_point_ = glGetUniformLocation( program_, "vec4_point" );
+    return true;
+}
+
+void PointCloud::release( GLState& gl ) {
+    // Only resident nodes have buffers. Requests in flight and points that arrived are kept for the next upload.
+    for( size_t node = 0; node < nodes_.size(); ++node ) {
+        if( nodes_[node].state == NODE_RESIDENT ) {
+            evict( gl, static_cast<int>( node ) );
+        }
+    }
+    draws_.clear();
+    last_points_ = 0;
+    gl.forget_program( program_ );
+    glDeleteProgram( program_ );
+    program_ = 0;
+}
+
+void PointCloud::open( GLState& gl, const std::string& url ) {
+    close( gl );
+    url_ = url;
+    STDOUT( "Opening point cloud %s.", url_.c_str() );
+    const std::string index = url_ + "/index.bin";
+    index_request_          = emscripten_async_wget2_data( index.c_str(), "GET", nullptr, this, 1, on_index, on_error, nullptr );
+}
+
+void PointCloud::close( GLState& gl ) {
+    // Aborted fetches never call back, so nothing refers to this cloud's nodes afterwards.
+    if( index_request_ >= 0 ) {
+        emscripten_async_wget2_abort( index_request_ );
+        index_request_ = -1;
+    }
+    for( const Request& request : requests_ ) {
+        emscripten_async_wget2_abort( request.handle );
+    }
+    requests_.clear();
+    for( size_t node = 0; node < nodes_.size(); ++node ) {
+        evict( gl, static_cast<int>( node ) );
+    }
+    nodes_.clear();
+    draws_.clear();
+    url_.clear();
+    memset( &header_, 0, sizeof( header_ ) );
+    last_points_ = 0;
+}
+
+bool PointCloud::opened() const {
+    return !url_.empty();
+}
+
+void PointCloud::set_placement( const GLfloat* matrix ) {
+    memcpy( placement_, matrix, sizeof( placement_ ) );
+    // Point sizes assume a uniform scale, taken from the first column.
+    placement_scale_ = sqrtf( matrix[0] * matrix[0] + matrix[4] * matrix[4] + matrix[8] * matrix[8] );
+}
+
+void PointCloud::set_point_budget( size_t points ) {
+    point_budget_ = points;
+}
+
+void PointCloud::set_memory_budget( size_t bytes ) {
+    memory_budget_ = bytes;
+}
+
+void PointCloud::on_index( unsigned, void* arg, void* data, unsigned size ) {
+    PointCloud& cloud    = *static_cast<PointCloud*>( arg );
+    cloud.index_request_ = -1;
+
+    PointCloudHeader header;
+    if( size < sizeof( header ) ) {
+        STDERR( "Point cloud %s has no header.", cloud.url_.c_str() );
+        return;
+    }
+    memcpy( &header, data, sizeof( header ) );
+    // Divided rather than multiplied, a node count from the file could overflow a 32-bit size_t.
+    const size_t record_bytes = size - sizeof( header );
+    if( ( header.magic != POINT_CLOUD_MAGIC ) || ( header.version != POINT_CLOUD_VERSION ) || !header.grid ||
+        ( record_bytes % sizeof( PointCloudNode ) ) || ( header.nodes != record_bytes / sizeof( PointCloudNode ) ) ) {
+        STDERR( "Point cloud %s is not a version %u octree.", cloud.url_.c_str(), POINT_CLOUD_VERSION );
+        return;
+    }
+
+    // Children come after their parents, which keeps every index in range and the walk down from the root finite.
+    std::vector<Node> nodes( header.nodes );
+    const uint8_t*    records = static_cast<const uint8_t*>( data ) + sizeof( header );
+    for( uint32_t i = 0; i < header.nodes; ++i ) {
+        Node& node = nodes[i];
+        memcpy( &node.record, records + i * sizeof( PointCloudNode ), sizeof( PointCloudNode ) );
+        for( int32_t child : node.record.children ) {
+            if( ( child != -1 ) && ( ( child <= static_cast<int64_t>( i ) ) || ( static_cast<uint32_t>( child ) >= header.nodes ) ) ) {
+                STDERR( "Point cloud %s has node %u with child %d out of order.", cloud.url_.c_str(), i, child );
+                return;
+            }
+        }
+        node.state        = node.record.points ? NODE_ABSENT : NODE_FAILED;
+        node.last_used    = 0;
+        node.buffer       = 0;
+        node.vertex_array = 0;
+    }
+    cloud.header_ = header;
+    cloud.nodes_.swap( nodes );
+    STDOUT( "Point cloud %s has %llu points in %u nodes.",
+            cloud.url_.c_str(),
+            static_cast<unsigned long long>( header.points ),
+            header.nodes );
+}
+
+void PointCloud::on_node( unsigned handle, void* arg, void* data, unsigned size ) {
+    PointCloud& cloud = *static_cast<PointCloud*>( arg );
+    const int   index = cloud.take_request( handle );
+    if( index < 0 ) {
+        return;
+    }
+    Node& node = cloud.nodes_[index];
+    if( size != node.record.points * sizeof( PointCloudPoint ) ) {
+        STDERR( "Point cloud node %d has %u bytes, not %u points.", index, size, node.record.points );
+        node.state = NODE_FAILED;
+        ++cloud.stats_.failures;
+        return;
+    }
+    // The data is freed once this returns, and uploads wait for the next update, when there is a context.
+    const PointCloudPoint* points = static_cast<const PointCloudPoint*>( data );
+    node.points.assign( points, points + node.record.points );
+    node.state = NODE_ARRIVED;
+}
+
+void PointCloud::on_error( unsigned handle, void* arg, int status, const char* ) {
+    PointCloud& cloud = *static_cast<PointCloud*>( arg );
+    if( static_cast<int>( handle ) == cloud.index_request_ ) {
+        cloud.index_request_ = -1;
+        STDERR( "Failed to fetch point cloud %s, status %d.", cloud.url_.c_str(), status );
+        return;
+    }
+    const int index = cloud.take_request( handle );
+    if( index >= 0 ) {
+        STDERR( "Failed to fetch point cloud node %d, status %d.", index, status );
+        cloud.nodes_[index].state = NODE_FAILED;
+        ++cloud.stats_.failures;
+    }
+}
+
+int PointCloud::take_request( unsigned handle ) {
+    for( size_t i = 0; i < requests_.size(); ++i ) {
+        if( requests_[i].handle == static_cast<int>( handle ) ) {
+            const int node = requests_[i].node;
+            requests_.erase( requests_.begin() + i );
+            return node;
+        }
+    }
+    return -1;
+}
+
+void PointCloud::request( int node ) {
+    const std::string url    = url_ + "/nodes/" + std::to_string( node ) + ".bin";
+    Request           record = {emscripten_async_wget2_data( url.c_str(), "GET", nullptr, this, 1, on_node, on_error, nullptr ), node};
+    requests_.push_back( record );
+    nodes_[node].state = NODE_REQUESTED;
+    ++stats_.requests;
+}
+
+void PointCloud::upload( UserContext& user_context, Node& node ) {
+    GLState&         gl   = user_context.gl_state;
+    const GLsizeiptr size = node.points.size() * sizeof( PointCloudPoint );
+    glGenBuffers( 1, &node.buffer );
+    glGenVertexArrays( 1, &node.vertex_array );
+    gl.bind_vertex_array( node.vertex_array );
+    gl.bind_buffer( GL_ARRAY_BUFFER, node.buffer );
+    glBufferData( GL_ARRAY_BUFFER, size, node.points.data(), GL_STATIC_DRAW );
+    gpu_memory_allocated( GPU_MEMORY_BUFFER, node.buffer, size );
+    // Positions stay quantized to the node's cube, the model matrix maps 0 to 1 onto it.
+    gl.enable_vertex_attrib_array( 0 );
+    gl.vertex_attrib_pointer( 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof( PointCloudPoint ), 0 );
+    gl.enable_vertex_attrib_array( 1 );
+    gl.vertex_attrib_pointer( 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( PointCloudPoint ), reinterpret_cast<const GLvoid*>( offsetof( PointCloudPoint, color ) ) );
+    gl.bind_vertex_array( 0 );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    user_context.frame_budget.count_bytes_uploaded( size );
+
+    std::vector<PointCloudPoint>().swap( node.points );
+    node.state = NODE_RESIDENT;
+    resident_bytes_ += size;
+    ++resident_nodes_;
+    stats_.bytes_streamed += size;
+}
+
+void PointCloud::evict( GLState& gl, int index ) {
+    Node& node = nodes_[index];
+    if( node.state == NODE_RESIDENT ) {
+        gpu_memory_freed( GPU_MEMORY_BUFFER, node.buffer );
+        gl.forget_buffer( node.buffer );
+        gl.forget_vertex_array( node.vertex_array );
+        glDeleteBuffers( 1, &node.buffer );
+        glDeleteVertexArrays( 1, &node.vertex_array );
+        node.buffer       = 0;
+        node.vertex_array = 0;
+        resident_bytes_ -= node.record.points * sizeof( PointCloudPoint );
+        --resident_nodes_;
+    }
+    std::vector<PointCloudPoint>().swap( node.points );
+    if( node.state != NODE_FAILED ) {
+        node.state = NODE_ABSENT;
+    }
+}
+
+void PointCloud::update( UserContext& user_context, const CameraMatrices* cameras, const Frustum* eyes, GLfloat pixels_per_unit ) {
+    draws_.clear();
+    last_points_     = 0;
+    pixels_per_unit_ = pixels_per_unit;
+    if( nodes_.empty() ) {
+        return;
+    }
+    const unsigned long frame = ++stats_.frames;
+
+    // Arrived nodes are uploaded before picking, so they can be drawn this frame.
+    size_t uploaded = 0;
+    for( Node& node : nodes_ ) {
+        if( uploaded >= UPLOAD_BYTES_PER_FRAME ) {
+            break;
+        }
+        if( node.state == NODE_ARRIVED ) {
+            uploaded += node.points.size() * sizeof( PointCloudPoint );
+            upload( user_context, node );
+        }
+    }
+
+    GLfloat eye_positions[2][3];
+    for( int eye = 0; eye < 2; ++eye ) {
+        camera_position( cameras[eye], eye_positions[eye] );
+    }
+
+    // Nodes are visited largest on screen first, from the root down through resident nodes only, so every
+    // node drawn has all its ancestors drawn too and the cloud refines evenly wherever the eyes look.
+    const GLfloat                  grid = static_cast<GLfloat>( header_.grid );
+    std::priority_queue<Candidate> candidates;
+    std::vector<int>               missing;
+    candidates.push( {HUGE_VALF, 0} );
+    while( !candidates.empty() ) {
+        const int index = candidates.top().node;
+        candidates.pop();
+        Node&                 node   = nodes_[index];
+        const PointCloudNode& record = node.record;
+
+        GLfloat box[6];
+        placed_box( placement_, record, box );
+        uint8_t mask = 0;
+        for( int eye = 0; eye < 2; ++eye ) {
+            mask |= frustum_intersects_box( eyes[eye], box ) ? ( 1 << eye ) : 0;
+        }
+        if( !mask ) {
+            continue;
+        }
+
+        if( node.state != NODE_RESIDENT ) {
+            if( node.state == NODE_ABSENT ) {
+                missing.push_back( index );
+            }
+            continue;
+        }
+        if( last_points_ + record.points > point_budget_ ) {
+            break;
+        }
+        node.last_used = frame;
+        draws_.push_back( {index, mask} );
+        last_points_ += record.points;
+
+        for( int child : record.children ) {
+            if( child < 0 ) {
+                continue;
+            }
+            const PointCloudNode& c = nodes_[child].record;
+            GLfloat               child_box[6];
+            placed_box( placement_, c, child_box );
+            // From the nearer eye, and never closer than inside the box would make it.
+            const GLfloat near     = std::max( std::min( distance_to_box( eye_positions[0], child_box ), distance_to_box( eye_positions[1], child_box ) ), 0.01f );
+            const GLfloat priority = 2.0f * c.half_size * placement_scale_ / grid * pixels_per_unit / near;
+            if( priority >= MIN_SPACING_PIXELS ) {
+                candidates.push( {priority, child} );
+            }
+        }
+    }
+
+    // Missing nodes were found most important first.
+    for( size_t i = 0; ( i < missing.size() ) && ( requests_.size() < MAX_REQUESTS ); ++i ) {
+        request( missing[i] );
+    }
+
+    // Nodes not drawn this frame go least recently used first, until the rest fit.
+    if( resident_bytes_ > memory_budget_ ) {
+        std::vector<int> resident;
+        for( size_t i = 0; i < nodes_.size(); ++i ) {
+            if( ( nodes_[i].state == NODE_RESIDENT ) && ( nodes_[i].last_used != frame ) ) {
+                resident.push_back( static_cast<int>( i ) );
+            }
+        }
+        std::sort( resident.begin(), resident.end(), [this]( int a, int b ) { return nodes_[a].last_used < nodes_[b].last_used; } );
+        for( size_t i = 0; ( i < resident.size() ) && ( resident_bytes_ > memory_budget_ ); ++i ) {
+            evict( user_context.gl_state, resident[i] );
+            ++stats_.evictions;
+        }
+    }
+
+    stats_.points += last_points_;
+    stats_.nodes += draws_.size();
+}
+
+void PointCloud::record( GLCommandBuffer& commands ) const {
+    if( draws_.empty() ) {
+        return;
+    }
+    commands.use_program( program_ );
+    uint8_t mask = 3;
+    for( const Draw& draw : draws_ ) {
+        const Node&           node   = nodes_[draw.node];
+        const PointCloudNode& record = node.record;
+        if( draw.eyes != mask ) {
+            mask = draw.eyes;
+            commands.camera_mask( mask );
+        }
+
+        // clang-format off
+        const GLfloat size = 2.0f * record.half_size;
+        const GLfloat dequantize[4 * 4] = {
+            size, 0.0f, 0.0f, record.center[0] - record.half_size,
+            0.0f, size, 0.0f, record.center[1] - record.half_size,
+            0.0f, 0.0f, size, record.center[2] - record.half_size,
+            0.0f, 0.0f, 0.0f, 1.0f,
+        };
+        // clang-format on
+        GLfloat model[4 * 4];
+        float4x4_multiply( model, placement_, dequantize );
+        commands.bind_vertex_array( node.vertex_array );
+        commands.uniform_matrix4fv( mat4_model_, GL_TRUE, model );
+        commands.uniform_4f( vec4_point_, size * placement_scale_ / header_.grid, pixels_per_unit_, 0.0f, 0.0f );
+        commands.draw_arrays( GL_POINTS, 0, static_cast<GLsizei>( record.points ) );
+    }
+    if( mask != 3 ) {
+        commands.camera_mask( 3 );
+    }
+}
+
+size_t PointCloud::nodes() const {
+    return nodes_.size();
+}
+
+size_t PointCloud::resident_nodes() const {
+    return resident_nodes_;
+}
+
+size_t PointCloud::resident_bytes() const {
+    return resident_bytes_;
+}
+
+size_t PointCloud::last_points() const {
+    return last_points_;
+}
+
+const PointCloudStats& PointCloud::stats() const {
+    return stats_;
+}
+
+void print_point_cloud_stats( const PointCloud& point_cloud ) {
+    if( !point_cloud.opened() ) {
+        return;
+    }
+    const PointCloudStats& stats  = point_cloud.stats();
+    const double           frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "Point cloud: %lu of %lu nodes resident in %.1lf MB, %.0lf points in %.1lf nodes drawn and %.1lf KB streamed per frame, %lu requests, %lu evictions, %lu failures.",
+            static_cast<unsigned long>( point_cloud.resident_nodes() ),
+            static_cast<unsigned long>( point_cloud.nodes() ),
+            point_cloud.resident_bytes() / ( 1024.0 * 1024.0 ),
+            stats.points / frames,
+            stats.nodes / frames,
+            stats.bytes_streamed / frames / 1024.0,
+            stats.requests,
+            stats.evictions,
+            stats.failures );
+}
@@ -0,0 +1,131 @@
+#ifndef WASMVR_POINTCLOUD_H
+#define WASMVR_POINTCLOUD_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pointcloud_format.h"
+
+class GLCommandBuffer;
+class GLState;
+class UserContext;
+struct CameraMatrices;
+struct Frustum;
+
+struct PointCloudStats {
+    unsigned long frames;
+    unsigned long points;         // Drawn, summed over frames.
+    unsigned long nodes;          // Drawn, summed over frames.
+    unsigned long bytes_streamed; // Uploaded from fetched nodes, summed over frames.
+    unsigned long requests;
+    unsigned long evictions;
+    unsigned long failures;
+
+    PointCloudStats();
+};
+
+// An octree of points from src_tool/pointcloud_convert, far larger than fits in memory, streamed in by node.
+// Each frame picks the nodes whose points are largest on screen for either eye, until the point budget is
+// spent, fetches those that aren't resident in the background, and drops the least recently used ones when
+// the resident points outgrow the memory budget. Nodes are drawn as points sized to fill the gaps between
+// them, so a sparse level still reads as a surface until the one below arrives.
+class PointCloud {
+public:
+    PointCloud();
+
+    bool create( UserContext& user_context );
+    // Deletes the program and the nodes' buffers, e.g. when they died with the context. The cloud stays open
+    // and its nodes stream back in once there is a context again.
+    void release( GLState& gl );
+
+    // Starts fetching the cloud in the directory at url, relative to the page, closing any open one.
+    void open( GLState& gl, const std::string& url );
+    void close( GLState& gl );
+    bool opened() const;
+
+    // Row major matrix placing the cloud in the scene. Its origin is the converter's offset.
+    void set_placement( const GLfloat* matrix );
+    // Most points drawn per frame.
+    void set_point_budget( size_t points );
+    // Most bytes of points resident in buffers.
+    void set_memory_budget( size_t bytes );
+
+    // Picks the nodes to draw for the eyes' cameras and frusta, requests missing ones and uploads those
+    // that arrived. pixels_per_unit is the projection's scale, as for levels of detail.
+    void update( UserContext& user_context, const CameraMatrices* cameras, const Frustum* eyes, GLfloat pixels_per_unit );
+    // Records drawing the nodes picked, each only for the eyes it is in.
+    void record( GLCommandBuffer& commands ) const;
+
+    size_t                 nodes() const;
+    size_t                 resident_nodes() const;
+    size_t                 resident_bytes() const;
+    size_t                 last_points() const;
+    const PointCloudStats& stats() const;
+
+private:
+    enum NodeState {
+        NODE_ABSENT,
+        NODE_REQUESTED,
+        NODE_ARRIVED, // Fetched, waiting for its upload.
+        NODE_RESIDENT,
+        NODE_FAILED,  // Not requested again until the cloud is reopened.
+    };
+
+    struct Node {
+        PointCloudNode               record;
+        NodeState                    state;
+        unsigned long                last_used; // Frame it was last picked in.
+        std::vector<PointCloudPoint> points;    // While arrived.
+        GLuint                       buffer;
+        GLuint                       vertex_array;
+    };
+
+    struct Request {
+        int handle;
+        int node;
+    };
+
+    struct Draw {
+        int     node;
+        uint8_t eyes;
+    };
+
+    static void on_index( unsigned handle, void* arg, void* data, unsigned size );
+    static void on_node( unsigned handle, void* arg, void* data, unsigned size );
+    static void on_error( unsigned handle, void* arg, int status, const char* text );
+
+    int  take_request( unsigned handle );
+    void request( int node );
+    void upload( UserContext& user_context, Node& node );
+    void evict( GLState& gl, int node );
+
+    std::string          url_;
+    PointCloudHeader     header_;
+    std::vector<Node>    nodes_;
+    int                  index_request_;
+    std::vector<Request> requests_;
+
+    GLfloat placement_[4 * 4];
+    GLfloat placement_scale_;
+    size_t  point_budget_;
+    size_t  memory_budget_;
+    size_t  resident_bytes_;
+    size_t  resident_nodes_;
+
+    std::vector<Draw> draws_;
+    size_t            last_points_;
+    GLfloat           pixels_per_unit_;
+
+    GLuint program_;
+    GLint  mat4_model_;
+    GLint  vec4_point_; // Spacing of the node's grid, pixels per unit.
+
+    PointCloudStats stats_;
+};
+
+void print_point_cloud_stats( const PointCloud& point_cloud );
+
+#endif // WASMVR_POINTCLOUD_H
@@ -0,0 +1,45 @@
+#ifndef WASMVR_POINTCLOUD_FORMAT_H
+#define WASMVR_POINTCLOUD_FORMAT_H
+
+#include <stdint.h>
+
+// Point cloud octrees as src_tool/pointcloud_convert writes them and PointCloud streams them. A cloud is a
+// directory holding index.bin, a PointCloudHeader followed by a PointCloudNode per node, and nodes/<node>.bin
+// with each node's points. Everything is little endian, and a node's files can be fetched on their own.
+//
+// Every node is a cube holding a sample of the points inside it, at most one per cell of a grid of
+// PointCloudHeader::grid cells per side and at most a fixed budget of them. Points are only stored once,
+// so drawing a node and its ancestors draws the points of its cube at the node's density.
+
+const uint32_t POINT_CLOUD_MAGIC   = 0x43505657; // "WVPC"
+const uint32_t POINT_CLOUD_VERSION = 1;
+
+struct PointCloudHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nodes; // Node 0 is the root, parents come before their children.
+    uint32_t grid;
+    uint64_t points;
+    // Subtracted from the input's coordinates, which may be far from the origin, to keep floats precise.
+    double offset[3];
+};
+
+struct PointCloudNode {
+    float    center[3];
+    float    half_size;
+    int32_t  parent;      // -1 for the root.
+    int32_t  children[8]; // -1 where there is none. Child i has +x if i & 1, +y if i & 2 and +z if i & 4.
+    uint32_t points;
+};
+
+// Position quantized from the node's cube to 0 to 65535 on each axis, and RGBA colour.
+struct PointCloudPoint {
+    uint16_t position[3];
+    uint8_t  color[4];
+};
+
+static_assert( sizeof( PointCloudHeader ) == 48, "The header is read and written as is." );
+static_assert( sizeof( PointCloudNode ) == 56, "Nodes are read and written as they are." );
+static_assert( sizeof( PointCloudPoint ) == 10, "Points are uploaded as they are." );
+
+#endif // WASMVR_POINTCLOUD_FORMAT_H
@@ -0,0 +1,709 @@
+#include "raycast.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <math.h>
+#include <string.h>
+
+#include "bvh.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "scene.h"
+#include "util.h"
+
+namespace {
+    // Past this depth nodes are halved by count, which bounds the depth and with it the traversal stacks.
+    const int32_t SAH_MAX_DEPTH = 48;
+    // Enough for a four wide tree made from a binary one no deeper than SAH_MAX_DEPTH plus halving
+    // the largest meshes, each level pushing at most three siblings.
+    const int TRAVERSAL_STACK_SIZE = 256;
+    const int SCENE_STACK_SIZE     = 64;
+    // Triangles boxed, binned or partitioned between looks at the clock.
+    const size_t STEP_WORK = 16384;
+
+    void box_empty( GLfloat* box ) {
+        for( int i = 0; i < 3; ++i ) {
+            box[i]     = 1e30f;
+            box[3 + i] = -1e30f;
+        }
+    }
+
+    void box_grow( GLfloat* box, const GLfloat* other ) {
+        for( int i = 0; i < 3; ++i ) {
+            box[i]     = std::min( box[i], other[i] );
+            box[3 + i] = std::max( box[3 + i], other[3 + i] );
+        }
+    }
+
+    // Bin of a centroid coordinate along an axis of a node's centroid bounds, computed the same way when
+    // binning and when partitioning so both agree on every triangle.
+    int bin_of( const GLfloat* centroid_bounds, int axis, GLfloat centroid ) {
+        const GLfloat extent = centroid_bounds[3 + axis] - centroid_bounds[axis];
+        if( extent <= 0.0f ) {
+            return 0;
+        }
+        const int bins = TriangleBvh::BINS;
+        return std::min( static_cast<int>( ( centroid - centroid_bounds[axis] ) * ( bins / extent ) ), bins - 1 );
+    }
+
+    GLfloat box_half_area( const GLfloat* box ) {
+        const GLfloat x = std::max( box[3] - box[0], 0.0f );
+        const GLfloat y = std::max( box[4] - box[1], 0.0f );
+        const GLfloat z = std::max( box[5] - box[2], 0.0f );
+        return x * y + y * z + z * x;
+    }
+
+    // Reciprocal of a direction, huge but finite where it is zero so slab tests never produce NaN.
+    GLfloat safe_inverse( GLfloat d ) {
+        return ( fabsf( d ) > 1e-20f ) ? 1.0f / d : copysignf( 1e20f, d );
+    }
+
+    // Distance at which the ray enters the box, or a negative value if it misses it within far.
+    GLfloat ray_box( const GLfloat* origin, const GLfloat* inverse, const GLfloat* box, GLfloat far ) {
+        GLfloat near = 0.0f;
+        for( int i = 0; i < 3; ++i ) {
+            const GLfloat t0 = ( box[i] - origin[i] ) * inverse[i];
+            const GLfloat t1 = ( box[3 + i] - origin[i] ) * inverse[i];
+            near             = std::max( near, std::min( t0, t1 ) );
+            far              = std::min( far, std::max( t0, t1 ) );
+        }
+        return ( near <= far ) ? near : -1.0f;
+    }
+
+    // Row major point and direction transforms.
+    void transform_point( const GLfloat* m, const GLfloat* p, GLfloat* out ) {
+        for( int i = 0; i < 3; ++i ) {
+            out[i] = m[4 * i] * p[0] + m[4 * i + 1] * p[1] + m[4 * i + 2] * p[2] + m[4 * i + 3];
+        }
+    }
+
+    void transform_direction( const GLfloat* m, const GLfloat* d, GLfloat* out ) {
+        for( int i = 0; i < 3; ++i ) {
+            out[i] = m[4 * i] * d[0] + m[4 * i + 1] * d[1] + m[4 * i + 2] * d[2];
+        }
+    }
+}
+
+void ray_from_matrix( const GLfloat* matrix, GLfloat max_distance, Ray& ray ) {
+    GLfloat length = 0.0f;
+    for( int i = 0; i < 3; ++i ) {
+        ray.origin[i]    = matrix[4 * i + 3];
+        ray.direction[i] = -matrix[4 * i + 2];
+        length += ray.direction[i] * ray.direction[i];
+    }
+    length = ( length > 0.0f ) ? 1.0f / sqrtf( length ) : 0.0f;
+    for( int i = 0; i < 3; ++i ) {
+        ray.direction[i] *= length;
+    }
+    ray.max_distance = max_distance;
+}
+
+TriangleBvh::TriangleBvh()
+    : phase_( PHASE_IDLE )
+    , triangles_( 0 )
+    , cursor_( 0 )
+    , build_ms_( 0.0 )
+    , leaves_( 0 )
+    , split_pass_( SPLIT_NEXT )
+    , split_axis_( -1 )
+    , split_bin_( 0 )
+    , split_cursor_( 0 )
+    , split_end_( 0 ) {
+    memset( &splitting_, 0, sizeof( splitting_ ) );
+}
+
+void TriangleBvh::begin( const Mesh& mesh ) {
+    triangles_  = ( mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].index_count ) / 3;
+    phase_      = PHASE_BOUNDS;
+    cursor_     = 0;
+    build_ms_   = 0.0;
+    split_pass_ = SPLIT_NEXT;
+    boxes_.resize( 6 * triangles_ );
+    centroids_.resize( 3 * triangles_ );
+    order_.resize( triangles_ );
+    // Growing the build nodes copies them, which on large meshes takes longer than a step. Trees are mostly
+    // a little over half as many nodes as triangles, so this is rarely outgrown.
+    build_nodes_.clear();
+    build_nodes_.reserve( triangles_ );
+    leaves_ = 0;
+    split_stack_.clear();
+    if( triangles_ ) {
+        // Grown by the bounds phase.
+        BuildNode root;
+        box_empty( root.bounds );
+        box_empty( root.centroid_bounds );
+        root.left  = -1;
+        root.first = 0;
+        root.count = static_cast<int32_t>( triangles_ );
+        build_nodes_.push_back( root );
+        split_stack_.push_back( {0, 0} );
+    }
+    collapse_stack_.clear();
+    nodes_.clear();
+    packets_.clear();
+}
+
+bool TriangleBvh::step( const Mesh& mesh, double deadline_ms ) {
+    const double begin_ms = emscripten_get_now();
+    size_t       work     = 0;
+    bool         late     = false;
+    auto         expired  = [&]() {
+        if( !late && ( work >= STEP_WORK ) ) {
+            work = 0;
+            late = emscripten_get_now() >= deadline_ms;
+        }
+        return late;
+    };
+
+    if( phase_ == PHASE_BOUNDS ) {
+        const uint32_t* indices   = mesh.indices.data();
+        const GLfloat*  positions = mesh.positions.data();
+        for( ; cursor_ < triangles_; ++cursor_, ++work ) {
+            if( expired() ) {
+                break;
+            }
+            GLfloat* box = &boxes_[6 * cursor_];
+            box_empty( box );
+            for( int k = 0; k < 3; ++k ) {
+                const GLfloat* p     = positions + 3 * indices[3 * cursor_ + k];
+                const GLfloat  at[6] = {p[0], p[1], p[2], p[0], p[1], p[2]};
+                box_grow( box, at );
+            }
+            GLfloat* c = &centroids_[3 * cursor_];
+            for( int k = 0; k < 3; ++k ) {
+                c[k] = 0.5f * ( box[k] + box[3 + k] );
+            }
+            const GLfloat at[6] = {c[0], c[1], c[2], c[0], c[1], c[2]};
+            box_grow( build_nodes_[0].bounds, box );
+            box_grow( build_nodes_[0].centroid_bounds, at );
+            order_[cursor_] = static_cast<int32_t>( cursor_ );
+        }
+        if( cursor_ == triangles_ ) {
+            phase_ = PHASE_SPLIT;
+        }
+    }
+
+    while( ( phase_ == PHASE_SPLIT ) && !expired() ) {
+        if( split_pass_ == SPLIT_NEXT ) {
+            if( split_stack_.empty() ) {
+                if( !build_nodes_.empty() ) {
+                    // Leaves become packets one to one, and about half as many nodes hold them.
+                    packets_.reserve( leaves_ );
+                    nodes_.reserve( 2 * leaves_ / 3 + 1 );
+                    TriangleBvhNode root;
+                    memset( &root, 0, sizeof( root ) );
+                    nodes_.push_back( root );
+                    collapse_stack_.push_back( {0, 0} );
+                }
+                phase_ = PHASE_COLLAPSE;
+                break;
+            }
+            splitting_ = split_stack_.back();
+            split_stack_.pop_back();
+            const BuildNode& node = build_nodes_[splitting_.build_node];
+            if( node.count <= LEAF_SIZE ) {
+                ++leaves_;
+                continue;
+            }
+            if( splitting_.depth >= SAH_MAX_DEPTH ) {
+                split_choose( false );
+                continue;
+            }
+            for( int axis = 0; axis < 3; ++axis ) {
+                for( int b = 0; b < BINS; ++b ) {
+                    box_empty( bin_bounds_[axis][b] );
+                    bin_counts_[axis][b] = 0;
+                }
+            }
+            split_cursor_ = node.first;
+            split_pass_   = SPLIT_BIN;
+            continue;
+        }
+
+        const BuildNode& node = build_nodes_[splitting_.build_node];
+        const int32_t    end  = node.first + node.count;
+        if( split_pass_ == SPLIT_BIN ) {
+            for( ; ( split_cursor_ < end ) && !expired(); ++split_cursor_, ++work ) {
+                const int32_t triangle = order_[split_cursor_];
+                for( int axis = 0; axis < 3; ++axis ) {
+                    const int b = bin_of( node.centroid_bounds, axis, centroids_[3 * triangle + axis] );
+                    box_grow( bin_bounds_[axis][b], &boxes_[6 * triangle] );
+                    ++bin_counts_[axis][b];
+                }
+            }
+            if( split_cursor_ == end ) {
+                split_choose( true );
+            }
+            continue;
+        }
+
+        // Hoare style, so it can stop anywhere: everything before the cursor goes left, from split_end_ on right.
+        for( ; ( split_cursor_ < split_end_ ) && !expired(); ++work ) {
+            int side = 0;
+            if( !split_goes_left( split_cursor_ ) ) {
+                side = 1;
+                std::swap( order_[split_cursor_], order_[--split_end_] );
+            }
+            const int32_t  triangle = order_[side ? split_end_ : split_cursor_++];
+            const GLfloat* c        = &centroids_[3 * triangle];
+            const GLfloat  at[6]    = {c[0], c[1], c[2], c[0], c[1], c[2]};
+            box_grow( side_bounds_[side], &boxes_[6 * triangle] );
+            box_grow( side_centroid_bounds_[side], at );
+        }
+        if( split_cursor_ == split_end_ ) {
+            split_finish();
+        }
+    }
+
+    while( ( phase_ == PHASE_COLLAPSE ) && !expired() ) {
+        if( collapse_stack_.empty() ) {
+            // Nothing but the finished tree is kept.
+            std::vector<GLfloat>().swap( boxes_ );
+            std::vector<GLfloat>().swap( centroids_ );
+            std::vector<int32_t>().swap( order_ );
+            std::vector<BuildNode>().swap( build_nodes_ );
+            std::vector<Split>().swap( split_stack_ );
+            std::vector<Collapse>().swap( collapse_stack_ );
+            phase_ = PHASE_DONE;
+            break;
+        }
+        const Collapse work_item = collapse_stack_.back();
+        collapse_stack_.pop_back();
+        collapse( mesh, work_item );
+        work += 4 * LEAF_SIZE;
+    }
+
+    build_ms_ += emscripten_get_now() - begin_ms;
+    return phase_ == PHASE_DONE;
+}
+
+bool TriangleBvh::split_goes_left( int32_t position ) const {
+    const BuildNode& node = build_nodes_[splitting_.build_node];
+    if( split_axis_ < 0 ) {
+        return position < node.first + node.count / 2;
+    }
+    const int32_t triangle = order_[position];
+    return bin_of( node.centroid_bounds, split_axis_, centroids_[3 * triangle + split_axis_] ) < split_bin_;
+}
+
+void TriangleBvh::split_choose( bool binned ) {
+    // Binned surface area heuristic over all three axes. Every node past one packet is split, so the cost
+    // only decides where, and without any split between bins the node is halved by count.
+    split_axis_ = -1;
+    if( binned ) {
+        GLfloat best_cost = 1e30f;
+        for( int axis = 0; axis < 3; ++axis ) {
+            // Costs of everything right of each boundary, swept from the right.
+            GLfloat right_area[BINS];
+            int32_t right_count[BINS];
+            GLfloat box[6];
+            box_empty( box );
+            int32_t sum = 0;
+            for( int b = BINS - 1; b > 0; --b ) {
+                box_grow( box, bin_bounds_[axis][b] );
+                sum += bin_counts_[axis][b];
+                right_area[b]  = box_half_area( box );
+                right_count[b] = sum;
+            }
+            box_empty( box );
+            sum = 0;
+            for( int b = 1; b < BINS; ++b ) {
+                box_grow( box, bin_bounds_[axis][b - 1] );
+                sum += bin_counts_[axis][b - 1];
+                if( !sum || !right_count[b] ) {
+                    continue;
+                }
+                const GLfloat cost = box_half_area( box ) * sum + right_area[b] * right_count[b];
+                if( cost < best_cost ) {
+                    best_cost   = cost;
+                    split_axis_ = axis;
+                    split_bin_  = b;
+                }
+            }
+        }
+    }
+
+    const BuildNode& node = build_nodes_[splitting_.build_node];
+    split_cursor_         = node.first;
+    split_end_            = node.first + node.count;
+    for( int side = 0; side < 2; ++side ) {
+        box_empty( side_bounds_[side] );
+        box_empty( side_centroid_bounds_[side] );
+    }
+    split_pass_ = SPLIT_PARTITION;
+}
+
+void TriangleBvh::split_finish() {
+    const int32_t index  = splitting_.build_node;
+    const int32_t first  = build_nodes_[index].first;
+    const int32_t count  = build_nodes_[index].count;
+    const int32_t middle = split_cursor_;
+    const int32_t left   = static_cast<int32_t>( build_nodes_.size() );
+    build_nodes_.resize( left + 2 );
+    build_nodes_[index].left   = left;
+    const int32_t ranges[2][2] = {{first, middle - first}, {middle, first + count - middle}};
+    for( int side = 0; side < 2; ++side ) {
+        BuildNode& child = build_nodes_[left + side];
+        memcpy( child.bounds, side_bounds_[side], sizeof( child.bounds ) );
+        memcpy( child.centroid_bounds, side_centroid_bounds_[side], sizeof( child.centroid_bounds ) );
+        child.left  = -1;
+        child.first = ranges[side][0];
+        child.count = ranges[side][1];
+        split_stack_.push_back( {left + side, splitting_.depth + 1} );
+    }
+    split_pass_ = SPLIT_NEXT;
+}
+
+void TriangleBvh::collapse( const Mesh& mesh, const Collapse& work ) {
+    // Opens the largest inner children until there are four, so each node covers up to two binary levels.
+    int32_t children[4];
+    int     count = 0;
+    const BuildNode& parent = build_nodes_[work.build_node];
+    if( parent.left < 0 ) {
+        children[count++] = work.build_node; // A root small enough to be a single leaf.
+    } else {
+        children[count++] = parent.left;
+        children[count++] = parent.left + 1;
+    }
+    while( count < 4 ) {
+        int     largest = -1;
+        GLfloat area    = -1.0f;
+        for( int i = 0; i < count; ++i ) {
+            const BuildNode& child = build_nodes_[children[i]];
+            if( ( child.left >= 0 ) && ( box_half_area( child.bounds ) > area ) ) {
+                largest = i;
+                area    = box_half_area( child.bounds );
+            }
+        }
+        if( largest < 0 ) {
+            break;
+        }
+        const int32_t opened = children[largest];
+        children[largest]    = build_nodes_[opened].left;
+        children[count++]    = build_nodes_[opened].left + 1;
+    }
+
+    GLfloat lanes[6][4];
+    int32_t links[4];
+    for( int lane = 0; lane < 4; ++lane ) {
+        if( lane >= count ) {
+            // Inverted boxes no ray can be inside of.
+            for( int k = 0; k < 3; ++k ) {
+                lanes[k][lane]     = 1e30f;
+                lanes[3 + k][lane] = -1e30f;
+            }
+            links[lane] = 0;
+            continue;
+        }
+        const BuildNode& child = build_nodes_[children[lane]];
+        for( int k = 0; k < 6; ++k ) {
+            lanes[k][lane] = child.bounds[k];
+        }
+        if( child.left < 0 ) {
+            links[lane] = ~add_packet( mesh, child );
+        } else {
+            links[lane] = static_cast<int32_t>( nodes_.size() );
+            TriangleBvhNode node;
+            memset( &node, 0, sizeof( node ) );
+            nodes_.push_back( node );
+            collapse_stack_.push_back( {children[lane], links[lane]} );
+        }
+    }
+
+    TriangleBvhNode& node = nodes_[work.node];
+    node.min_x            = float4_load( lanes[0] );
+    node.min_y            = float4_load( lanes[1] );
+    node.min_z            = float4_load( lanes[2] );
+    node.max_x            = float4_load( lanes[3] );
+    node.max_y            = float4_load( lanes[4] );
+    node.max_z            = float4_load( lanes[5] );
+    memcpy( node.children, links, sizeof( links ) );
+}
+
+int32_t TriangleBvh::add_packet( const Mesh& mesh, const BuildNode& leaf ) {
+    GLfloat lanes[9][4] = {};
+    int32_t triangles[4] = {-1, -1, -1, -1};
+    for( int32_t lane = 0; lane < leaf.count; ++lane ) {
+        const int32_t   triangle = order_[leaf.first + lane];
+        const uint32_t* index    = &mesh.indices[3 * triangle];
+        const GLfloat*  p0       = &mesh.positions[3 * index[0]];
+        const GLfloat*  p1       = &mesh.positions[3 * index[1]];
+        const GLfloat*  p2       = &mesh.positions[3 * index[2]];
+        for( int k = 0; k < 3; ++k ) {
+            lanes[k][lane]     = p0[k];
+            lanes[3 + k][lane] = p1[k] - p0[k];
+            lanes[6 + k][lane] = p2[k] - p0[k];
+        }
+        triangles[lane] = triangle;
+    }
+    TrianglePacket packet;
+    for( int k = 0; k < 3; ++k ) {
+        packet.v0[k] = float4_load( lanes[k] );
+        packet.e1[k] = float4_load( lanes[3 + k] );
+        packet.e2[k] = float4_load( lanes[6 + k] );
+    }
+    memcpy( packet.triangles, triangles, sizeof( triangles ) );
+    packets_.push_back( packet );
+    return static_cast<int32_t>( packets_.size() ) - 1;
+}
+
+bool TriangleBvh::built() const {
+    return phase_ == PHASE_DONE;
+}
+
+bool TriangleBvh::intersect( const GLfloat* origin, const GLfloat* direction, GLfloat& distance, int32_t& triangle, GLfloat* barycentric ) const {
+    if( ( phase_ != PHASE_DONE ) || nodes_.empty() ) {
+        return false;
+    }
+
+    const float4 ox = float4_splat( origin[0] );
+    const float4 oy = float4_splat( origin[1] );
+    const float4 oz = float4_splat( origin[2] );
+    const float4 dx = float4_splat( direction[0] );
+    const float4 dy = float4_splat( direction[1] );
+    const float4 dz = float4_splat( direction[2] );
+    const float4 ix = float4_splat( safe_inverse( direction[0] ) );
+    const float4 iy = float4_splat( safe_inverse( direction[1] ) );
+    const float4 iz = float4_splat( safe_inverse( direction[2] ) );
+    const float4 zero = float4_splat( 0.0f );
+    const float4 one  = float4_splat( 1.0f );
+
+    bool    hit = false;
+    int32_t stack[TRAVERSAL_STACK_SIZE];
+    int     top  = 0;
+    stack[top++] = 0;
+    while( top > 0 ) {
+        const int32_t link = stack[--top];
+        if( link < 0 ) {
+            // Möller and Trumbore, four triangles at a time.
+            const TrianglePacket& p    = packets_[~link];
+            const float4          px   = dy * p.e2[2] - dz * p.e2[1];
+            const float4          py   = dz * p.e2[0] - dx * p.e2[2];
+            const float4          pz   = dx * p.e2[1] - dy * p.e2[0];
+            const float4          det  = p.e1[0] * px + p.e1[1] * py + p.e1[2] * pz;
+            const int4            ok   = float4_abs( det ) > float4_splat( 1e-12f );
+            const float4          inv  = one / float4_select( ok, det, one );
+            const float4          tx   = ox - p.v0[0];
+            const float4          ty   = oy - p.v0[1];
+            const float4          tz   = oz - p.v0[2];
+            const float4          u    = ( tx * px + ty * py + tz * pz ) * inv;
+            const float4          qx   = ty * p.e1[2] - tz * p.e1[1];
+            const float4          qy   = tz * p.e1[0] - tx * p.e1[2];
+            const float4          qz   = tx * p.e1[1] - ty * p.e1[0];
+            const float4          v    = ( dx * qx + dy * qy + dz * qz ) * inv;
+            const float4          t    = ( p.e2[0] * qx + p.e2[1] * qy + p.e2[2] * qz ) * inv;
+            const int4            lane = ok & ( u >= zero ) & ( v >= zero ) & ( u + v <= one ) & ( t > zero ) & ( t < float4_splat( distance ) );
+            if( !int4_any( lane ) ) {
+                continue;
+            }
+            for( int i = 0; i < 4; ++i ) {
+                if( lane[i] && ( t[i] < distance ) ) {
+                    distance       = t[i];
+                    triangle       = p.triangles[i];
+                    barycentric[0] = u[i];
+                    barycentric[1] = v[i];
+                    hit            = true;
+                }
+            }
+            continue;
+        }
+
+        // Slabs of all four children at once.
+        const TriangleBvhNode& node = nodes_[link];
+        const float4           x0   = ( node.min_x - ox ) * ix;
+        const float4           x1   = ( node.max_x - ox ) * ix;
+        const float4           y0   = ( node.min_y - oy ) * iy;
+        const float4           y1   = ( node.max_y - oy ) * iy;
+        const float4           z0   = ( node.min_z - oz ) * iz;
+        const float4           z1   = ( node.max_z - oz ) * iz;
+        const float4           near = float4_max( float4_max( float4_min( x0, x1 ), float4_min( y0, y1 ) ), float4_max( float4_min( z0, z1 ), zero ) );
+        const float4           far  = float4_min( float4_min( float4_max( x0, x1 ), float4_max( y0, y1 ) ), float4_min( float4_max( z0, z1 ), float4_splat( distance ) ) );
+        const int4             enter = ( near <= far ) & ( node.max_x >= node.min_x );
+        if( !int4_any( enter ) ) {
+            continue;
+        }
+        // Farthest pushed first, so the nearest is visited first and shrinks distance for the rest.
+        int     order[4];
+        int     count = 0;
+        for( int i = 0; i < 4; ++i ) {
+            if( enter[i] ) {
+                int at = count++;
+                while( ( at > 0 ) && ( near[order[at - 1]] < near[i] ) ) {
+                    order[at] = order[at - 1];
+                    --at;
+                }
+                order[at] = i;
+            }
+        }
+        for( int i = 0; ( i < count ) && ( top < TRAVERSAL_STACK_SIZE ); ++i ) {
+            stack[top++] = node.children[order[i]];
+        }
+    }
+    return hit;
+}
+
+size_t TriangleBvh::triangles() const {
+    return triangles_;
+}
+
+size_t TriangleBvh::nodes() const {
+    return nodes_.size();
+}
+
+size_t TriangleBvh::bytes() const {
+    return nodes_.size() * sizeof( TriangleBvhNode ) + packets_.size() * sizeof( TrianglePacket );
+}
+
+double TriangleBvh::build_ms() const {
+    return build_ms_;
+}
+
+RayCastStats::RayCastStats()
+    : casts( 0 )
+    , rays( 0 )
+    , hits( 0 )
+    , meshes_tested( 0 )
+    , cast_ms( 0.0 )
+    , build_ms( 0.0 )
+    , built_triangles( 0 ) {
+}
+
+RayCaster::Entry::Entry()
+    : pickable( true )
+    , started( false ) {
+}
+
+RayCaster::RayCaster() {
+}
+
+void RayCaster::clear() {
+    entries_.clear();
+}
+
+void RayCaster::set_pickable( int mesh, bool pickable ) {
+    if( static_cast<size_t>( mesh ) >= entries_.size() ) {
+        entries_.resize( mesh + 1 );
+    }
+    entries_[mesh].pickable = pickable;
+}
+
+bool RayCaster::ready( int mesh ) const {
+    return ( mesh >= 0 ) && ( static_cast<size_t>( mesh ) < entries_.size() ) && entries_[mesh].pickable && entries_[mesh].tree.built();
+}
+
+void RayCaster::update( const std::vector<Mesh>& meshes, double budget_ms ) {
+    if( entries_.size() < meshes.size() ) {
+        entries_.resize( meshes.size() );
+    }
+    const double deadline_ms = emscripten_get_now() + budget_ms;
+    for( size_t i = 0; i < meshes.size(); ++i ) {
+        Entry& entry = entries_[i];
+        if( !entry.pickable || meshes[i].skinned() || entry.tree.built() ) {
+            continue;
+        }
+        if( emscripten_get_now() >= deadline_ms ) {
+            break;
+        }
+        if( !entry.started ) {
+            entry.tree.begin( meshes[i] );
+            entry.started = true;
+        }
+        if( entry.tree.step( meshes[i], deadline_ms ) ) {
+            stats_.build_ms += entry.tree.build_ms();
+            stats_.built_triangles += entry.tree.triangles();
+        }
+    }
+}
+
+unsigned RayCaster::trace( const Bvh& bvh, const Scene& scene, const Ray& ray, RayHit& hit ) const {
+    hit.node           = Scene::NONE;
+    hit.triangle       = -1;
+    hit.distance       = ray.max_distance;
+    hit.barycentric[0] = 0.0f;
+    hit.barycentric[1] = 0.0f;
+
+    const std::vector<BvhNode>& nodes = bvh.nodes();
+    const std::vector<int32_t>& items = bvh.items();
+    if( nodes.empty() ) {
+        return 0;
+    }
+    const GLfloat inverse[3] = {safe_inverse( ray.direction[0] ), safe_inverse( ray.direction[1] ), safe_inverse( ray.direction[2] )};
+
+    unsigned tested = 0;
+    int32_t  stack[SCENE_STACK_SIZE];
+    int      top = 0;
+    stack[top++] = 0;
+    while( top > 0 ) {
+        const BvhNode& node = nodes[stack[--top]];
+        if( ray_box( ray.origin, inverse, node.bounds, hit.distance ) < 0.0f ) {
+            continue;
+        }
+        if( node.left >= 0 ) {
+            // Nearer child last, to be popped first.
+            const GLfloat left  = ray_box( ray.origin, inverse, nodes[node.left].bounds, hit.distance );
+            const GLfloat right = ray_box( ray.origin, inverse, nodes[node.left + 1].bounds, hit.distance );
+            const bool    swap  = ( right >= 0.0f ) && ( ( left < 0.0f ) || ( right < left ) );
+            stack[top++]        = swap ? node.left : node.left + 1;
+            stack[top++]        = swap ? node.left + 1 : node.left;
+            continue;
+        }
+
+        for( int32_t i = node.first; i < node.first + node.count; ++i ) {
+            const int32_t item = items[i];
+            const int     mesh = scene.mesh( item );
+            if( !scene.visible( item ) || !ready( mesh ) ||
+                ( ray_box( ray.origin, inverse, scene.world_bounds( item ), hit.distance ) < 0.0f ) ) {
+                continue;
+            }
+            // Into the mesh's space without normalizing, so distances along the ray stay comparable.
+            GLfloat inverse_world[4 * 4];
+            if( !gl_matrix4x4_invert( inverse_world, scene.world_matrix( item ) ) ) {
+                continue;
+            }
+            GLfloat origin[3];
+            GLfloat direction[3];
+            transform_point( inverse_world, ray.origin, origin );
+            transform_direction( inverse_world, ray.direction, direction );
+            ++tested;
+            if( entries_[mesh].tree.intersect( origin, direction, hit.distance, hit.triangle, hit.barycentric ) ) {
+                hit.node = item;
+            }
+        }
+    }
+    return tested;
+}
+
+void RayCaster::cast( const Bvh& bvh, const Scene& scene, const Ray* rays, size_t count, RayHit* hits ) {
+    const double          begin_ms = emscripten_get_now();
+    std::vector<unsigned> tested( count );
+    parallel_for( count, [&]( size_t i ) {
+        tested[i] = trace( bvh, scene, rays[i], hits[i] );
+    } );
+    for( size_t i = 0; i < count; ++i ) {
+        stats_.meshes_tested += tested[i];
+        stats_.hits += ( hits[i].node != Scene::NONE ) ? 1 : 0;
+    }
+    ++stats_.casts;
+    stats_.rays += count;
+    stats_.cast_ms += emscripten_get_now() - begin_ms;
+}
+
+const TriangleBvh& RayCaster::tree( int mesh ) const {
+    return entries_[mesh].tree;
+}
+
+const RayCastStats& RayCaster::stats() const {
+    return stats_;
+}
+
+void print_raycast_stats( const RayCaster& ray_caster ) {
+    const RayCastStats& stats = ray_caster.stats();
+    const double        casts = stats.casts ? static_cast<double>( stats.casts ) : 1.0;
+    STDOUT( "Ray casts: %lu rays, %lu hits, %.2lf mesh trees per ray, %.3lf ms per cast, %lu triangles built into trees in %.1lf ms.",
+            stats.rays,
+            stats.hits,
+            stats.rays ? static_cast<double>( stats.meshes_tested ) / stats.rays : 0.0,
+            stats.cast_ms / casts,
+            stats.built_triangles,
+            stats.build_ms );
+}
@@ -0,0 +1,197 @@
+#ifndef WASMVR_RAYCAST_H
+#define WASMVR_RAYCAST_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "simd.h"
+
+class Bvh;
+class Scene;
+struct Mesh;
+
+struct Ray {
+    GLfloat origin[3];
+    GLfloat direction[3]; // Unit length, so hit distances are in the same units as the scene.
+    GLfloat max_distance;
+};
+
+struct RayHit {
+    int32_t node;           // Scene node hit, Scene::NONE if the ray hit nothing.
+    int32_t triangle;       // Of the mesh's full level, i.e. indices[3 * triangle] onwards.
+    GLfloat distance;       // Along the ray, max_distance for a miss.
+    GLfloat barycentric[2]; // Weights of the triangle's second and third vertices.
+};
+
+// The ray a row major pose matrix points along, from its origin down its -z axis like the controllers.
+void ray_from_matrix( const GLfloat* matrix, GLfloat max_distance, Ray& ray );
+
+// Four children's boxes side by side, so a ray is tested against all of them at once.
+struct TriangleBvhNode {
+    float4  min_x, min_y, min_z;
+    float4  max_x, max_y, max_z; // Below min on unused lanes, which then never hit.
+    int32_t children[4];         // Inner nodes by index, leaves as ~packet, 0 on unused lanes.
+};
+
+// Up to four triangles ready for a four wide ray test, as a corner and the two edges leaving it.
+struct TrianglePacket {
+    float4  v0[3];
+    float4  e1[3];
+    float4  e2[3];
+    int32_t triangles[4]; // -1 on unused lanes, whose edges are zero so they never hit.
+};
+
+// Four wide BVH over the triangles of a mesh's full level. It is built with the surface area heuristic as a
+// binary tree first, whose nodes are then merged four at a time. Building is split into steps that each end
+// once a deadline has passed, so even a mesh of millions of triangles is built over frames without stalling
+// any of them.
+class TriangleBvh {
+public:
+    // Binary leaves hold at most this many triangles, exactly one packet.
+    static const int LEAF_SIZE = 4;
+    // Centroids are sorted into this many bins along each axis to find the cheapest split.
+    static const int BINS = 12;
+
+    TriangleBvh();
+
+    // Starts over on the mesh, which must not change until the build is done.
+    void begin( const Mesh& mesh );
+    // Builds on until emscripten_get_now() passes deadline_ms, returning whether the tree is done.
+    bool step( const Mesh& mesh, double deadline_ms );
+    bool built() const;
+
+    // Closest hit along the ray in the mesh's space, closer than distance, which is updated on a hit.
+    // direction needs no particular length, distance is in multiples of it.
+    bool intersect( const GLfloat* origin, const GLfloat* direction, GLfloat& distance, int32_t& triangle, GLfloat* barycentric ) const;
+
+    size_t triangles() const;
+    size_t nodes() const;
+    size_t bytes() const;
+    double build_ms() const;
+
+private:
+    enum Phase {
+        PHASE_IDLE,
+        PHASE_BOUNDS,   // Each triangle's box and centroid.
+        PHASE_SPLIT,    // The binary tree.
+        PHASE_COLLAPSE, // The four wide tree and packets.
+        PHASE_DONE,
+    };
+
+    // Even a single split can take too long on millions of triangles, so each is done in passes that stop
+    // and resume with the rest of the build.
+    enum SplitPass {
+        SPLIT_NEXT,      // Take the next node off the stack.
+        SPLIT_BIN,       // Bin the node's triangles along each axis.
+        SPLIT_PARTITION, // Move them to either side of the split chosen from the bins.
+    };
+
+    struct BuildNode {
+        GLfloat bounds[6];
+        GLfloat centroid_bounds[6];
+        int32_t left; // The right child follows it, -1 for leaves.
+        int32_t first;
+        int32_t count;
+    };
+
+    struct Split {
+        int32_t build_node;
+        int32_t depth;
+    };
+
+    struct Collapse {
+        int32_t build_node;
+        int32_t node;
+    };
+
+    bool    split_goes_left( int32_t position ) const;
+    void    split_choose( bool binned );
+    void    split_finish();
+    void    collapse( const Mesh& mesh, const Collapse& work );
+    int32_t add_packet( const Mesh& mesh, const BuildNode& leaf );
+
+    Phase  phase_;
+    size_t triangles_;
+    size_t cursor_; // Next triangle of the bounds phase.
+    double build_ms_;
+
+    // Only while building.
+    std::vector<GLfloat>   boxes_;     // Six per triangle.
+    std::vector<GLfloat>   centroids_; // Three per triangle.
+    std::vector<int32_t>   order_;     // Triangles, in the order the leaves hold them.
+    std::vector<BuildNode> build_nodes_;
+    size_t                 leaves_;
+    std::vector<Split>     split_stack_;
+    std::vector<Collapse>  collapse_stack_;
+
+    // The split in progress.
+    SplitPass split_pass_;
+    Split     splitting_;
+    int       split_axis_; // -1 to split at the middle by count.
+    int       split_bin_;
+    int32_t   split_cursor_;
+    int32_t   split_end_; // Triangles from here on go right.
+    GLfloat   bin_bounds_[3][BINS][6];
+    int32_t   bin_counts_[3][BINS];
+    GLfloat   side_bounds_[2][6];
+    GLfloat   side_centroid_bounds_[2][6];
+
+    std::vector<TriangleBvhNode> nodes_;
+    std::vector<TrianglePacket>  packets_;
+};
+
+struct RayCastStats {
+    unsigned long casts;
+    unsigned long rays;
+    unsigned long hits;
+    unsigned long meshes_tested; // Mesh trees a ray was taken into.
+    double        cast_ms;
+    double        build_ms; // Of every mesh built so far.
+    unsigned long built_triangles;
+
+    RayCastStats();
+};
+
+// Picks what rays hit among the scene's visible meshes, through the scene's BVH down to each mesh's
+// triangle BVH. Trees are built in the background of the frames, a time slice per update, and meshes only
+// become pickable once theirs is done. Skinned meshes are never picked, as their triangles move on the GPU.
+class RayCaster {
+public:
+    RayCaster();
+
+    // Drops every tree, for when the meshes are replaced.
+    void clear();
+    // Meshes are pickable by default, unless skinned.
+    void set_pickable( int mesh, bool pickable );
+    bool ready( int mesh ) const;
+
+    // Builds trees of meshes that don't have one, for at most budget_ms.
+    void update( const std::vector<Mesh>& meshes, double budget_ms );
+
+    // Closest hit of each ray, in a batch so the rays share the trees' cache lines.
+    void cast( const Bvh& bvh, const Scene& scene, const Ray* rays, size_t count, RayHit* hits );
+
+    const TriangleBvh&  tree( int mesh ) const;
+    const RayCastStats& stats() const;
+
+private:
+    struct Entry {
+        TriangleBvh tree;
+        bool        pickable;
+        bool        started;
+
+        Entry();
+    };
+
+    // Returns how many mesh trees the ray was taken into.
+    unsigned trace( const Bvh& bvh, const Scene& scene, const Ray& ray, RayHit& hit ) const;
+
+    std::vector<Entry> entries_;
+    RayCastStats       stats_;
+};
+
+void print_raycast_stats( const RayCaster& ray_caster );
+
+#endif // WASMVR_RAYCAST_H
@@ -0,0 +1,186 @@
+#include "reprojection.h"
+
+#include <emscripten.h>
+#include <string.h>
+
+#include "framebuffer_pool.h"
+#include "gles.h"
+#include "user_context.h"
+#include "util.h"
+
+Reprojection::Reprojection()
+    : enabled( false )
+    , positional( false )
+    , active( false )
+    , max_consecutive( 1 )
+    , consecutive( 0 )
+    , program( 0 )
+    , sampler2D_color( -1 )
+    , sampler2D_depth( -1 )
+    , mat4_reprojection( -1 )
+    , vec4_eye_rect( -1 )
+    , bool_positional( -1 )
+    , history( nullptr )
+    , reprojected_frames( 0 ) {
+}
+
+bool reprojection_load_shaders( UserContext& user_context ) {
+    Reprojection& reprojection = user_context.reprojection;
+
+    reprojection.program = gles_load_program( "src_asset/reproject.vert", "src_asset/reproject.frag" );
+    if( !reprojection.program ) {
+        STDERR( "Failed to load reprojection program." );
+        return false;
+    }
+
+    reprojection.sampler2D_color   = glGetUniformLocation( reprojection.program, "sampler2D_color" );
+    reprojection.sampler2D_depth   = glGetUniformLocation( reprojection.program, "sampler2D_depth" );
+    reprojection.mat4_reprojection = glGetUniformLocation( reprojection.program, "mat4_reprojection" );
+    reprojection.vec4_eye_rect     = glGetUniformLocation( reprojection.program, "vec4_eye_rect" );
+    reprojection.bool_positional   = glGetUniformLocation( reprojection.program, "bool_positional" );
+    return true;
+}
+
+bool reprojection_should_reproject( UserContext& user_context ) {
+    Reprojection& reprojection = user_context.reprojection;
+
+    const bool possible = reprojection.enabled &&
+                          reprojection.program &&
+                          reprojection.history &&
+                          ( reprojection.history->desc.width == user_context.width ) &&
+                          ( reprojection.history->desc.height == user_context.height );
+    if( !possible ||
+        ( reprojection.consecutive >= reprojection.max_consecutive ) ||
+        !user_context.frame_timer.predict_miss( emscripten_get_now() ) ) {
+        reprojection.consecutive = 0;
+        return false;
+    }
+    return true;
+}
+
+void reprojection_draw( UserContext& user_context, const CameraMatrices* cameras ) {
+    Reprojection& reprojection = user_context.reprojection;
+    reprojection.active        = true;
+    ++reprojection.consecutive;
+    ++reprojection.reprojected_frames;
+
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    user_context.gl_state.disable( GL_DEPTH_TEST );
+    user_context.gl_state.disable( GL_BLEND );
+
+    user_context.gl_state.use_program( reprojection.program );
+
+    glActiveTexture( GL_TEXTURE0 );
+    glBindTexture( GL_TEXTURE_2D, reprojection.history->color );
+    user_context.gl_state.uniform_1i( reprojection.sampler2D_color, 0 );
+    glActiveTexture( GL_TEXTURE1 );
+    glBindTexture( GL_TEXTURE_2D, reprojection.history->depth );
+    user_context.gl_state.uniform_1i( reprojection.sampler2D_depth, 1 );
+    user_context.gl_state.uniform_1i( reprojection.bool_positional, reprojection.positional );
+
+    const GLint width_l = user_context.width / 2;
+    const GLint width_r = user_context.width - width_l;
+    const GLint x[2]    = {0, width_l};
+    const GLint w[2]    = {width_l, width_r};
+    for( int eye = 0; eye < 2; ++eye ) {
+        GLfloat matrix[4 * 4];
+        reprojection_matrix( reprojection.history_cameras[eye], cameras[eye], reprojection.positional, matrix );
+        user_context.gl_state.uniform_matrix4fv( reprojection.mat4_reprojection, GL_FALSE, matrix );
+        user_context.gl_state.uniform_4f(
+            reprojection.vec4_eye_rect,
+            static_cast<GLfloat>( x[eye] ) / user_context.width,
+            0.0f,
+            static_cast<GLfloat>( w[eye] ) / user_context.width,
+            1.0f );
+        user_context.gl_state.viewport( x[eye], 0, w[eye], user_context.height );
+
+        // One oversized triangle generated from gl_VertexID covers the eye.
+        glDrawArrays( GL_TRIANGLES, 0, 3 );
+        user_context.frame_budget.count_draw_calls( 1 );
+    }
+
+    glBindTexture( GL_TEXTURE_2D, 0 );
+    glActiveTexture( GL_TEXTURE0 );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+void reprojection_capture( UserContext& user_context, RenderTarget* target, const CameraMatrices* cameras ) {
+    if( !target ) {
+        return;
+    }
+
+    Reprojection&    reprojection = user_context.reprojection;
+    FramebufferPool& pool         = user_context.framebuffer_pool;
+
+    RenderTarget* history = target;
+    if( target->multisampled() ) {
+        RenderTargetDesc desc = target->desc;
+        desc.samples          = 0;
+        history               = pool.acquire( desc );
+        if( !history ) {
+            gles_end_offscreen( user_context, target );
+            return;
+        }
+
+        // Resolve both color and depth; depth is what positional reprojection needs.
+        glBindFramebuffer( GL_READ_FRAMEBUFFER, target->framebuffer );
+        glBindFramebuffer( GL_DRAW_FRAMEBUFFER, history->framebuffer );
+        glBlitFramebuffer(
+            0, 0, desc.width, desc.height,
+            0, 0, desc.width, desc.height,
+            GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+            GL_NEAREST );
+        render_target_invalidate( *target, true, true );
+        pool.release( target );
+    }
+
+    render_target_resolve( *history, 0 );
+
+    // The previous history goes back to the pool, where the next capture will likely pick it up again.
+    pool.release( reprojection.history );
+    reprojection.history = history;
+    memcpy( reprojection.history_cameras, cameras, sizeof( reprojection.history_cameras ) );
+}
+
+void reprojection_release( Reprojection& reprojection ) {
+    reprojection.program     = 0;
+    reprojection.history     = nullptr;
+    reprojection.active      = false;
+    reprojection.consecutive = 0;
+    for( int eye = 0; eye < 2; ++eye ) {
+        camera_identity( reprojection.history_cameras[eye] );
+    }
+}
+
+void reprojection_matrix( const CameraMatrices& history, const CameraMatrices& current, bool positional, GLfloat* matrix ) {
+    GLfloat history_view[4 * 4];
+    GLfloat current_view[4 * 4];
+    memcpy( history_view, history.view, sizeof( history_view ) );
+    memcpy( current_view, current.view, sizeof( current_view ) );
+    if( !positional ) {
+        for( int i = 12; i < 15; ++i ) {
+            history_view[i] = 0.0f;
+            current_view[i] = 0.0f;
+        }
+    }
+
+    GLfloat inverse_view[4 * 4];
+    GLfloat inverse_projection[4 * 4];
+    if( !gl_matrix4x4_invert( inverse_view, current_view ) ||
+        !gl_matrix4x4_invert( inverse_projection, current.projection ) ) {
+        memcpy( matrix, identity4, sizeof( identity4 ) );
+        return;
+    }
+
+    // current clip -> current view -> world -> history view -> history clip
+    gl_matrix4x4_multiply( matrix, history.projection, history_view );
+    gl_matrix4x4_multiply( matrix, matrix, inverse_view );
+    gl_matrix4x4_multiply( matrix, matrix, inverse_projection );
+}
+
+void print_reprojection_stats( const Reprojection& reprojection ) {
+    STDOUT( "Reprojection: %s (%s), %u frames reprojected.",
+            reprojection.enabled ? "enabled" : "disabled",
+            reprojection.positional ? "positional" : "rotational",
+            reprojection.reprojected_frames );
+}
@@ -0,0 +1,59 @@
+#ifndef WASMVR_REPROJECTION_H
+#define WASMVR_REPROJECTION_H
+
+#include <GLES3/gl3.h>
+
+#include "camera.h"
+
+class UserContext;
+struct RenderTarget;
+
+// Keeps the last rendered frame around so a frame that would miss its deadline
+// can be replaced by that image warped to the newest HMD pose.
+struct Reprojection {
+    bool enabled;
+    bool positional; // Also correct for head translation using the history depth.
+    bool active;     // The current frame is reprojected rather than rendered.
+
+    // Always render at least every max_consecutive + 1 frames.
+    int max_consecutive;
+    int consecutive;
+
+    GLuint program;
+    GLint  sampler2D_color;
+    GLint  sampler2D_depth;
+    GLint  mat4_reprojection;
+    GLint  vec4_eye_rect;
+    GLint  bool_positional;
+
+    RenderTarget*  history;
+    CameraMatrices history_cameras[2];
+
+    unsigned int reprojected_frames;
+
+    Reprojection();
+};
+
+bool reprojection_load_shaders( UserContext& user_context );
+
+// Asks the frame timer whether the frame being started should be reprojected.
+bool reprojection_should_reproject( UserContext& user_context );
+
+// Warps the history frame to cameras and writes it to the default framebuffer.
+void reprojection_draw( UserContext& user_context, const CameraMatrices* cameras );
+
+// Used in place of gles_end_offscreen: keeps a resolved copy of target (color and depth)
+// as the new history frame and presents it.
+void reprojection_capture( UserContext& user_context, RenderTarget* target, const CameraMatrices* cameras );
+
+// Forgets the history frame and the program, e.g. when they died with the context. The history's target
+// is the framebuffer pool's to free, so this goes before the pool is cleared.
+void reprojection_release( Reprojection& reprojection );
+
+// Maps the current camera's normalized device coordinates to the history camera's clip space.
+// Without positional, translation is dropped from both views.
+void reprojection_matrix( const CameraMatrices& history, const CameraMatrices& current, bool positional, GLfloat* matrix );
+
+void print_reprojection_stats( const Reprojection& reprojection );
+
+#endif // WASMVR_REPROJECTION_H
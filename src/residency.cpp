@@ -0,0 +1,353 @@
+#include "residency.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <emscripten/html5.h>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "gles.h"
+#include "reprojection.h"
+#include "scene.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const char* CANVAS_ID = "webgl-canvas";
+
+    // Enough for the default scene many times over, and well under what standalone headsets give a page.
+    const size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+    // About a millisecond of uploads on a standalone headset.
+    const size_t DEFAULT_RELOAD_LIMIT = 4 * 1024 * 1024;
+
+    struct GpuMemory {
+        std::unordered_map<uint64_t, size_t> sizes; // By kind and name.
+        size_t                               bytes[GPU_MEMORY_KINDS];
+
+        GpuMemory()
+            : bytes() {
+        }
+    };
+
+    GpuMemory memory;
+
+    uint64_t memory_key( GpuMemoryKind kind, GLuint name ) {
+        return ( static_cast<uint64_t>( kind ) << 32 ) | name;
+    }
+
+    EM_BOOL on_context_lost( int, const void*, void* arg ) {
+        UserContext& user_context = *( reinterpret_cast<UserContext*>( arg ) );
+        STDERR( "WebGL context lost, waiting for it to be restored." );
+        user_context.residency.context_lost();
+        // Handled, so the browser may restore the context.
+        return true;
+    }
+
+    EM_BOOL on_context_restored( int, const void*, void* arg ) {
+        UserContext& user_context = *( reinterpret_cast<UserContext*>( arg ) );
+        STDOUT( "WebGL context restored, recreating everything." );
+
+        // The old names died with the context, deleting them does nothing, but their owners forget them.
+        user_context.gl_state.reset();
+        reprojection_release( user_context.reprojection );
+        user_context.framebuffer_pool.clear();
+        user_context.instance_ring.release( user_context.gl_state );
+        user_context.light_clusters.release();
+        user_context.skinning.release();
+        user_context.textures.release();
+        user_context.particles.release( user_context.gl_state );
+        user_context.point_cloud.release( user_context.gl_state );
+        user_context.hud.release( user_context.gl_state );
+        user_context.gpu_timer.release();
+        user_context.residency.context_restored();
+
+        if( !gles_load_shaders( user_context ) ) {
+            STDERR( "Failed to set up program again." );
+            return true;
+        }
+        if( !reprojection_load_shaders( user_context ) ) {
+            STDERR( "Continuing without reprojection." );
+        }
+        // Uploads the meshes and adds them as assets again.
+        scene_build_default( user_context );
+        user_context.redraw.request();
+        return true;
+    }
+}
+
+const char* gpu_memory_kind_name( GpuMemoryKind kind ) {
+    switch( kind ) {
+    case GPU_MEMORY_BUFFER: return "buffers";
+    case GPU_MEMORY_TEXTURE: return "textures";
+    case GPU_MEMORY_RENDER_TARGET: return "render targets";
+    default: return "unknown";
+    }
+}
+
+size_t gpu_memory_texel_bytes( GLenum format ) {
+    switch( format ) {
+    case GL_R8:
+    case GL_R8UI: return 1;
+    case GL_R16UI:
+    case GL_R16F:
+    case GL_RG8:
+    case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RG16F:
+    case GL_R32UI:
+    case GL_R32F:
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_RGB10_A2:
+    case GL_R11F_G11F_B10F:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8: return 4;
+    case GL_RG32UI:
+    case GL_RG32F:
+    case GL_RGBA16F:
+    case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA32UI:
+    case GL_RGBA32F: return 16;
+    default: return 4;
+    }
+}
+
+void gpu_memory_allocated( GpuMemoryKind kind, GLuint name, size_t bytes ) {
+    if( !name ) {
+        return;
+    }
+    size_t& size = memory.sizes[memory_key( kind, name )];
+    memory.bytes[kind] += bytes - size;
+    size = bytes;
+}
+
+void gpu_memory_freed( GpuMemoryKind kind, GLuint name ) {
+    auto found = memory.sizes.find( memory_key( kind, name ) );
+    if( found == memory.sizes.end() ) {
+        return;
+    }
+    memory.bytes[kind] -= found->second;
+    memory.sizes.erase( found );
+}
+
+void gpu_memory_forget() {
+    memory = GpuMemory();
+}
+
+size_t gpu_memory_bytes( GpuMemoryKind kind ) {
+    return memory.bytes[kind];
+}
+
+size_t gpu_memory_total() {
+    size_t total = 0;
+    for( int kind = 0; kind < GPU_MEMORY_KINDS; ++kind ) {
+        total += memory.bytes[kind];
+    }
+    return total;
+}
+
+ResidencyStats::ResidencyStats()
+    : evictions( 0 )
+    , reloads( 0 )
+    , failed_reloads( 0 )
+    , evicted_bytes( 0 )
+    , reloaded_bytes( 0 )
+    , context_losses( 0 )
+    , context_restores( 0 )
+    , last_resident_bytes( 0 )
+    , last_evictions( 0 )
+    , last_reloads( 0 )
+    , last_deferred( 0 ) {
+}
+
+GpuResidency::GpuResidency()
+    : budget_( DEFAULT_BUDGET )
+    , reload_limit_( DEFAULT_RELOAD_LIMIT )
+    , frame_( 1 )
+    , frame_reloaded_bytes_( 0 )
+    , lost_( false ) {
+}
+
+void GpuResidency::set_budget( size_t bytes ) {
+    budget_ = bytes;
+}
+
+size_t GpuResidency::budget() const {
+    return budget_;
+}
+
+void GpuResidency::set_reload_limit( size_t bytes ) {
+    reload_limit_ = bytes;
+}
+
+int GpuResidency::add_asset( size_t bytes, Evict evict, Reload reload ) {
+    Asset asset = {bytes, true, frame_, evict, reload};
+    if( !free_.empty() ) {
+        const int handle = free_.back();
+        free_.pop_back();
+        assets_[handle] = asset;
+        return handle;
+    }
+    assets_.push_back( asset );
+    return static_cast<int>( assets_.size() ) - 1;
+}
+
+void GpuResidency::remove_asset( int handle ) {
+    if( ( handle < 0 ) || ( static_cast<size_t>( handle ) >= assets_.size() ) || !assets_[handle].reload ) {
+        return;
+    }
+    // Never resident again, so never evicted, and without a reload never used.
+    Asset removed = {0, false, 0, Evict(), Reload()};
+    assets_[handle] = removed;
+    free_.push_back( handle );
+}
+
+bool GpuResidency::resident( int asset ) const {
+    return ( asset >= 0 ) && ( static_cast<size_t>( asset ) < assets_.size() ) && assets_[asset].resident;
+}
+
+bool GpuResidency::use( int handle ) {
+    if( lost_ || ( static_cast<size_t>( handle ) >= assets_.size() ) ) {
+        return !lost_ && ( handle < 0 );
+    }
+    Asset& asset = assets_[handle];
+    if( !asset.reload ) {
+        return false;
+    }
+    asset.last_used = frame_;
+    if( asset.resident ) {
+        return true;
+    }
+
+    // The first reload of a frame always goes ahead, so even an asset over the limit comes back.
+    if( frame_reloaded_bytes_ && ( frame_reloaded_bytes_ + asset.bytes > reload_limit_ ) ) {
+        ++frame_stats_.last_deferred;
+        return false;
+    }
+    const size_t before = gpu_memory_total();
+    if( !asset.reload() ) {
+        ++stats_.failed_reloads;
+        return false;
+    }
+    const size_t after = gpu_memory_total();
+    asset.bytes        = ( after > before ) ? after - before : asset.bytes;
+    asset.resident     = true;
+    frame_reloaded_bytes_ += asset.bytes;
+    ++stats_.reloads;
+    ++frame_stats_.last_reloads;
+    stats_.reloaded_bytes += asset.bytes;
+    return true;
+}
+
+void GpuResidency::evict( Asset& asset ) {
+    asset.evict();
+    asset.resident = false;
+    ++stats_.evictions;
+    ++frame_stats_.last_evictions;
+    stats_.evicted_bytes += asset.bytes;
+}
+
+void GpuResidency::end_frame() {
+    size_t total = gpu_memory_total();
+    if( !lost_ && ( total > budget_ ) ) {
+        // Least recently drawn first, leaving what this frame drew, which would only come straight back.
+        order_.clear();
+        for( size_t i = 0; i < assets_.size(); ++i ) {
+            if( assets_[i].resident && ( assets_[i].last_used != frame_ ) ) {
+                order_.push_back( static_cast<int>( i ) );
+            }
+        }
+        std::sort( order_.begin(), order_.end(), [&]( int a, int b ) {
+            return assets_[a].last_used < assets_[b].last_used;
+        } );
+        for( size_t i = 0; ( i < order_.size() ) && ( total > budget_ ); ++i ) {
+            Asset& asset = assets_[order_[i]];
+            evict( asset );
+            total = gpu_memory_total();
+        }
+        if( total > budget_ ) {
+            static unsigned long reported = 0;
+            if( reported++ < 10 ) {
+                STDERR( "GPU memory over budget with %lu bytes of %lu, drawn this frame or not evictable.",
+                        static_cast<unsigned long>( total ),
+                        static_cast<unsigned long>( budget_ ) );
+            }
+        }
+    }
+
+    stats_.last_resident_bytes = total;
+    stats_.last_evictions      = frame_stats_.last_evictions;
+    stats_.last_reloads        = frame_stats_.last_reloads;
+    stats_.last_deferred       = frame_stats_.last_deferred;
+    frame_stats_               = ResidencyStats();
+    frame_reloaded_bytes_      = 0;
+    ++frame_;
+}
+
+void GpuResidency::context_lost() {
+    lost_ = true;
+    gpu_memory_forget();
+    for( Asset& asset : assets_ ) {
+        asset.resident = false;
+    }
+    ++stats_.context_losses;
+}
+
+void GpuResidency::context_restored() {
+    lost_ = false;
+    ++stats_.context_restores;
+}
+
+bool GpuResidency::lost() const {
+    return lost_;
+}
+
+size_t GpuResidency::asset_bytes() const {
+    size_t bytes = 0;
+    for( const Asset& asset : assets_ ) {
+        bytes += asset.resident ? asset.bytes : 0;
+    }
+    return bytes;
+}
+
+size_t GpuResidency::assets() const {
+    return assets_.size() - free_.size();
+}
+
+const ResidencyStats& GpuResidency::stats() const {
+    return stats_;
+}
+
+bool residency_initialize( UserContext& user_context ) {
+    void* arg = static_cast<void*>( &user_context );
+    if( ( EMSCRIPTEN_RESULT_SUCCESS != emscripten_set_webglcontextlost_callback( CANVAS_ID, arg, false, on_context_lost ) ) ||
+        ( EMSCRIPTEN_RESULT_SUCCESS != emscripten_set_webglcontextrestored_callback( CANVAS_ID, arg, false, on_context_restored ) ) ) {
+        STDERR( "Failed to attach WebGL context callbacks." );
+        return false;
+    }
+    return true;
+}
+
+void print_residency_stats( const GpuResidency& residency ) {
+    const ResidencyStats& stats = residency.stats();
+    STDOUT( "GPU memory: %.1lf MB of a %.1lf MB budget, %.1lf MB in buffers, %.1lf MB in textures, %.1lf MB in render targets.",
+            stats.last_resident_bytes / ( 1024.0 * 1024.0 ),
+            residency.budget() / ( 1024.0 * 1024.0 ),
+            gpu_memory_bytes( GPU_MEMORY_BUFFER ) / ( 1024.0 * 1024.0 ),
+            gpu_memory_bytes( GPU_MEMORY_TEXTURE ) / ( 1024.0 * 1024.0 ),
+            gpu_memory_bytes( GPU_MEMORY_RENDER_TARGET ) / ( 1024.0 * 1024.0 ) );
+    STDOUT( "Residency: %lu assets holding %.1lf MB, %lu evictions of %.1lf MB and %lu reloads of %.1lf MB (%lu failed), "
+            "last frame %lu evictions, %lu reloads and %lu draws deferred, %lu context losses and %lu restores.",
+            static_cast<unsigned long>( residency.assets() ),
+            residency.asset_bytes() / ( 1024.0 * 1024.0 ),
+            stats.evictions,
+            stats.evicted_bytes / ( 1024.0 * 1024.0 ),
+            stats.reloads,
+            stats.reloaded_bytes / ( 1024.0 * 1024.0 ),
+            stats.failed_reloads,
+            stats.last_evictions,
+            stats.last_reloads,
+            stats.last_deferred,
+            stats.context_losses,
+            stats.context_restores );
+}
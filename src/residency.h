@@ -0,0 +1,118 @@
+#ifndef WASMVR_RESIDENCY_H
+#define WASMVR_RESIDENCY_H
+
+#include <GLES3/gl3.h>
+#include <functional>
+#include <stddef.h>
+#include <vector>
+
+class UserContext;
+
+enum GpuMemoryKind {
+    GPU_MEMORY_BUFFER,
+    GPU_MEMORY_TEXTURE,
+    GPU_MEMORY_RENDER_TARGET, // Textures and renderbuffers of the framebuffer pool.
+    GPU_MEMORY_KINDS
+};
+
+const char* gpu_memory_kind_name( GpuMemoryKind kind );
+// Bytes per texel of a sized internal format, 4 for formats not listed.
+size_t gpu_memory_texel_bytes( GLenum format );
+
+// Bytes of GPU memory behind each GL name, reported next to the GL calls that allocate and free it. Like
+// the names themselves it is one table for the whole context. Reporting a name again replaces its size,
+// for buffers whose storage is respecified.
+void   gpu_memory_allocated( GpuMemoryKind kind, GLuint name, size_t bytes );
+void   gpu_memory_freed( GpuMemoryKind kind, GLuint name );
+// With the context lost every name is gone at once, without being freed.
+void   gpu_memory_forget();
+size_t gpu_memory_bytes( GpuMemoryKind kind );
+size_t gpu_memory_total();
+
+struct ResidencyStats {
+    unsigned long evictions;
+    unsigned long reloads;
+    unsigned long failed_reloads;
+    unsigned long evicted_bytes;
+    unsigned long reloaded_bytes;
+    unsigned long context_losses;
+    unsigned long context_restores;
+
+    // Of the last frame.
+    size_t        last_resident_bytes;
+    unsigned long last_evictions;
+    unsigned long last_reloads;
+    unsigned long last_deferred; // Draws skipped as their asset waits for next frame's reload allowance.
+
+    ResidencyStats();
+};
+
+// Keeps the GPU memory accounted above under a budget by evicting the assets drawn least recently, which
+// are uploaded again the next time they are drawn. Only assets can be evicted, everything else, like
+// render targets and streaming buffers, counts against the budget all the same. Reloads are limited per
+// frame, so a view full of evicted assets comes back over a few frames instead of in one long one.
+class GpuResidency {
+public:
+    // Frees the asset's GPU memory, keeping what it needs to upload it again.
+    typedef std::function<void()> Evict;
+    // Uploads the asset again, returning whether it could.
+    typedef std::function<bool()> Reload;
+
+    GpuResidency();
+
+    void   set_budget( size_t bytes );
+    size_t budget() const;
+    // Bytes reloads may upload per frame. One asset always may, however large.
+    void   set_reload_limit( size_t bytes );
+
+    // An asset of bytes, already uploaded. Returns its handle.
+    int  add_asset( size_t bytes, Evict evict, Reload reload );
+    // Forgets an asset, for when its owner is replaced. Its handle may be given to a later asset.
+    void remove_asset( int asset );
+    bool resident( int asset ) const;
+
+    // The asset is drawn this frame. Reloads it if it was evicted and the frame's allowance isn't spent,
+    // returning whether it can be drawn. Handles below 0 are of GPU memory that is never evicted.
+    bool use( int asset );
+
+    // Evicts the least recently drawn assets, never those drawn this frame, while over budget.
+    void end_frame();
+
+    // The context was lost: nothing is resident any more and nothing can be drawn until it is restored.
+    void context_lost();
+    void context_restored();
+    bool lost() const;
+
+    size_t                asset_bytes() const; // Of the resident assets.
+    size_t                assets() const; // Not counting removed ones.
+    const ResidencyStats& stats() const;
+
+private:
+    struct Asset {
+        size_t        bytes;
+        bool          resident;
+        unsigned long last_used; // Frame it was last drawn in.
+        Evict         evict;
+        Reload        reload;
+    };
+
+    void evict( Asset& asset );
+
+    size_t             budget_;
+    size_t             reload_limit_;
+    std::vector<Asset> assets_;
+    std::vector<int>   free_; // Handles of removed assets.
+    unsigned long      frame_;
+    size_t             frame_reloaded_bytes_;
+    ResidencyStats     frame_stats_; // Counts of the frame so far, only those the last frame has.
+    bool               lost_;
+    std::vector<int>   order_; // Scratch for picking eviction victims.
+    ResidencyStats     stats_;
+};
+
+// Lets the context be restored after it is lost, and rebuilds every GL object of the app when it is.
+bool residency_initialize( UserContext& user_context );
+
+void print_residency_stats( const GpuResidency& residency );
+
+#endif // WASMVR_RESIDENCY_H
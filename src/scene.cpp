@@ -0,0 +1,530 @@
+#include "scene.h"
+
+#include <math.h>
+#include <string.h>
+#include <utility>
+
+#include "clusters.h"
+#include "mesh.h"
+#include "particles.h"
+#include "simd.h"
+#include "skinning.h"
+#include "user_context.h"
+#include "util.h"
+
+const int     SCENE_OBJECT_VERTICES   = 3;
+const GLfloat scene_object_vertices[] = {
+    0.0f, 0.5f, 0.0f,
+    -0.5f, -0.5f, 0.0f,
+    0.5f, -0.5f, 0.0f};
+
+const int SCENE_INSTANCE_GRID_NODES = 100000;
+
+const int     SCENE_TETRAHEDRON_VERTICES   = 12;
+const GLfloat scene_tetrahedron_vertices[] = {
+    0.02f, 0.02f, 0.02f, -0.02f, 0.02f, -0.02f, -0.02f, -0.02f, 0.02f,
+    0.02f, 0.02f, 0.02f, 0.02f, -0.02f, -0.02f, -0.02f, 0.02f, -0.02f,
+    0.02f, 0.02f, 0.02f, -0.02f, -0.02f, 0.02f, 0.02f, -0.02f, -0.02f,
+    -0.02f, 0.02f, -0.02f, 0.02f, -0.02f, -0.02f, -0.02f, -0.02f, 0.02f};
+
+SceneStats::SceneStats()
+    : updates( 0 )
+    , recomputed( 0 )
+    , last_recomputed( 0 ) {
+}
+
+// Defined for where it is bound to a reference, e.g. by push_back().
+const int Scene::NONE;
+
+Scene::Scene()
+    : first_dirty_( 0 )
+    , topology_version_( 0 ) {
+}
+
+void Scene::reserve( size_t nodes ) {
+    parents_.reserve( nodes );
+    translations_.reserve( 3 * nodes );
+    rotations_.reserve( 4 * nodes );
+    scales_.reserve( 3 * nodes );
+    locals_.reserve( 16 * nodes );
+    worlds_.reserve( 16 * nodes );
+    bounds_.reserve( 6 * nodes );
+    world_bounds_.reserve( 6 * nodes );
+    meshes_.reserve( nodes );
+    colors_.reserve( 4 * nodes );
+    skins_.reserve( nodes );
+    flags_.reserve( nodes );
+}
+
+void Scene::clear() {
+    parents_.clear();
+    translations_.clear();
+    rotations_.clear();
+    scales_.clear();
+    locals_.clear();
+    worlds_.clear();
+    bounds_.clear();
+    world_bounds_.clear();
+    meshes_.clear();
+    colors_.clear();
+    skins_.clear();
+    flags_.clear();
+    changed_.clear();
+    first_dirty_ = 0;
+    ++topology_version_;
+}
+
+size_t Scene::size() const {
+    return parents_.size();
+}
+
+int Scene::add_node( int parent ) {
+    const int node = static_cast<int>( size() );
+    if( ( parent < NONE ) || ( parent >= node ) ) {
+        STDERR( "Scene node %d can not have parent %d.", node, parent );
+        parent = NONE;
+    }
+
+    parents_.push_back( parent );
+    translations_.insert( translations_.end(), 3, 0.0f );
+    rotations_.push_back( 1.0f );
+    rotations_.insert( rotations_.end(), 3, 0.0f );
+    scales_.insert( scales_.end(), 3, 1.0f );
+    locals_.insert( locals_.end(), identity4, identity4 + 16 );
+    worlds_.insert( worlds_.end(), identity4, identity4 + 16 );
+    bounds_.insert( bounds_.end(), 6, 0.0f );
+    world_bounds_.insert( world_bounds_.end(), 6, 0.0f );
+    meshes_.push_back( NONE );
+    colors_.insert( colors_.end(), {255, 0, 0, 255} );
+    skins_.push_back( NONE );
+    flags_.push_back( FLAG_VISIBLE );
+    ++topology_version_;
+    mark_dirty( node, FLAG_WORLD_DIRTY );
+    return node;
+}
+
+int Scene::parent( int node ) const {
+    return parents_[node];
+}
+
+void Scene::set_translation( int node, GLfloat x, GLfloat y, GLfloat z ) {
+    GLfloat* t = &translations_[3 * node];
+    t[0]       = x;
+    t[1]       = y;
+    t[2]       = z;
+    mark_dirty( node, FLAG_TRS_DIRTY | FLAG_WORLD_DIRTY );
+}
+
+void Scene::set_rotation( int node, GLfloat qw, GLfloat qx, GLfloat qy, GLfloat qz ) {
+    GLfloat* r = &rotations_[4 * node];
+    r[0]       = qw;
+    r[1]       = qx;
+    r[2]       = qy;
+    r[3]       = qz;
+    mark_dirty( node, FLAG_TRS_DIRTY | FLAG_WORLD_DIRTY );
+}
+
+void Scene::set_scale( int node, GLfloat x, GLfloat y, GLfloat z ) {
+    GLfloat* s = &scales_[3 * node];
+    s[0]       = x;
+    s[1]       = y;
+    s[2]       = z;
+    mark_dirty( node, FLAG_TRS_DIRTY | FLAG_WORLD_DIRTY );
+}
+
+void Scene::set_local_matrix( int node, const GLfloat* matrix ) {
+    memcpy( &locals_[16 * node], matrix, 16 * sizeof( GLfloat ) );
+    flags_[node] &= ~FLAG_TRS_DIRTY;
+    mark_dirty( node, FLAG_WORLD_DIRTY );
+}
+
+void Scene::set_visible( int node, bool visible ) {
+    if( visible ) {
+        flags_[node] |= FLAG_VISIBLE;
+    } else {
+        flags_[node] &= ~FLAG_VISIBLE;
+    }
+}
+
+bool Scene::visible( int node ) const {
+    return flags_[node] & FLAG_VISIBLE;
+}
+
+void Scene::set_bounds( int node, const GLfloat* min, const GLfloat* max ) {
+    memcpy( &bounds_[6 * node + 0], min, 3 * sizeof( GLfloat ) );
+    memcpy( &bounds_[6 * node + 3], max, 3 * sizeof( GLfloat ) );
+    if( !( flags_[node] & FLAG_BOUNDS ) ) {
+        flags_[node] |= FLAG_BOUNDS;
+        ++topology_version_;
+    }
+    mark_dirty( node, FLAG_WORLD_DIRTY );
+}
+
+bool Scene::has_bounds( int node ) const {
+    return flags_[node] & FLAG_BOUNDS;
+}
+
+const GLfloat* Scene::world_bounds( int node ) const {
+    return &world_bounds_[6 * node];
+}
+
+void Scene::set_mesh( int node, int mesh ) {
+    meshes_[node] = mesh;
+}
+
+int Scene::mesh( int node ) const {
+    return meshes_[node];
+}
+
+void Scene::set_color( int node, GLubyte r, GLubyte g, GLubyte b, GLubyte a ) {
+    GLubyte* c = &colors_[4 * node];
+    c[0]       = r;
+    c[1]       = g;
+    c[2]       = b;
+    c[3]       = a;
+}
+
+const GLubyte* Scene::color( int node ) const {
+    return &colors_[4 * node];
+}
+
+void Scene::set_skin( int node, int first_bone ) {
+    skins_[node] = first_bone;
+}
+
+int Scene::skin( int node ) const {
+    return skins_[node];
+}
+
+size_t Scene::update() {
+    const size_t count = size();
+    changed_.clear();
+    if( first_dirty_ >= count ) {
+        stats_.last_recomputed = 0;
+        return 0;
+    }
+
+    const int32_t* parents    = parents_.data();
+    uint8_t*       flags      = flags_.data();
+    const GLfloat* locals     = locals_.data();
+    GLfloat*       worlds     = worlds_.data();
+    size_t         recomputed = 0;
+
+    for( size_t i = first_dirty_; i < count; ++i ) {
+        const int32_t parent = parents[i];
+        if( ( parent != NONE ) && ( flags[parent] & FLAG_WORLD_DIRTY ) ) {
+            flags[i] |= FLAG_WORLD_DIRTY;
+        }
+        if( !( flags[i] & FLAG_WORLD_DIRTY ) ) {
+            continue;
+        }
+
+        if( flags[i] & FLAG_TRS_DIRTY ) {
+            compose_local( i );
+            flags[i] &= ~FLAG_TRS_DIRTY;
+        }
+        if( parent == NONE ) {
+            memcpy( worlds + 16 * i, locals + 16 * i, 16 * sizeof( GLfloat ) );
+        } else {
+            float4x4_multiply( worlds + 16 * i, worlds + 16 * parent, locals + 16 * i );
+        }
+        if( flags[i] & FLAG_BOUNDS ) {
+            transform_bounds( i );
+        }
+        changed_.push_back( static_cast<int32_t>( i ) );
+        ++recomputed;
+    }
+
+    // Children look at their parent's flag during the sweep, so flags are only cleared after it.
+    for( size_t i = first_dirty_; i < count; ++i ) {
+        flags[i] &= ~FLAG_WORLD_DIRTY;
+    }
+    first_dirty_ = count;
+
+    ++stats_.updates;
+    stats_.recomputed += recomputed;
+    stats_.last_recomputed = recomputed;
+    return recomputed;
+}
+
+const GLfloat* Scene::world_matrix( int node ) const {
+    return &worlds_[16 * node];
+}
+
+bool Scene::dirty() const {
+    return first_dirty_ < size();
+}
+
+const std::vector<int32_t>& Scene::changed() const {
+    return changed_;
+}
+
+unsigned int Scene::topology_version() const {
+    return topology_version_;
+}
+
+const SceneStats& Scene::stats() const {
+    return stats_;
+}
+
+void Scene::mark_dirty( int node, uint8_t flags ) {
+    flags_[node] |= flags;
+    if( static_cast<size_t>( node ) < first_dirty_ ) {
+        first_dirty_ = node;
+    }
+}
+
+void Scene::compose_local( size_t node ) {
+    const GLfloat* t = &translations_[3 * node];
+    const GLfloat* r = &rotations_[4 * node];
+    const GLfloat* s = &scales_[3 * node];
+    GLfloat*       m = &locals_[16 * node];
+
+    const GLfloat w = r[0];
+    const GLfloat x = r[1];
+    const GLfloat y = r[2];
+    const GLfloat z = r[3];
+
+    // Rows of translate * rotate * scale: the rotation's columns are scaled, the translation is not.
+    const float4 scale = float4_make( s[0], s[1], s[2], 1.0f );
+    float4_store( m + 0, float4_make( 1 - 2 * ( y * y + z * z ), 2 * ( x * y - z * w ), 2 * ( x * z + y * w ), t[0] ) * scale );
+    float4_store( m + 4, float4_make( 2 * ( x * y + z * w ), 1 - 2 * ( x * x + z * z ), 2 * ( y * z - x * w ), t[1] ) * scale );
+    float4_store( m + 8, float4_make( 2 * ( x * z - y * w ), 2 * ( y * z + x * w ), 1 - 2 * ( x * x + y * y ), t[2] ) * scale );
+    float4_store( m + 12, float4_make( 0.0f, 0.0f, 0.0f, 1.0f ) );
+}
+
+void Scene::transform_bounds( size_t node ) {
+    const GLfloat* m   = &worlds_[16 * node];
+    const GLfloat* box = &bounds_[6 * node];
+    GLfloat*       out = &world_bounds_[6 * node];
+
+    // Transform the center and take the extent along each world axis from the absolute rotation (Arvo).
+    const float4 center = float4_make(
+        0.5f * ( box[0] + box[3] ),
+        0.5f * ( box[1] + box[4] ),
+        0.5f * ( box[2] + box[5] ),
+        1.0f );
+    const float4 extent = float4_make(
+        0.5f * ( box[3] - box[0] ),
+        0.5f * ( box[4] - box[1] ),
+        0.5f * ( box[5] - box[2] ),
+        0.0f );
+    for( int i = 0; i < 3; ++i ) {
+        const float4 row      = float4_load( m + 4 * i );
+        const float4 c        = row * center;
+        const float4 e        = float4_abs( row ) * extent;
+        const float  center_i = c[0] + c[1] + c[2] + c[3];
+        const float  extent_i = e[0] + e[1] + e[2];
+        out[i]                = center_i - extent_i;
+        out[3 + i]            = center_i + extent_i;
+    }
+}
+
+void scene_build_default( UserContext& user_context ) {
+    Scene&             scene  = user_context.scene;
+    std::vector<Mesh>& meshes = user_context.meshes;
+    scene.clear();
+    for( Mesh& mesh : meshes ) {
+        user_context.residency.remove_asset( mesh.residency );
+        mesh_release( user_context.gl_state, mesh );
+    }
+    meshes.clear();
+    user_context.skeletons.clear();
+    user_context.skinning.clear();
+
+    // Meshes are the assets evicted when over the GPU memory budget, their vertices stay to upload again.
+    auto add_mesh = [&]( Mesh mesh ) -> int {
+        mesh_optimize( mesh );
+        const size_t before = gpu_memory_total();
+        if( !mesh_upload( user_context, mesh, user_context.mesh_format ) ) {
+            return Scene::NONE;
+        }
+        const size_t bytes = gpu_memory_total() - before;
+        const int    index = static_cast<int>( meshes.size() );
+        meshes.push_back( std::move( mesh ) );
+        meshes[index].residency = user_context.residency.add_asset(
+            bytes,
+            [&user_context, index]() { mesh_release( user_context.gl_state, user_context.meshes[index] ); },
+            [&user_context, index]() {
+                Mesh& evicted = user_context.meshes[index];
+                return mesh_upload( user_context, evicted, evicted.format );
+            } );
+        return index;
+    };
+    // Bounds match the mesh drawn for each node.
+    auto attach_mesh = [&]( int node, int mesh ) {
+        if( mesh != Scene::NONE ) {
+            scene.set_mesh( node, mesh );
+            scene.set_bounds( node, meshes[mesh].bounds, meshes[mesh].bounds + 3 );
+        }
+    };
+
+    // A scene file replaces the object and the sphere, the object's node stays for the simulation to move.
+    const bool from_file     = user_context.scene_file.ready();
+    user_context.node_object = scene.add_node( Scene::NONE );
+    user_context.occlusion.clear_occluders();
+    if( !from_file ) {
+        const int object_mesh = add_mesh( mesh_from_triangles( scene_object_vertices, SCENE_OBJECT_VERTICES ) );
+
+        // A dense mesh with a chain of simplified levels, for LOD selection to work on.
+        Mesh sphere = mesh_create_sphere( 0.25f, 32, 64 );
+        mesh_build_lods( sphere, 6, 0.5f );
+        const int sphere_mesh = add_mesh( std::move( sphere ) );
+
+        attach_mesh( user_context.node_object, object_mesh );
+        user_context.occlusion.add_occluder( user_context.node_object, scene_object_vertices, SCENE_OBJECT_VERTICES );
+
+        const int node_sphere = scene.add_node( Scene::NONE );
+        scene.set_translation( node_sphere, -0.75f, 0.0f, -1.5f );
+        attach_mesh( node_sphere, sphere_mesh );
+    }
+
+    user_context.node_hmd = scene.add_node( Scene::NONE );
+    scene.set_visible( user_context.node_hmd, false );
+
+    // Skinned meshes with their skeletons, each node posed by its own range of the bone palettes.
+    auto add_skinned = [&]( int node, Skeleton skeleton, Mesh mesh, GLfloat phase ) {
+        const int mesh_index = add_mesh( std::move( mesh ) );
+        if( mesh_index == Scene::NONE ) {
+            return;
+        }
+        user_context.skeletons.push_back( std::move( skeleton ) );
+        const int skeleton_index = static_cast<int>( user_context.skeletons.size() ) - 1;
+        attach_mesh( node, mesh_index );
+        scene.set_skin( node, static_cast<int>( user_context.skinning.add( user_context.skeletons, skeleton_index, mesh_index, phase ) ) );
+    };
+
+    for( int i = 0; i < 2; ++i ) {
+        // Controllers only show up once they report a pose, as hands opening and closing around them.
+        user_context.node_controllers[i] = scene.add_node( Scene::NONE );
+        Skeleton skeleton;
+        Mesh     hand;
+        skinned_create_hand( i == 0, skeleton, hand );
+        add_skinned( user_context.node_controllers[i], std::move( skeleton ), std::move( hand ), 1.5f * i );
+        scene.set_color( user_context.node_controllers[i], 230, 180, 150, 255 );
+        scene.set_visible( user_context.node_controllers[i], false );
+    }
+
+    // A dot where each controller points, moved there by vr_scene_pick. Its own rays must pass through it.
+    user_context.ray_caster.clear();
+    const int pointer_mesh = add_mesh( mesh_create_sphere( 0.01f, 6, 12 ) );
+    if( pointer_mesh != Scene::NONE ) {
+        user_context.ray_caster.set_pickable( pointer_mesh, false );
+    }
+    for( int i = 0; i < 2; ++i ) {
+        user_context.node_pointer_hits[i] = scene.add_node( Scene::NONE );
+        attach_mesh( user_context.node_pointer_hits[i], pointer_mesh );
+        scene.set_color( user_context.node_pointer_hits[i], 255, 255, 255, 255 );
+        scene.set_visible( user_context.node_pointer_hits[i], false );
+    }
+
+    if( from_file ) {
+        user_context.scene_file.instantiate( user_context );
+    }
+
+    // Rows of figures behind the object, sharing one skeleton and mesh but each animated on its own.
+    if( user_context.skinned_characters > 0 ) {
+        const int     count   = user_context.skinned_characters;
+        const int     PER_ROW = 10;
+        const GLfloat SPACING = 0.8f;
+        Skeleton      skeleton;
+        Mesh          avatar;
+        skinned_create_avatar( skeleton, avatar );
+        const int avatar_mesh = add_mesh( std::move( avatar ) );
+        user_context.skeletons.push_back( std::move( skeleton ) );
+        const int avatar_skeleton = static_cast<int>( user_context.skeletons.size() ) - 1;
+        scene.reserve( scene.size() + count );
+        for( int i = 0; ( i < count ) && ( avatar_mesh != Scene::NONE ); ++i ) {
+            const int node = scene.add_node( Scene::NONE );
+            scene.set_translation( node, ( i % PER_ROW - 0.5f * ( PER_ROW - 1 ) ) * SPACING, -1.2f, -3.0f - ( i / PER_ROW ) * SPACING );
+            scene.set_color( node, static_cast<GLubyte>( 80 + 17 * ( i % 10 ) ), 160, static_cast<GLubyte>( 230 - 13 * ( i % 10 ) ), 255 );
+            attach_mesh( node, avatar_mesh );
+            scene.set_skin( node, static_cast<int>( user_context.skinning.add( user_context.skeletons, avatar_skeleton, avatar_mesh, 0.37f * i ) ) );
+        }
+    }
+
+    // A cube of tetrahedra in front of the viewer, coloured by where they are in it.
+    if( user_context.instance_grid > 0 ) {
+        const int     count     = user_context.instance_grid;
+        const int     side      = static_cast<int>( ceil( cbrt( static_cast<double>( count ) ) ) );
+        const GLfloat SPACING   = 0.12f;
+        const int     grid_mesh = add_mesh( mesh_from_triangles( scene_tetrahedron_vertices, SCENE_TETRAHEDRON_VERTICES ) );
+        const int     grid      = scene.add_node( Scene::NONE );
+        const GLfloat half      = 0.5f * SPACING * ( side - 1 );
+        scene.reserve( scene.size() + count );
+        scene.set_translation( grid, 0.0f, 0.0f, -2.0f - half );
+        for( int i = 0; i < count; ++i ) {
+            const int x    = i % side;
+            const int y    = ( i / side ) % side;
+            const int z    = i / ( side * side );
+            const int node = scene.add_node( grid );
+            scene.set_translation( node, x * SPACING - half, y * SPACING - half, z * SPACING - half );
+            scene.set_color( node, static_cast<GLubyte>( 255 * x / side ), static_cast<GLubyte>( 255 * y / side ), static_cast<GLubyte>( 255 * z / side ), 255 );
+            attach_mesh( node, grid_mesh );
+        }
+    }
+
+    // Coloured point lights on a ring around the scene, and with the grid, many small ones through it.
+    std::vector<PointLight> lights;
+    auto add_light = [&]( GLfloat x, GLfloat y, GLfloat z, GLfloat radius, int hue ) {
+        const GLfloat palette[6][3] = {{1.0f, 0.3f, 0.3f}, {1.0f, 0.8f, 0.3f}, {0.3f, 1.0f, 0.3f},
+                                       {0.3f, 1.0f, 1.0f}, {0.3f, 0.3f, 1.0f}, {1.0f, 0.3f, 1.0f}};
+        const GLfloat* color = palette[hue % 6];
+        PointLight     light = {{x, y, z}, radius, {color[0], color[1], color[2]}, 0.8f};
+        lights.push_back( light );
+    };
+    const int RING_LIGHTS = 12;
+    for( int i = 0; i < RING_LIGHTS; ++i ) {
+        const GLfloat angle = 6.2831853f * i / RING_LIGHTS;
+        add_light( 1.5f * cosf( angle ), 0.25f * ( i % 3 ), -1.5f + 1.5f * sinf( angle ), 1.0f, i );
+    }
+    if( user_context.instance_grid > 0 ) {
+        const int     side    = static_cast<int>( ceil( cbrt( static_cast<double>( user_context.instance_grid ) ) ) );
+        const GLfloat SPACING = 0.12f;
+        const GLfloat half    = 0.5f * SPACING * ( side - 1 );
+        const int     STEP    = 4; // Grid cells between lights along each axis.
+        for( int z = 0; z < side; z += STEP ) {
+            for( int y = 0; y < side; y += STEP ) {
+                for( int x = 0; x < side; x += STEP ) {
+                    add_light( x * SPACING - half, y * SPACING - half, -2.0f - half + z * SPACING - half, 1.5f * STEP * SPACING, x + y + z );
+                }
+            }
+        }
+    }
+    user_context.light_clusters.set_lights( lights );
+
+    // A spark emitter per controller, placed every frame from its pose, and a box of motes around the object.
+    ParticleSystem& particles = user_context.particles;
+    particles.clear_emitters();
+    for( int i = 0; i < 2; ++i ) {
+        user_context.emitter_controllers[i] = particles.add_emitter( PARTICLE_SPARK, 4000.0f );
+    }
+    if( user_context.particle_motes > 0 ) {
+        const GLfloat MOTE_LIFE = 5.0f; // On average, emitting this many seconds' worth keeps the count steady.
+        // clang-format off
+        const GLfloat box[4 * 4] = {
+            2.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 2.0f, -1.5f,
+            0.0f, 0.0f, 0.0f, 1.0f};
+        // clang-format on
+        const int motes = particles.add_emitter( PARTICLE_MOTE, user_context.particle_motes / MOTE_LIFE );
+        particles.set_emitter( motes, box, nullptr, 1.0f );
+        // Starting out full rather than fading in over a mote's life.
+        const size_t wanted = static_cast<size_t>( user_context.particle_motes );
+        if( particles.alive( PARTICLE_MOTE ) < wanted ) {
+            particles.emit( motes, wanted - particles.alive( PARTICLE_MOTE ) );
+        }
+    }
+
+    scene.update();
+}
+
+void print_scene_stats( const Scene& scene ) {
+    const SceneStats& stats = scene.stats();
+    STDOUT( "Scene: %lu nodes, %lu updates recomputed %lu world matrices, %lu in the last one.",
+            static_cast<unsigned long>( scene.size() ),
+            stats.updates,
+            stats.recomputed,
+            static_cast<unsigned long>( stats.last_recomputed ) );
+}
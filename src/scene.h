@@ -0,0 +1,122 @@
+#ifndef WASMVR_SCENE_H
+#define WASMVR_SCENE_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class UserContext;
+
+struct SceneStats {
+    unsigned long updates;
+    unsigned long recomputed; // World matrices recomputed over all updates.
+    size_t        last_recomputed;
+
+    SceneStats();
+};
+
+// A transform hierarchy stored as structure of arrays. Parents are always added before their children,
+// so the arrays are in topological order and one forward sweep brings every world matrix up to date.
+// Only nodes that changed, and their descendants, have their matrices recomputed.
+// All matrices are row major, like the model matrices the scene shader takes.
+class Scene {
+public:
+    static const int NONE = -1;
+
+    Scene();
+
+    void   reserve( size_t nodes );
+    void   clear();
+    size_t size() const;
+
+    // parent has to be NONE or an existing node. Returns the new node.
+    int add_node( int parent );
+    int parent( int node ) const;
+
+    // Local transform as translation, rotation (quaternion) and scale.
+    void set_translation( int node, GLfloat x, GLfloat y, GLfloat z );
+    void set_rotation( int node, GLfloat qw, GLfloat qx, GLfloat qy, GLfloat qz );
+    void set_scale( int node, GLfloat x, GLfloat y, GLfloat z );
+    // Local transform as a matrix, e.g. a tracked pose. Replaces the translation, rotation and scale
+    // until one of them is set again.
+    void set_local_matrix( int node, const GLfloat* matrix );
+
+    void set_visible( int node, bool visible );
+    bool visible( int node ) const;
+
+    // Local axis aligned bounding box. Only nodes with bounds can be culled and drawn.
+    void set_bounds( int node, const GLfloat* min, const GLfloat* max );
+    bool has_bounds( int node ) const;
+    // World space bounding box as min x, y, z followed by max x, y, z.
+    const GLfloat* world_bounds( int node ) const;
+
+    // Index of the mesh drawn for the node, or NONE.
+    void set_mesh( int node, int mesh );
+    int  mesh( int node ) const;
+    // RGBA the mesh is drawn in, red by default.
+    void           set_color( int node, GLubyte r, GLubyte g, GLubyte b, GLubyte a );
+    const GLubyte* color( int node ) const;
+    // Where the node's bone palette starts, for a skinned mesh, or NONE.
+    void set_skin( int node, int first_bone );
+    int  skin( int node ) const;
+
+    // Recomputes the world matrices of changed nodes and their descendants, returning how many.
+    size_t         update();
+    const GLfloat* world_matrix( int node ) const;
+    bool           dirty() const;
+    // Nodes whose world matrix was recomputed by the last update().
+    const std::vector<int32_t>& changed() const;
+    // Changes whenever nodes are added or removed or gain bounds, i.e. when structures built
+    // over the scene have to be rebuilt instead of refit.
+    unsigned int topology_version() const;
+
+    const SceneStats& stats() const;
+
+private:
+    enum Flags {
+        FLAG_TRS_DIRTY   = 1 << 0, // The local matrix has to be rebuilt from translation, rotation and scale.
+        FLAG_WORLD_DIRTY = 1 << 1, // The world matrix has to be recomputed.
+        FLAG_VISIBLE     = 1 << 2,
+        FLAG_BOUNDS      = 1 << 3,
+    };
+
+    void mark_dirty( int node, uint8_t flags );
+    void compose_local( size_t node );
+    void transform_bounds( size_t node );
+
+    std::vector<int32_t> parents_;
+    std::vector<GLfloat> translations_; // 3 per node.
+    std::vector<GLfloat> rotations_;    // 4 per node, w first.
+    std::vector<GLfloat> scales_;       // 3 per node.
+    std::vector<GLfloat> locals_;       // 16 per node.
+    std::vector<GLfloat> worlds_;       // 16 per node.
+    std::vector<GLfloat> bounds_;       // 6 per node, local.
+    std::vector<GLfloat> world_bounds_; // 6 per node.
+    std::vector<int32_t> meshes_;
+    std::vector<GLubyte> colors_;       // 4 per node.
+    std::vector<int32_t> skins_;
+    std::vector<uint8_t> flags_;
+    std::vector<int32_t> changed_;
+
+    size_t       first_dirty_; // Nodes before this one are all up to date.
+    unsigned int topology_version_;
+    SceneStats   stats_;
+};
+
+// Triangle list, three floats per vertex, the object's mesh is made from.
+extern const int     SCENE_OBJECT_VERTICES;
+extern const GLfloat scene_object_vertices[];
+
+// Small tetrahedra in a grid that scene_build_default() adds user_context.instance_grid of.
+extern const int     SCENE_INSTANCE_GRID_NODES;
+extern const int     SCENE_TETRAHEDRON_VERTICES;
+extern const GLfloat scene_tetrahedron_vertices[];
+
+// Adds the nodes the app draws or tracks to user_context.scene, and uploads their meshes to user_context.meshes.
+// The meshes and nodes of user_context.scene_file, once it has arrived, replace the built-in object and sphere.
+void scene_build_default( UserContext& user_context );
+
+void print_scene_stats( const Scene& scene );
+
+#endif // WASMVR_SCENE_H
@@ -0,0 +1,344 @@
+#include "scene_file.h"
+
+#include <emscripten.h>
+#include <map>
+#include <string.h>
+
+#include "residency.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    bool verify_scene( flatbuffers::Verifier& verifier ) {
+        return SceneFormat::VerifySceneBuffer( verifier );
+    }
+
+    const SceneFormat::Scene* get_scene( const void* data ) {
+        return SceneFormat::GetScene( data );
+    }
+
+    // clang-format off
+    EM_JS( void, save_scene_file, ( const char* name, const uint8_t* data, int size ), { impl_save_file( UTF8ToString( name ), HEAPU8.slice( data, data + size ) ); } );
+    // clang-format on
+}
+
+SceneFileStats::SceneFileStats()
+    : loads( 0 )
+    , failures( 0 )
+    , bytes( 0 )
+    , fetch_ms( 0.0 )
+    , verify_ms( 0.0 )
+    , upload_ms( 0.0 )
+    , meshes( 0 )
+    , nodes( 0 ) {
+}
+
+SceneFile::SceneFile()
+    : request_( -1 )
+    , open_ms_( 0.0 ) {
+}
+
+void SceneFile::open( UserContext& user_context, const std::string& url ) {
+    close();
+    url_     = url;
+    open_ms_ = emscripten_get_now();
+    STDOUT( "Opening scene file %s.", url_.c_str() );
+    // Not freed after on_load(), the data becomes the container's slab and is read where it arrived.
+    request_ = emscripten_async_wget2_data( url_.c_str(), "GET", nullptr, &user_context, 0, on_load, on_error, nullptr );
+}
+
+void SceneFile::close() {
+    // Aborted fetches never call back.
+    if( request_ >= 0 ) {
+        emscripten_async_wget2_abort( request_ );
+        request_ = -1;
+    }
+    container_.release();
+    url_.clear();
+}
+
+bool SceneFile::opened() const {
+    return !url_.empty();
+}
+
+bool SceneFile::ready() const {
+    return container_.view() != nullptr;
+}
+
+const std::string& SceneFile::url() const {
+    return url_;
+}
+
+void SceneFile::on_load( unsigned, void* arg, void* data, unsigned size ) {
+    UserContext& user_context = *static_cast<UserContext*>( arg );
+    SceneFile&   file         = user_context.scene_file;
+    file.request_             = -1;
+
+    const double start_ms = emscripten_get_now();
+    file.stats_.fetch_ms  = start_ms - file.open_ms_;
+    const bool valid      = SceneContainer::slab(
+        &file.container_,
+        [data, size]( uint8_t** slab ) -> int {
+            *slab = static_cast<uint8_t*>( data );
+            return static_cast<int>( size );
+        },
+        verify_scene,
+        get_scene );
+    file.stats_.verify_ms = emscripten_get_now() - start_ms;
+    if( !valid ) {
+        STDERR( "Scene file %s is not a valid scene.", file.url_.c_str() );
+        file.container_.release();
+        ++file.stats_.failures;
+        return;
+    }
+    ++file.stats_.loads;
+    file.stats_.bytes = size;
+    STDOUT( "Scene file %s arrived, %u bytes verified in %.2lf ms.", file.url_.c_str(), size, file.stats_.verify_ms );
+
+    scene_build_default( user_context );
+    user_context.redraw.request();
+}
+
+void SceneFile::on_error( unsigned, void* arg, int status, const char* ) {
+    UserContext& user_context = *static_cast<UserContext*>( arg );
+    SceneFile&   file         = user_context.scene_file;
+    file.request_             = -1;
+    STDERR( "Failed to fetch scene file %s, status %d.", file.url_.c_str(), status );
+    ++file.stats_.failures;
+}
+
+void SceneFile::instantiate( UserContext& user_context ) {
+    const SceneFormat::Scene* file = container_.view();
+    if( !file ) {
+        return;
+    }
+    const double       start_ms = emscripten_get_now();
+    Scene&             scene    = user_context.scene;
+    std::vector<Mesh>& meshes   = user_context.meshes;
+
+    // The verifier only checks the buffer's structure, what the ranges and indices point at is checked here.
+    // Indices past the vertices are left to WebGL, which checks every draw.
+    auto add_mesh = [&]( const SceneFormat::Mesh& record ) -> int {
+        const uint8_t*                                      vertices   = scene_format_range( *file, record.vertices() );
+        const uint8_t*                                      indices    = scene_format_range( *file, record.indices() );
+        const flatbuffers::Vector<float>*                   dequantize = record.dequantize();
+        const flatbuffers::Vector<const SceneFormat::Lod*>* lods       = record.lods();
+        if( !vertices || !indices || !record.bounds() || !lods || !lods->size() || ( record.format() > SceneFormat::VertexFormat_MAX ) ||
+            ( dequantize && ( dequantize->size() != 4 * 4 ) ) ) {
+            return Scene::NONE;
+        }
+        const MeshVertexFormat format       = static_cast<MeshVertexFormat>( record.format() );
+        const size_t           vertex_bytes = record.vertices()->size();
+        const size_t           index_bytes  = record.indices()->size();
+        const size_t           index_size   = record.short_indices() ? sizeof( uint16_t ) : sizeof( uint32_t );
+        if( ( vertex_bytes % mesh_vertex_size( format ) ) || ( index_bytes % index_size ) ) {
+            return Scene::NONE;
+        }
+
+        Mesh mesh;
+        mesh.format     = format;
+        mesh.index_type = record.short_indices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        if( dequantize ) {
+            memcpy( mesh.dequantize, dequantize->data(), sizeof( mesh.dequantize ) );
+        }
+        const SceneFormat::Bounds& bounds = *record.bounds();
+        const GLfloat              box[6] = {bounds.min().x(), bounds.min().y(), bounds.min().z(), bounds.max().x(), bounds.max().y(), bounds.max().z()};
+        memcpy( mesh.bounds, box, sizeof( mesh.bounds ) );
+        for( const SceneFormat::Lod* lod : *lods ) {
+            if( ( lod->first_index() > index_bytes / index_size ) || ( lod->index_count() > index_bytes / index_size - lod->first_index() ) ) {
+                return Scene::NONE;
+            }
+            const MeshLod level = {lod->first_index(), lod->index_count(), lod->error()};
+            mesh.lods.push_back( level );
+        }
+
+        const size_t before = gpu_memory_total();
+        if( !mesh_upload_packed( user_context, mesh, vertices, vertex_bytes, indices, index_bytes ) ) {
+            return Scene::NONE;
+        }
+        const size_t bytes = gpu_memory_total() - before;
+        const int    index = static_cast<int>( meshes.size() );
+        meshes.push_back( std::move( mesh ) );
+        // Evicted meshes are uploaded again from the file, which outlives them.
+        meshes[index].residency = user_context.residency.add_asset(
+            bytes,
+            [&user_context, index]() { mesh_release( user_context.gl_state, user_context.meshes[index] ); },
+            [&user_context, index, vertices, vertex_bytes, indices, index_bytes]() {
+                return mesh_upload_packed( user_context, user_context.meshes[index], vertices, vertex_bytes, indices, index_bytes );
+            } );
+        // Without vertices of their own there is nothing to pick them by.
+        user_context.ray_caster.set_pickable( index, false );
+        return index;
+    };
+
+    std::vector<int> file_meshes;
+    if( file->meshes() ) {
+        for( const SceneFormat::Mesh* record : *file->meshes() ) {
+            const int mesh = add_mesh( *record );
+            if( mesh == Scene::NONE ) {
+                STDERR( "Skipping mesh %lu of scene file %s.", static_cast<unsigned long>( file_meshes.size() ), url_.c_str() );
+            }
+            file_meshes.push_back( mesh );
+        }
+    }
+
+    // The first material with an albedo gives the scene its albedo, which is sampled by every mesh.
+    const flatbuffers::Vector<flatbuffers::Offset<SceneFormat::Material>>* materials = file->materials();
+    if( materials ) {
+        for( const SceneFormat::Material* material : *materials ) {
+            if( material->albedo() ) {
+                const size_t      slash = url_.rfind( '/' );
+                const std::string base  = ( slash == std::string::npos ) ? std::string() : url_.substr( 0, slash + 1 );
+                user_context.textures.set_albedo( user_context.textures.load( base + material->albedo()->str() ) );
+                break;
+            }
+        }
+    }
+
+    // Parents come first, so every node's parent is already in the scene.
+    std::vector<int> file_nodes;
+    if( file->nodes() ) {
+        scene.reserve( scene.size() + file->nodes()->size() );
+        for( const SceneFormat::Node* record : *file->nodes() ) {
+            const int parent = record->parent();
+            if( parent >= static_cast<int>( file_nodes.size() ) ) {
+                STDERR( "Scene file %s has a node before its parent, skipping the rest.", url_.c_str() );
+                break;
+            }
+            const int node = scene.add_node( ( parent < 0 ) ? Scene::NONE : file_nodes[parent] );
+            file_nodes.push_back( node );
+            if( record->matrix() && ( record->matrix()->size() == 4 * 4 ) ) {
+                scene.set_local_matrix( node, record->matrix()->data() );
+            }
+            const int mesh = record->mesh();
+            if( ( mesh >= 0 ) && ( static_cast<size_t>( mesh ) < file_meshes.size() ) && ( file_meshes[mesh] != Scene::NONE ) ) {
+                scene.set_mesh( node, file_meshes[mesh] );
+                scene.set_bounds( node, meshes[file_meshes[mesh]].bounds, meshes[file_meshes[mesh]].bounds + 3 );
+            }
+            const int material = record->material();
+            if( materials && ( material >= 0 ) && ( static_cast<flatbuffers::uoffset_t>( material ) < materials->size() ) && materials->Get( material )->color() ) {
+                const SceneFormat::Color& color = *materials->Get( material )->color();
+                scene.set_color( node, color.r(), color.g(), color.b(), color.a() );
+            }
+        }
+    }
+
+    stats_.meshes    = file_meshes.size();
+    stats_.nodes     = file_nodes.size();
+    stats_.upload_ms = emscripten_get_now() - start_ms;
+    STDOUT( "Scene file %s: %lu meshes and %lu nodes instantiated in %.2lf ms.",
+            url_.c_str(),
+            static_cast<unsigned long>( stats_.meshes ),
+            static_cast<unsigned long>( stats_.nodes ),
+            stats_.upload_ms );
+}
+
+const SceneFileStats& SceneFile::stats() const {
+    return stats_;
+}
+
+void scene_file_write( const UserContext& user_context, std::vector<uint8_t>& file ) {
+    const Scene&             scene  = user_context.scene;
+    const std::vector<Mesh>& meshes = user_context.meshes;
+
+    flatbuffers::FlatBufferBuilder                      builder;
+    std::vector<uint8_t>                                blob;
+    std::vector<flatbuffers::Offset<SceneFormat::Mesh>> mesh_records;
+    std::vector<flatbuffers::Offset<SceneFormat::Node>> node_records;
+    std::vector<SceneFormat::Color>                     colors; // Of the materials, one per colour drawn.
+    std::map<uint32_t, int>                             color_materials;
+    std::vector<int>                                    file_meshes( meshes.size(), -1 );
+
+    // Meshes are written the first time a node draws them.
+    auto write_mesh = [&]( int index ) -> int {
+        if( file_meshes[index] >= 0 ) {
+            return file_meshes[index];
+        }
+        const Mesh& mesh = meshes[index];
+        MeshPacked  packed;
+        mesh_pack( mesh, user_context.mesh_format, packed );
+        const SceneFormat::Range vertices = scene_format_append( blob, packed.vertices.data(), packed.vertices.size() );
+        const SceneFormat::Range indices  = scene_format_append( blob, packed.indices.data(), packed.indices.size() );
+        std::vector<SceneFormat::Lod> lods;
+        for( const MeshLod& lod : mesh.lods ) {
+            lods.push_back( SceneFormat::Lod( lod.first_index, lod.index_count, lod.error ) );
+        }
+        const SceneFormat::Bounds bounds( SceneFormat::Vec3( mesh.bounds[0], mesh.bounds[1], mesh.bounds[2] ),
+                                          SceneFormat::Vec3( mesh.bounds[3], mesh.bounds[4], mesh.bounds[5] ) );
+        mesh_records.push_back( SceneFormat::CreateMesh(
+            builder,
+            0,
+            static_cast<SceneFormat::VertexFormat>( packed.format ),
+            builder.CreateVector( packed.dequantize, 4 * 4 ),
+            &vertices,
+            &indices,
+            packed.index_type == GL_UNSIGNED_SHORT,
+            builder.CreateVectorOfStructs( lods ),
+            &bounds ) );
+        file_meshes[index] = static_cast<int>( mesh_records.size() ) - 1;
+        return file_meshes[index];
+    };
+
+    // Drawn nodes are flattened to roots with their world matrices, the hierarchy only holds them in place.
+    for( size_t i = 0; i < scene.size(); ++i ) {
+        const int node = static_cast<int>( i );
+        const int mesh = scene.mesh( node );
+        if( ( mesh == Scene::NONE ) || !scene.visible( node ) || ( scene.skin( node ) != Scene::NONE ) ||
+            ( node == user_context.node_pointer_hits[0] ) || ( node == user_context.node_pointer_hits[1] ) ||
+            meshes[mesh].skinned() || meshes[mesh].positions.empty() || meshes[mesh].lods.empty() ) {
+            continue;
+        }
+        const GLubyte* color = scene.color( node );
+        const uint32_t key   = color[0] | ( color[1] << 8 ) | ( color[2] << 16 ) | ( static_cast<uint32_t>( color[3] ) << 24 );
+        auto           found = color_materials.find( key );
+        if( found == color_materials.end() ) {
+            found = color_materials.insert( std::make_pair( key, static_cast<int>( colors.size() ) ) ).first;
+            colors.push_back( SceneFormat::Color( color[0], color[1], color[2], color[3] ) );
+        }
+        const int file_mesh = write_mesh( mesh );
+        node_records.push_back( SceneFormat::CreateNode( builder, 0, -1, builder.CreateVector( scene.world_matrix( node ), 4 * 4 ), file_mesh, found->second ) );
+    }
+
+    std::vector<flatbuffers::Offset<SceneFormat::Material>> material_records;
+    for( const SceneFormat::Color& color : colors ) {
+        material_records.push_back( SceneFormat::CreateMaterial( builder, 0, &color ) );
+    }
+    builder.ForceVectorAlignment( blob.size(), sizeof( uint8_t ), SCENE_BLOB_ALIGNMENT );
+    const auto blob_vector = builder.CreateVector( blob );
+    SceneFormat::FinishSceneBuffer( builder,
+                                    SceneFormat::CreateScene(
+                                        builder,
+                                        builder.CreateVector( node_records ),
+                                        builder.CreateVector( mesh_records ),
+                                        builder.CreateVector( material_records ),
+                                        blob_vector ) );
+    file.assign( builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize() );
+    STDOUT( "Scene file written: %lu meshes, %lu nodes, %lu materials, %lu bytes of which %lu are vertices and indices.",
+            static_cast<unsigned long>( mesh_records.size() ),
+            static_cast<unsigned long>( node_records.size() ),
+            static_cast<unsigned long>( material_records.size() ),
+            static_cast<unsigned long>( file.size() ),
+            static_cast<unsigned long>( blob.size() ) );
+}
+
+void scene_file_save( const UserContext& user_context, const char* name ) {
+    std::vector<uint8_t> file;
+    scene_file_write( user_context, file );
+    save_scene_file( name, file.data(), static_cast<int>( file.size() ) );
+}
+
+void print_scene_file_stats( const SceneFile& scene_file ) {
+    const SceneFileStats& stats = scene_file.stats();
+    if( !stats.loads && !stats.failures ) {
+        return;
+    }
+    STDOUT( "Scene file: %lu loaded, %lu failed, %.1lf KB, %.1lf ms fetching, %.2lf ms verifying, %.2lf ms uploading %lu meshes and adding %lu nodes.",
+            stats.loads,
+            stats.failures,
+            stats.bytes / 1024.0,
+            stats.fetch_ms,
+            stats.verify_ms,
+            stats.upload_ms,
+            static_cast<unsigned long>( stats.meshes ),
+            static_cast<unsigned long>( stats.nodes ) );
+}
@@ -0,0 +1,66 @@
+#ifndef WASMVR_SCENE_FILE_H
+#define WASMVR_SCENE_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "scene_format.h"
+
+class UserContext;
+
+struct SceneFileStats {
+    unsigned long loads;
+    unsigned long failures;
+    size_t        bytes;     // Of the file loaded last.
+    double        fetch_ms;  // From opening to the whole file arriving.
+    double        verify_ms; // Checking the buffer in place, all the "parsing" there is.
+    double        upload_ms; // Handing the blob's ranges to GL and adding the nodes.
+    size_t        meshes;
+    size_t        nodes;
+
+    SceneFileStats();
+};
+
+// A scene file, see src/scene_format.h, fetched whole with a single request and kept as it arrived.
+// Meshes are uploaded straight from the file's blob, and uploaded again from it when evicted, so the file
+// stays in memory as long as it is open and no mesh of it keeps vertices of its own.
+class SceneFile {
+public:
+    SceneFile();
+
+    // Fetches the file and rebuilds the scene from it once it has arrived.
+    void open( UserContext& user_context, const std::string& url );
+    // Forgets the file, the scene has to be rebuilt without it.
+    void close();
+    bool opened() const;
+    // Whether the file has arrived and can be instantiated.
+    bool ready() const;
+    const std::string& url() const;
+
+    // Uploads the file's meshes to user_context.meshes and adds its nodes to user_context.scene, at its root.
+    void instantiate( UserContext& user_context );
+
+    const SceneFileStats& stats() const;
+
+private:
+    static void on_load( unsigned handle, void* arg, void* data, unsigned size );
+    static void on_error( unsigned handle, void* arg, int status, const char* text );
+
+    std::string    url_;
+    int            request_;
+    double         open_ms_;
+    SceneContainer container_;
+    SceneFileStats stats_;
+};
+
+// Writes the static meshes of user_context.scene, the nodes drawing them with their world matrices and their
+// colours as a scene file, with vertices in user_context.mesh_format. Skinned meshes and meshes without
+// vertices of their own, e.g. those of a scene file, are left out.
+void scene_file_write( const UserContext& user_context, std::vector<uint8_t>& file );
+// Writes the scene and hands it to the browser as a download.
+void scene_file_save( const UserContext& user_context, const char* name );
+
+void print_scene_file_stats( const SceneFile& scene_file );
+
+#endif // WASMVR_SCENE_FILE_H
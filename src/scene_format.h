@@ -0,0 +1,72 @@
+#ifndef WASMVR_SCENE_FORMAT_H
+#define WASMVR_SCENE_FORMAT_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "flatbuffer_container.h"
+#include "scene_generated.h"
+
+// Scene files as SceneFile loads them and writes them and src_tool/scene_bench generates them, see
+// src_fbs/scene.fbs. A file is one FlatBuffer whose tables describe the nodes, meshes and materials and whose
+// blob holds every mesh's vertices and indices already laid out for their buffers. Nothing is parsed or
+// copied on load: the buffer is verified where it arrived and the blob's ranges go to glBufferData as they are.
+
+typedef FlatbufferContainer<SceneFormat::Scene> SceneContainer;
+
+// Of the blob's start and of every range in it, enough for any attribute and for SIMD reads.
+const uint32_t SCENE_BLOB_ALIGNMENT = 16;
+
+// The bytes of a range of the scene's blob, or nullptr when it doesn't lie within the blob.
+inline const uint8_t* scene_format_range( const SceneFormat::Scene& scene, const SceneFormat::Range* range ) {
+    const flatbuffers::Vector<uint8_t>* blob = scene.blob();
+    if( !blob || !range || ( range->offset() > blob->size() ) || ( range->size() > blob->size() - range->offset() ) ) {
+        return nullptr;
+    }
+    return blob->Data() + range->offset();
+}
+
+// Appends bytes to a blob being written, padded so the next range starts aligned, and returns their range.
+inline SceneFormat::Range scene_format_append( std::vector<uint8_t>& blob, const void* data, size_t size ) {
+    const uint32_t offset = static_cast<uint32_t>( blob.size() );
+    const uint8_t* bytes  = static_cast<const uint8_t*>( data );
+    blob.insert( blob.end(), bytes, bytes + size );
+    blob.resize( ( blob.size() + SCENE_BLOB_ALIGNMENT - 1 ) / SCENE_BLOB_ALIGNMENT * SCENE_BLOB_ALIGNMENT, 0 );
+    return SceneFormat::Range( offset, static_cast<uint32_t>( size ) );
+}
+
+// Maps a scene file read only and verifies it in place, for native builds. The mapping is the container's
+// slab and is unmapped with it, so pages are only read from disk when they are touched.
+inline bool scene_format_map( const char* path, SceneContainer& container ) {
+    auto slab_init = [path]( uint8_t** slab ) -> int {
+        *slab    = nullptr;
+        int file = ::open( path, O_RDONLY );
+        if( file < 0 ) {
+            return 0;
+        }
+        struct stat status;
+        void*       data = MAP_FAILED;
+        if( !fstat( file, &status ) && ( status.st_size > 0 ) && ( status.st_size <= 0x7fffffff ) ) {
+            data = mmap( nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+        }
+        // The mapping stays valid once the file is closed.
+        ::close( file );
+        if( data == MAP_FAILED ) {
+            return 0;
+        }
+        *slab = static_cast<uint8_t*>( data );
+        return static_cast<int>( status.st_size );
+    };
+    return SceneContainer::slab(
+        &container,
+        slab_init,
+        []( flatbuffers::Verifier& verifier ) { return SceneFormat::VerifySceneBuffer( verifier ); },
+        []( const void* data ) { return SceneFormat::GetScene( data ); },
+        []( uint8_t* slab, int length ) { munmap( slab, length ); } );
+}
+
+#endif // WASMVR_SCENE_FORMAT_H
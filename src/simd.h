@@ -0,0 +1,73 @@
+#ifndef WASMVR_SIMD_H
+#define WASMVR_SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Four floats in one vector register. These are compiler vector extensions: emscripten.sh builds with
+// -msimd128 so they become wasm SIMD instructions, and native builds use the host's vector registers.
+typedef float   float4 __attribute__( ( vector_size( 16 ) ) );
+typedef int32_t int4 __attribute__( ( vector_size( 16 ) ) );
+
+inline float4 float4_load( const float* source ) {
+    float4 v;
+    memcpy( &v, source, sizeof( v ) );
+    return v;
+}
+
+inline void float4_store( float* destination, float4 v ) {
+    memcpy( destination, &v, sizeof( v ) );
+}
+
+inline float4 float4_splat( float s ) {
+    float4 v = {s, s, s, s};
+    return v;
+}
+
+inline float4 float4_make( float x, float y, float z, float w ) {
+    float4 v = {x, y, z, w};
+    return v;
+}
+
+inline float4 float4_abs( float4 v ) {
+    const int4 mask = {0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff};
+    return reinterpret_cast<float4>( reinterpret_cast<int4>( v ) & mask );
+}
+
+// Per lane a where mask is set and b elsewhere.
+inline float4 float4_select( int4 mask, float4 a, float4 b ) {
+    return reinterpret_cast<float4>( ( reinterpret_cast<int4>( a ) & mask ) | ( reinterpret_cast<int4>( b ) & ~mask ) );
+}
+
+inline float4 float4_min( float4 a, float4 b ) {
+    return float4_select( a < b, a, b );
+}
+
+inline float4 float4_max( float4 a, float4 b ) {
+    return float4_select( a > b, a, b );
+}
+
+// True if any lane of a comparison result is set.
+inline bool int4_any( int4 mask ) {
+    return ( mask[0] | mask[1] | mask[2] | mask[3] ) != 0;
+}
+
+// out = a * b for row major 4x4 matrices. out may alias a or b.
+inline void float4x4_multiply( float* out, const float* a, const float* b ) {
+    const float4 b0 = float4_load( b + 0 );
+    const float4 b1 = float4_load( b + 4 );
+    const float4 b2 = float4_load( b + 8 );
+    const float4 b3 = float4_load( b + 12 );
+    float4       rows[4];
+    for( int i = 0; i < 4; ++i ) {
+        rows[i] = float4_splat( a[4 * i + 0] ) * b0 +
+                  float4_splat( a[4 * i + 1] ) * b1 +
+                  float4_splat( a[4 * i + 2] ) * b2 +
+                  float4_splat( a[4 * i + 3] ) * b3;
+    }
+    for( int i = 0; i < 4; ++i ) {
+        float4_store( out + 4 * i, rows[i] );
+    }
+}
+
+#endif // WASMVR_SIMD_H
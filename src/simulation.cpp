@@ -0,0 +1,128 @@
+#include "simulation.h"
+
+#include <math.h>
+
+#include "util.h"
+
+SimulationState::SimulationState()
+    : time_s( 0.0 )
+    , object_angle( 0.0 ) {
+}
+
+SimulationState simulation_state_lerp( const SimulationState& a, const SimulationState& b, double t ) {
+    SimulationState result;
+    result.time_s       = a.time_s + ( b.time_s - a.time_s ) * t;
+    result.object_angle = a.object_angle + ( b.object_angle - a.object_angle ) * t;
+    return result;
+}
+
+Simulation::Simulation()
+    : dt_s_( 1.0 / 60.0 )
+    , max_steps_( 5 )
+    , started_( false )
+    , last_ms_( 0.0 )
+    , accumulator_s_( 0.0 )
+    , steps_( 0 )
+    , dropped_steps_( 0 ) {
+}
+
+void Simulation::set_tick_rate( double hz ) {
+    if( hz > 0.0 ) {
+        dt_s_ = 1.0 / hz;
+    }
+}
+
+double Simulation::tick_rate() const {
+    return 1.0 / dt_s_;
+}
+
+void Simulation::set_max_steps( int max_steps ) {
+    max_steps_ = ( max_steps > 0 ) ? max_steps : 1;
+}
+
+int Simulation::advance( double now_ms ) {
+    if( !started_ ) {
+        started_ = true;
+        last_ms_ = now_ms;
+        return 0;
+    }
+
+    double elapsed_s = ( now_ms - last_ms_ ) / 1000.0;
+    last_ms_         = now_ms;
+    if( elapsed_s > 0.0 ) {
+        accumulator_s_ += elapsed_s;
+    }
+
+    int taken = 0;
+    while( ( accumulator_s_ >= dt_s_ ) && ( taken < max_steps_ ) ) {
+        step( dt_s_ );
+        accumulator_s_ -= dt_s_;
+        ++taken;
+    }
+
+    // Out of budget: drop whole ticks we could not simulate, but keep the fraction for interpolation.
+    if( accumulator_s_ >= dt_s_ ) {
+        double dropped = floor( accumulator_s_ / dt_s_ );
+        dropped_steps_ += static_cast<unsigned int>( dropped );
+        accumulator_s_ -= dropped * dt_s_;
+    }
+
+    return taken;
+}
+
+double Simulation::alpha() const {
+    return accumulator_s_ / dt_s_;
+}
+
+SimulationState Simulation::interpolated() const {
+    return simulation_state_lerp( previous_, current_, alpha() );
+}
+
+const SimulationState& Simulation::previous() const {
+    return previous_;
+}
+
+const SimulationState& Simulation::current() const {
+    return current_;
+}
+
+unsigned int Simulation::steps() const {
+    return steps_;
+}
+
+unsigned int Simulation::dropped_steps() const {
+    return dropped_steps_;
+}
+
+void Simulation::step( double dt_s ) {
+    previous_ = current_;
+
+    current_.time_s += dt_s;
+    // A quarter turn per second.
+    current_.object_angle += PI * dt_s / 2.0;
+
+    ++steps_;
+}
+
+void simulation_object_model_matrix( const SimulationState& state, GLfloat* matrix ) {
+    const double q = state.object_angle;
+#define F( x ) static_cast<float>( x )
+    // clang-format off
+    const GLfloat model_matrix[4 * 4] = {
+        F( cos( q ) ), 0.0f, F( -sin( q ) ), F( 1.25 + sin( q ) ),
+                 0.0f, 1.0f,           0.0f,                 0.0f,
+        F( sin( q ) ), 0.0f, F(  cos( q ) ),                 0.0f,
+                 0.0f, 0.0f,           0.0f,                 1.0f};
+// clang-format on
+#undef F
+    for( int i = 0; i < 16; ++i ) {
+        matrix[i] = model_matrix[i];
+    }
+}
+
+void print_simulation_stats( const Simulation& simulation ) {
+    STDOUT( "Simulation: %.1lf Hz, %u steps, %u dropped steps.",
+            simulation.tick_rate(),
+            simulation.steps(),
+            simulation.dropped_steps() );
+}
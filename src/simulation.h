@@ -0,0 +1,62 @@
+#ifndef WASMVR_SIMULATION_H
+#define WASMVR_SIMULATION_H
+
+#include <GLES3/gl3.h>
+
+// Everything the simulation produces that rendering needs to interpolate.
+struct SimulationState {
+    double time_s;
+    double object_angle;
+
+    SimulationState();
+};
+
+SimulationState simulation_state_lerp( const SimulationState& a, const SimulationState& b, double t );
+
+// Steps the simulation at a fixed rate independent of the display refresh rate.
+// Rendering shows interpolated() which lags the newest step by less than one tick.
+class Simulation {
+public:
+    Simulation();
+
+    void   set_tick_rate( double hz );
+    double tick_rate() const;
+
+    // Caps how many steps one advance() may take so a long stall can not
+    // snowball into ever longer frames. Time beyond the cap is dropped.
+    void set_max_steps( int max_steps );
+
+    // Consumes the wall clock time elapsed since the last call and returns the number of steps taken.
+    int advance( double now_ms );
+
+    // Fraction of a tick between previous() and current() that has elapsed.
+    double                 alpha() const;
+    SimulationState        interpolated() const;
+    const SimulationState& previous() const;
+    const SimulationState& current() const;
+
+    unsigned int steps() const;
+    unsigned int dropped_steps() const;
+
+private:
+    void step( double dt_s );
+
+    SimulationState previous_;
+    SimulationState current_;
+
+    double dt_s_;
+    int    max_steps_;
+    bool   started_;
+    double last_ms_;
+    double accumulator_s_;
+
+    unsigned int steps_;
+    unsigned int dropped_steps_;
+};
+
+// Model matrix (row major) of the rotating object in the scene.
+void simulation_object_model_matrix( const SimulationState& state, GLfloat* matrix );
+
+void print_simulation_stats( const Simulation& simulation );
+
+#endif // WASMVR_SIMULATION_H
@@ -0,0 +1,344 @@
+#include "skinning.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <math.h>
+#include <string.h>
+
+#include "gles.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "residency.h"
+#include "simd.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const int RINGS_PER_BONE = 4;
+    const int TUBE_SEGMENTS  = 8;
+    // Animation cycles per second, in radians.
+    const double ANIMATION_SPEED = 2.0;
+
+    void translation( GLfloat x, GLfloat y, GLfloat z, GLfloat* out ) {
+        memcpy( out, identity4, 16 * sizeof( GLfloat ) );
+        out[3]  = x;
+        out[7]  = y;
+        out[11] = z;
+    }
+
+    void rotation_x( GLfloat angle, GLfloat* out ) {
+        const GLfloat c = cosf( angle );
+        const GLfloat s = sinf( angle );
+        memcpy( out, identity4, 16 * sizeof( GLfloat ) );
+        out[5]  = c;
+        out[6]  = -s;
+        out[9]  = s;
+        out[10] = c;
+    }
+
+    void rotation_z( GLfloat angle, GLfloat* out ) {
+        const GLfloat c = cosf( angle );
+        const GLfloat s = sinf( angle );
+        memcpy( out, identity4, 16 * sizeof( GLfloat ) );
+        out[0] = c;
+        out[1] = -s;
+        out[4] = s;
+        out[5] = c;
+    }
+
+    // Inverse of a rotation and translation: the transposed rotation and the translation rotated back.
+    void rigid_inverse( const GLfloat* m, GLfloat* out ) {
+        memcpy( out, identity4, 16 * sizeof( GLfloat ) );
+        for( int i = 0; i < 3; ++i ) {
+            for( int j = 0; j < 3; ++j ) {
+                out[4 * i + j] = m[4 * j + i];
+            }
+            out[4 * i + 3] = -( m[i] * m[3] + m[4 + i] * m[7] + m[8 + i] * m[11] );
+        }
+    }
+
+    void transform_point( const GLfloat* m, const GLfloat* p, GLfloat* out ) {
+        for( int i = 0; i < 3; ++i ) {
+            out[i] = m[4 * i] * p[0] + m[4 * i + 1] * p[1] + m[4 * i + 2] * p[2] + m[4 * i + 3];
+        }
+    }
+
+    void transform_direction( const GLfloat* m, const GLfloat* d, GLfloat* out ) {
+        for( int i = 0; i < 3; ++i ) {
+            out[i] = m[4 * i] * d[0] + m[4 * i + 1] * d[1] + m[4 * i + 2] * d[2];
+        }
+    }
+
+    void add_bone( Skeleton& skeleton, int32_t parent, const GLfloat* bind_local, GLfloat curl ) {
+        skeleton.parents.push_back( parent );
+        skeleton.bind_locals.insert( skeleton.bind_locals.end(), bind_local, bind_local + 16 );
+        skeleton.curls.push_back( curl );
+    }
+}
+
+size_t Skeleton::bones() const {
+    return parents.size();
+}
+
+void skinned_create_chains( const GLfloat* root, const SkinnedChain* chains, int count, Skeleton& skeleton, Mesh& mesh ) {
+    skeleton = Skeleton();
+    mesh     = Mesh();
+    add_bone( skeleton, -1, root, 0.0f );
+
+    // Bone numbers of each chain's first bone.
+    std::vector<int> first_bones;
+    for( int c = 0; c < count; ++c ) {
+        const SkinnedChain& chain = chains[c];
+        first_bones.push_back( static_cast<int>( skeleton.bones() ) );
+        for( int b = 0; b < chain.bones; ++b ) {
+            GLfloat local[16];
+            if( b == 0 ) {
+                GLfloat place[16];
+                GLfloat turn[16];
+                translation( chain.origin[0], chain.origin[1], chain.origin[2], place );
+                rotation_z( chain.angle, turn );
+                float4x4_multiply( local, place, turn );
+            } else {
+                translation( 0.0f, chain.length, 0.0f, local );
+            }
+            add_bone( skeleton, ( b == 0 ) ? 0 : static_cast<int32_t>( skeleton.bones() ) - 1, local, chain.curl );
+        }
+    }
+
+    const size_t         bones = skeleton.bones();
+    std::vector<GLfloat> binds( 16 * bones );
+    skeleton.inverse_binds.resize( 16 * bones );
+    for( size_t b = 0; b < bones; ++b ) {
+        GLfloat* bind = &binds[16 * b];
+        if( skeleton.parents[b] < 0 ) {
+            memcpy( bind, &skeleton.bind_locals[16 * b], 16 * sizeof( GLfloat ) );
+        } else {
+            float4x4_multiply( bind, &binds[16 * skeleton.parents[b]], &skeleton.bind_locals[16 * b] );
+        }
+        rigid_inverse( bind, &skeleton.inverse_binds[16 * b] );
+    }
+
+    // A tube per chain, with rings along its bones and one more closing it to a point past the end.
+    GLfloat reach = 0.0f;
+    for( int c = 0; c < count; ++c ) {
+        const SkinnedChain& chain = chains[c];
+        const uint32_t      first = static_cast<uint32_t>( mesh.positions.size() / 3 );
+        const int           rings = chain.bones * RINGS_PER_BONE + 2;
+        for( int ring = 0; ring < rings; ++ring ) {
+            const bool    tip    = ring == rings - 1;
+            const GLfloat along  = tip ? static_cast<GLfloat>( chain.bones ) : static_cast<GLfloat>( ring ) / RINGS_PER_BONE;
+            const int     bone   = std::min( static_cast<int>( along ), chain.bones - 1 );
+            const GLfloat within = along - bone;
+            const GLfloat radius = tip ? 0.0f : chain.radius;
+            const GLfloat y      = within * chain.length + ( tip ? 0.5f * chain.radius : 0.0f );
+
+            // Halfway between joints a vertex follows its bone alone, at a joint both bones equally.
+            // The first bone blends with the root.
+            const int bone_index = first_bones[c] + bone;
+            int       other      = bone_index;
+            GLfloat   blend      = 0.0f;
+            if( within < 0.5f ) {
+                other = ( bone == 0 ) ? 0 : bone_index - 1;
+                blend = 0.5f - within;
+            } else if( bone + 1 < chain.bones ) {
+                other = bone_index + 1;
+                blend = within - 0.5f;
+            }
+
+            const GLfloat* bind = &binds[16 * bone_index];
+            for( int s = 0; s <= TUBE_SEGMENTS; ++s ) {
+                const GLfloat phi       = 6.2831853f * s / TUBE_SEGMENTS;
+                const GLfloat around[3] = {cosf( phi ), 0.0f, sinf( phi )};
+                const GLfloat local[3]  = {radius * around[0], y, radius * around[2]};
+                const GLfloat up[3]     = {0.0f, 1.0f, 0.0f};
+                GLfloat       position[3];
+                GLfloat       normal[3];
+                transform_point( bind, local, position );
+                transform_direction( bind, tip ? up : around, normal );
+                mesh.positions.insert( mesh.positions.end(), position, position + 3 );
+                mesh.normals.insert( mesh.normals.end(), normal, normal + 3 );
+                mesh.uvs.push_back( static_cast<GLfloat>( s ) / TUBE_SEGMENTS );
+                mesh.uvs.push_back( static_cast<GLfloat>( ring ) / ( rings - 1 ) );
+                mesh.bone_indices.insert( mesh.bone_indices.end(), {static_cast<uint8_t>( bone_index ), static_cast<uint8_t>( other ), 0, 0} );
+                mesh.bone_weights.insert( mesh.bone_weights.end(), {1.0f - blend, blend, 0.0f, 0.0f} );
+            }
+        }
+
+        // Counter clockwise seen from outside.
+        for( int ring = 0; ring + 1 < rings; ++ring ) {
+            for( int s = 0; s < TUBE_SEGMENTS; ++s ) {
+                const uint32_t a = first + ring * ( TUBE_SEGMENTS + 1 ) + s;
+                const uint32_t b = a + TUBE_SEGMENTS + 1;
+                mesh.indices.insert( mesh.indices.end(), {a, b, a + 1, a + 1, b, b + 1} );
+            }
+        }
+
+        // Bones only turn about their joints, so nothing in the chain gets further from the root than this.
+        const GLfloat* o = chain.origin;
+        reach            = std::max( reach, sqrtf( o[0] * o[0] + o[1] * o[1] + o[2] * o[2] ) + chain.bones * chain.length + 1.5f * chain.radius );
+    }
+
+    // Bounds hold every pose, not just the bind pose, since they are used for culling.
+    for( int i = 0; i < 3; ++i ) {
+        mesh.bounds[i]     = root[4 * i + 3] - reach;
+        mesh.bounds[3 + i] = root[4 * i + 3] + reach;
+    }
+    MeshLod lod = {0, static_cast<uint32_t>( mesh.indices.size() ), 0.0f};
+    mesh.lods.assign( 1, lod );
+}
+
+void skinned_create_hand( bool left, Skeleton& skeleton, Mesh& mesh ) {
+    // Mirrored chains for the left hand, rather than a mirroring matrix, keep every bone a rotation.
+    const GLfloat side = left ? -1.0f : 1.0f;
+    // clang-format off
+    const SkinnedChain chains[] = {
+        {{0.0f, -0.09f, 0.0f}, 0.0f, 1, 0.09f, 0.035f, 0.0f}, // Palm.
+        {{side * 0.035f, -0.06f, 0.0f}, side * -0.8f, 2, 0.03f, 0.011f, 0.5f}, // Thumb.
+        {{side * 0.024f, 0.0f, 0.0f}, side * -0.1f, 3, 0.028f, 0.009f, 0.6f},
+        {{side * 0.008f, 0.0f, 0.0f}, side * -0.03f, 3, 0.031f, 0.009f, 0.6f},
+        {{side * -0.008f, 0.0f, 0.0f}, side * 0.03f, 3, 0.029f, 0.009f, 0.6f},
+        {{side * -0.024f, 0.0f, 0.0f}, side * 0.1f, 3, 0.023f, 0.008f, 0.6f},
+    };
+    // clang-format on
+    // Fingers along +y turned to point down -z, like a hand holding the controller.
+    GLfloat root[16];
+    rotation_x( -1.5707963f, root );
+    skinned_create_chains( root, chains, sizeof( chains ) / sizeof( chains[0] ), skeleton, mesh );
+}
+
+void skinned_create_avatar( Skeleton& skeleton, Mesh& mesh ) {
+    // clang-format off
+    const SkinnedChain chains[] = {
+        {{0.0f, 0.0f, 0.0f}, 0.0f, 3, 0.15f, 0.1f, 0.1f},             // Spine.
+        {{0.0f, 0.5f, 0.0f}, 0.0f, 1, 0.15f, 0.09f, 0.2f},            // Head.
+        {{0.18f, 0.4f, 0.0f}, -1.5707963f, 2, 0.25f, 0.045f, 0.8f},   // Arms.
+        {{-0.18f, 0.4f, 0.0f}, 1.5707963f, 2, 0.25f, 0.045f, 0.8f},
+        {{0.1f, 0.0f, 0.0f}, 3.1415927f, 2, 0.38f, 0.06f, 0.5f},      // Legs.
+        {{-0.1f, 0.0f, 0.0f}, 3.1415927f, 2, 0.38f, 0.06f, 0.5f},
+    };
+    // clang-format on
+    GLfloat root[16];
+    translation( 0.0f, 0.76f, 0.0f, root );
+    skinned_create_chains( root, chains, sizeof( chains ) / sizeof( chains[0] ), skeleton, mesh );
+}
+
+SkinningStats::SkinningStats()
+    : frames( 0 )
+    , bones( 0 )
+    , update_ms( 0.0 )
+    , last_bones( 0 ) {
+}
+
+SkinningPalette::SkinningPalette()
+    : bones_( 0 )
+    , texture_( 0 )
+    , rows_( 0 ) {
+}
+
+bool SkinningPalette::create( UserContext& user_context ) {
+    rows_    = 1;
+    texture_ = gles_create_data_texture( PALETTE_UNIT, GL_RGBA32F, 3 * BONES_PER_ROW, rows_ );
+    user_context.frame_budget.count_buffer_allocations( 1 );
+    if( !texture_ ) {
+        STDERR( "Failed to create bone palette texture." );
+        return false;
+    }
+
+    GLState&     gl          = user_context.gl_state;
+    const GLuint programs[2] = {user_context.skinned_program, user_context.depth_skinned_program};
+    for( GLuint program : programs ) {
+        gl.use_program( program );
+        gl.uniform_1i( glGetUniformLocation( program, "sampler2D_palette" ), PALETTE_UNIT );
+    }
+    return true;
+}
+
+void SkinningPalette::release() {
+    gpu_memory_freed( GPU_MEMORY_TEXTURE, texture_ );
+    glDeleteTextures( 1, &texture_ );
+    texture_ = 0;
+    rows_    = 0;
+}
+
+void SkinningPalette::clear() {
+    instances_.clear();
+    bones_ = 0;
+}
+
+uint32_t SkinningPalette::add( const std::vector<Skeleton>& skeletons, int skeleton, int mesh, GLfloat phase ) {
+    Instance instance = {skeleton, mesh, phase, bones_};
+    instances_.push_back( instance );
+    bones_ += static_cast<uint32_t>( skeletons[skeleton].bones() );
+    return instance.first_bone;
+}
+
+size_t SkinningPalette::instances() const {
+    return instances_.size();
+}
+
+void SkinningPalette::update( const std::vector<Skeleton>& skeletons, const std::vector<Mesh>& meshes, double seconds ) {
+    const double begin_ms = emscripten_get_now();
+
+    palette_.resize( 12 * bones_ );
+    worlds_.resize( 16 * bones_ );
+
+    // Each instance only writes its own bones.
+    parallel_for( instances_.size(), [&]( size_t i ) {
+        const Instance& instance = instances_[i];
+        const Skeleton& skeleton = skeletons[instance.skeleton];
+        const Mesh&     mesh     = meshes[instance.mesh];
+        const GLfloat   grip     = static_cast<GLfloat>( 0.5 + 0.5 * sin( seconds * ANIMATION_SPEED + instance.phase ) );
+        GLfloat*        worlds   = &worlds_[16 * instance.first_bone];
+        GLfloat*        palette  = &palette_[12 * instance.first_bone];
+        for( size_t b = 0; b < skeleton.bones(); ++b ) {
+            GLfloat* world = worlds + 16 * b;
+            GLfloat  bend[16];
+            rotation_x( grip * skeleton.curls[b], bend );
+            float4x4_multiply( world, &skeleton.bind_locals[16 * b], bend );
+            if( skeleton.parents[b] >= 0 ) {
+                float4x4_multiply( world, worlds + 16 * skeleton.parents[b], world );
+            }
+            GLfloat skin[16];
+            float4x4_multiply( skin, world, &skeleton.inverse_binds[16 * b] );
+            float4x4_multiply( skin, skin, mesh.dequantize );
+            memcpy( palette + 12 * b, skin, 12 * sizeof( GLfloat ) );
+        }
+    } );
+
+    ++stats_.frames;
+    stats_.bones += bones_;
+    stats_.last_bones = bones_;
+    stats_.update_ms += emscripten_get_now() - begin_ms;
+}
+
+void SkinningPalette::upload( UserContext& user_context ) {
+    if( !texture_ || !bones_ ) {
+        return;
+    }
+    const GLsizei rows = static_cast<GLsizei>( ( bones_ + BONES_PER_ROW - 1 ) / BONES_PER_ROW );
+    if( rows > rows_ ) {
+        // Storage is immutable, so a bigger texture replaces the old one. Doubling keeps that rare.
+        gpu_memory_freed( GPU_MEMORY_TEXTURE, texture_ );
+        glDeleteTextures( 1, &texture_ );
+        rows_    = std::max( rows, 2 * rows_ );
+        texture_ = gles_create_data_texture( PALETTE_UNIT, GL_RGBA32F, 3 * BONES_PER_ROW, rows_ );
+        user_context.frame_budget.count_buffer_allocations( 1 );
+    }
+    // Rows hold whole bones, so no bone straddles two.
+    gles_upload_data_rows( PALETTE_UNIT, 3 * BONES_PER_ROW, 3 * bones_, GL_RGBA, GL_FLOAT, palette_.data(), 4 * sizeof( GLfloat ) );
+    user_context.frame_budget.count_bytes_uploaded( palette_.size() * sizeof( GLfloat ) );
+}
+
+const SkinningStats& SkinningPalette::stats() const {
+    return stats_;
+}
+
+void print_skinning_stats( const SkinningPalette& palette ) {
+    const SkinningStats& stats  = palette.stats();
+    const double         frames = stats.frames ? static_cast<double>( stats.frames ) : 1.0;
+    STDOUT( "Skinning: %lu instances, %.3lf ms posing %.1lf bones per frame, %.1lf KiB of palette uploaded per frame.",
+            static_cast<unsigned long>( palette.instances() ),
+            stats.update_ms / frames,
+            stats.bones / frames,
+            stats.bones / frames * 12 * sizeof( GLfloat ) / 1024.0 );
+}
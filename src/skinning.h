@@ -0,0 +1,98 @@
+#ifndef WASMVR_SKINNING_H
+#define WASMVR_SKINNING_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct Mesh;
+class UserContext;
+
+// Bones listed parents first, with row major matrices.
+struct Skeleton {
+    std::vector<int32_t> parents;       // -1 for the root.
+    std::vector<GLfloat> bind_locals;   // 16 per bone, relative to its parent.
+    std::vector<GLfloat> inverse_binds; // 16 per bone, from the skeleton's space into the bone's in the bind pose.
+    std::vector<GLfloat> curls;         // Radians a bone bends about its x axis at the height of the animation.
+
+    size_t bones() const;
+};
+
+// A tube around a chain of bones hanging off a skeleton's root. It points along +y turned by angle about z.
+struct SkinnedChain {
+    GLfloat origin[3]; // In the root bone's space.
+    GLfloat angle;
+    int     bones;
+    GLfloat length; // Of each bone.
+    GLfloat radius;
+    GLfloat curl;
+};
+
+// Builds a skeleton of a root bone, placed by root (row major), and the chains' bones, along with a mesh
+// of the chains' tubes skinned to them. Vertices near a joint blend the two bones meeting there.
+void skinned_create_chains( const GLfloat* root, const SkinnedChain* chains, int count, Skeleton& skeleton, Mesh& mesh );
+// A hand whose fingers point down -z, made to hang off a controller.
+void skinned_create_hand( bool left, Skeleton& skeleton, Mesh& mesh );
+// A rough figure of about 1.3 m standing on y = 0, with a spine, head, arms and legs.
+void skinned_create_avatar( Skeleton& skeleton, Mesh& mesh );
+
+struct SkinningStats {
+    unsigned long frames;
+    unsigned long bones;
+    double        update_ms;
+    size_t        last_bones;
+
+    SkinningStats();
+};
+
+// The bone palettes of every skinned instance, posed once per frame in one pass over all their hierarchies and
+// uploaded into one float texture that all skinned draws share. Each bone takes three texels: the top three rows
+// of its row major matrix. Instances are told where their palette starts through the instance data.
+class SkinningPalette {
+public:
+    // Texture unit the skinned scene shader samples the palette from.
+    static const GLint   PALETTE_UNIT  = 5;
+    static const GLsizei BONES_PER_ROW = 256;
+
+    SkinningPalette();
+
+    // Creates the texture and points the skinned programs' samplers at it.
+    bool create( UserContext& user_context );
+    void release();
+
+    void clear();
+    // Adds an instance of a skinned mesh and returns the palette entry its first bone gets.
+    // The phase offsets its animation from the others'.
+    uint32_t add( const std::vector<Skeleton>& skeletons, int skeleton, int mesh, GLfloat phase );
+    size_t   instances() const;
+
+    // Poses every instance for the time and computes its palette. An entry takes the mesh's vertices, dequantizing
+    // them if need be, to where its bone puts them in the skeleton's space, so the instance's model matrix follows.
+    void update( const std::vector<Skeleton>& skeletons, const std::vector<Mesh>& meshes, double seconds );
+    void upload( UserContext& user_context );
+
+    const SkinningStats& stats() const;
+
+private:
+    struct Instance {
+        int      skeleton;
+        int      mesh;
+        GLfloat  phase;
+        uint32_t first_bone;
+    };
+
+    std::vector<Instance> instances_;
+    uint32_t              bones_;
+    std::vector<GLfloat>  palette_; // 12 per bone.
+    std::vector<GLfloat>  worlds_;  // 16 per bone, the posed bones in the skeleton's space.
+
+    GLuint  texture_;
+    GLsizei rows_;
+
+    SkinningStats stats_;
+};
+
+void print_skinning_stats( const SkinningPalette& palette );
+
+#endif // WASMVR_SKINNING_H
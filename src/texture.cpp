@@ -0,0 +1,632 @@
+#include "texture.h"
+
+#include <algorithm>
+#include <emscripten.h>
+#include <emscripten/html5.h>
+#include <math.h>
+#include <string.h>
+
+#include "gl_state.h"
+#include "jobs.h"
+#include "residency.h"
+#include "simd.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    // The identifier, header and index, after which the level index follows.
+    const size_t KTX2_HEADER_BYTES = 80;
+    const size_t KTX2_LEVEL_BYTES  = 24;
+
+    // Blocks encoded between deadline checks, well under a millisecond.
+    const size_t ENCODE_BLOCKS = 64;
+
+    // The default albedo: the scene's cells, 16 by 8 across a mesh's texture coordinates, darker and lighter.
+    const int     CHECKER_WIDTH  = 256;
+    const int     CHECKER_HEIGHT = 128;
+    const int     CHECKER_CELL   = 16;
+    const uint8_t CHECKER_DARK   = 217;
+
+    struct VkFormat {
+        uint32_t      vk;
+        TextureFormat format;
+        bool          srgb;
+    };
+
+    // The Vulkan formats KTX2 names its payloads by, of those there are GPU formats for.
+    const VkFormat VK_FORMATS[] = {
+        {37, TEXTURE_RGBA8, false},
+        {43, TEXTURE_RGBA8, true},
+        {131, TEXTURE_BC1, false},
+        {132, TEXTURE_BC1, true},
+        {133, TEXTURE_BC1, false},
+        {134, TEXTURE_BC1, true},
+        {137, TEXTURE_BC3, false},
+        {138, TEXTURE_BC3, true},
+        {147, TEXTURE_ETC2_RGB8, false},
+        {148, TEXTURE_ETC2_RGB8, true},
+        {151, TEXTURE_ETC2_RGBA8, false},
+        {152, TEXTURE_ETC2_RGBA8, true},
+        {157, TEXTURE_ASTC_4X4, false},
+        {158, TEXTURE_ASTC_4X4, true},
+    };
+
+    uint32_t read_u32( const uint8_t* bytes ) {
+        return static_cast<uint32_t>( bytes[0] ) | static_cast<uint32_t>( bytes[1] ) << 8 | static_cast<uint32_t>( bytes[2] ) << 16 |
+               static_cast<uint32_t>( bytes[3] ) << 24;
+    }
+
+    uint64_t read_u64( const uint8_t* bytes ) {
+        return static_cast<uint64_t>( read_u32( bytes ) ) | static_cast<uint64_t>( read_u32( bytes + 4 ) ) << 32;
+    }
+
+    int mip_count( int width, int height ) {
+        int levels = 1;
+        while( std::max( width, height ) >> levels ) {
+            ++levels;
+        }
+        return levels;
+    }
+
+    int level_size( int size, int level ) {
+        return std::max( size >> level, 1 );
+    }
+
+    // From sRGB bytes to linear, and back from linear quantized to 12 bits.
+    struct SrgbTables {
+        float   linear[256];
+        uint8_t encoded[4096];
+
+        SrgbTables() {
+            for( int i = 0; i < 256; ++i ) {
+                const float c = i / 255.0f;
+                linear[i]     = ( c <= 0.04045f ) ? c / 12.92f : powf( ( c + 0.055f ) / 1.055f, 2.4f );
+            }
+            for( int i = 0; i < 4096; ++i ) {
+                const float l = i / 4095.0f;
+                const float c = ( l <= 0.0031308f ) ? l * 12.92f : 1.055f * powf( l, 1.0f / 2.4f ) - 0.055f;
+                encoded[i]    = static_cast<uint8_t>( std::min( std::max( c * 255.0f + 0.5f, 0.0f ), 255.0f ) );
+            }
+        }
+    };
+
+    const SrgbTables& srgb_tables() {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    float4 load_texel( const uint8_t* texel, bool srgb ) {
+        if( srgb ) {
+            const float* linear = srgb_tables().linear;
+            return float4_make( linear[texel[0]], linear[texel[1]], linear[texel[2]], texel[3] / 255.0f );
+        }
+        return float4_make( texel[0], texel[1], texel[2], texel[3] ) * float4_splat( 1.0f / 255.0f );
+    }
+
+    void store_texel( float4 v, bool srgb, uint8_t* texel ) {
+        if( srgb ) {
+            const uint8_t* encoded = srgb_tables().encoded;
+            for( int c = 0; c < 3; ++c ) {
+                texel[c] = encoded[static_cast<int>( v[c] * 4095.0f + 0.5f )];
+            }
+            texel[3] = static_cast<uint8_t>( v[3] * 255.0f + 0.5f );
+            return;
+        }
+        const float4 scaled = v * float4_splat( 255.0f ) + float4_splat( 0.5f );
+        for( int c = 0; c < 4; ++c ) {
+            texel[c] = static_cast<uint8_t>( scaled[c] );
+        }
+    }
+}
+
+void texture_generate_mip( const uint8_t* texels, int width, int height, bool srgb, uint8_t* mip ) {
+    const int mip_width  = std::max( width / 2, 1 );
+    const int mip_height = std::max( height / 2, 1 );
+    // Each row only writes its own texels.
+    parallel_for( static_cast<size_t>( mip_height ), [&]( size_t y ) {
+        const int y0 = 2 * static_cast<int>( y );
+        const int y1 = std::min( y0 + ( ( static_cast<int>( y ) == mip_height - 1 ) && ( height & 1 ) ? 2 : 1 ), height - 1 );
+        for( int x = 0; x < mip_width; ++x ) {
+            const int x0  = 2 * x;
+            const int x1  = std::min( x0 + ( ( x == mip_width - 1 ) && ( width & 1 ) ? 2 : 1 ), width - 1 );
+            float4    sum = float4_splat( 0.0f );
+            for( int sy = y0; sy <= y1; ++sy ) {
+                const uint8_t* row = texels + 4 * static_cast<size_t>( sy ) * width;
+                for( int sx = x0; sx <= x1; ++sx ) {
+                    sum += load_texel( row + 4 * sx, srgb );
+                }
+            }
+            const float count = static_cast<float>( ( y1 - y0 + 1 ) * ( x1 - x0 + 1 ) );
+            store_texel( sum * float4_splat( 1.0f / count ), srgb, mip + 4 * ( y * mip_width + x ) );
+        }
+    } );
+}
+
+TextureStats::TextureStats()
+    : loaded( 0 )
+    , failed( 0 )
+    , transcoded( 0 )
+    , encoded( 0 )
+    , generated( 0 )
+    , parse_ms( 0.0 )
+    , decode_ms( 0.0 )
+    , mip_ms( 0.0 )
+    , encode_ms( 0.0 )
+    , upload_ms( 0.0 )
+    , bytes() {
+}
+
+TextureCache::TextureCache()
+    : supported_()
+    , s3tc_srgb_( false )
+    , white_( 0 )
+    , albedo_( -1 )
+    , checker_( -1 ) {
+}
+
+bool TextureCache::create( UserContext& user_context ) {
+    const EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context = emscripten_webgl_get_current_context();
+
+    supported_[TEXTURE_RGBA8]      = true;
+    supported_[TEXTURE_ETC2_RGB8]  = emscripten_webgl_enable_extension( context, "WEBGL_compressed_texture_etc" );
+    supported_[TEXTURE_ETC2_RGBA8] = supported_[TEXTURE_ETC2_RGB8];
+    supported_[TEXTURE_BC1]        = emscripten_webgl_enable_extension( context, "WEBGL_compressed_texture_s3tc" );
+    supported_[TEXTURE_BC3]        = supported_[TEXTURE_BC1];
+    supported_[TEXTURE_ASTC_4X4]   = emscripten_webgl_enable_extension( context, "WEBGL_compressed_texture_astc" );
+    s3tc_srgb_                     = emscripten_webgl_enable_extension( context, "WEBGL_compressed_texture_s3tc_srgb" );
+    STDOUT( "Compressed textures: ETC2 %s, S3TC %s (sRGB %s), ASTC %s.",
+            supported_[TEXTURE_ETC2_RGB8] ? "yes" : "no",
+            supported_[TEXTURE_BC1] ? "yes" : "no",
+            s3tc_srgb_ ? "yes" : "no",
+            supported_[TEXTURE_ASTC_4X4] ? "yes" : "no" );
+
+    const uint8_t white[4] = {255, 255, 255, 255};
+    glGenTextures( 1, &white_ );
+    if( !white_ ) {
+        STDERR( "Failed to create white texture." );
+        return false;
+    }
+    glActiveTexture( GL_TEXTURE0 + ALBEDO_UNIT );
+    glBindTexture( GL_TEXTURE_2D, white_ );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1 );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white );
+    glActiveTexture( GL_TEXTURE0 );
+    gpu_memory_allocated( GPU_MEMORY_TEXTURE, white_, sizeof( white ) );
+
+    GLState&     gl          = user_context.gl_state;
+    const GLuint programs[2] = {user_context.program, user_context.skinned_program};
+    for( GLuint program : programs ) {
+        gl.use_program( program );
+        gl.uniform_1i( glGetUniformLocation( program, "sampler2D_albedo" ), ALBEDO_UNIT );
+    }
+
+    if( checker_ < 0 ) {
+        std::vector<uint8_t> texels( 4 * CHECKER_WIDTH * CHECKER_HEIGHT );
+        for( int y = 0; y < CHECKER_HEIGHT; ++y ) {
+            for( int x = 0; x < CHECKER_WIDTH; ++x ) {
+                const uint8_t value = ( ( x / CHECKER_CELL + y / CHECKER_CELL ) & 1 ) ? 255 : CHECKER_DARK;
+                uint8_t*      texel = &texels[4 * ( y * CHECKER_WIDTH + x )];
+                texel[0] = texel[1] = texel[2] = value;
+                texel[3]                       = 255;
+            }
+        }
+        checker_ = add_rgba( "checker", CHECKER_WIDTH, CHECKER_HEIGHT, texels.data(), false );
+        albedo_  = checker_;
+    }
+    return true;
+}
+
+void TextureCache::release() {
+    for( Texture& texture : textures_ ) {
+        unload( texture );
+    }
+    gpu_memory_freed( GPU_MEMORY_TEXTURE, white_ );
+    glDeleteTextures( 1, &white_ );
+    white_ = 0;
+}
+
+int TextureCache::load( const std::string& url ) {
+    int index = -1;
+    for( size_t i = 0; i < textures_.size(); ++i ) {
+        if( textures_[i].name == url ) {
+            index = static_cast<int>( i );
+        }
+    }
+    if( ( index >= 0 ) && ( textures_[index].state != TEXTURE_FAILED ) ) {
+        return index;
+    }
+    if( index < 0 ) {
+        index = static_cast<int>( textures_.size() );
+        textures_.push_back( Texture() );
+    }
+
+    Texture& texture  = textures_[index];
+    texture           = Texture();
+    texture.name      = url;
+    texture.state     = TEXTURE_FETCHING;
+    texture.texture   = 0;
+    texture.bytes     = 0;
+    texture.residency = -1;
+    STDOUT( "Loading texture %s.", url.c_str() );
+    Request request = {emscripten_async_wget2_data( url.c_str(), "GET", nullptr, this, 1, on_load, on_error, nullptr ), index};
+    requests_.push_back( request );
+    return index;
+}
+
+int TextureCache::add_rgba( const char* name, int width, int height, const uint8_t* texels, bool srgb ) {
+    Texture texture;
+    texture.name      = name;
+    texture.state     = TEXTURE_MIPMAPPING;
+    texture.srgb      = srgb;
+    texture.source    = TEXTURE_RGBA8;
+    texture.width     = width;
+    texture.height    = height;
+    texture.levels    = mip_count( width, height );
+    texture.level     = 1;
+    texture.block     = 0;
+    texture.texture   = 0;
+    texture.bytes     = 0;
+    texture.residency = -1;
+    texture.rgba.resize( texture.levels );
+    texture.rgba[0].assign( texels, texels + 4 * static_cast<size_t>( width ) * height );
+    choose_format( texture );
+    textures_.push_back( std::move( texture ) );
+    return static_cast<int>( textures_.size() ) - 1;
+}
+
+void TextureCache::on_load( unsigned handle, void* arg, void* data, unsigned size ) {
+    TextureCache& cache = *static_cast<TextureCache*>( arg );
+    const int     index = cache.take_request( handle );
+    if( index < 0 ) {
+        return;
+    }
+    // The data is freed once this returns, and is parsed in the next update.
+    Texture&       texture = cache.textures_[index];
+    const uint8_t* bytes   = static_cast<const uint8_t*>( data );
+    texture.file.assign( bytes, bytes + size );
+    texture.state = TEXTURE_ARRIVED;
+}
+
+void TextureCache::on_error( unsigned handle, void* arg, int status, const char* ) {
+    TextureCache& cache = *static_cast<TextureCache*>( arg );
+    const int     index = cache.take_request( handle );
+    if( index >= 0 ) {
+        STDERR( "Failed to fetch texture %s, status %d.", cache.textures_[index].name.c_str(), status );
+        cache.textures_[index].state = TEXTURE_FAILED;
+        ++cache.stats_.failed;
+    }
+}
+
+int TextureCache::take_request( unsigned handle ) {
+    for( size_t i = 0; i < requests_.size(); ++i ) {
+        if( requests_[i].handle == static_cast<int>( handle ) ) {
+            const int texture = requests_[i].texture;
+            requests_.erase( requests_.begin() + i );
+            return texture;
+        }
+    }
+    return -1;
+}
+
+void TextureCache::fail( Texture& texture, const char* reason ) {
+    STDERR( "Failed to load texture %s: %s.", texture.name.c_str(), reason );
+    texture.state = TEXTURE_FAILED;
+    std::vector<uint8_t>().swap( texture.file );
+    texture.data.clear();
+    texture.rgba.clear();
+    ++stats_.failed;
+}
+
+// Only 2D textures, of a single layer and face, whose levels aren't supercompressed.
+bool TextureCache::parse( Texture& texture ) {
+    const std::vector<uint8_t>& file = texture.file;
+    if( ( file.size() < KTX2_HEADER_BYTES ) || memcmp( file.data(), KTX2_IDENTIFIER, sizeof( KTX2_IDENTIFIER ) ) ) {
+        fail( texture, "not a KTX2 file" );
+        return false;
+    }
+    const uint8_t* header        = file.data();
+    const uint32_t vk_format     = read_u32( header + 12 );
+    const uint32_t width         = read_u32( header + 20 );
+    const uint32_t height        = read_u32( header + 24 );
+    const uint32_t depth         = read_u32( header + 28 );
+    const uint32_t layers        = read_u32( header + 32 );
+    const uint32_t faces         = read_u32( header + 36 );
+    const uint32_t file_levels   = std::max( read_u32( header + 40 ), 1u );
+    const uint32_t supercompress = read_u32( header + 44 );
+    if( !width || !height || ( width > 16384 ) || ( height > 16384 ) || depth || ( layers > 1 ) || ( faces != 1 ) ) {
+        fail( texture, "only 2D textures are supported" );
+        return false;
+    }
+    if( supercompress ) {
+        // BasisLZ and Zstandard would need their transcoders in the build.
+        fail( texture, "supercompressed levels are not supported" );
+        return false;
+    }
+    const VkFormat* format = nullptr;
+    for( const VkFormat& candidate : VK_FORMATS ) {
+        format = ( candidate.vk == vk_format ) ? &candidate : format;
+    }
+    if( !format ) {
+        fail( texture, "unsupported format" );
+        return false;
+    }
+    const size_t levels = std::min( file_levels, static_cast<uint32_t>( mip_count( width, height ) ) );
+    if( file.size() < KTX2_HEADER_BYTES + KTX2_LEVEL_BYTES * file_levels ) {
+        fail( texture, "truncated level index" );
+        return false;
+    }
+
+    texture.source = format->format;
+    texture.srgb   = format->srgb;
+    texture.width  = static_cast<int>( width );
+    texture.height = static_cast<int>( height );
+    texture.data.resize( levels );
+    for( size_t level = 0; level < levels; ++level ) {
+        const uint8_t* entry    = header + KTX2_HEADER_BYTES + KTX2_LEVEL_BYTES * level;
+        const uint64_t offset   = read_u64( entry );
+        const uint64_t length   = read_u64( entry + 8 );
+        const size_t   expected = texture_level_bytes( texture.source, level_size( texture.width, level ), level_size( texture.height, level ) );
+        if( ( length != expected ) || ( offset > file.size() ) || ( length > file.size() - offset ) ) {
+            fail( texture, "level out of bounds" );
+            return false;
+        }
+        texture.data[level].assign( file.begin() + offset, file.begin() + offset + length );
+    }
+    std::vector<uint8_t>().swap( texture.file );
+
+    const bool direct = supported_[texture.source] &&
+                        ( !texture.srgb || s3tc_srgb_ || ( ( texture.source != TEXTURE_BC1 ) && ( texture.source != TEXTURE_BC3 ) ) );
+    texture.level = 0;
+    if( direct && texture_format_compressed( texture.source ) ) {
+        texture.format = texture.source;
+        texture.levels = static_cast<int>( levels );
+        texture.state  = TEXTURE_UPLOADING;
+    } else if( texture.source == TEXTURE_RGBA8 ) {
+        // Uncompressed levels are compressed like texels added directly, with a full chain.
+        texture.levels = mip_count( texture.width, texture.height );
+        texture.rgba   = std::move( texture.data );
+        texture.rgba.resize( texture.levels );
+        texture.data.clear();
+        texture.level = static_cast<int>( levels );
+        texture.state = TEXTURE_MIPMAPPING;
+        choose_format( texture );
+    } else if( texture.source == TEXTURE_ASTC_4X4 ) {
+        fail( texture, "ASTC is not available and can't be transcoded" );
+        return false;
+    } else {
+        texture.levels = mip_count( texture.width, texture.height );
+        texture.rgba.resize( texture.levels );
+        texture.state = TEXTURE_DECODING;
+        ++stats_.transcoded;
+    }
+    return true;
+}
+
+// The most compact format the context has for the RGBA8 texels of the first level: ETC2, or S3TC where blocks
+// align with the edges, or staying RGBA8. Opaque texels drop the alpha channel.
+void TextureCache::choose_format( Texture& texture ) {
+    const std::vector<uint8_t>& texels = texture.rgba[0];
+    bool                        opaque = true;
+    for( size_t i = 3; ( i < texels.size() ) && opaque; i += 4 ) {
+        opaque = texels[i] == 255;
+    }
+    const bool aligned = !( texture.width % 4 ) && !( texture.height % 4 );
+    if( supported_[TEXTURE_ETC2_RGB8] ) {
+        texture.format = opaque ? TEXTURE_ETC2_RGB8 : TEXTURE_ETC2_RGBA8;
+    } else if( supported_[TEXTURE_BC1] && aligned && ( !texture.srgb || s3tc_srgb_ ) ) {
+        texture.format = opaque ? TEXTURE_BC1 : TEXTURE_BC3;
+    } else {
+        texture.format = TEXTURE_RGBA8;
+    }
+}
+
+void TextureCache::step( Texture& texture ) {
+    const double begin_ms = emscripten_get_now();
+    const int    width    = level_size( texture.width, texture.level );
+    const int    height   = level_size( texture.height, texture.level );
+    switch( texture.state ) {
+    case TEXTURE_ARRIVED:
+        parse( texture );
+        stats_.parse_ms += emscripten_get_now() - begin_ms;
+        break;
+
+    case TEXTURE_DECODING:
+        texture.rgba[texture.level].resize( 4 * static_cast<size_t>( width ) * height );
+        texture_decode( texture.source, texture.data[texture.level].data(), width, height, texture.rgba[texture.level].data() );
+        if( ++texture.level == static_cast<int>( texture.data.size() ) ) {
+            texture.data.clear();
+            texture.state = TEXTURE_MIPMAPPING;
+            choose_format( texture );
+        }
+        stats_.decode_ms += emscripten_get_now() - begin_ms;
+        break;
+
+    case TEXTURE_MIPMAPPING:
+        if( texture.level < texture.levels ) {
+            const std::vector<uint8_t>& above = texture.rgba[texture.level - 1];
+            texture.rgba[texture.level].resize( 4 * static_cast<size_t>( width ) * height );
+            texture_generate_mip( above.data(),
+                                  level_size( texture.width, texture.level - 1 ),
+                                  level_size( texture.height, texture.level - 1 ),
+                                  texture.srgb,
+                                  texture.rgba[texture.level].data() );
+            ++texture.level;
+            ++stats_.generated;
+        }
+        if( texture.level == texture.levels ) {
+            texture.level = 0;
+            texture.block = 0;
+            texture.state = TEXTURE_ENCODING;
+        }
+        stats_.mip_ms += emscripten_get_now() - begin_ms;
+        break;
+
+    case TEXTURE_ENCODING:
+        if( texture.format == TEXTURE_RGBA8 ) {
+            texture.data  = std::move( texture.rgba );
+            texture.state = TEXTURE_UPLOADING;
+            break;
+        }
+        if( !texture.block ) {
+            texture.data.resize( texture.levels );
+            texture.data[texture.level].resize( texture_level_bytes( texture.format, width, height ) );
+        }
+        texture_encode( texture.format, texture.rgba[texture.level].data(), width, height, texture.block, ENCODE_BLOCKS, texture.data[texture.level].data() );
+        texture.block += ENCODE_BLOCKS;
+        if( texture.block >= static_cast<size_t>( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) ) {
+            texture.block = 0;
+            if( ++texture.level == texture.levels ) {
+                texture.rgba.clear();
+                texture.state = TEXTURE_UPLOADING;
+                ++stats_.encoded;
+            }
+        }
+        stats_.encode_ms += emscripten_get_now() - begin_ms;
+        break;
+
+    default: break;
+    }
+}
+
+bool TextureCache::upload( UserContext& user_context, Texture& texture ) {
+    const double begin_ms = emscripten_get_now();
+    const GLenum format   = texture_format_gl( texture.format, texture.srgb );
+    glGenTextures( 1, &texture.texture );
+    glActiveTexture( GL_TEXTURE0 + ALBEDO_UNIT );
+    glBindTexture( GL_TEXTURE_2D, texture.texture );
+    glTexStorage2D( GL_TEXTURE_2D, texture.levels, format, texture.width, texture.height );
+    texture.bytes = 0;
+    for( int level = 0; level < texture.levels; ++level ) {
+        const std::vector<uint8_t>& data   = texture.data[level];
+        const GLsizei               width  = level_size( texture.width, level );
+        const GLsizei               height = level_size( texture.height, level );
+        if( texture_format_compressed( texture.format ) ) {
+            glCompressedTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, width, height, format, static_cast<GLsizei>( data.size() ), data.data() );
+        } else {
+            glTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data.data() );
+        }
+        texture.bytes += data.size();
+    }
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, ( texture.levels > 1 ) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glActiveTexture( GL_TEXTURE0 );
+
+    gpu_memory_allocated( GPU_MEMORY_TEXTURE, texture.texture, texture.bytes );
+    user_context.frame_budget.count_bytes_uploaded( texture.bytes );
+    stats_.bytes[texture.format] += texture.bytes;
+    stats_.upload_ms += emscripten_get_now() - begin_ms;
+    return texture.texture != 0;
+}
+
+void TextureCache::unload( Texture& texture ) {
+    if( !texture.texture ) {
+        return;
+    }
+    gpu_memory_freed( GPU_MEMORY_TEXTURE, texture.texture );
+    glDeleteTextures( 1, &texture.texture );
+    texture.texture = 0;
+    stats_.bytes[texture.format] -= texture.bytes;
+}
+
+void TextureCache::update( UserContext& user_context, double budget_ms ) {
+    const double deadline_ms = emscripten_get_now() + budget_ms;
+    for( size_t i = 0; ( i < textures_.size() ) && ( emscripten_get_now() < deadline_ms ); ++i ) {
+        Texture& texture = textures_[i];
+        while( ( texture.state >= TEXTURE_ARRIVED ) && ( texture.state <= TEXTURE_ENCODING ) && ( emscripten_get_now() < deadline_ms ) ) {
+            step( texture );
+        }
+        if( texture.state != TEXTURE_UPLOADING ) {
+            continue;
+        }
+
+        if( !upload( user_context, texture ) ) {
+            fail( texture, "could not create the GL texture" );
+            continue;
+        }
+        texture.state = TEXTURE_READY;
+        ++stats_.loaded;
+        STDOUT( "Texture %s is %dx%d %s%s with %d levels, %.1lf KB.",
+                texture.name.c_str(),
+                texture.width,
+                texture.height,
+                texture_format_name( texture.format ),
+                texture.srgb ? " sRGB" : "",
+                texture.levels,
+                texture.bytes / 1024.0 );
+
+        // The levels stay to upload again after an eviction.
+        const int index   = static_cast<int>( i );
+        texture.residency = user_context.residency.add_asset(
+            texture.bytes,
+            [this, index]() { unload( textures_[index] ); },
+            [this, index, &user_context]() { return upload( user_context, textures_[index] ); } );
+        if( index == albedo_ ) {
+            user_context.redraw.request();
+        }
+    }
+}
+
+bool TextureCache::ready( int texture ) const {
+    return ( texture >= 0 ) && ( static_cast<size_t>( texture ) < textures_.size() ) && ( textures_[texture].state == TEXTURE_READY );
+}
+
+bool TextureCache::failed( int texture ) const {
+    return ( texture >= 0 ) && ( static_cast<size_t>( texture ) < textures_.size() ) && ( textures_[texture].state == TEXTURE_FAILED );
+}
+
+void TextureCache::set_albedo( int texture ) {
+    albedo_ = texture;
+}
+
+int TextureCache::albedo() const {
+    return albedo_;
+}
+
+int TextureCache::checker() const {
+    return checker_;
+}
+
+void TextureCache::bind( UserContext& user_context ) {
+    GLuint texture = white_;
+    if( ready( albedo_ ) && user_context.residency.use( textures_[albedo_].residency ) ) {
+        texture = textures_[albedo_].texture;
+    }
+    glActiveTexture( GL_TEXTURE0 + ALBEDO_UNIT );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glActiveTexture( GL_TEXTURE0 );
+}
+
+bool TextureCache::supported( TextureFormat format ) const {
+    return supported_[format];
+}
+
+size_t TextureCache::textures() const {
+    return textures_.size();
+}
+
+const TextureStats& TextureCache::stats() const {
+    return stats_;
+}
+
+void print_texture_stats( const TextureCache& cache ) {
+    const TextureStats& stats = cache.stats();
+    STDOUT( "Textures: %lu of %lu loaded, %lu failed, %lu transcoded, %lu encoded, %lu mip levels generated, "
+            "%.1lf ms parsing, %.1lf ms decoding, %.1lf ms mipmapping, %.1lf ms encoding, %.1lf ms uploading.",
+            stats.loaded,
+            static_cast<unsigned long>( cache.textures() ),
+            stats.failed,
+            stats.transcoded,
+            stats.encoded,
+            stats.generated,
+            stats.parse_ms,
+            stats.decode_ms,
+            stats.mip_ms,
+            stats.encode_ms,
+            stats.upload_ms );
+    for( int format = 0; format < TEXTURE_FORMATS; ++format ) {
+        if( stats.bytes[format] ) {
+            STDOUT( "Texture memory: %.1lf KB of %s.", stats.bytes[format] / 1024.0, texture_format_name( static_cast<TextureFormat>( format ) ) );
+        }
+    }
+}
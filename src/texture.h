@@ -0,0 +1,134 @@
+#ifndef WASMVR_TEXTURE_H
+#define WASMVR_TEXTURE_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "texture_codec.h"
+
+class UserContext;
+
+struct TextureStats {
+    unsigned long loaded;
+    unsigned long failed;
+    unsigned long transcoded; // Decoded from a compressed format the context can't sample.
+    unsigned long encoded;    // Compressed at load time.
+    unsigned long generated;  // Mip levels generated.
+    double        parse_ms;
+    double        decode_ms;
+    double        mip_ms;
+    double        encode_ms;
+    double        upload_ms;
+    size_t        bytes[TEXTURE_FORMATS]; // Resident on the GPU, by format.
+
+    TextureStats();
+};
+
+// Textures from KTX2 files or RGBA8 texels, kept on the GPU in the most compact format the context can sample.
+// A file's levels go up as they are if the context has their format. Otherwise they are decoded, and
+// uncompressed texels are given a full mip chain, box filtered in linear space, then encoded to ETC2 or S3TC,
+// whichever the context has, or kept as RGBA8 if neither. The work is split into steps that each end once a
+// deadline has passed, so a large texture is prepared over frames. Textures are assets of the GPU residency,
+// which may evict them and upload them again from the levels kept.
+class TextureCache {
+public:
+    // Texture unit the scene shader samples the albedo from.
+    static const GLint ALBEDO_UNIT = 6;
+
+    TextureCache();
+
+    // Finds the compressed formats the context has, creates the white texture drawn until the albedo is ready and
+    // points the scene programs' samplers at the unit. Adds the default albedo the first time.
+    bool create( UserContext& user_context );
+    // Deletes the GL textures, keeping every texture's levels to upload again.
+    void release();
+
+    // Starts fetching a KTX2 file, relative to the page, unless it was already. Returns the texture's handle.
+    int load( const std::string& url );
+    // A texture of width by height RGBA8 texels, row by row. Returns its handle.
+    int add_rgba( const char* name, int width, int height, const uint8_t* texels, bool srgb );
+
+    // Prepares textures that arrived for at most budget_ms, uploading those that are done.
+    void update( UserContext& user_context, double budget_ms );
+    bool ready( int texture ) const;
+    bool failed( int texture ) const;
+
+    void set_albedo( int texture );
+    int  albedo() const;
+    // The default albedo, a checker pattern.
+    int checker() const;
+    // Binds the albedo to its unit, or white while it isn't ready, and counts it as used this frame.
+    void bind( UserContext& user_context );
+
+    bool                supported( TextureFormat format ) const;
+    size_t              textures() const;
+    const TextureStats& stats() const;
+
+private:
+    enum TextureState {
+        TEXTURE_FETCHING,
+        TEXTURE_ARRIVED,  // The file, waiting to be parsed.
+        TEXTURE_DECODING, // Levels in a format the context lacks, to RGBA8.
+        TEXTURE_MIPMAPPING,
+        TEXTURE_ENCODING,
+        TEXTURE_UPLOADING,
+        TEXTURE_READY,
+        TEXTURE_FAILED,
+    };
+
+    struct Texture {
+        std::string                       name;
+        TextureState                      state;
+        bool                              srgb;
+        TextureFormat                     source; // Of the file's levels.
+        TextureFormat                     format; // On the GPU.
+        int                               width;
+        int                               height;
+        int                               levels;
+        std::vector<uint8_t>              file; // While arrived.
+        std::vector<std::vector<uint8_t>> data; // Each level in the source format, then in the GPU's.
+        std::vector<std::vector<uint8_t>> rgba; // Each level as RGBA8 texels, while being prepared.
+        int                               level;
+        size_t                            block; // Next block of the level being encoded.
+        GLuint                            texture;
+        size_t                            bytes;
+        int                               residency;
+    };
+
+    struct Request {
+        int handle;
+        int texture;
+    };
+
+    static void on_load( unsigned handle, void* arg, void* data, unsigned size );
+    static void on_error( unsigned handle, void* arg, int status, const char* text );
+
+    int  take_request( unsigned handle );
+    bool parse( Texture& texture );
+    void choose_format( Texture& texture );
+    // One step of preparing the texture, a level or some blocks of one.
+    void step( Texture& texture );
+    void fail( Texture& texture, const char* reason );
+    bool upload( UserContext& user_context, Texture& texture );
+    void unload( Texture& texture );
+
+    std::vector<Texture> textures_;
+    std::vector<Request> requests_;
+    bool                 supported_[TEXTURE_FORMATS];
+    bool                 s3tc_srgb_;
+    GLuint               white_;
+    int                  albedo_;
+    int                  checker_;
+    TextureStats         stats_;
+};
+
+// Generates the next mip level, half the size rounded down, from width by height RGBA8 texels.
+// sRGB texels are averaged in linear space. Odd edges fold their last texel into the one before.
+void texture_generate_mip( const uint8_t* texels, int width, int height, bool srgb, uint8_t* mip );
+
+void print_texture_stats( const TextureCache& cache );
+
+#endif // WASMVR_TEXTURE_H
@@ -0,0 +1,623 @@
+#include "texture_codec.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+    // Sized formats of the compressed texture extensions, which the core headers lack.
+    const GLenum GL_COMPRESSED_RGBA_S3TC_DXT1        = 0x83F1;
+    const GLenum GL_COMPRESSED_RGBA_S3TC_DXT5        = 0x83F3;
+    const GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1  = 0x8C4D;
+    const GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5  = 0x8C4F;
+    const GLenum GL_COMPRESSED_RGBA_ASTC_4X4         = 0x93B0;
+    const GLenum GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4X4 = 0x93D0;
+
+    // The small and large modifier of each ETC1 table, each also used negated.
+    const int ETC_MODIFIERS[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+    // Distances between the paint colours of the ETC2 T and H modes.
+    const int ETC2_DISTANCES[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+    // EAC alpha modifiers, scaled by the block's multiplier. The first four are negative, the last four positive.
+    const int EAC_MODIFIERS[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14},
+        {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8, -13, 1, 4, 7, 12},
+        {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11},
+        {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10},
+        {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9},
+        {-2, -5, -8, -10, 1, 4, 7, 9},
+        {-2, -4, -8, -10, 1, 3, 7, 9},
+        {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9},
+        {-1, -2, -3, -10, 0, 1, 2, 9},
+        {-4, -6, -8, -9, 3, 5, 7, 8},
+        {-3, -5, -7, -9, 2, 4, 6, 8},
+    };
+
+    // Texels of a block row by row, four bytes each.
+    typedef uint8_t Block[16][4];
+
+    int clamp255( int v ) {
+        return std::min( std::max( v, 0 ), 255 );
+    }
+
+    int square( int v ) {
+        return v * v;
+    }
+
+    void load_block( const uint8_t* rgba, int width, int height, int bx, int by, Block& texels ) {
+        for( int y = 0; y < 4; ++y ) {
+            const int sy = std::min( 4 * by + y, height - 1 );
+            for( int x = 0; x < 4; ++x ) {
+                const int sx = std::min( 4 * bx + x, width - 1 );
+                memcpy( texels[4 * y + x], rgba + 4 * ( static_cast<size_t>( sy ) * width + sx ), 4 );
+            }
+        }
+    }
+
+    void store_block( const Block& texels, int width, int height, int bx, int by, uint8_t* rgba ) {
+        for( int y = 0; ( y < 4 ) && ( 4 * by + y < height ); ++y ) {
+            for( int x = 0; ( x < 4 ) && ( 4 * bx + x < width ); ++x ) {
+                memcpy( rgba + 4 * ( static_cast<size_t>( 4 * by + y ) * width + 4 * bx + x ), texels[4 * y + x], 4 );
+            }
+        }
+    }
+
+    uint64_t load_big_endian( const uint8_t* bytes ) {
+        uint64_t v = 0;
+        for( int i = 0; i < 8; ++i ) {
+            v = ( v << 8 ) | bytes[i];
+        }
+        return v;
+    }
+
+    void store_big_endian( uint64_t v, uint8_t* bytes ) {
+        for( int i = 7; i >= 0; --i ) {
+            bytes[i] = static_cast<uint8_t>( v );
+            v >>= 8;
+        }
+    }
+
+    uint64_t load_little_endian( const uint8_t* bytes, int count ) {
+        uint64_t v = 0;
+        for( int i = count - 1; i >= 0; --i ) {
+            v = ( v << 8 ) | bytes[i];
+        }
+        return v;
+    }
+
+    void store_little_endian( uint64_t v, uint8_t* bytes, int count ) {
+        for( int i = 0; i < count; ++i ) {
+            bytes[i] = static_cast<uint8_t>( v );
+            v >>= 8;
+        }
+    }
+
+    // Bits high down to low of a block, as the ETC2 specification numbers them.
+    int bits( uint64_t block, int high, int low ) {
+        return static_cast<int>( ( block >> low ) & ( ( 1u << ( high - low + 1 ) ) - 1 ) );
+    }
+
+    int extend( int v, int from ) {
+        return ( v << ( 8 - from ) ) | ( v >> ( 2 * from - 8 ) );
+    }
+
+    // ETC indices are column by column, their high bits in the upper half of the low word.
+    int etc_index( uint64_t block, int x, int y ) {
+        const int p = 4 * x + y;
+        return static_cast<int>( ( ( block >> ( 16 + p ) ) & 1 ) << 1 | ( ( block >> p ) & 1 ) );
+    }
+
+    int etc_modifier( int table, int index ) {
+        const int magnitude = ETC_MODIFIERS[table][index & 1];
+        return ( index & 2 ) ? -magnitude : magnitude;
+    }
+
+    void etc_decode_subblocks( uint64_t block, const int base[2][3], Block& texels ) {
+        const int  tables[2] = {bits( block, 39, 37 ), bits( block, 36, 34 )};
+        const bool flip      = bits( block, 32, 32 ) != 0;
+        for( int y = 0; y < 4; ++y ) {
+            for( int x = 0; x < 4; ++x ) {
+                const int sub      = flip ? ( y >= 2 ) : ( x >= 2 );
+                const int modifier = etc_modifier( tables[sub], etc_index( block, x, y ) );
+                for( int c = 0; c < 3; ++c ) {
+                    texels[4 * y + x][c] = static_cast<uint8_t>( clamp255( base[sub][c] + modifier ) );
+                }
+            }
+        }
+    }
+
+    void etc_decode_paint( uint64_t block, const int paint[4][3], Block& texels ) {
+        for( int y = 0; y < 4; ++y ) {
+            for( int x = 0; x < 4; ++x ) {
+                const int* color = paint[etc_index( block, x, y )];
+                for( int c = 0; c < 3; ++c ) {
+                    texels[4 * y + x][c] = static_cast<uint8_t>( clamp255( color[c] ) );
+                }
+            }
+        }
+    }
+
+    void etc_paint( const int a[3], int distance, int* out ) {
+        for( int c = 0; c < 3; ++c ) {
+            out[c] = a[c] + distance;
+        }
+    }
+
+    // ETC1 with the T, H and planar modes of ETC2, which hide in overflowing differential colours.
+    void etc_decode_color( const uint8_t* bytes, Block& texels ) {
+        const uint64_t block = load_big_endian( bytes );
+        if( !bits( block, 33, 33 ) ) {
+            const int base[2][3] = {{extend( bits( block, 63, 60 ), 4 ), extend( bits( block, 55, 52 ), 4 ), extend( bits( block, 47, 44 ), 4 )},
+                                    {extend( bits( block, 59, 56 ), 4 ), extend( bits( block, 51, 48 ), 4 ), extend( bits( block, 43, 40 ), 4 )}};
+            etc_decode_subblocks( block, base, texels );
+            return;
+        }
+
+        int first[3];
+        int second[3];
+        for( int c = 0; c < 3; ++c ) {
+            const int delta = bits( block, 58 - 8 * c, 56 - 8 * c );
+            first[c]        = bits( block, 63 - 8 * c, 59 - 8 * c );
+            second[c]       = first[c] + ( ( delta & 4 ) ? delta - 8 : delta );
+        }
+
+        if( ( second[0] < 0 ) || ( second[0] > 31 ) ) {
+            const int c1[3]    = {extend( bits( block, 60, 59 ) << 2 | bits( block, 57, 56 ), 4 ), extend( bits( block, 55, 52 ), 4 ), extend( bits( block, 51, 48 ), 4 )};
+            const int c2[3]    = {extend( bits( block, 47, 44 ), 4 ), extend( bits( block, 43, 40 ), 4 ), extend( bits( block, 39, 36 ), 4 )};
+            const int distance = ETC2_DISTANCES[bits( block, 35, 34 ) << 1 | bits( block, 32, 32 )];
+            int       paint[4][3];
+            etc_paint( c1, 0, paint[0] );
+            etc_paint( c2, distance, paint[1] );
+            etc_paint( c2, 0, paint[2] );
+            etc_paint( c2, -distance, paint[3] );
+            etc_decode_paint( block, paint, texels );
+        } else if( ( second[1] < 0 ) || ( second[1] > 31 ) ) {
+            const int r1       = bits( block, 62, 59 );
+            const int g1       = bits( block, 58, 56 ) << 1 | bits( block, 52, 52 );
+            const int b1       = bits( block, 51, 51 ) << 3 | bits( block, 49, 47 );
+            const int r2       = bits( block, 46, 43 );
+            const int g2       = bits( block, 42, 39 );
+            const int b2       = bits( block, 38, 35 );
+            const int ordering = ( ( r1 << 8 ) | ( g1 << 4 ) | b1 ) >= ( ( r2 << 8 ) | ( g2 << 4 ) | b2 );
+            const int distance = ETC2_DISTANCES[bits( block, 34, 34 ) << 2 | bits( block, 32, 32 ) << 1 | ordering];
+            const int c1[3]    = {extend( r1, 4 ), extend( g1, 4 ), extend( b1, 4 )};
+            const int c2[3]    = {extend( r2, 4 ), extend( g2, 4 ), extend( b2, 4 )};
+            int       paint[4][3];
+            etc_paint( c1, distance, paint[0] );
+            etc_paint( c1, -distance, paint[1] );
+            etc_paint( c2, distance, paint[2] );
+            etc_paint( c2, -distance, paint[3] );
+            etc_decode_paint( block, paint, texels );
+        } else if( ( second[2] < 0 ) || ( second[2] > 31 ) ) {
+            // Planar: a gradient from the origin colour towards the colours right and below the block.
+            const int o[3] = {extend( bits( block, 62, 57 ), 6 ),
+                              extend( bits( block, 56, 56 ) << 6 | bits( block, 54, 49 ), 7 ),
+                              extend( bits( block, 48, 48 ) << 5 | bits( block, 44, 43 ) << 3 | bits( block, 41, 39 ), 6 )};
+            const int h[3] = {extend( bits( block, 38, 34 ) << 1 | bits( block, 32, 32 ), 6 ), extend( bits( block, 31, 25 ), 7 ), extend( bits( block, 24, 19 ), 6 )};
+            const int v[3] = {extend( bits( block, 18, 13 ), 6 ), extend( bits( block, 12, 6 ), 7 ), extend( bits( block, 5, 0 ), 6 )};
+            for( int y = 0; y < 4; ++y ) {
+                for( int x = 0; x < 4; ++x ) {
+                    for( int c = 0; c < 3; ++c ) {
+                        texels[4 * y + x][c] = static_cast<uint8_t>( clamp255( ( x * ( h[c] - o[c] ) + y * ( v[c] - o[c] ) + 4 * o[c] + 2 ) >> 2 ) );
+                    }
+                }
+            }
+        } else {
+            const int base[2][3] = {{extend( first[0], 5 ), extend( first[1], 5 ), extend( first[2], 5 )},
+                                    {extend( second[0], 5 ), extend( second[1], 5 ), extend( second[2], 5 )}};
+            etc_decode_subblocks( block, base, texels );
+        }
+    }
+
+    void eac_decode_alpha( const uint8_t* bytes, Block& texels ) {
+        const uint64_t block      = load_big_endian( bytes );
+        const int      base       = bits( block, 63, 56 );
+        const int      multiplier = bits( block, 55, 52 );
+        const int*     modifiers  = EAC_MODIFIERS[bits( block, 51, 48 )];
+        for( int y = 0; y < 4; ++y ) {
+            for( int x = 0; x < 4; ++x ) {
+                const int p          = 4 * x + y;
+                texels[4 * y + x][3] = static_cast<uint8_t>( clamp255( base + multiplier * modifiers[bits( block, 47 - 3 * p, 45 - 3 * p )] ) );
+            }
+        }
+    }
+
+    void bc_unpack_565( int color, int* out ) {
+        out[0] = extend( ( color >> 11 ) & 31, 5 );
+        out[1] = extend( ( color >> 5 ) & 63, 6 );
+        out[2] = extend( color & 31, 5 );
+    }
+
+    int bc_pack_565( const int* color ) {
+        return ( ( clamp255( color[0] ) * 31 + 127 ) / 255 ) << 11 | ( ( clamp255( color[1] ) * 63 + 127 ) / 255 ) << 5 |
+               ( ( clamp255( color[2] ) * 31 + 127 ) / 255 );
+    }
+
+    // The four colours of a BC1 block. BC3 colour blocks always use four, BC1 ones three and transparent black
+    // when the first endpoint isn't the greater.
+    void bc_palette( int c0, int c1, bool four_always, int palette[4][4] ) {
+        bc_unpack_565( c0, palette[0] );
+        bc_unpack_565( c1, palette[1] );
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+        for( int c = 0; c < 3; ++c ) {
+            if( four_always || ( c0 > c1 ) ) {
+                palette[2][c] = ( 2 * palette[0][c] + palette[1][c] ) / 3;
+                palette[3][c] = ( palette[0][c] + 2 * palette[1][c] ) / 3;
+            } else {
+                palette[2][c] = ( palette[0][c] + palette[1][c] ) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        if( !four_always && ( c0 <= c1 ) ) {
+            palette[3][3] = 0;
+        }
+    }
+
+    void bc_decode_color( const uint8_t* bytes, bool four_always, Block& texels ) {
+        const int      c0      = static_cast<int>( load_little_endian( bytes, 2 ) );
+        const int      c1      = static_cast<int>( load_little_endian( bytes + 2, 2 ) );
+        const uint64_t indices = load_little_endian( bytes + 4, 4 );
+        int            palette[4][4];
+        bc_palette( c0, c1, four_always, palette );
+        for( int i = 0; i < 16; ++i ) {
+            const int* color = palette[( indices >> ( 2 * i ) ) & 3];
+            // BC3 blocks get their alpha from the alpha block.
+            for( int c = 0; c < ( four_always ? 3 : 4 ); ++c ) {
+                texels[i][c] = static_cast<uint8_t>( color[c] );
+            }
+        }
+    }
+
+    void bc_alpha_palette( int a0, int a1, int palette[8] ) {
+        palette[0] = a0;
+        palette[1] = a1;
+        if( a0 > a1 ) {
+            for( int i = 1; i < 7; ++i ) {
+                palette[i + 1] = ( ( 7 - i ) * a0 + i * a1 ) / 7;
+            }
+        } else {
+            for( int i = 1; i < 5; ++i ) {
+                palette[i + 1] = ( ( 5 - i ) * a0 + i * a1 ) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    void bc_decode_alpha( const uint8_t* bytes, Block& texels ) {
+        int palette[8];
+        bc_alpha_palette( bytes[0], bytes[1], palette );
+        const uint64_t indices = load_little_endian( bytes + 2, 6 );
+        for( int i = 0; i < 16; ++i ) {
+            texels[i][3] = static_cast<uint8_t>( palette[( indices >> ( 3 * i ) ) & 7] );
+        }
+    }
+
+    // Endpoints are the corners of the colours' bounding box, inset a little, along the diagonal that follows
+    // how the channels change together.
+    void bc_encode_color( const Block& texels, uint8_t* bytes ) {
+        int lo[3]   = {255, 255, 255};
+        int hi[3]   = {0, 0, 0};
+        int mean[3] = {0, 0, 0};
+        for( int i = 0; i < 16; ++i ) {
+            for( int c = 0; c < 3; ++c ) {
+                lo[c] = std::min( lo[c], static_cast<int>( texels[i][c] ) );
+                hi[c] = std::max( hi[c], static_cast<int>( texels[i][c] ) );
+                mean[c] += texels[i][c];
+            }
+        }
+        int axis = 0;
+        for( int c = 1; c < 3; ++c ) {
+            axis = ( hi[c] - lo[c] > hi[axis] - lo[axis] ) ? c : axis;
+        }
+        for( int c = 0; c < 3; ++c ) {
+            int covariance = 0;
+            for( int i = 0; i < 16; ++i ) {
+                covariance += ( 16 * texels[i][c] - mean[c] ) * ( 16 * texels[i][axis] - mean[axis] );
+            }
+            const int inset = ( hi[c] - lo[c] ) / 16;
+            lo[c] += inset;
+            hi[c] -= inset;
+            if( covariance < 0 ) {
+                std::swap( lo[c], hi[c] );
+            }
+        }
+
+        int c0 = bc_pack_565( hi );
+        int c1 = bc_pack_565( lo );
+        if( c0 < c1 ) {
+            std::swap( c0, c1 );
+        }
+        uint64_t indices = 0;
+        if( c0 != c1 ) {
+            int palette[4][4];
+            bc_palette( c0, c1, true, palette );
+            for( int i = 0; i < 16; ++i ) {
+                int best       = 0;
+                int best_error = 1 << 30;
+                for( int p = 0; p < 4; ++p ) {
+                    const int error = square( palette[p][0] - texels[i][0] ) + square( palette[p][1] - texels[i][1] ) + square( palette[p][2] - texels[i][2] );
+                    if( error < best_error ) {
+                        best       = p;
+                        best_error = error;
+                    }
+                }
+                indices |= static_cast<uint64_t>( best ) << ( 2 * i );
+            }
+        }
+        store_little_endian( static_cast<uint64_t>( c0 ), bytes, 2 );
+        store_little_endian( static_cast<uint64_t>( c1 ), bytes + 2, 2 );
+        store_little_endian( indices, bytes + 4, 4 );
+    }
+
+    void bc_encode_alpha( const Block& texels, uint8_t* bytes ) {
+        int a0 = 0;
+        int a1 = 255;
+        for( int i = 0; i < 16; ++i ) {
+            a0 = std::max( a0, static_cast<int>( texels[i][3] ) );
+            a1 = std::min( a1, static_cast<int>( texels[i][3] ) );
+        }
+        uint64_t indices = 0;
+        if( a0 != a1 ) {
+            int palette[8];
+            bc_alpha_palette( a0, a1, palette );
+            for( int i = 0; i < 16; ++i ) {
+                int best = 0;
+                for( int p = 1; p < 8; ++p ) {
+                    best = ( abs( palette[p] - texels[i][3] ) < abs( palette[best] - texels[i][3] ) ) ? p : best;
+                }
+                indices |= static_cast<uint64_t>( best ) << ( 3 * i );
+            }
+        }
+        bytes[0] = static_cast<uint8_t>( a0 );
+        bytes[1] = static_cast<uint8_t>( a1 );
+        store_little_endian( indices, bytes + 2, 6 );
+    }
+
+    // The ETC1 table and indices that best fit a subblock's texels around a base colour. A modifier moves all
+    // three channels alike, so each texel takes the one nearest its mean offset from the base.
+    int etc_fit_subblock( const Block& texels, const int* pixels, const int* base, int& table, int* indices ) {
+        int offsets[8]; // Three times the mean offset.
+        for( int i = 0; i < 8; ++i ) {
+            const uint8_t* texel = texels[pixels[i]];
+            offsets[i]           = texel[0] + texel[1] + texel[2] - base[0] - base[1] - base[2];
+        }
+        int best_error = 1 << 30;
+        for( int t = 0; t < 8; ++t ) {
+            const int threshold = 3 * ( ETC_MODIFIERS[t][0] + ETC_MODIFIERS[t][1] );
+            int       error     = 0;
+            int       chosen[8];
+            for( int i = 0; ( i < 8 ) && ( error < best_error ); ++i ) {
+                const uint8_t* texel    = texels[pixels[i]];
+                chosen[i]               = ( ( offsets[i] < 0 ) ? 2 : 0 ) | ( ( 2 * abs( offsets[i] ) >= threshold ) ? 1 : 0 );
+                const int      modifier = etc_modifier( t, chosen[i] );
+                error += square( clamp255( base[0] + modifier ) - texel[0] ) + square( clamp255( base[1] + modifier ) - texel[1] ) +
+                         square( clamp255( base[2] + modifier ) - texel[2] );
+            }
+            if( error < best_error ) {
+                best_error = error;
+                table      = t;
+                memcpy( indices, chosen, sizeof( chosen ) );
+            }
+        }
+        return best_error;
+    }
+
+    // ETC1 individual and differential modes, which ETC2 decodes the same. Each subblock's base colour is the
+    // mean of its texels, the flip and mode that fit best are kept.
+    void etc_encode_color( const Block& texels, uint8_t* bytes ) {
+        int      best_error = 1 << 30;
+        uint64_t best_block = 0;
+        for( int flip = 0; flip < 2; ++flip ) {
+            int pixels[2][8];
+            int counts[2] = {0, 0};
+            int sums[2][3] = {{0, 0, 0}, {0, 0, 0}};
+            for( int y = 0; y < 4; ++y ) {
+                for( int x = 0; x < 4; ++x ) {
+                    const int sub              = flip ? ( y >= 2 ) : ( x >= 2 );
+                    pixels[sub][counts[sub]++] = 4 * y + x;
+                    for( int c = 0; c < 3; ++c ) {
+                        sums[sub][c] += texels[4 * y + x][c];
+                    }
+                }
+            }
+
+            for( int differential = 0; differential < 2; ++differential ) {
+                const int levels = differential ? 31 : 15;
+                int       quantized[2][3];
+                int       base[2][3];
+                bool      fits = true;
+                for( int sub = 0; sub < 2; ++sub ) {
+                    for( int c = 0; c < 3; ++c ) {
+                        quantized[sub][c] = ( sums[sub][c] * levels + 8 * 127 ) / ( 8 * 255 );
+                        base[sub][c]      = extend( quantized[sub][c], differential ? 5 : 4 );
+                    }
+                }
+                for( int c = 0; differential && ( c < 3 ); ++c ) {
+                    const int delta = quantized[1][c] - quantized[0][c];
+                    fits            = fits && ( delta >= -4 ) && ( delta <= 3 );
+                }
+                if( !fits ) {
+                    continue;
+                }
+
+                int tables[2];
+                int indices[2][8];
+                int error = 0;
+                for( int sub = 0; sub < 2; ++sub ) {
+                    error += etc_fit_subblock( texels, pixels[sub], base[sub], tables[sub], indices[sub] );
+                }
+                if( error >= best_error ) {
+                    continue;
+                }
+
+                uint64_t block = 0;
+                for( int c = 0; c < 3; ++c ) {
+                    if( differential ) {
+                        block |= static_cast<uint64_t>( quantized[0][c] ) << ( 59 - 8 * c );
+                        block |= static_cast<uint64_t>( ( quantized[1][c] - quantized[0][c] ) & 7 ) << ( 56 - 8 * c );
+                    } else {
+                        block |= static_cast<uint64_t>( quantized[0][c] ) << ( 60 - 8 * c );
+                        block |= static_cast<uint64_t>( quantized[1][c] ) << ( 56 - 8 * c );
+                    }
+                }
+                block |= static_cast<uint64_t>( tables[0] ) << 37 | static_cast<uint64_t>( tables[1] ) << 34;
+                block |= static_cast<uint64_t>( differential ) << 33 | static_cast<uint64_t>( flip ) << 32;
+                for( int sub = 0; sub < 2; ++sub ) {
+                    for( int i = 0; i < 8; ++i ) {
+                        const int p = 4 * ( pixels[sub][i] % 4 ) + pixels[sub][i] / 4;
+                        block |= static_cast<uint64_t>( indices[sub][i] >> 1 ) << ( 16 + p ) | static_cast<uint64_t>( indices[sub][i] & 1 ) << p;
+                    }
+                }
+                best_error = error;
+                best_block = block;
+            }
+        }
+        store_big_endian( best_block, bytes );
+    }
+
+    void eac_encode_alpha( const Block& texels, uint8_t* bytes ) {
+        int lo = 255;
+        int hi = 0;
+        for( int i = 0; i < 16; ++i ) {
+            lo = std::min( lo, static_cast<int>( texels[i][3] ) );
+            hi = std::max( hi, static_cast<int>( texels[i][3] ) );
+        }
+
+        // Table 13 has a zero modifier, which keeps a flat block exact.
+        uint64_t best_block = static_cast<uint64_t>( lo ) << 56 | static_cast<uint64_t>( 1 ) << 52 | static_cast<uint64_t>( 13 ) << 48;
+        for( int p = 0; p < 16; ++p ) {
+            best_block |= static_cast<uint64_t>( 4 ) << ( 45 - 3 * p );
+        }
+        int best_error = ( lo == hi ) ? 0 : 1 << 30;
+        for( int t = 0; ( t < 16 ) && best_error; ++t ) {
+            const int* modifiers = EAC_MODIFIERS[t];
+            const int  span      = modifiers[7] - modifiers[3];
+            const int  guess     = ( hi - lo + span / 2 ) / span;
+            for( int multiplier = std::max( guess - 1, 1 ); multiplier <= std::min( guess + 1, 15 ); ++multiplier ) {
+                const int base  = clamp255( ( hi + lo - multiplier * ( modifiers[7] + modifiers[3] ) + 1 ) / 2 );
+                uint64_t  block = static_cast<uint64_t>( base ) << 56 | static_cast<uint64_t>( multiplier ) << 52 | static_cast<uint64_t>( t ) << 48;
+                int       error = 0;
+                for( int y = 0; ( y < 4 ) && ( error < best_error ); ++y ) {
+                    for( int x = 0; x < 4; ++x ) {
+                        const int alpha       = texels[4 * y + x][3];
+                        int       best        = 0;
+                        int       pixel_error = 1 << 30;
+                        for( int index = 0; index < 8; ++index ) {
+                            const int e = square( clamp255( base + multiplier * modifiers[index] ) - alpha );
+                            if( e < pixel_error ) {
+                                pixel_error = e;
+                                best        = index;
+                            }
+                        }
+                        error += pixel_error;
+                        block |= static_cast<uint64_t>( best ) << ( 45 - 3 * ( 4 * x + y ) );
+                    }
+                }
+                if( error < best_error ) {
+                    best_error = error;
+                    best_block = block;
+                }
+            }
+        }
+        store_big_endian( best_block, bytes );
+    }
+}
+
+const char* texture_format_name( TextureFormat format ) {
+    switch( format ) {
+    case TEXTURE_RGBA8: return "RGBA8";
+    case TEXTURE_ETC2_RGB8: return "ETC2 RGB8";
+    case TEXTURE_ETC2_RGBA8: return "ETC2 RGBA8";
+    case TEXTURE_BC1: return "BC1";
+    case TEXTURE_BC3: return "BC3";
+    case TEXTURE_ASTC_4X4: return "ASTC 4x4";
+    default: return "unknown";
+    }
+}
+
+bool texture_format_compressed( TextureFormat format ) {
+    return format != TEXTURE_RGBA8;
+}
+
+GLenum texture_format_gl( TextureFormat format, bool srgb ) {
+    switch( format ) {
+    case TEXTURE_RGBA8: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    case TEXTURE_ETC2_RGB8: return srgb ? GL_COMPRESSED_SRGB8_ETC2 : GL_COMPRESSED_RGB8_ETC2;
+    case TEXTURE_ETC2_RGBA8: return srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC : GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case TEXTURE_BC1: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 : GL_COMPRESSED_RGBA_S3TC_DXT1;
+    case TEXTURE_BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 : GL_COMPRESSED_RGBA_S3TC_DXT5;
+    case TEXTURE_ASTC_4X4: return srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4X4 : GL_COMPRESSED_RGBA_ASTC_4X4;
+    default: return 0;
+    }
+}
+
+size_t texture_level_bytes( TextureFormat format, int width, int height ) {
+    if( !texture_format_compressed( format ) ) {
+        return 4 * static_cast<size_t>( width ) * height;
+    }
+    const size_t block_bytes = ( ( format == TEXTURE_ETC2_RGB8 ) || ( format == TEXTURE_BC1 ) ) ? 8 : 16;
+    return block_bytes * ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 );
+}
+
+bool texture_decode( TextureFormat format, const uint8_t* blocks, int width, int height, uint8_t* rgba ) {
+    if( ( format != TEXTURE_ETC2_RGB8 ) && ( format != TEXTURE_ETC2_RGBA8 ) && ( format != TEXTURE_BC1 ) && ( format != TEXTURE_BC3 ) ) {
+        return false;
+    }
+    const size_t block_bytes = texture_level_bytes( format, 4, 4 );
+    const int    columns     = ( width + 3 ) / 4;
+    for( int by = 0; by < ( height + 3 ) / 4; ++by ) {
+        for( int bx = 0; bx < columns; ++bx ) {
+            const uint8_t* block = blocks + block_bytes * ( static_cast<size_t>( by ) * columns + bx );
+            Block          texels;
+            for( int i = 0; i < 16; ++i ) {
+                texels[i][3] = 255;
+            }
+            switch( format ) {
+            case TEXTURE_ETC2_RGB8: etc_decode_color( block, texels ); break;
+            case TEXTURE_ETC2_RGBA8:
+                eac_decode_alpha( block, texels );
+                etc_decode_color( block + 8, texels );
+                break;
+            case TEXTURE_BC1: bc_decode_color( block, false, texels ); break;
+            default:
+                bc_decode_alpha( block, texels );
+                bc_decode_color( block + 8, true, texels );
+                break;
+            }
+            store_block( texels, width, height, bx, by, rgba );
+        }
+    }
+    return true;
+}
+
+bool texture_encode( TextureFormat format, const uint8_t* rgba, int width, int height, size_t first, size_t count, uint8_t* blocks ) {
+    if( ( format != TEXTURE_ETC2_RGB8 ) && ( format != TEXTURE_ETC2_RGBA8 ) && ( format != TEXTURE_BC1 ) && ( format != TEXTURE_BC3 ) ) {
+        return false;
+    }
+    const size_t block_bytes = texture_level_bytes( format, 4, 4 );
+    const size_t columns     = ( width + 3 ) / 4;
+    const size_t last        = std::min( first + count, columns * ( ( height + 3 ) / 4 ) );
+    for( size_t i = first; i < last; ++i ) {
+        uint8_t* block = blocks + block_bytes * i;
+        Block    texels;
+        load_block( rgba, width, height, static_cast<int>( i % columns ), static_cast<int>( i / columns ), texels );
+        switch( format ) {
+        case TEXTURE_ETC2_RGB8: etc_encode_color( texels, block ); break;
+        case TEXTURE_ETC2_RGBA8:
+            eac_encode_alpha( texels, block );
+            etc_encode_color( texels, block + 8 );
+            break;
+        case TEXTURE_BC1: bc_encode_color( texels, block ); break;
+        default:
+            bc_encode_alpha( texels, block );
+            bc_encode_color( texels, block + 8 );
+            break;
+        }
+    }
+    return true;
+}
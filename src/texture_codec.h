@@ -0,0 +1,34 @@
+#ifndef WASMVR_TEXTURE_CODEC_H
+#define WASMVR_TEXTURE_CODEC_H
+
+#include <GLES3/gl3.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Formats textures are kept in on the GPU. All compressed ones are of 4x4 blocks.
+enum TextureFormat {
+    TEXTURE_RGBA8,
+    TEXTURE_ETC2_RGB8,
+    TEXTURE_ETC2_RGBA8, // ETC2 colour with EAC alpha.
+    TEXTURE_BC1,        // S3TC DXT1.
+    TEXTURE_BC3,        // S3TC DXT5.
+    TEXTURE_ASTC_4X4,
+    TEXTURE_FORMATS
+};
+
+const char* texture_format_name( TextureFormat format );
+bool        texture_format_compressed( TextureFormat format );
+// The sized internal format, of the sRGB variant if srgb.
+GLenum texture_format_gl( TextureFormat format, bool srgb );
+// Bytes of a level of the format, counting partial blocks at the edges as whole ones.
+size_t texture_level_bytes( TextureFormat format, int width, int height );
+
+// Decodes a level of BC1, BC3 or ETC2 blocks into RGBA8 texels, returning false for formats it can't decode.
+bool texture_decode( TextureFormat format, const uint8_t* blocks, int width, int height, uint8_t* rgba );
+
+// Encodes the blocks [first, first + count) of an RGBA8 level, counted row by row, into BC1, BC3 or ETC2 blocks,
+// so a large level can be encoded over several calls. Edge blocks repeat the last column and row.
+// Returns false for formats it can't encode.
+bool texture_encode( TextureFormat format, const uint8_t* rgba, int width, int height, size_t first, size_t count, uint8_t* blocks );
+
+#endif // WASMVR_TEXTURE_CODEC_H
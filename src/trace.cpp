@@ -0,0 +1,188 @@
+#include "trace.h"
+
+#include <atomic>
+#include <emscripten.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "util.h"
+
+namespace {
+    struct TraceEvent {
+        const char* name;
+        double      ms;
+        uint32_t    thread;
+        char        phase; // 'B' or 'E', as in the trace event format.
+    };
+
+    struct Trace {
+        std::vector<TraceEvent> ring;
+        std::atomic<uint64_t>   next; // Events added to the capture, the ring's slot is this modulo its size.
+        bool                    capturing;
+        TraceStats              stats;
+
+        Trace()
+            : next( 0 )
+            , capturing( false )
+            , stats() {
+        }
+    };
+
+    Trace trace;
+
+    // Threads are numbered as they first add an event, the first being the main thread.
+    std::atomic<uint32_t> threads( 0 );
+
+    uint32_t thread_id() {
+        thread_local uint32_t id = ++threads;
+        return id;
+    }
+
+    void add_event( const char* name, char phase ) {
+        if( !trace.capturing ) {
+            return;
+        }
+        const uint64_t index = trace.next++;
+        TraceEvent&    event = trace.ring[index % trace.ring.size()];
+        event.name           = name;
+        event.ms             = emscripten_get_now();
+        event.thread         = thread_id();
+        event.phase          = phase;
+    }
+
+    void update_stats() {
+        const uint64_t added    = trace.next;
+        trace.stats.events      = static_cast<unsigned long>( added );
+        trace.stats.overwritten = static_cast<unsigned long>( ( added > trace.ring.size() ) ? added - trace.ring.size() : 0 );
+        trace.stats.capacity    = trace.ring.size();
+    }
+
+    // Returned by trace_capture_json().
+    std::string exported;
+}
+
+// clang-format off
+EM_JS( void, save_trace, ( const char* name, const char* data, int size ), { impl_save_file( UTF8ToString( name ), HEAPU8.slice( data, data + size ) ); } );
+// clang-format on
+
+void trace_start( size_t events ) {
+    trace.capturing = false;
+    // Filled here, so the pages are touched before the capture rather than during it.
+    trace.ring.assign( events ? events : TRACE_DEFAULT_EVENTS, TraceEvent() );
+    trace.next = 0;
+    ++trace.stats.captures;
+    update_stats();
+    trace.capturing = true;
+}
+
+void trace_stop() {
+    trace.capturing = false;
+    update_stats();
+}
+
+bool trace_capturing() {
+    return trace.capturing;
+}
+
+void trace_begin( const char* name ) {
+    add_event( name, 'B' );
+}
+
+void trace_end( const char* name ) {
+    add_event( name, 'E' );
+}
+
+std::string trace_json() {
+    const uint64_t added = trace.next;
+    const uint64_t size  = trace.ring.size();
+    const uint64_t first = ( added > size ) ? added - size : 0;
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"wasmvr\"}}";
+    const uint32_t thread_count = threads;
+    for( uint32_t thread = 1; thread <= thread_count; ++thread ) {
+        char name[32];
+        char line[128];
+        if( thread == 1 ) {
+            snprintf( name, sizeof( name ), "main" );
+        } else {
+            snprintf( name, sizeof( name ), "worker %u", thread );
+        }
+        snprintf( line, sizeof( line ), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                  thread, name );
+        out += line;
+    }
+    for( uint64_t i = first; i < added; ++i ) {
+        const TraceEvent& event = trace.ring[i % size];
+        char              line[256];
+        // Timestamps are in microseconds.
+        snprintf( line, sizeof( line ), ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                  event.name, event.phase, 1000.0 * event.ms, event.thread );
+        out += line;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+TraceScope::TraceScope( const char* name )
+    : name_( name ) {
+    add_event( name_, 'B' );
+}
+
+TraceScope::~TraceScope() {
+    add_event( name_, 'E' );
+}
+
+const TraceStats& trace_stats() {
+    update_stats();
+    return trace.stats;
+}
+
+void print_trace_stats() {
+    const TraceStats& stats = trace_stats();
+    if( !stats.captures ) {
+        return;
+    }
+    STDOUT( "Trace: %s, %lu events in a ring of %lu, %lu overwritten.",
+            trace.capturing ? "capturing" : "stopped",
+            stats.events,
+            static_cast<unsigned long>( stats.capacity ),
+            stats.overwritten );
+}
+
+extern "C" {
+EMSCRIPTEN_KEEPALIVE void trace_capture_start( int events ) {
+    trace_start( ( events > 0 ) ? static_cast<size_t>( events ) : TRACE_DEFAULT_EVENTS );
+}
+
+EMSCRIPTEN_KEEPALIVE void trace_capture_stop() {
+    trace_stop();
+}
+
+EMSCRIPTEN_KEEPALIVE const char* trace_capture_json() {
+    exported = trace_json();
+    return exported.c_str();
+}
+
+EMSCRIPTEN_KEEPALIVE int trace_capture_write( const char* path ) {
+    const std::string out  = trace_json();
+    FILE*             file = fopen( path, "wb" );
+    if( !file ) {
+        STDERR( "Failed to create %s.", path );
+        return 0;
+    }
+    bool written = fwrite( out.data(), 1, out.size(), file ) == out.size();
+    written      = ( fclose( file ) == 0 ) && written;
+    if( !written ) {
+        STDERR( "Failed to write %s.", path );
+    }
+    return written ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE void trace_capture_save() {
+    trace_stop();
+    const std::string out = trace_json();
+    save_trace( "trace.json", out.data(), static_cast<int>( out.size() ) );
+}
+}
@@ -0,0 +1,62 @@
+#ifndef WASMVR_TRACE_H
+#define WASMVR_TRACE_H
+
+#include <stddef.h>
+#include <string>
+
+// Timeline of the phases of each frame, to see why a particular frame was slow where the running stats only
+// show that some were. While capturing, begin and end events go into a ring allocated up front, so a capture
+// can be left running for a whole session and keeps the most recent events once the ring is full. Captures
+// export as Chrome trace event JSON, for chrome://tracing or ui.perfetto.dev.
+//
+// Names must be string literals, or otherwise outlive the capture, as only their pointers are kept.
+
+// Events the ring holds by default, half a minute of VR frames with room to spare.
+const size_t TRACE_DEFAULT_EVENTS = 1 << 18;
+
+// Starts a new capture, dropping any previous one.
+void trace_start( size_t events = TRACE_DEFAULT_EVENTS );
+// Stops adding events, keeping those captured for export.
+void trace_stop();
+bool trace_capturing();
+
+void trace_begin( const char* name );
+void trace_end( const char* name );
+
+// The events captured, oldest first, as Chrome trace event JSON.
+std::string trace_json();
+
+// Begins an event when constructed and ends it when it goes out of scope.
+class TraceScope {
+public:
+    explicit TraceScope( const char* name );
+    ~TraceScope();
+
+private:
+    const char* name_;
+};
+
+struct TraceStats {
+    unsigned long captures;
+    unsigned long events;      // Of the current capture, including those overwritten.
+    unsigned long overwritten; // Lost to newer events once the ring was full.
+    size_t        capacity;
+};
+
+const TraceStats& trace_stats();
+void              print_trace_stats();
+
+// For the browser console, e.g. Module.UTF8ToString( Module._trace_capture_json() ).
+extern "C" {
+// Starts a capture of up to events events, or the default number for 0.
+void trace_capture_start( int events );
+void trace_capture_stop();
+// The capture as JSON, valid until the next call.
+const char* trace_capture_json();
+// Writes the capture to a file, returning whether it was written.
+int trace_capture_write( const char* path );
+// Stops the capture, if running, and offers the JSON as a download.
+void trace_capture_save();
+}
+
+#endif // WASMVR_TRACE_H
@@ -10,11 +10,43 @@ UserContext::UserContext()
     , surface( 0 )
     , program( 0 )
     , vec4_position( -1 )
+    , vec4_normal( -1 )
+    , vec2_uv( -1 )
     , mat4_model( -1 )
-    , mat4_view( -1 )
-    , mat4_projection( -1 )
+    , bool_octahedral( -1 )
+    , vec4_instance_rows{-1, -1, -1}
+    , vec4_instance_color( -1 )
+    , bool_instanced( -1 )
+    , vec4_bone_indices( -1 )
+    , vec4_bone_weights( -1 )
+    , float_instance_palette( -1 )
+    , skinned_program( 0 )
+    , skinned_bool_instanced( -1 )
+    , skinned_bool_octahedral( -1 )
+    , depth_program( 0 )
+    , depth_bool_instanced( -1 )
+    , depth_skinned_program( 0 )
+    , depth_skinned_bool_instanced( -1 )
+    , vertex_buffer( 0 )
+    , camera_block( GL_INVALID_INDEX )
+    , camera_buffer( 0 )
+    , camera_stride( 0 )
+    , msaa_samples( 4 )
+    , dump_scene_commands( false )
+    , depth_prepass( false )
+    , mesh_format( MESH_VERTEX_QUANTIZED )
+    , instance_grid( 0 )
+    , skinned_characters( 0 )
+    , emitter_controllers{-1, -1}
+    , particle_motes( 0 )
+    , node_object( Scene::NONE )
+    , node_hmd( Scene::NONE )
+    , node_controllers{Scene::NONE, Scene::NONE}
+    , node_pointer_hits{Scene::NONE, Scene::NONE}
+    , frame_count( 0 )
     , draw_func( nullptr )
     , update_func( nullptr )
     , use_vr( true )
-    , vr_display( VR_NOT_SET ) {
+    , vr_display( VR_NOT_SET )
+    , late_latch( true ) {
 }
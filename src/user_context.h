@@ -3,6 +3,30 @@
 
 #include <EGL/egl.h>
 #include <GLES3/gl3.h>
+#include <vector>
+
+#include "bvh.h"
+#include "clusters.h"
+#include "frame.h"
+#include "frame_budget.h"
+#include "framebuffer_pool.h"
+#include "gl_command_buffer.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "hud.h"
+#include "instancing.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "particles.h"
+#include "pointcloud.h"
+#include "raycast.h"
+#include "reprojection.h"
+#include "residency.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "simulation.h"
+#include "skinning.h"
+#include "texture.h"
 
 extern const int VR_NOT_SET;
 
@@ -17,9 +41,108 @@ public:
 
     GLuint program;
     GLint  vec4_position;
+    GLint  vec4_normal;
+    GLint  vec2_uv;
     GLint  mat4_model;
-    GLint  mat4_view;
-    GLint  mat4_projection;
+    GLint  bool_octahedral;
+    GLint  vec4_instance_rows[3];
+    GLint  vec4_instance_color;
+    GLint  bool_instanced;
+    // Skinned meshes' attributes, only the skinned programs have them.
+    GLint  vec4_bone_indices;
+    GLint  vec4_bone_weights;
+    GLint  float_instance_palette;
+
+    // The scene program built with SKINNED, for meshes posed by the bone palettes.
+    GLuint skinned_program;
+    GLint  skinned_bool_instanced;
+    GLint  skinned_bool_octahedral;
+
+    // Writes depth only, for the depth pre-pass. Shares the vertex shader and its attribute locations.
+    GLuint depth_program;
+    GLint  depth_bool_instanced;
+    GLuint depth_skinned_program;
+    GLint  depth_skinned_bool_instanced;
+
+    GLuint vertex_buffer; // Streams the vertices drawn without VR, meshes have their own buffers.
+
+    GLuint camera_block;
+    GLuint camera_buffer;
+    GLint  camera_stride;
+
+    GLState         gl_state;
+    FramebufferPool framebuffer_pool;
+    GLsizei         msaa_samples;
+
+    // The scene recorded once per frame and replayed for each eye.
+    GLCommandBuffer scene_commands;
+    bool            dump_scene_commands; // Print the next recording.
+    // Draw the opaque scene into depth first and shade it with GL_EQUAL, so each pixel is shaded once.
+    bool            depth_prepass;
+
+    // GPU time of replaying the scene for both eyes.
+    GpuTimer    gpu_timer;
+    SampleStats scene_gpu_ms[2]; // Indexed by depth_prepass.
+
+    Simulation simulation;
+
+    std::vector<Mesh> meshes;
+    MeshVertexFormat  mesh_format; // Layout meshes are uploaded in.
+    LodSelector       lod;
+
+    // Every mesh in the VR view is drawn instanced, with the instances streamed through one buffer.
+    InstanceRing    instance_ring;
+    InstanceBatcher instance_batcher;
+    int             instance_grid; // Extra nodes sharing one small mesh, to stress instancing.
+
+    // Skeletons of the skinned meshes, and the palettes of every skinned node.
+    std::vector<Skeleton> skeletons;
+    SkinningPalette       skinning;
+    int                   skinned_characters; // Animated figures in front of the viewer, to stress skinning.
+
+    // Sparks thrown from the controllers while a button is held, and motes drifting through the scene.
+    ParticleSystem particles;
+    int            emitter_controllers[2];
+    int            particle_motes; // Motes alive at once, to stress the particles.
+
+    // Scans streamed in by octree node, see src_tool/pointcloud_convert.cpp.
+    PointCloud point_cloud;
+
+    Scene scene;
+    int   node_object;
+    int   node_hmd;
+    int   node_controllers[2];
+    int   node_pointer_hits[2]; // Where each controller points at the scene, hidden when it points at nothing.
+
+    // Drawn instead of the built-in object and sphere once it has arrived, see src/scene_format.h.
+    SceneFile scene_file;
+
+    // Picks what the controllers point at, down to the triangle.
+    RayCaster ray_caster;
+
+    LightClusters light_clusters;
+
+    Bvh       bvh;
+    BvhCuller culler;
+
+    OcclusionCuller occlusion;
+
+    FrameTimer   frame_timer;
+    FrameBudget  frame_budget;
+    Reprojection reprojection;
+    unsigned int frame_count;
+
+    // Skips frames of the normal loop that would look the same as the last one. Not used in VR.
+    RedrawTracker redraw;
+
+    // The albedo textures sampled by the scene shader.
+    TextureCache textures;
+
+    // Frame stats drawn in front of the viewer, for when the console can't be seen.
+    Hud hud;
+
+    // Keeps GPU memory under a budget by evicting meshes and textures not drawn lately, and knows when the context is lost.
+    GpuResidency residency;
 
     void ( *draw_func )( UserContext& );
     void ( *update_func )( UserContext& );
@@ -28,6 +151,10 @@ public:
 
     int vr_display;
 
+    // Fetch a fresh HMD pose right before the eyes are drawn instead of using the one from the frame's start.
+    bool        late_latch;
+    SampleStats pose_to_submit_ms[2]; // Indexed by late_latch.
+
     UserContext();
 };
 
@@ -40,6 +40,15 @@ void gl_matrix4x4_mac(
     const GLfloat* b,
     const GLfloat* c );
 
+// Column-major (GL convention) out = a * b. out may alias either input.
+void gl_matrix4x4_multiply(
+    GLfloat*       out,
+    const GLfloat* a,
+    const GLfloat* b );
+
+// Column-major inverse. Returns false, leaving out untouched, for singular matrices.
+bool gl_matrix4x4_invert( GLfloat* out, const GLfloat* m );
+
 int pose_dof( const VR::Pose* pose );
 
 void print_flatbuffers_float_matrix4xN( const flatbuffers::Vector<float>* matrix, int space_depth = 0 );
@@ -2,12 +2,29 @@
 
 #include "vr.h"
 
+#include <algorithm>
 #include <functional>
 #include <math.h>
+#include <string.h>
 #include <sys/time.h>
 #include <vector>
 
+#include "bvh.h"
+#include "camera.h"
 #include "finally.h"
+#include "frame.h"
+#include "frustum.h"
+#include "gl_command_buffer.h"
+#include "gles.h"
+#include "instancing.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "raycast.h"
+#include "reprojection.h"
+#include "scene.h"
+#include "simd.h"
+#include "simulation.h"
+#include "trace.h"
 #include "user_context.h"
 #include "util.h"
 
@@ -18,6 +35,7 @@ namespace {
 
 // clang-format off
 EM_JS( int, get_vr_state, ( uint8_t** vr_state, int vr_display_handle ), { return impl_get_vr_state( vr_state, vr_display_handle ); } );
+EM_JS( double, get_vr_hmd_matrices, ( GLfloat* matrices, int vr_display_handle ), { return impl_get_vr_hmd_matrices( matrices, vr_display_handle ); } );
 // clang-format on
 
 void print_vr_state( const VRState& state ) {
@@ -181,9 +199,19 @@ void vr_gles_update( UserContext& user_context ) {
     user_context.width  = left_param.renderWidth + right_param.renderWidth;
     user_context.height = std::max( left_param.renderHeight, right_param.renderHeight );
     set_canvas_size( user_context.width, user_context.height );
+
+    user_context.simulation.advance( emscripten_get_now() );
+
+    // Meshes' picking trees are built a slice per frame, small enough to hide in the frame's slack.
+    const double PICKING_BUILD_MS = 2.0;
+    user_context.ray_caster.update( user_context.meshes, PICKING_BUILD_MS );
+    // Likewise textures are prepared a slice per frame.
+    const double TEXTURE_PREPARE_MS = 2.0;
+    user_context.textures.update( user_context, TEXTURE_PREPARE_MS );
 }
 
 bool vr_state_get( VRState& vr_state, UserContext& user_context ) {
+    TraceScope trace( "vr_state_get" );
     if( !VRState::slab(
             &vr_state,
             [&]( uint8_t** ptr_slab ) -> int {
@@ -198,7 +226,172 @@ bool vr_state_get( VRState& vr_state, UserContext& user_context ) {
     return true;
 }
 
+double vr_hmd_matrices_get( UserContext& user_context, CameraMatrices* cameras ) {
+    // Two cameras of a view and a projection matrix each, in the order the JS side writes them.
+    GLfloat      matrices[2 * 2 * 4 * 4];
+    const double pose_ms = get_vr_hmd_matrices( matrices, user_context.vr_display );
+    if( pose_ms >= 0.0 ) {
+        for( int eye = 0; eye < 2; ++eye ) {
+            memcpy( cameras[eye].view, matrices + 32 * eye, sizeof( cameras[eye].view ) );
+            memcpy( cameras[eye].projection, matrices + 32 * eye + 16, sizeof( cameras[eye].projection ) );
+        }
+    }
+    return pose_ms;
+}
+
+void vr_cameras_from_state( const VR::HMD& hmd, CameraMatrices* cameras ) {
+    // Without clustered lights until they are binned for these cameras.
+    camera_identity( cameras[0] );
+    camera_identity( cameras[1] );
+    flatbuffers_vector_to_native( hmd.leftViewMatrix(), cameras[0].view );
+    flatbuffers_vector_to_native( hmd.leftProjectionMatrix(), cameras[0].projection );
+    flatbuffers_vector_to_native( hmd.rightViewMatrix(), cameras[1].view );
+    flatbuffers_vector_to_native( hmd.rightProjectionMatrix(), cameras[1].projection );
+}
+
+void vr_cameras_get( UserContext& user_context, const VR::HMD& hmd, CameraMatrices* cameras, double& pose_ms ) {
+    vr_cameras_from_state( hmd, cameras );
+
+    if( user_context.late_latch ) {
+        double latched_ms = vr_hmd_matrices_get( user_context, cameras );
+        if( latched_ms >= 0.0 ) {
+            pose_ms = latched_ms;
+        }
+    }
+}
+
+bool vr_pose_model_matrix( const VR::Pose& pose, bool offset_without_position, GLfloat* matrix ) {
+    bool six_dof = false;
+
+    const auto* ptr_position     = pose.position();
+    double      draw_position[3] = {0.0, 0.0, 0.0};
+    if( ptr_position && ( ptr_position->Length() == 3 ) ) {
+        flatbuffers_vector_to_native( ptr_position, draw_position );
+        six_dof = true;
+    }
+
+    const auto* ptr_orientation     = pose.orientation();
+    double      draw_orientation[4] = {0.0, 0.0, 0.0, 1.0}; // This API uses the wrong quaternion ordering.
+    if( ptr_orientation && ( ptr_orientation->Length() == 4 ) ) {
+        flatbuffers_vector_to_native( ptr_orientation, draw_orientation );
+    }
+
+    quaternion_to_gl_matrix4x4(
+        draw_orientation[3], // This API uses the wrong quaternion ordering.
+        draw_orientation[0],
+        draw_orientation[1],
+        draw_orientation[2],
+        draw_position[0],
+        draw_position[1],
+        draw_position[2],
+        matrix );
+
+    // Add an offset to non-6DoF devices.
+    if( !six_dof && offset_without_position ) {
+        GLfloat offset[4 * 4] = {
+            0.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f,
+            0.0f, 0.0f, 0.0f, 0.0f,
+        };
+        gl_matrix4x4_mac(
+            matrix,
+            identity4,
+            matrix,
+            offset );
+    }
+    return six_dof;
+}
+
+void vr_scene_bind( UserContext& user_context, const VR::State& state ) {
+    Scene&  scene = user_context.scene;
+    GLfloat matrix[4 * 4];
+
+    if( state.hmd() && state.hmd()->pose() ) {
+        vr_pose_model_matrix( *state.hmd()->pose(), false, matrix );
+        scene.set_local_matrix( user_context.node_hmd, matrix );
+    }
+
+    // Pull in left and right controller matrices.
+    bool seen[2] = {false, false};
+    if( state.gamepads() ) {
+        for( const auto* ptr_gamepad : *( state.gamepads() ) ) {
+            if( !ptr_gamepad || !ptr_gamepad->pose() ) {
+                continue;
+            }
+            int index = ptr_gamepad->index();
+            if( !( ( 0 <= index ) && ( index < 2 ) ) ) {
+                continue;
+            }
+
+            vr_pose_model_matrix( *ptr_gamepad->pose(), true, matrix );
+            scene.set_local_matrix( user_context.node_controllers[index], matrix );
+            seen[index] = true;
+
+            // Sparks fly from the controller as hard as its most pressed button, carried along with its motion.
+            GLfloat intensity = 0.0f;
+            if( ptr_gamepad->buttons() ) {
+                for( const auto* ptr_button : *( ptr_gamepad->buttons() ) ) {
+                    if( ptr_button ) {
+                        intensity = std::max( intensity, static_cast<GLfloat>( ptr_button->pressed() ? 1.0 : ptr_button->value() ) );
+                    }
+                }
+            }
+            GLfloat     velocity[3]  = {0.0f, 0.0f, 0.0f};
+            const auto* ptr_velocity = ptr_gamepad->pose()->linearVelocity();
+            if( ptr_velocity && ( ptr_velocity->Length() == 3 ) ) {
+                flatbuffers_vector_to_native( ptr_velocity, velocity );
+            }
+            user_context.particles.set_emitter( user_context.emitter_controllers[index], matrix, velocity, intensity );
+        }
+    }
+    for( int i = 0; i < 2; ++i ) {
+        scene.set_visible( user_context.node_controllers[i], seen[i] );
+        if( !seen[i] ) {
+            user_context.particles.set_emitter( user_context.emitter_controllers[i], identity4, nullptr, 0.0f );
+        }
+    }
+}
+
+void vr_scene_pick( UserContext& user_context ) {
+    // Farthest a controller picks at, in metres.
+    const GLfloat POINTER_RANGE = 10.0f;
+
+    Scene& scene = user_context.scene;
+    Ray    rays[2];
+    RayHit hits[2];
+    int    controllers[2]; // Of each ray.
+    size_t count = 0;
+    for( int i = 0; i < 2; ++i ) {
+        scene.set_visible( user_context.node_pointer_hits[i], false );
+        if( scene.visible( user_context.node_controllers[i] ) ) {
+            ray_from_matrix( scene.world_matrix( user_context.node_controllers[i] ), POINTER_RANGE, rays[count] );
+            controllers[count++] = i;
+        }
+    }
+    if( !count ) {
+        return;
+    }
+    user_context.ray_caster.cast( user_context.bvh, scene, rays, count, hits );
+    for( size_t i = 0; i < count; ++i ) {
+        if( hits[i].node == Scene::NONE ) {
+            continue;
+        }
+        const Ray& ray  = rays[i];
+        const int  node = user_context.node_pointer_hits[controllers[i]];
+        scene.set_translation( node,
+                               ray.origin[0] + ray.direction[0] * hits[i].distance,
+                               ray.origin[1] + ray.direction[1] * hits[i].distance,
+                               ray.origin[2] + ray.direction[2] * hits[i].distance );
+        scene.set_visible( node, true );
+    }
+}
+
 void vr_gles_draw( UserContext& user_context ) {
+    if( user_context.residency.lost() ) {
+        return;
+    }
+
     VRState vr_state;
     if( !vr_state_get( vr_state, user_context ) ) {
         STDERR( "Failed to get VR state." );
@@ -224,238 +417,249 @@ void vr_gles_draw( UserContext& user_context ) {
     }
     const VR::HMD& hmd = *ptr_hmd;
 
-    {
-        // Get a list of buffers to bind shader attributes to.
-        const GLsizei vertex_shader_buffer_count = 1;
-        GLuint        vertex_shader_buffers[vertex_shader_buffer_count];
-        glGenBuffers( vertex_shader_buffer_count, vertex_shader_buffers );
-        const GLuint vbuf_position = vertex_shader_buffers[0];
-
-        // Set the viewport.
-        glViewport( 0, 0, user_context.width, user_context.height );
-
-        // Clear the color output buffer.
-        glClear( GL_COLOR_BUFFER_BIT );
-
-        // Use this shader program.
-        glUseProgram( user_context.program );
-
-        // Set model orientation.
-        const double time_s = state.timestamp() / 1000.0;
-        const double q      = PI * time_s / 2.0;
-#define F( x ) static_cast<float>( x )
-        // clang-format off
-        GLfloat model_matrix_object[4 * 4] = {
-            F( cos( q ) ), 0.0f, F( -sin( q ) ), F( 1.25 + sin( q ) ),
-                     0.0f, 1.0f,           0.0f,                 0.0f,
-            F( sin( q ) ), 0.0f, F(  cos( q ) ),                 0.0f,
-                     0.0f, 0.0f,           0.0f,                 1.0f};
-// clang-format on
-#undef F
-        bool    model_lcon_ok = false;
-        bool    model_rcon_ok = false;
-        GLfloat model_matrix_lcon[4 * 4];
-        GLfloat model_matrix_rcon[4 * 4];
-
-        // Pull in left and right controller matrices.
-        if( state.gamepads() ) {
-            for( const auto* ptr_gamepad : *( state.gamepads() ) ) {
-                if( ptr_gamepad ) {
-                    int index = ptr_gamepad->index();
-                    if( !( ( 0 <= index ) && ( index < 2 ) ) ) {
-                        continue;
-                    }
-
-                    const VR::Pose* ptr_pose = ptr_gamepad->pose();
-                    if( ptr_pose ) {
-                        bool six_dof = false;
-
-                        const auto* ptr_position     = ptr_pose->position();
-                        double      draw_position[3] = {0.0, 0.0, 0.0};
-                        if( ptr_position && ( ptr_position->Length() == 3 ) ) {
-                            flatbuffers_vector_to_native( ptr_position, draw_position );
-                            six_dof = true;
-                        }
-
-                        const auto* ptr_orientation     = ptr_pose->orientation();
-                        double      draw_orientation[4] = {0.0, 0.0, 0.0, 1.0}; // This API uses the wrong quaternion ordering.
-                        if( ptr_orientation && ( ptr_orientation->Length() == 4 ) ) {
-                            flatbuffers_vector_to_native( ptr_orientation, draw_orientation );
-                        }
+    double pose_ms = state.timestamp();
 
-                        GLfloat* matrix = nullptr;
-                        switch( index ) {
-                        case 0:
-                            matrix        = model_matrix_lcon;
-                            model_lcon_ok = true;
-                            break;
-                        case 1:
-                            matrix        = model_matrix_rcon;
-                            model_rcon_ok = true;
-                            break;
-                        }
-                        if( matrix ) {
-                            quaternion_to_gl_matrix4x4(
-                                draw_orientation[3], // This API uses the wrong quaternion ordering.
-                                draw_orientation[0],
-                                draw_orientation[1],
-                                draw_orientation[2],
-                                draw_position[0],
-                                draw_position[1],
-                                draw_position[2],
-                                matrix );
-
-                            // Add an offset to non-6DoF controllers.
-                            if( !six_dof ) {
-                                GLfloat offset[4 * 4] = {
-                                    0.0f, 0.0f, 0.0f, 0.0f,
-                                    0.0f, 0.0f, 0.0f, 0.0f,
-                                    0.0f, 0.0f, 0.0f, 1.0f,
-                                    0.0f, 0.0f, 0.0f, 0.0f,
-                                };
-                                gl_matrix4x4_mac(
-                                    matrix,
-                                    identity4,
-                                    matrix,
-                                    offset );
-                            }
-                        }
-                    }
-                }
+    if( reprojection_should_reproject( user_context ) ) {
+        // Rendering would miss the deadline, so warp the last frame to the newest pose instead.
+        TraceScope     trace( "reproject" );
+        CameraMatrices cameras[2];
+        vr_cameras_get( user_context, hmd, cameras, pose_ms );
+        reprojection_draw( user_context, cameras );
+    } else {
+        // Set model orientation from the simulation, interpolated between its last two steps,
+        // and attach the tracked devices to their scene nodes.
+        GLfloat model_matrix_object[4 * 4];
+        trace_begin( "scene_update" );
+        simulation_object_model_matrix( user_context.simulation.interpolated(), model_matrix_object );
+        user_context.scene.set_local_matrix( user_context.node_object, model_matrix_object );
+        vr_scene_bind( user_context, state );
+        Scene& scene = user_context.scene;
+        scene.update();
+        trace_end( "scene_update" );
+        // Picking goes through the scene's BVH, and only moves the markers, so it's refit again for them below.
+        trace_begin( "pick" );
+        user_context.bvh.refit( scene );
+        vr_scene_pick( user_context );
+        scene.update();
+        trace_end( "pick" );
+
+        // Cull with the pose from the start of the frame. The late latched pose is at most a few
+        // milliseconds newer, and objects only culled for one eye are still drawn for the other.
+        trace_begin( "cull" );
+        CameraMatrices cull_cameras[2];
+        vr_cameras_from_state( hmd, cull_cameras );
+        Frustum eyes[2];
+        Frustum combined;
+        for( int eye = 0; eye < 2; ++eye ) {
+            frustum_from_view_projection( cull_cameras[eye].view, cull_cameras[eye].projection, eyes[eye] );
+        }
+        if( !frustum_combine( cull_cameras[0].view, cull_cameras[0].projection, cull_cameras[1].view, cull_cameras[1].projection, combined ) ) {
+            STDERR( "Failed to combine the eye frusta, only culling per eye." );
+        }
+        user_context.bvh.refit( scene );
+        user_context.culler.cull( user_context.bvh, scene, combined, eyes );
+
+        user_context.occlusion.cull( scene, cull_cameras, user_context.culler.result() );
+        trace_end( "cull" );
+
+        // Pose every skinned instance in one pass, for all their draws to read from the same palette texture.
+        trace_begin( "animate" );
+        user_context.skinning.update( user_context.skeletons, user_context.meshes, emscripten_get_now() / 1000.0 );
+        user_context.skinning.upload( user_context );
+        user_context.particles.update( emscripten_get_now() );
+        user_context.particles.upload( user_context );
+        trace_end( "animate" );
+
+        // Record the scene once, before the camera is known, so it can be replayed for each eye.
+        trace_begin( "record" );
+        GLCommandBuffer& commands = user_context.scene_commands;
+        commands.reset();
+        gles_record_clear( commands );
+        commands.bind_camera();
+
+        // Levels of detail are picked from the distance to a point between the eyes, and the error in pixels
+        // from the vertical projection scale, which both eyes share.
+        GLfloat eye_positions[2][3];
+        GLfloat center[3];
+        for( int eye = 0; eye < 2; ++eye ) {
+            camera_position( cull_cameras[eye], eye_positions[eye] );
+        }
+        for( int i = 0; i < 3; ++i ) {
+            center[i] = 0.5f * ( eye_positions[0][i] + eye_positions[1][i] );
+        }
+        const GLfloat pixels_per_unit = 0.5f * cull_cameras[0].projection[5] * user_context.height;
+        const GLfloat NEAR_DISTANCE   = 0.05f;
+
+        // Only what survived culling, limited to the eyes that can see it, grouped into one batch
+        // per mesh level and set of eyes, and sorted front to back so the depth test rejects as much as it can.
+        const CullResult& visible = user_context.occlusion.result();
+        LodSelector&      lod     = user_context.lod;
+        InstanceBatcher&  batcher = user_context.instance_batcher;
+        lod.begin_frame();
+        batcher.clear();
+        for( size_t i = 0; i < visible.nodes.size(); ++i ) {
+            const int node       = visible.nodes[i];
+            const int mesh_index = scene.mesh( node );
+            if( mesh_index == Scene::NONE ) {
+                continue;
+            }
+            const Mesh& mesh = user_context.meshes[mesh_index];
+            // Evicted meshes are uploaded again here, or wait for a later frame if enough already were.
+            if( !user_context.residency.use( mesh.residency ) ) {
+                continue;
             }
+            const GLfloat away = lod_distance( scene, node, center, NEAR_DISTANCE );
+            batcher.add( mesh_index, lod.select( scene, node, mesh, away, pixels_per_unit ), visible.eyes[i], node, away );
         }
-
-        // Define how to draw the scene so it can be later drawn for each eye.
-        auto draw_scene = [&]() {
-            const int DIMENSION = 3;
-
-            const int VERTICES_OBJECT                              = 3;
-            GLfloat   vertices_object[DIMENSION * VERTICES_OBJECT] = {
-                0.0f, 0.5f, 0.0f,
-                -0.5f, -0.5f, 0.0f,
-                0.5f, -0.5f, 0.0f};
-            // Load vertices into vertex shader buffer for vertices.
-            glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-            glBufferData( GL_ARRAY_BUFFER, sizeof( vertices_object ), vertices_object, GL_STATIC_DRAW );
-            // Point the shader attribute for position at the shader buffer for position.
-            glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-            glVertexAttribPointer(
-                user_context.vec4_position, // GLuint index
-                DIMENSION,                  // GLint size (in number of vertex dimensions)
-                GL_FLOAT,                   // GLenum type
-                0,                          // GLboolean normalized (i.e. is-fixed-point)
-                0,                          // GLsizei stride (i.e. byte offset between consecutive elements)
-                0 );                        // const GLvoid * pointer (because GL_ARRAY_BUFFER is bound this is an offset into that bound buffer)
-            glEnableVertexAttribArray( user_context.vec4_position );
-            glUniformMatrix4fv(
-                user_context.mat4_model, // GLint location
-                1,                       // GLsizei count
-                GL_TRUE,                 // GLboolean transpose
-                model_matrix_object );   // const GLfloat* value
-            glDrawArrays( GL_TRIANGLES, 0, 3 );
-
-            if( model_lcon_ok ) {
-                const int VERTICES                       = 3;
-                GLfloat   vertices[DIMENSION * VERTICES] = {
-                    0.0f, 0.05f, 0.0f,
-                    -0.05f, -0.05f, 0.0f,
-                    0.05f, -0.05f, 0.0f};
-                // Load vertices into vertex shader buffer for vertices.
-                glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-                glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_STATIC_DRAW );
-                // Point the shader attribute for position at the shader buffer for position.
-                glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-                glVertexAttribPointer(
-                    user_context.vec4_position, // GLuint index
-                    DIMENSION,                  // GLint size (in number of vertex dimensions)
-                    GL_FLOAT,                   // GLenum type
-                    0,                          // GLboolean normalized (i.e. is-fixed-point)
-                    0,                          // GLsizei stride (i.e. byte offset between consecutive elements)
-                    0 );                        // const GLvoid * pointer (because GL_ARRAY_BUFFER is bound this is an offset into that bound buffer)
-                glEnableVertexAttribArray( user_context.vec4_position );
-                glUniformMatrix4fv(
-                    user_context.mat4_model, // GLint location
-                    1,                       // GLsizei count
-                    GL_TRUE,                 // GLboolean transpose
-                    model_matrix_lcon );     // const GLfloat* value
-                glDrawArrays( GL_TRIANGLES, 0, 3 );
+        lod.end_frame();
+        batcher.build();
+        // Point cloud nodes are picked by the same projection scale, and culled per eye on their own.
+        user_context.point_cloud.update( user_context, cull_cameras, eyes, pixels_per_unit );
+
+        // Instances go straight into the ring buffer, the recording only refers to them,
+        // so they are uploaded once instead of once per eye.
+        const std::vector<int32_t>& nodes     = batcher.nodes();
+        InstanceRing&               ring      = user_context.instance_ring;
+        InstanceData*               instances = ring.begin( user_context, nodes.size() );
+        for( const InstanceBatch& batch : batcher.batches() ) {
+            const Mesh& mesh = user_context.meshes[batch.mesh];
+            for( uint32_t i = batch.first; i < batch.first + batch.count; ++i ) {
+                InstanceData& instance = instances[i];
+                // Skinned meshes are dequantized by their palettes.
+                if( ( mesh.format == MESH_VERTEX_FLOAT ) || mesh.skinned() ) {
+                    memcpy( instance.model_rows, scene.world_matrix( nodes[i] ), sizeof( instance.model_rows ) );
+                } else {
+                    GLfloat model[4 * 4];
+                    float4x4_multiply( model, scene.world_matrix( nodes[i] ), mesh.dequantize );
+                    memcpy( instance.model_rows, model, sizeof( instance.model_rows ) );
+                }
+                memcpy( instance.color, scene.color( nodes[i] ), sizeof( instance.color ) );
+                instance.palette = static_cast<GLfloat>( scene.skin( nodes[i] ) );
             }
-
-            if( model_rcon_ok ) {
-                const int VERTICES                       = 3;
-                GLfloat   vertices[DIMENSION * VERTICES] = {
-                    0.0f, 0.05f, 0.0f,
-                    -0.05f, -0.05f, 0.0f,
-                    0.05f, -0.05f, 0.0f};
-                // Load vertices into vertex shader buffer for vertices.
-                glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-                glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_STATIC_DRAW );
-                // Point the shader attribute for position at the shader buffer for position.
-                glBindBuffer( GL_ARRAY_BUFFER, vbuf_position );
-                glVertexAttribPointer(
-                    user_context.vec4_position, // GLuint index
-                    DIMENSION,                  // GLint size (in number of vertex dimensions)
-                    GL_FLOAT,                   // GLenum type
-                    0,                          // GLboolean normalized (i.e. is-fixed-point)
-                    0,                          // GLsizei stride (i.e. byte offset between consecutive elements)
-                    0 );                        // const GLvoid * pointer (because GL_ARRAY_BUFFER is bound this is an offset into that bound buffer)
-                glEnableVertexAttribArray( user_context.vec4_position );
-                glUniformMatrix4fv(
-                    user_context.mat4_model, // GLint location
-                    1,                       // GLsizei count
-                    GL_TRUE,                 // GLboolean transpose
-                    model_matrix_rcon );     // const GLfloat* value
-                glDrawArrays( GL_TRIANGLES, 0, 3 );
+        }
+        ring.end( user_context );
+
+        // Skinned meshes need the skinned variant of the pass's program, switched to as batches come.
+        uint8_t mask           = 3;
+        auto    record_batches = [&]( bool shaded ) {
+            int skinned = -1;
+            for( const InstanceBatch& batch : batcher.batches() ) {
+                const Mesh&    mesh  = user_context.meshes[batch.mesh];
+                const MeshLod& level = mesh.lods[batch.lod];
+                if( batch.eyes != mask ) {
+                    mask = batch.eyes;
+                    commands.camera_mask( mask );
+                }
+                if( static_cast<int>( mesh.skinned() ) != skinned ) {
+                    skinned = mesh.skinned();
+                    if( shaded ) {
+                        commands.use_program( skinned ? user_context.skinned_program : user_context.program );
+                        commands.uniform_1i( skinned ? user_context.skinned_bool_instanced : user_context.bool_instanced, 1 );
+                    } else {
+                        commands.use_program( skinned ? user_context.depth_skinned_program : user_context.depth_program );
+                        commands.uniform_1i( skinned ? user_context.depth_skinned_bool_instanced : user_context.depth_bool_instanced, 1 );
+                    }
+                }
+                // The vertex array holds the mesh's attribute setup and index buffer.
+                commands.bind_vertex_array( mesh.vertex_array );
+                instance_record_attributes( user_context, commands, ring.offset() + batch.first * sizeof( InstanceData ), mesh.skinned() );
+                if( shaded ) {
+                    commands.uniform_1i( skinned ? user_context.skinned_bool_octahedral : user_context.bool_octahedral, mesh.format != MESH_VERTEX_FLOAT );
+                }
+                commands.draw_elements_instanced( GL_TRIANGLES, level.index_count, mesh.index_type, mesh.index_offset( batch.lod ), batch.count );
             }
         };
+        if( user_context.depth_prepass ) {
+            // Lay down the depth of everything first, so the shading pass only runs the
+            // fragment shader for the surface that ends up visible.
+            commands.color_mask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+            record_batches( false );
+            commands.color_mask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+            commands.depth_mask( GL_FALSE );
+            commands.depth_func( GL_EQUAL );
+        }
+        record_batches( true );
+        if( user_context.depth_prepass ) {
+            commands.depth_mask( GL_TRUE );
+            commands.depth_func( GL_LESS );
+        }
+        if( mask != 3 ) {
+            commands.camera_mask( 3 );
+        }
+        // Opaque like the meshes, and after them so the depth test rejects the points they hide.
+        user_context.point_cloud.record( commands );
+        // Particles are culled by the depth test alone, so both eyes draw them all.
+        user_context.particles.record( commands );
+        // Held in front of the head as posed at the start of the frame, over everything else.
+        if( user_context.hud.enabled() ) {
+            GLfloat model[4 * 4];
+            user_context.hud.upload( user_context );
+            user_context.hud.head_matrix( scene.world_matrix( user_context.node_hmd ), model );
+            user_context.hud.record( commands, model );
+        }
+        commands.bind_vertex_array( 0 );
+        trace_end( "record" );
+
+        if( user_context.dump_scene_commands ) {
+            user_context.dump_scene_commands = false;
+            print_gl_command_buffer( commands );
+        }
 
         // Draw
 
         auto width_l = user_context.width / 2;
         auto width_r = user_context.width - width_l;
 
-        GLfloat leftViewMatrix[16];
-        GLfloat leftProjectionMatrix[16];
-        GLfloat rightViewMatrix[16];
-        GLfloat rightProjectionMatrix[16];
-        flatbuffers_vector_to_native( hmd.leftViewMatrix(), leftViewMatrix );
-        flatbuffers_vector_to_native( hmd.leftProjectionMatrix(), leftProjectionMatrix );
-        flatbuffers_vector_to_native( hmd.rightViewMatrix(), rightViewMatrix );
-        flatbuffers_vector_to_native( hmd.rightProjectionMatrix(), rightProjectionMatrix );
-
-        // Draw left viewport.
-        glUniformMatrix4fv(
-            user_context.mat4_view, // GLint location
-            1,                      // GLsizei count
-            GL_FALSE,               // GLboolean transpose
-            leftViewMatrix );       // const GLfloat* value
-        glUniformMatrix4fv(
-            user_context.mat4_projection, // GLint location
-            1,                            // GLsizei count
-            GL_FALSE,                     // GLboolean transpose
-            leftProjectionMatrix );       // const GLfloat* value
-        glViewport( 0, 0, width_l, user_context.height );
-        draw_scene();
+        // Everything up to here only needed the state from the start of the frame,
+        // so the camera can take the freshest HMD pose available right before the recording is replayed.
+        trace_begin( "latch" );
+        CameraMatrices cameras[2];
+        vr_cameras_get( user_context, hmd, cameras, pose_ms );
+        // The clusters are in the view space of the cameras drawn with, so lights are binned after the latch.
+        user_context.light_clusters.bin( cameras, 2 );
+        user_context.light_clusters.upload( user_context );
+        camera_buffer_upload( user_context, cameras, 2 );
+        trace_end( "latch" );
+
+        trace_begin( "gl_submit" );
+        GLState& gl = user_context.gl_state;
+        gl.enable( GL_SCISSOR_TEST );
+        user_context.textures.bind( user_context );
+        user_context.gpu_timer.poll( user_context.scene_gpu_ms );
+        RenderTarget* target = gles_begin_offscreen( user_context );
+        user_context.gpu_timer.begin( user_context.depth_prepass ? 1 : 0 );
+
+        // Draw left viewport. The scissor keeps the recording's clear to this eye's half.
+        gl.viewport( 0, 0, width_l, user_context.height );
+        gl.scissor( 0, 0, width_l, user_context.height );
+        gl_command_buffer_replay( user_context, commands, 0 );
 
         // Draw right viewport.
-        glUniformMatrix4fv(
-            user_context.mat4_view, // GLint location
-            1,                      // GLsizei count
-            GL_FALSE,               // GLboolean transpose
-            rightViewMatrix );      // const GLfloat* value
-        glUniformMatrix4fv(
-            user_context.mat4_projection, // GLint location
-            1,                            // GLsizei count
-            GL_FALSE,                     // GLboolean transpose
-            rightProjectionMatrix );      // const GLfloat* value
-        glViewport( width_l, 0, width_r, user_context.height );
-        draw_scene();
+        gl.viewport( width_l, 0, width_r, user_context.height );
+        gl.scissor( width_l, 0, width_r, user_context.height );
+        gl_command_buffer_replay( user_context, commands, 1 );
+
+        user_context.gpu_timer.end();
+        // Blits are scissored too, and the resolve has to cover both eyes.
+        gl.disable( GL_SCISSOR_TEST );
+
+        if( user_context.reprojection.enabled ) {
+            reprojection_capture( user_context, target, cameras );
+        } else {
+            gles_end_offscreen( user_context, target );
+        }
+        trace_end( "gl_submit" );
     }
 
-    if( !emscripten_vr_submit_frame( user_context.vr_display ) ) {
+    const double submit_ms = emscripten_get_now();
+    trace_begin( "submit_frame" );
+    const bool submitted = emscripten_vr_submit_frame( user_context.vr_display );
+    trace_end( "submit_frame" );
+    if( !submitted ) {
         STDERR( "Failed to submit frame to VR display." );
         return;
     }
+    user_context.pose_to_submit_ms[user_context.late_latch ? 1 : 0].add( submit_ms - pose_ms );
 }
 
 void vr_render_loop( void* arg ) {
@@ -481,12 +685,17 @@ void vr_render_loop( void* arg ) {
             setup = true;
         }
     } else {
+        TraceScope trace( "vr_render_loop" );
+        frame_begin( user_context );
         if( user_context.update_func != nullptr ) {
+            TraceScope trace_update( "update" );
             user_context.update_func( user_context );
         }
         if( user_context.draw_func != nullptr ) {
+            TraceScope trace_draw( "draw" );
             user_context.draw_func( user_context );
         }
+        frame_end( user_context );
     }
 
     cleanup.Clear();
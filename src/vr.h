@@ -1,6 +1,7 @@
 #ifndef WASMVR_VR_H
 #define WASMVR_VR_H
 
+#include <GLES3/gl3.h>
 #include <emscripten.h>
 #include <emscripten/html5.h>
 #include <emscripten/vr.h>
@@ -9,9 +10,11 @@
 #include "vr_state_generated.h"
 
 class UserContext;
+struct CameraMatrices;
 
 extern "C" {
-int get_vr_state( uint8_t** vr_state, int vr_display_handle );
+int    get_vr_state( uint8_t** vr_state, int vr_display_handle );
+double get_vr_hmd_matrices( GLfloat* matrices, int vr_display_handle );
 }
 
 typedef FlatbufferContainer<VR::State> VRState;
@@ -19,6 +22,23 @@ typedef FlatbufferContainer<VR::State> VRState;
 void print_vr_state( const VRState& state );
 
 bool vr_state_get( VRState& vr_state, UserContext& user_context );
+// Lightweight alternative to vr_state_get that only refreshes the view and projection matrices of both eyes.
+// Returns the time in ms the pose was read at, or a negative value on failure.
+double vr_hmd_matrices_get( UserContext& user_context, CameraMatrices* cameras );
+// Both eyes' cameras as they were at the start of the frame.
+void vr_cameras_from_state( const VR::HMD& hmd, CameraMatrices* cameras );
+// Both eyes' cameras from the frame's state, refreshed with vr_hmd_matrices_get in late latch mode.
+// pose_ms is updated to the time of the pose that was used.
+void vr_cameras_get( UserContext& user_context, const VR::HMD& hmd, CameraMatrices* cameras, double& pose_ms );
+// Model matrix (row major) of a tracked pose. Returns whether the pose had a position;
+// if it did not and offset_without_position is set the matrix is pushed forward to where a hand would be.
+bool vr_pose_model_matrix( const VR::Pose& pose, bool offset_without_position, GLfloat* matrix );
+// Sets the HMD and controller nodes of the scene from the state, hiding controllers without a pose,
+// and points the controllers' particle emitters the same way.
+void vr_scene_bind( UserContext& user_context, const VR::State& state );
+// Casts the visible controllers' rays into the scene, once Scene::update() and Bvh::refit() have placed it,
+// and moves their hit markers to where they point.
+void vr_scene_pick( UserContext& user_context );
 void vr_gles_draw( UserContext& user_context );
 void vr_render_loop( void* arg );
 void vr_present( void* arg );
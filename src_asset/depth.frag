@@ -0,0 +1,7 @@
+#version 300 es
+
+precision mediump float;
+
+// Linked with stl.vert for the depth pre-pass, which only writes depth.
+void main() {
+}
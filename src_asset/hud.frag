@@ -0,0 +1,19 @@
+#version 300 es
+
+precision mediump float;
+
+// Signed distance to the nearest glyph edge, one half on the edge itself.
+uniform sampler2D sampler2D_atlas;
+
+in vec2 vec2_uv;
+in vec4 vec4_color;
+
+out vec4 fragmentColor;
+
+void main() {
+    float distance = texture( sampler2D_atlas, vec2_uv ).r;
+    // Smoothed over about a pixel whatever the glyphs' size on screen, so they stay sharp up close and far away.
+    float width    = max( 0.7 * fwidth( distance ), 1.0 / 255.0 );
+    float coverage = smoothstep( 0.5 - width, 0.5 + width, distance );
+    fragmentColor  = vec4( vec4_color.rgb, vec4_color.a * coverage );
+}
@@ -0,0 +1,23 @@
+#version 300 es
+
+// Locations match Hud's vertices, laid out in glyph cells.
+layout( location = 0 ) in vec2 vec2_position;
+layout( location = 1 ) in vec2 vec2_glyph_uv;
+layout( location = 2 ) in vec4 vec4_glyph_color;
+// Places the panel, in the scene or straight in clip space with the identity camera.
+uniform mat4 mat4_model;
+
+layout( std140 ) uniform Camera {
+    mat4 mat4_view;
+    mat4 mat4_projection;
+    vec4 vec4_clusters;
+};
+
+out vec2 vec2_uv;
+out vec4 vec4_color;
+
+void main() {
+    vec2_uv     = vec2_glyph_uv;
+    vec4_color  = vec4_glyph_color;
+    gl_Position = mat4_projection * mat4_view * mat4_model * vec4( vec2_position, 0.0, 1.0 );
+}
@@ -0,0 +1,15 @@
+#version 300 es
+
+precision mediump float;
+
+in vec2 vec2_corner;
+in vec4 vec4_color;
+
+out vec4 fragmentColor;
+
+void main() {
+    // A soft disc, fading to nothing at the quad's inscribed circle instead of discarding outside it.
+    float falloff = max( 1.0 - dot( vec2_corner, vec2_corner ), 0.0 );
+    // Blended additively, so the colour is premultiplied.
+    fragmentColor = vec4( vec4_color.rgb * ( vec4_color.a * falloff * falloff ), 0.0 );
+}
@@ -0,0 +1,35 @@
+#version 300 es
+
+// Per particle, read straight from the particle system's arrays. Locations match ParticleSystem's.
+layout( location = 0 ) in float float_x;
+layout( location = 1 ) in float float_y;
+layout( location = 2 ) in float float_z;
+layout( location = 3 ) in float float_age;
+layout( location = 4 ) in float float_life;
+layout( location = 5 ) in vec4 vec4_particle_color;
+// Half the quad's width at birth and at death.
+uniform vec4 vec4_size;
+
+layout( std140 ) uniform Camera {
+    mat4 mat4_view;
+    mat4 mat4_projection;
+    vec4 vec4_clusters;
+};
+
+out vec2 vec2_corner;
+out vec4 vec4_color;
+
+void main() {
+    // The strip's corners (-1, -1), (1, -1), (-1, 1), (1, 1).
+    vec2  corner = vec2( float( gl_VertexID & 1 ), float( ( gl_VertexID >> 1 ) & 1 ) ) * 2.0 - 1.0;
+    float t      = clamp( float_age / float_life, 0.0, 1.0 );
+    float size   = mix( vec4_size.x, vec4_size.y, t );
+    // The view's rotation rows are the camera's right and up in world space, so the quad faces this eye.
+    vec3 right  = vec3( mat4_view[0][0], mat4_view[1][0], mat4_view[2][0] );
+    vec3 up     = vec3( mat4_view[0][1], mat4_view[1][1], mat4_view[2][1] );
+    vec3 world  = vec3( float_x, float_y, float_z ) + ( corner.x * right + corner.y * up ) * size;
+    vec2_corner = corner;
+    // Fades out over its life.
+    vec4_color  = vec4( vec4_particle_color.rgb, vec4_particle_color.a * ( 1.0 - t ) );
+    gl_Position = mat4_projection * mat4_view * vec4( world, 1.0 );
+}
@@ -0,0 +1,16 @@
+#version 300 es
+
+precision mediump float;
+
+in vec4 vec4_color;
+
+out vec4 fragmentColor;
+
+void main() {
+    // Round points, their depth written like any opaque surface's.
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    if( dot( offset, offset ) > 1.0 ) {
+        discard;
+    }
+    fragmentColor = vec4_color;
+}
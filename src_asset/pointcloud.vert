@@ -0,0 +1,24 @@
+#version 300 es
+
+// Locations match PointCloud's, the position quantized to the node's cube.
+layout( location = 0 ) in vec3 vec3_position;
+layout( location = 1 ) in vec4 vec4_point_color;
+// The node's cube placed in the scene.
+uniform mat4 mat4_model;
+// Spacing of the node's grid in the scene and the projection's pixels per unit.
+uniform vec4 vec4_point;
+
+layout( std140 ) uniform Camera {
+    mat4 mat4_view;
+    mat4 mat4_projection;
+    vec4 vec4_clusters;
+};
+
+out vec4 vec4_color;
+
+void main() {
+    vec4_color  = vec4_point_color;
+    gl_Position = mat4_projection * mat4_view * mat4_model * vec4( vec3_position, 1.0 );
+    // Wide enough to cover the grid cell the point stands for, so sparse nodes still close up.
+    gl_PointSize = clamp( vec4_point.x * vec4_point.y / max( gl_Position.w, 0.001 ), 1.0, 32.0 );
+}
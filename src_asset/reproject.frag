@@ -0,0 +1,35 @@
+#version 300 es
+
+precision highp float;
+
+uniform sampler2D sampler2D_color;
+uniform sampler2D sampler2D_depth;
+uniform mat4 mat4_reprojection;
+uniform vec4 vec4_eye_rect; // Offset and size of this eye in the history textures.
+uniform bool bool_positional;
+
+in vec2 vec2_ndc;
+
+out vec4 fragmentColor;
+
+vec2 eye_uv( vec2 ndc ) {
+    return vec4_eye_rect.xy + ( ndc * 0.5 + 0.5 ) * vec4_eye_rect.zw;
+}
+
+void main() {
+    // Without depth assume everything is far away, which is all rotation needs.
+    float depth = 1.0;
+    if( bool_positional ) {
+        // The history depth at this pixel is the best guess available for what is seen now.
+        depth = texture( sampler2D_depth, eye_uv( vec2_ndc ) ).r * 2.0 - 1.0;
+    }
+
+    vec4 history_clip = mat4_reprojection * vec4( vec2_ndc, depth, 1.0 );
+    vec2 history_ndc  = history_clip.xy / history_clip.w;
+    if( ( history_clip.w <= 0.0 ) || any( greaterThan( abs( history_ndc ), vec2( 1.0 ) ) ) ) {
+        fragmentColor = vec4( 0.0, 0.0, 0.0, 1.0 );
+        return;
+    }
+
+    fragmentColor = texture( sampler2D_color, eye_uv( history_ndc ) );
+}
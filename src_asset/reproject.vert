@@ -0,0 +1,10 @@
+#version 300 es
+
+out vec2 vec2_ndc;
+
+void main() {
+    // A single triangle covering the viewport: (-1, -1), (3, -1), (-1, 3).
+    vec2 position = vec2( float( ( gl_VertexID << 1 ) & 2 ), float( gl_VertexID & 2 ) ) * 2.0 - 1.0;
+    vec2_ndc      = position;
+    gl_Position   = vec4( position, 0.0, 1.0 );
+}
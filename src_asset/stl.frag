@@ -1,9 +1,85 @@
 #version 300 es
 
 precision mediump float;
+// Light lists grow past what mediump ints can index.
+precision highp int;
+
+in vec3 vec3_normal;
+in vec2 vec2_texcoord;
+in vec4 vec4_color;
+in highp vec3 vec3_world;
+in highp vec4 vec4_clip;
+
+layout( std140 ) uniform Camera {
+    highp mat4 mat4_view;
+    highp mat4 mat4_projection;
+    // Layer of this camera's light clusters, or negative without them, and the scale and bias taking
+    // the log of the depth to a slice.
+    highp vec4 vec4_clusters;
+};
+
+// Per cluster the first of its lights in the index list and how many there are, a row per slice.
+uniform highp usampler2D usampler2D_clusters;
+uniform highp usampler2D usampler2D_light_indices;
+// Two texels per light, position and radius followed by colour and intensity.
+uniform highp sampler2D sampler2D_lights;
+// Sampled by the mesh's texture coordinates.
+uniform sampler2D sampler2D_albedo;
 
 out vec4 fragmentColor;
 
+const vec3 LIGHT_DIRECTION = vec3( 0.267, 0.802, 0.535 );
+
+// Match LightClusters.
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 8;
+const int CLUSTER_SLICES  = 24;
+const int TEXTURE_WIDTH   = 1024;
+
+// The light of the point lights in the fragment's cluster.
+vec3 clustered_light( vec3 normal, bool lit ) {
+    vec3 sum = vec3( 0.0 );
+    if( vec4_clusters.x < 0.0 ) {
+        return sum;
+    }
+
+    highp vec2  ndc   = vec4_clip.xy / vec4_clip.w;
+    ivec2       tile  = clamp( ivec2( ( ndc * 0.5 + 0.5 ) * vec2( CLUSTER_TILES_X, CLUSTER_TILES_Y ) ), ivec2( 0 ), ivec2( CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1 ) );
+    int         slice = clamp( int( log( vec4_clip.w ) * vec4_clusters.y + vec4_clusters.z ), 0, CLUSTER_SLICES - 1 );
+    highp uvec2 cluster =
+        texelFetch( usampler2D_clusters, ivec2( tile.y * CLUSTER_TILES_X + tile.x, int( vec4_clusters.x ) * CLUSTER_SLICES + slice ), 0 ).xy;
+
+    for( uint i = 0u; i < cluster.y; ++i ) {
+        int        index    = int( cluster.x + i );
+        int        light    = 2 * int( texelFetch( usampler2D_light_indices, ivec2( index % TEXTURE_WIDTH, index / TEXTURE_WIDTH ), 0 ).r );
+        ivec2      texel    = ivec2( light % TEXTURE_WIDTH, light / TEXTURE_WIDTH );
+        highp vec4 position = texelFetch( sampler2D_lights, texel, 0 );
+        highp vec3 to_light = position.xyz - vec3_world;
+        highp float squared = dot( to_light, to_light );
+        highp float radius  = position.w * position.w;
+        if( squared >= radius ) {
+            continue;
+        }
+        vec4  color   = texelFetch( sampler2D_lights, texel + ivec2( 1, 0 ), 0 );
+        float falloff = 1.0 - squared / radius;
+        // Two sided like the directional light.
+        float facing = lit ? abs( dot( normal, to_light * inversesqrt( max( squared, 1e-6 ) ) ) ) : 1.0;
+        sum += color.rgb * ( color.a * falloff * falloff * facing );
+    }
+    return sum;
+}
+
 void main() {
-    fragmentColor = vec4( 1.0, 0.0, 0.0, 1.0 );
+    // Geometry drawn without normals is left unlit.
+    vec3  light  = vec3( 1.0 );
+    vec3  normal = vec3( 0.0 );
+    bool  lit    = dot( vec3_normal, vec3_normal ) > 0.0;
+    if( lit ) {
+        normal = normalize( vec3_normal );
+        // Two sided, since some meshes are open.
+        light = vec3( 0.35 + 0.65 * abs( dot( normal, LIGHT_DIRECTION ) ) );
+    }
+    light += clustered_light( normal, lit );
+    vec4 albedo   = texture( sampler2D_albedo, vec2_texcoord );
+    fragmentColor = vec4( vec4_color.rgb * light * albedo.rgb, vec4_color.a * albedo.a );
 }
@@ -1,10 +1,89 @@
 #version 300 es
 
-in vec4 vec4_position;
+// Locations are fixed so the depth program, which links this shader too, reads the same vertex arrays.
+layout( location = 0 ) in vec4 vec4_position;
+// Either a plain normal in xyz or, with bool_octahedral, an octahedral encoded one in xy.
+layout( location = 1 ) in vec4 vec4_normal;
+layout( location = 2 ) in vec2 vec2_uv;
+// With bool_instanced, the model matrix's top three rows and the colour come per instance instead.
+layout( location = 3 ) in vec4 vec4_instance_row0;
+layout( location = 4 ) in vec4 vec4_instance_row1;
+layout( location = 5 ) in vec4 vec4_instance_row2;
+layout( location = 6 ) in vec4 vec4_instance_color;
+#ifdef SKINNED
+// Up to four bones per vertex as whole numbers, and their weights adding up to one.
+layout( location = 7 ) in vec4 vec4_bone_indices;
+layout( location = 8 ) in vec4 vec4_bone_weights;
+// Where the instance's bones start in the palette.
+layout( location = 9 ) in float float_instance_palette;
+// Three texels per bone, the top three rows of its row major matrix, BONES_PER_ROW bones to a row.
+uniform highp sampler2D sampler2D_palette;
+#endif
 uniform mat4 mat4_model;
-uniform mat4 mat4_view;
-uniform mat4 mat4_projection;
+uniform bool bool_octahedral;
+uniform bool bool_instanced;
+
+layout( std140 ) uniform Camera {
+    mat4 mat4_view;
+    mat4 mat4_projection;
+    vec4 vec4_clusters;
+};
+
+out vec3 vec3_normal;
+out vec2 vec2_texcoord;
+out vec4 vec4_color;
+out vec3 vec3_world;
+// The clip space position again, for the fragment shader to find its light cluster with.
+out vec4 vec4_clip;
+// The shading pass after a depth pre-pass tests with GL_EQUAL, so both programs have to compute the exact same depth.
+invariant gl_Position;
+
+vec3 octahedral_decode( vec2 e ) {
+    vec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );
+    if( n.z < 0.0 ) {
+        n.xy = ( 1.0 - abs( n.yx ) ) * vec2( n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0 );
+    }
+    return n;
+}
+
+#ifdef SKINNED
+// Match SkinningPalette.
+const int BONES_PER_ROW = 256;
+
+mat4 bone_matrix( float index ) {
+    int   bone  = int( float_instance_palette + index );
+    ivec2 texel = ivec2( 3 * ( bone % BONES_PER_ROW ), bone / BONES_PER_ROW );
+    vec4  row0  = texelFetch( sampler2D_palette, texel, 0 );
+    vec4  row1  = texelFetch( sampler2D_palette, texel + ivec2( 1, 0 ), 0 );
+    vec4  row2  = texelFetch( sampler2D_palette, texel + ivec2( 2, 0 ), 0 );
+    return transpose( mat4( row0, row1, row2, vec4( 0.0, 0.0, 0.0, 1.0 ) ) );
+}
+#endif
 
 void main() {
-    gl_Position = mat4_projection * mat4_view * mat4_model * vec4_position;
+    mat4 model = mat4_model;
+    vec4_color = vec4( 1.0, 0.0, 0.0, 1.0 );
+    if( bool_instanced ) {
+        model      = transpose( mat4( vec4_instance_row0, vec4_instance_row1, vec4_instance_row2, vec4( 0.0, 0.0, 0.0, 1.0 ) ) );
+        vec4_color = vec4_instance_color;
+    }
+
+    vec3 normal   = bool_octahedral ? octahedral_decode( vec4_normal.xy ) : vec4_normal.xyz;
+    vec4 position = vec4_position;
+#ifdef SKINNED
+    // Skinned meshes are only drawn instanced. The palette already dequantizes, so the model matrix only places them.
+    if( bool_instanced ) {
+        mat4 skin = vec4_bone_weights.x * bone_matrix( vec4_bone_indices.x ) + vec4_bone_weights.y * bone_matrix( vec4_bone_indices.y ) +
+                    vec4_bone_weights.z * bone_matrix( vec4_bone_indices.z ) + vec4_bone_weights.w * bone_matrix( vec4_bone_indices.w );
+        position = skin * position;
+        normal   = mat3( skin ) * normal;
+    }
+#endif
+    // The model matrix may scale uniformly, e.g. to dequantize positions, so the fragment shader renormalizes.
+    vec3_normal   = mat3( model ) * normal;
+    vec2_texcoord = vec2_uv;
+    vec4 world    = model * position;
+    vec3_world    = world.xyz;
+    gl_Position   = mat4_projection * mat4_view * world;
+    vec4_clip     = gl_Position;
 }
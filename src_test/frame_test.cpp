@@ -0,0 +1,289 @@
+// Runs the app's frames, with and without VR, against the mock GL and checks the GL work each frame does:
+// how many draws, that nothing is allocated once the first frames have set up what they need, and how many
+// bytes go up. The work is counted twice, by the mock from the calls made and by the app's FrameBudget, and
+// the two have to agree. GLState runs in debug mode throughout, so every call it elides is checked against
+// the mock's state too.
+
+#include <flatbuffers/flatbuffers.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "egl.h"
+#include "frame.h"
+#include "gles.h"
+#include "input.h"
+#include "mock.h"
+#include "reprojection.h"
+#include "scene.h"
+#include "test.h"
+#include "user_context.h"
+#include "vr.h"
+#include "vr_state_generated.h"
+
+namespace {
+    const double FRAME_MS = 1000.0 / 90.0;
+    // Frames that may still create what later frames reuse, e.g. the offscreen targets.
+    const int WARM_UP_FRAMES = 3;
+    const int FRAMES         = 30;
+
+    const GLfloat EYE_HEIGHT     = 1.6f;
+    const GLfloat HALF_IPD       = 0.032f;
+    const GLfloat NEAR_PLANE     = 0.1f;
+    const GLfloat FAR_PLANE      = 100.0f;
+    const GLfloat TAN_HALF_FOV_Y = 1.2f;
+    const GLfloat ASPECT         = 1080.0f / 1200.0f;
+
+    // Column major, as WebVR hands them over. The head turns a little every frame, about the vertical axis.
+    void eye_matrices( int eye, double ms, GLfloat* view, GLfloat* projection ) {
+        const GLfloat angle = static_cast<GLfloat>( 0.0005 * ms );
+        const GLfloat c     = cosf( angle );
+        const GLfloat s     = sinf( angle );
+        const GLfloat x     = eye ? HALF_IPD : -HALF_IPD;
+        // The inverse of a rotation about y followed by the eye's offset and height.
+        const GLfloat eye_view[4 * 4] = {
+            c, 0.0f, -s, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            s, 0.0f, c, 0.0f,
+            -x, -EYE_HEIGHT, 0.0f, 1.0f};
+        memcpy( view, eye_view, sizeof( eye_view ) );
+
+        memset( projection, 0, 4 * 4 * sizeof( GLfloat ) );
+        projection[0]  = 1.0f / ( TAN_HALF_FOV_Y * ASPECT );
+        projection[5]  = 1.0f / TAN_HALF_FOV_Y;
+        projection[10] = -( FAR_PLANE + NEAR_PLANE ) / ( FAR_PLANE - NEAR_PLANE );
+        projection[11] = -1.0f;
+        projection[14] = -2.0f * FAR_PLANE * NEAR_PLANE / ( FAR_PLANE - NEAR_PLANE );
+    }
+
+    flatbuffers::Offset<VR::Pose> create_pose( flatbuffers::FlatBufferBuilder& builder, GLfloat x, GLfloat y, GLfloat z ) {
+        const float position[3]    = {x, y, z};
+        const float zero[3]        = {0.0f, 0.0f, 0.0f};
+        const float orientation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        return VR::CreatePose( builder,
+                               builder.CreateVector( position, 3 ),
+                               builder.CreateVector( zero, 3 ),
+                               builder.CreateVector( zero, 3 ),
+                               builder.CreateVector( orientation, 4 ),
+                               builder.CreateVector( zero, 3 ),
+                               builder.CreateVector( zero, 3 ) );
+    }
+
+    // The state impl_get_vr_state() would hand over at the time: the head's matrices and pose, and both
+    // controllers held out in front, neither pressing a button.
+    std::vector<uint8_t> vr_state_buffer( double ms ) {
+        flatbuffers::FlatBufferBuilder builder;
+        GLfloat                        views[2][4 * 4];
+        GLfloat                        projections[2][4 * 4];
+        for( int eye = 0; eye < 2; ++eye ) {
+            eye_matrices( eye, ms, views[eye], projections[eye] );
+        }
+        const auto hmd = VR::CreateHMD( builder,
+                                        builder.CreateVector( projections[0], 4 * 4 ),
+                                        builder.CreateVector( views[0], 4 * 4 ),
+                                        builder.CreateVector( projections[1], 4 * 4 ),
+                                        builder.CreateVector( views[1], 4 * 4 ),
+                                        create_pose( builder, 0.0f, EYE_HEIGHT, 0.0f ) );
+
+        std::vector<flatbuffers::Offset<VR::Gamepad>> gamepads;
+        for( int i = 0; i < 2; ++i ) {
+            const double                                        axes[2] = {0.0, 0.0};
+            std::vector<flatbuffers::Offset<VR::GamepadButton>> buttons( 1, VR::CreateGamepadButton( builder, false, false, 0.0 ) );
+            gamepads.push_back( VR::CreateGamepad( builder,
+                                                   builder.CreateString( "Mock Controller" ),
+                                                   i,
+                                                   true,
+                                                   builder.CreateString( "standard" ),
+                                                   builder.CreateVector( axes, 2 ),
+                                                   builder.CreateVector( buttons ),
+                                                   create_pose( builder, i ? 0.2f : -0.2f, 1.2f, -0.3f ) ) );
+        }
+
+        builder.Finish( VR::CreateState( builder, ms, hmd, builder.CreateVector( gamepads ) ) );
+        return std::vector<uint8_t>( builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize() );
+    }
+
+    // Hands the frame's state to the mock, late latched matrices included, as the browser would have it.
+    void vr_state_set( double ms ) {
+        const std::vector<uint8_t> state = vr_state_buffer( ms );
+        mock_vr_set_state( state.data(), state.size() );
+        GLfloat matrices[2 * 2 * 4 * 4];
+        for( int eye = 0; eye < 2; ++eye ) {
+            eye_matrices( eye, ms, matrices + 32 * eye, matrices + 32 * eye + 16 );
+        }
+        mock_vr_set_hmd_matrices( matrices, ms );
+    }
+
+    // The mock and the app's budget have to count the same work, and a frame after the first few
+    // creates nothing.
+    void check_frame_work( const UserContext& user_context, int frame, const char* mode ) {
+        const MockWork& work   = mock_work();
+        const GLWork&   budget = user_context.frame_budget.frame();
+        bool            passed = true;
+        passed &= CHECK_EQUAL( work.draw_calls, budget.draw_calls );
+        passed &= CHECK_EQUAL( work.bytes_uploaded, budget.bytes_uploaded );
+        passed &= CHECK( work.draw_calls > 0 );
+        if( frame >= WARM_UP_FRAMES ) {
+            passed &= CHECK_EQUAL( 0, work.objects_created );
+            passed &= CHECK_EQUAL( 0, budget.buffer_allocations );
+            passed &= CHECK( budget.draw_calls <= user_context.frame_budget.limit().draw_calls );
+            passed &= CHECK( budget.bytes_uploaded <= user_context.frame_budget.limit().bytes_uploaded );
+        }
+        if( !passed ) {
+            fprintf( stderr, "In %s frame %d, whose calls were:\n", mode, frame );
+            print_mock_calls();
+        }
+    }
+
+    // A batch is drawn once for each eye that sees it.
+    unsigned int vr_mesh_draws( const UserContext& user_context ) {
+        unsigned int draws = 0;
+        for( const InstanceBatch& batch : user_context.instance_batcher.batches() ) {
+            draws += ( batch.eyes & 1 ) + ( ( batch.eyes >> 1 ) & 1 );
+        }
+        return draws;
+    }
+
+    bool live( MockObjectKind kind, GLuint name ) {
+        for( const MockObject& object : mock_objects() ) {
+            if( ( object.kind == kind ) && ( object.name == name ) ) {
+                return !object.deleted;
+            }
+        }
+        return false;
+    }
+
+    void run_frame( UserContext& user_context, double ms ) {
+        mock_set_now( ms );
+        mock_begin_frame();
+        frame_begin( user_context );
+        user_context.update_func( user_context );
+        user_context.draw_func( user_context );
+        eglSwapBuffers( user_context.display, user_context.surface );
+        frame_end( user_context );
+    }
+
+    void run_vr_frame( double ms ) {
+        mock_set_now( ms );
+        vr_state_set( ms );
+        mock_begin_frame();
+        CHECK( mock_vr_run_frame() );
+    }
+
+    bool set_up( UserContext& user_context ) {
+        if( !( egl_initialize( user_context ) && gles_load_shaders( user_context ) ) ) {
+            return false;
+        }
+        scene_build_default( user_context );
+        return reprojection_load_shaders( user_context ) && input_initialize( user_context ) && residency_initialize( user_context );
+    }
+}
+
+int main() {
+    mock_reset();
+    UserContext& user_context = *( new UserContext() );
+    user_context.gl_state.set_debug( true );
+    if( !CHECK( set_up( user_context ) ) ) {
+        return test_result( "frame_test" );
+    }
+    user_context.update_func = gles_update;
+    user_context.draw_func   = gles_draw;
+
+    // Without VR the triangle is drawn in clip space, from vertices streamed into the one vertex buffer,
+    // with the identity camera.
+    double ms = 1000.0;
+    for( int frame = 0; frame < FRAMES; ++frame, ms += FRAME_MS ) {
+        run_frame( user_context, ms );
+        check_frame_work( user_context, frame, "gles_draw" );
+        if( frame >= WARM_UP_FRAMES ) {
+            CHECK_EQUAL( 1, mock_work().draw_calls );
+            CHECK_EQUAL( 3 * 3 * sizeof( GLfloat ) + sizeof( CameraMatrices ), mock_work().bytes_uploaded );
+        }
+    }
+
+    // The HUD adds one draw, and its vertices when the text changes. Its numbers change every frame, so
+    // while it is shown no frame may be skipped as unchanged.
+    user_context.hud.set_enabled( true );
+    for( int frame = 0; frame < FRAMES; ++frame, ms += FRAME_MS ) {
+        run_frame( user_context, ms );
+        check_frame_work( user_context, frame, "gles_draw with the HUD" );
+        CHECK( user_context.redraw.needed( user_context.width, user_context.height, user_context.scene ) );
+        if( frame >= WARM_UP_FRAMES ) {
+            CHECK_EQUAL( 2, mock_work().draw_calls );
+        }
+    }
+    user_context.hud.set_enabled( false );
+
+    // Into VR the way the page goes: the display is found, the user asks to present, the browser grants it
+    // and runs the display's render loop from then on. Its first run only sees the display presenting.
+    vr_state_set( ms );
+    vr_prepare( user_context );
+    CHECK_EQUAL( 1, mock_count_calls( "emscripten_set_click_callback" ) );
+    switch_to_vr( user_context );
+    CHECK( mock_vr_grant_present() );
+    CHECK( user_context.draw_func == vr_gles_draw );
+    CHECK( mock_vr_run_frame() );
+    CHECK_EQUAL( 0, mock_vr_frames_submitted() );
+
+    // Nothing here is over the deadline, so every frame is rendered rather than reprojected.
+    for( int frame = 0; frame < FRAMES; ++frame ) {
+        ms += FRAME_MS;
+        run_vr_frame( ms );
+        check_frame_work( user_context, frame, "vr_gles_draw" );
+        CHECK_EQUAL( frame + 1, mock_vr_frames_submitted() );
+        CHECK( !user_context.reprojection.active );
+        if( frame >= WARM_UP_FRAMES ) {
+            // Everything the default scene draws is a mesh batch.
+            CHECK( vr_mesh_draws( user_context ) > 0 );
+            CHECK_EQUAL( vr_mesh_draws( user_context ), mock_work().draw_calls );
+            // Instances and the cameras go up once for both eyes.
+            const size_t instances = user_context.instance_batcher.nodes().size() * sizeof( InstanceData );
+            CHECK( mock_work().bytes_uploaded >= instances + 2 * sizeof( CameraMatrices ) );
+        }
+    }
+
+    // The depth pre-pass draws every mesh batch a second time.
+    user_context.depth_prepass = true;
+    for( int frame = 0; frame < FRAMES; ++frame ) {
+        ms += FRAME_MS;
+        run_vr_frame( ms );
+        check_frame_work( user_context, frame, "vr_gles_draw with the depth pre-pass" );
+        if( frame >= WARM_UP_FRAMES ) {
+            CHECK_EQUAL( 2 * vr_mesh_draws( user_context ), mock_work().draw_calls );
+        }
+    }
+    user_context.depth_prepass = false;
+
+    // Reprojection keeps the last rendered frame in a pooled target. Losing the context frees every target,
+    // that one too, and the frames after the restore have to start over without it. An open point cloud
+    // stays open, its requests still pending, to stream its nodes back in.
+    user_context.reprojection.enabled = true;
+    user_context.point_cloud.open( user_context.gl_state, "pointcloud" );
+    for( int frame = 0; frame < WARM_UP_FRAMES; ++frame ) {
+        ms += FRAME_MS;
+        run_vr_frame( ms );
+    }
+    CHECK( user_context.reprojection.history != nullptr );
+    CHECK( mock_lose_context() );
+    CHECK( mock_restore_context() );
+    CHECK( user_context.reprojection.history == nullptr );
+    CHECK( !user_context.reprojection.active );
+    CHECK( user_context.point_cloud.opened() );
+    CHECK_EQUAL( 0, mock_count_calls( "emscripten_async_wget2_abort" ) );
+    for( int frame = 0; frame < FRAMES; ++frame ) {
+        ms += FRAME_MS;
+        run_vr_frame( ms );
+        check_frame_work( user_context, frame, "vr_gles_draw after the context was restored" );
+        if( CHECK( user_context.reprojection.history != nullptr ) ) {
+            CHECK( live( MOCK_FRAMEBUFFER, user_context.reprojection.history->framebuffer ) );
+        }
+        if( frame >= WARM_UP_FRAMES ) {
+            CHECK_EQUAL( vr_mesh_draws( user_context ), mock_work().draw_calls );
+        }
+    }
+    user_context.reprojection.enabled = false;
+    user_context.point_cloud.close( user_context.gl_state );
+
+    CHECK_EQUAL( 0, user_context.gl_state.stats().mismatches );
+    return test_result( "frame_test" );
+}
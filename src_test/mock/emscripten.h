@@ -0,0 +1,28 @@
+#ifndef WASMVR_MOCK_EMSCRIPTEN_H
+#define WASMVR_MOCK_EMSCRIPTEN_H
+
+// The subset of emscripten.h the app uses, for native builds against the mock, see mock.h.
+// EM_JS functions become plain declarations, mock_emscripten.cpp defines them.
+
+#define EM_JS( ret, name, params, ... ) extern "C" ret name params
+#define EMSCRIPTEN_KEEPALIVE __attribute__( ( used ) )
+
+typedef int EM_BOOL;
+
+typedef void ( *em_callback_func )( void );
+typedef void ( *em_arg_callback_func )( void* );
+typedef void ( *em_async_wget2_data_onload_func )( unsigned handle, void* arg, void* data, unsigned size );
+typedef void ( *em_async_wget2_data_onerror_func )( unsigned handle, void* arg, int status, const char* text );
+typedef void ( *em_async_wget2_data_onprogress_func )( unsigned handle, void* arg, int loaded, int total );
+
+extern "C" {
+double emscripten_get_now( void );
+void   emscripten_set_main_loop_arg( em_arg_callback_func func, void* arg, int fps, int simulate_infinite_loop );
+void   emscripten_cancel_main_loop( void );
+int    emscripten_async_wget2_data( const char* url, const char* requesttype, const char* param, void* arg, int free,
+                                    em_async_wget2_data_onload_func onload, em_async_wget2_data_onerror_func onerror,
+                                    em_async_wget2_data_onprogress_func onprogress );
+void   emscripten_async_wget2_abort( int handle );
+}
+
+#endif // WASMVR_MOCK_EMSCRIPTEN_H
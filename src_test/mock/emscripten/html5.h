@@ -0,0 +1,72 @@
+#ifndef WASMVR_MOCK_EMSCRIPTEN_HTML5_H
+#define WASMVR_MOCK_EMSCRIPTEN_HTML5_H
+
+// The subset of emscripten/html5.h the app uses, for native builds against the mock, see mock.h.
+
+#include <emscripten.h>
+
+#define EMSCRIPTEN_RESULT_SUCCESS 0
+#define EMSCRIPTEN_RESULT_NOT_SUPPORTED -1
+
+#define EMSCRIPTEN_EVENT_TARGET_WINDOW ( reinterpret_cast<const char*>( 2 ) )
+
+#define EMSCRIPTEN_EVENT_KEYDOWN 2
+#define EMSCRIPTEN_EVENT_CLICK 4
+#define EMSCRIPTEN_EVENT_WEBGLCONTEXTLOST 31
+#define EMSCRIPTEN_EVENT_WEBGLCONTEXTRESTORED 32
+
+typedef struct EmscriptenKeyboardEvent {
+    double        timestamp;
+    unsigned long location;
+    EM_BOOL       ctrlKey;
+    EM_BOOL       shiftKey;
+    EM_BOOL       altKey;
+    EM_BOOL       metaKey;
+    EM_BOOL       repeat;
+    unsigned long charCode;
+    unsigned long keyCode;
+    unsigned long which;
+    char          key[32];
+    char          code[32];
+    char          charValue[32];
+    char          locale[32];
+} EmscriptenKeyboardEvent;
+
+typedef struct EmscriptenMouseEvent {
+    double         timestamp;
+    long           screenX;
+    long           screenY;
+    long           clientX;
+    long           clientY;
+    EM_BOOL        ctrlKey;
+    EM_BOOL        shiftKey;
+    EM_BOOL        altKey;
+    EM_BOOL        metaKey;
+    unsigned short button;
+    unsigned short buttons;
+    long           movementX;
+    long           movementY;
+    long           targetX;
+    long           targetY;
+    long           canvasX;
+    long           canvasY;
+    long           padding;
+} EmscriptenMouseEvent;
+
+typedef int EMSCRIPTEN_WEBGL_CONTEXT_HANDLE;
+
+typedef EM_BOOL ( *em_key_callback_func )( int eventType, const EmscriptenKeyboardEvent* keyEvent, void* userData );
+typedef EM_BOOL ( *em_mouse_callback_func )( int eventType, const EmscriptenMouseEvent* mouseEvent, void* userData );
+typedef EM_BOOL ( *em_webgl_context_callback )( int eventType, const void* reserved, void* userData );
+
+extern "C" {
+int emscripten_set_keydown_callback( const char* target, void* userData, EM_BOOL useCapture, em_key_callback_func callback );
+int emscripten_set_click_callback( const char* target, void* userData, EM_BOOL useCapture, em_mouse_callback_func callback );
+int emscripten_set_webglcontextlost_callback( const char* target, void* userData, EM_BOOL useCapture, em_webgl_context_callback callback );
+int emscripten_set_webglcontextrestored_callback( const char* target, void* userData, EM_BOOL useCapture, em_webgl_context_callback callback );
+
+EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_get_current_context( void );
+EM_BOOL                         emscripten_webgl_enable_extension( EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context, const char* extension );
+}
+
+#endif // WASMVR_MOCK_EMSCRIPTEN_HTML5_H
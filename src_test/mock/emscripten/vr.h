@@ -0,0 +1,62 @@
+#ifndef WASMVR_MOCK_EMSCRIPTEN_VR_H
+#define WASMVR_MOCK_EMSCRIPTEN_VR_H
+
+// emscripten/vr.h, the WebVR 1.1 bindings the app presents through, for native builds against the mock,
+// see mock.h. The mock has one display.
+
+#include <emscripten.h>
+#include <stdint.h>
+
+typedef int32_t VRDisplayHandle;
+
+typedef enum {
+    VREyeLeft,
+    VREyeRight
+} VREye;
+
+typedef struct VRDisplayCapabilities {
+    int32_t       hasPosition;
+    int32_t       hasExternalDisplay;
+    int32_t       canPresent;
+    unsigned long maxLayers;
+} VRDisplayCapabilities;
+
+typedef struct VRPoint3D {
+    float x;
+    float y;
+    float z;
+} VRPoint3D;
+
+typedef struct VREyeParameters {
+    VRPoint3D offset;
+    uint32_t  renderWidth;
+    uint32_t  renderHeight;
+} VREyeParameters;
+
+typedef struct VRLayerInit {
+    const char* source;
+    float       leftBounds[4];
+    float       rightBounds[4];
+} VRLayerInit;
+
+#define VR_LAYER_DEFAULT_LEFT_BOUNDS { 0.0f, 0.0f, 0.5f, 1.0f }
+#define VR_LAYER_DEFAULT_RIGHT_BOUNDS { 0.5f, 0.0f, 0.5f, 1.0f }
+
+extern "C" {
+int             emscripten_vr_init( em_arg_callback_func callback, void* userData );
+int             emscripten_vr_ready( void );
+int             emscripten_vr_version_major( void );
+int             emscripten_vr_version_minor( void );
+int             emscripten_vr_count_displays( void );
+VRDisplayHandle emscripten_vr_get_display_handle( int displayIndex );
+const char*     emscripten_vr_get_display_name( VRDisplayHandle handle );
+int             emscripten_vr_get_display_capabilities( VRDisplayHandle handle, VRDisplayCapabilities* displayCaps );
+int             emscripten_vr_get_eye_parameters( VRDisplayHandle handle, VREye whichEye, VREyeParameters* eyeParams );
+int             emscripten_vr_display_presenting( VRDisplayHandle handle );
+int             emscripten_vr_set_display_render_loop_arg( VRDisplayHandle handle, em_arg_callback_func callback, void* arg );
+int             emscripten_vr_cancel_display_render_loop( VRDisplayHandle handle );
+int             emscripten_vr_request_present( VRDisplayHandle handle, VRLayerInit* layerInit, int layerCount, em_arg_callback_func callback, void* userData );
+int             emscripten_vr_submit_frame( VRDisplayHandle handle );
+}
+
+#endif // WASMVR_MOCK_EMSCRIPTEN_VR_H
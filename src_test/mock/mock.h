@@ -0,0 +1,90 @@
+#ifndef WASMVR_MOCK_H
+#define WASMVR_MOCK_H
+
+#include <GLES3/gl3.h>
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Stands in for libGLESv2, EGL and the parts of emscripten and the browser the app calls, so its sources
+// build and run natively, see test.sh. Every call is recorded with its arguments, GL keeps enough state for
+// GLState's debug mode to check its cache against, and the objects made are tracked until deleted.
+// Nothing is drawn: draws and uploads are only counted.
+
+// A call into the mock. Arguments are recorded as numbers, pointers by their address.
+struct MockCall {
+    std::string         name;
+    std::vector<double> args;
+};
+
+// The GL work of the calls since mock_begin_frame(), counted from the calls themselves rather than
+// by the app's FrameBudget, so the two can be checked against each other.
+struct MockWork {
+    unsigned int calls;
+    unsigned int draw_calls;      // glDraw*.
+    unsigned int objects_created; // glGen*, glCreateProgram and glCreateShader.
+    size_t       bytes_uploaded;  // glBufferData with data, glBufferSubData and the texture uploads.
+
+    MockWork();
+};
+
+enum MockObjectKind {
+    MOCK_BUFFER,
+    MOCK_TEXTURE,
+    MOCK_FRAMEBUFFER,
+    MOCK_RENDERBUFFER,
+    MOCK_VERTEX_ARRAY,
+    MOCK_QUERY,
+    MOCK_SHADER,
+    MOCK_PROGRAM,
+    MOCK_OBJECT_KINDS
+};
+
+struct MockObject {
+    MockObjectKind kind;
+    GLuint         name;
+    bool           deleted;
+};
+
+// Forgets every call, object and bit of GL state, as for a fresh context.
+void mock_reset();
+// Starts counting the calls and work of a frame.
+void mock_begin_frame();
+const MockWork&              mock_work();
+const std::vector<MockCall>& mock_calls(); // Since mock_begin_frame().
+unsigned int                 mock_count_calls( const char* name );
+// Every object made since mock_reset(), in the order they were made.
+const std::vector<MockObject>& mock_objects();
+size_t                         mock_live_objects( MockObjectKind kind );
+// Bytes given to glBufferData for the buffer, zero for unknown buffers.
+size_t mock_buffer_size( GLuint buffer );
+
+// Prints the calls since mock_begin_frame(), for when a test fails.
+void print_mock_calls();
+
+// Used by the mocks to log a call.
+void mock_record( const char* name, std::initializer_list<double> args );
+double mock_pointer( const void* pointer );
+
+// emscripten_get_now(), which only moves when a test moves it.
+void   mock_set_now( double ms );
+double mock_now();
+
+// What the EM_JS functions of src/vr.cpp hand over: a VR::State FlatBuffer, and the late latched matrices
+// in the order get_vr_hmd_matrices() writes them, with the pose's time, or none with a negative time.
+void mock_vr_set_state( const uint8_t* buffer, size_t size );
+void mock_vr_set_hmd_matrices( const GLfloat* matrices, double pose_ms );
+// Grants the last emscripten_vr_request_present(), and runs the display's render loop once.
+bool         mock_vr_grant_present();
+bool         mock_vr_run_frame();
+unsigned int mock_vr_frames_submitted();
+
+// Fires the canvas' webglcontextlost callback, as the browser does when the GPU goes away.
+bool mock_lose_context();
+// Gives the app a fresh context, every object and bit of state gone as after mock_reset(), and fires the
+// webglcontextrestored callback.
+bool mock_restore_context();
+
+#endif // WASMVR_MOCK_H
@@ -0,0 +1,343 @@
+#include "mock.h"
+
+#include <emscripten.h>
+#include <emscripten/html5.h>
+#include <emscripten/vr.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+    // A headset's panels, and the canvas of the page around it.
+    const int EYE_WIDTH     = 1080;
+    const int EYE_HEIGHT    = 1200;
+    const int CANVAS_WIDTH  = 1280;
+    const int CANVAS_HEIGHT = 720;
+
+    const VRDisplayHandle DISPLAY = 1;
+
+    struct Browser {
+        double now_ms;
+        int    next_request;
+
+        std::vector<uint8_t> vr_state;
+        GLfloat              hmd_matrices[2 * 2 * 4 * 4];
+        double               hmd_pose_ms;
+
+        bool                 presenting;
+        em_arg_callback_func present_callback;
+        void*                present_arg;
+        em_arg_callback_func render_loop;
+        void*                render_loop_arg;
+        unsigned int         frames_submitted;
+
+        em_webgl_context_callback context_lost;
+        em_webgl_context_callback context_restored;
+        void*                     context_arg;
+
+        Browser()
+            : now_ms( 0.0 )
+            , next_request( 1 )
+            , hmd_pose_ms( -1.0 )
+            , presenting( false )
+            , present_callback( nullptr )
+            , present_arg( nullptr )
+            , render_loop( nullptr )
+            , render_loop_arg( nullptr )
+            , frames_submitted( 0 )
+            , context_lost( nullptr )
+            , context_restored( nullptr )
+            , context_arg( nullptr ) {
+        }
+    };
+
+    Browser& browser() {
+        static Browser instance;
+        return instance;
+    }
+}
+
+void mock_set_now( double ms ) {
+    browser().now_ms = ms;
+}
+
+double mock_now() {
+    return browser().now_ms;
+}
+
+void mock_vr_set_state( const uint8_t* buffer, size_t size ) {
+    browser().vr_state.assign( buffer, buffer + size );
+}
+
+void mock_vr_set_hmd_matrices( const GLfloat* matrices, double pose_ms ) {
+    if( matrices ) {
+        memcpy( browser().hmd_matrices, matrices, sizeof( browser().hmd_matrices ) );
+    }
+    browser().hmd_pose_ms = pose_ms;
+}
+
+bool mock_vr_grant_present() {
+    Browser& b = browser();
+    if( !b.present_callback ) {
+        return false;
+    }
+    b.presenting                  = true;
+    em_arg_callback_func callback = b.present_callback;
+    b.present_callback            = nullptr;
+    callback( b.present_arg );
+    return true;
+}
+
+bool mock_vr_run_frame() {
+    Browser& b = browser();
+    if( !b.render_loop ) {
+        return false;
+    }
+    b.render_loop( b.render_loop_arg );
+    return true;
+}
+
+unsigned int mock_vr_frames_submitted() {
+    return browser().frames_submitted;
+}
+
+bool mock_lose_context() {
+    Browser& b = browser();
+    return b.context_lost && b.context_lost( EMSCRIPTEN_EVENT_WEBGLCONTEXTLOST, nullptr, b.context_arg );
+}
+
+bool mock_restore_context() {
+    Browser& b = browser();
+    if( !b.context_restored ) {
+        return false;
+    }
+    mock_reset();
+    b.context_restored( EMSCRIPTEN_EVENT_WEBGLCONTEXTRESTORED, nullptr, b.context_arg );
+    return true;
+}
+
+extern "C" {
+
+double emscripten_get_now( void ) {
+    return browser().now_ms;
+}
+
+void emscripten_set_main_loop_arg( em_arg_callback_func func, void* arg, int fps, int simulate_infinite_loop ) {
+    mock_record( "emscripten_set_main_loop_arg", {mock_pointer( reinterpret_cast<void*>( func ) ), mock_pointer( arg ), static_cast<double>( fps ), static_cast<double>( simulate_infinite_loop )} );
+}
+
+void emscripten_cancel_main_loop( void ) {
+    mock_record( "emscripten_cancel_main_loop", {} );
+}
+
+// Nothing is served, requests stay pending until aborted.
+int emscripten_async_wget2_data( const char* url, const char* requesttype, const char* param, void* arg, int free,
+                                 em_async_wget2_data_onload_func onload, em_async_wget2_data_onerror_func onerror,
+                                 em_async_wget2_data_onprogress_func onprogress ) {
+    mock_record( "emscripten_async_wget2_data", {mock_pointer( url ), mock_pointer( requesttype ), mock_pointer( param ), mock_pointer( arg ), static_cast<double>( free ),
+                                                 mock_pointer( reinterpret_cast<void*>( onload ) ), mock_pointer( reinterpret_cast<void*>( onerror ) ), mock_pointer( reinterpret_cast<void*>( onprogress ) )} );
+    return browser().next_request++;
+}
+
+void emscripten_async_wget2_abort( int handle ) {
+    mock_record( "emscripten_async_wget2_abort", {static_cast<double>( handle )} );
+}
+
+int emscripten_set_keydown_callback( const char* target, void* userData, EM_BOOL useCapture, em_key_callback_func callback ) {
+    mock_record( "emscripten_set_keydown_callback", {mock_pointer( target ), mock_pointer( userData ), static_cast<double>( useCapture ), mock_pointer( reinterpret_cast<void*>( callback ) )} );
+    return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+int emscripten_set_click_callback( const char* target, void* userData, EM_BOOL useCapture, em_mouse_callback_func callback ) {
+    mock_record( "emscripten_set_click_callback", {mock_pointer( target ), mock_pointer( userData ), static_cast<double>( useCapture ), mock_pointer( reinterpret_cast<void*>( callback ) )} );
+    return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+int emscripten_set_webglcontextlost_callback( const char* target, void* userData, EM_BOOL useCapture, em_webgl_context_callback callback ) {
+    mock_record( "emscripten_set_webglcontextlost_callback", {mock_pointer( target ), mock_pointer( userData ), static_cast<double>( useCapture ), mock_pointer( reinterpret_cast<void*>( callback ) )} );
+    browser().context_lost = callback;
+    browser().context_arg  = userData;
+    return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+int emscripten_set_webglcontextrestored_callback( const char* target, void* userData, EM_BOOL useCapture, em_webgl_context_callback callback ) {
+    mock_record( "emscripten_set_webglcontextrestored_callback", {mock_pointer( target ), mock_pointer( userData ), static_cast<double>( useCapture ), mock_pointer( reinterpret_cast<void*>( callback ) )} );
+    browser().context_restored = callback;
+    browser().context_arg      = userData;
+    return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_get_current_context( void ) {
+    mock_record( "emscripten_webgl_get_current_context", {} );
+    return 1;
+}
+
+// Every extension is there, so the optional paths run too.
+EM_BOOL emscripten_webgl_enable_extension( EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context, const char* extension ) {
+    mock_record( "emscripten_webgl_enable_extension", {static_cast<double>( context ), mock_pointer( extension )} );
+    return 1;
+}
+
+int emscripten_vr_init( em_arg_callback_func callback, void* userData ) {
+    mock_record( "emscripten_vr_init", {mock_pointer( reinterpret_cast<void*>( callback ) ), mock_pointer( userData )} );
+    callback( userData );
+    return 1;
+}
+
+int emscripten_vr_ready( void ) {
+    mock_record( "emscripten_vr_ready", {} );
+    return 1;
+}
+
+int emscripten_vr_version_major( void ) {
+    mock_record( "emscripten_vr_version_major", {} );
+    return 1;
+}
+
+int emscripten_vr_version_minor( void ) {
+    mock_record( "emscripten_vr_version_minor", {} );
+    return 1;
+}
+
+int emscripten_vr_count_displays( void ) {
+    mock_record( "emscripten_vr_count_displays", {} );
+    return 1;
+}
+
+VRDisplayHandle emscripten_vr_get_display_handle( int displayIndex ) {
+    mock_record( "emscripten_vr_get_display_handle", {static_cast<double>( displayIndex )} );
+    return ( displayIndex == 0 ) ? DISPLAY : -1;
+}
+
+const char* emscripten_vr_get_display_name( VRDisplayHandle handle ) {
+    mock_record( "emscripten_vr_get_display_name", {static_cast<double>( handle )} );
+    return ( handle == DISPLAY ) ? "Mock HMD" : nullptr;
+}
+
+int emscripten_vr_get_display_capabilities( VRDisplayHandle handle, VRDisplayCapabilities* displayCaps ) {
+    mock_record( "emscripten_vr_get_display_capabilities", {static_cast<double>( handle ), mock_pointer( displayCaps )} );
+    if( handle != DISPLAY ) {
+        return 0;
+    }
+    displayCaps->hasPosition        = 1;
+    displayCaps->hasExternalDisplay = 1;
+    displayCaps->canPresent         = 1;
+    displayCaps->maxLayers          = 1;
+    return 1;
+}
+
+int emscripten_vr_get_eye_parameters( VRDisplayHandle handle, VREye whichEye, VREyeParameters* eyeParams ) {
+    mock_record( "emscripten_vr_get_eye_parameters", {static_cast<double>( handle ), static_cast<double>( whichEye ), mock_pointer( eyeParams )} );
+    if( handle != DISPLAY ) {
+        return 0;
+    }
+    eyeParams->offset.x     = ( whichEye == VREyeLeft ) ? -0.032f : 0.032f;
+    eyeParams->offset.y     = 0.0f;
+    eyeParams->offset.z     = 0.0f;
+    eyeParams->renderWidth  = EYE_WIDTH;
+    eyeParams->renderHeight = EYE_HEIGHT;
+    return 1;
+}
+
+int emscripten_vr_display_presenting( VRDisplayHandle handle ) {
+    mock_record( "emscripten_vr_display_presenting", {static_cast<double>( handle )} );
+    return ( handle == DISPLAY ) && browser().presenting;
+}
+
+int emscripten_vr_set_display_render_loop_arg( VRDisplayHandle handle, em_arg_callback_func callback, void* arg ) {
+    mock_record( "emscripten_vr_set_display_render_loop_arg", {static_cast<double>( handle ), mock_pointer( reinterpret_cast<void*>( callback ) ), mock_pointer( arg )} );
+    if( handle != DISPLAY ) {
+        return 0;
+    }
+    browser().render_loop     = callback;
+    browser().render_loop_arg = arg;
+    return 1;
+}
+
+int emscripten_vr_cancel_display_render_loop( VRDisplayHandle handle ) {
+    mock_record( "emscripten_vr_cancel_display_render_loop", {static_cast<double>( handle )} );
+    browser().render_loop = nullptr;
+    return handle == DISPLAY;
+}
+
+// Granted later, by mock_vr_grant_present(), as the browser would once the headset is ready.
+int emscripten_vr_request_present( VRDisplayHandle handle, VRLayerInit* layerInit, int layerCount, em_arg_callback_func callback, void* userData ) {
+    mock_record( "emscripten_vr_request_present", {static_cast<double>( handle ), mock_pointer( layerInit ), static_cast<double>( layerCount ), mock_pointer( reinterpret_cast<void*>( callback ) ), mock_pointer( userData )} );
+    if( handle != DISPLAY ) {
+        return 0;
+    }
+    browser().present_callback = callback;
+    browser().present_arg      = userData;
+    return 1;
+}
+
+int emscripten_vr_submit_frame( VRDisplayHandle handle ) {
+    mock_record( "emscripten_vr_submit_frame", {static_cast<double>( handle )} );
+    if( ( handle != DISPLAY ) || !browser().presenting ) {
+        return 0;
+    }
+    ++browser().frames_submitted;
+    return 1;
+}
+
+// The EM_JS functions of the app's sources.
+
+int get_canvas_client_width() {
+    mock_record( "get_canvas_client_width", {} );
+    return CANVAS_WIDTH;
+}
+
+int get_canvas_client_height() {
+    mock_record( "get_canvas_client_height", {} );
+    return CANVAS_HEIGHT;
+}
+
+void set_canvas_size( int width, int height ) {
+    mock_record( "set_canvas_size", {static_cast<double>( width ), static_cast<double>( height )} );
+}
+
+// Hands over a copy the app frees, as impl_get_vr_state() does from the JS heap.
+int get_vr_state( uint8_t** vr_state, int vr_display_handle ) {
+    mock_record( "get_vr_state", {mock_pointer( vr_state ), static_cast<double>( vr_display_handle )} );
+    const std::vector<uint8_t>& state = browser().vr_state;
+    if( state.empty() || ( vr_display_handle != DISPLAY ) ) {
+        *vr_state = nullptr;
+        return 0;
+    }
+    *vr_state = static_cast<uint8_t*>( malloc( state.size() ) );
+    memcpy( *vr_state, state.data(), state.size() );
+    return static_cast<int>( state.size() );
+}
+
+double get_vr_hmd_matrices( GLfloat* matrices, int vr_display_handle ) {
+    mock_record( "get_vr_hmd_matrices", {mock_pointer( matrices ), static_cast<double>( vr_display_handle )} );
+    if( ( browser().hmd_pose_ms < 0.0 ) || ( vr_display_handle != DISPLAY ) ) {
+        return -1.0;
+    }
+    memcpy( matrices, browser().hmd_matrices, sizeof( browser().hmd_matrices ) );
+    return browser().hmd_pose_ms;
+}
+
+void save_trace( const char* name, const char* data, int size ) {
+    mock_record( "save_trace", {mock_pointer( name ), mock_pointer( data ), static_cast<double>( size )} );
+}
+
+void save_scene_file( const char* name, const uint8_t* data, int size ) {
+    mock_record( "save_scene_file", {mock_pointer( name ), mock_pointer( data ), static_cast<double>( size )} );
+}
+
+// Every glyph is a block over the middle of its cell.
+int rasterize_glyphs( int first, int count, int size, uint8_t* coverage ) {
+    mock_record( "rasterize_glyphs", {static_cast<double>( first ), static_cast<double>( count ), static_cast<double>( size ), mock_pointer( coverage )} );
+    for( int glyph = 0; glyph < count; ++glyph ) {
+        uint8_t* cell = coverage + glyph * size * size;
+        for( int y = 0; y < size; ++y ) {
+            for( int x = 0; x < size; ++x ) {
+                const bool inside  = ( x >= size / 4 ) && ( x < 3 * size / 4 ) && ( y >= size / 4 ) && ( y < 3 * size / 4 );
+                cell[y * size + x] = inside ? 255 : 0;
+            }
+        }
+    }
+    return 3 * size / 5;
+}
+
+} // extern "C"
@@ -0,0 +1,875 @@
+#include "mock.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <ctype.h>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+    const int MAX_ATTRIBS = 16;
+
+    // The state that is part of a vertex array object, the default one included.
+    struct VertexArray {
+        GLuint element_buffer;
+        GLint  enabled[MAX_ATTRIBS];
+        GLuint buffers[MAX_ATTRIBS];
+        GLuint divisors[MAX_ATTRIBS];
+
+        VertexArray() {
+            element_buffer = 0;
+            memset( enabled, 0, sizeof( enabled ) );
+            memset( buffers, 0, sizeof( buffers ) );
+            memset( divisors, 0, sizeof( divisors ) );
+        }
+    };
+
+    struct Uniform {
+        GLint   i;
+        GLfloat f[4 * 4];
+    };
+
+    struct Program {
+        std::vector<GLuint>           shaders;
+        std::string                   source; // Of every shader attached when it was linked.
+        std::map<std::string, GLint>  uniforms;
+        std::map<std::string, GLuint> blocks;
+        std::map<GLint, Uniform>      values;
+    };
+
+    // What glBindBufferRange bound to an indexed binding point.
+    struct BufferRange {
+        GLuint     buffer;
+        GLintptr   offset;
+        GLsizeiptr size;
+    };
+
+    struct Mock {
+        std::vector<MockCall>   calls;
+        MockWork                work;
+        std::vector<MockObject> objects;
+        // Index into objects of each live object, by kind and name.
+        std::map<std::pair<int, GLuint>, size_t> live;
+        GLuint                                   next_name;
+
+        std::map<GLuint, std::string> shader_sources;
+        std::map<GLuint, Program>     programs;
+        std::map<GLuint, size_t>      buffer_sizes;
+        std::map<GLenum, GLuint>      buffer_bindings; // Of every target except GL_ELEMENT_ARRAY_BUFFER.
+        std::map<GLuint, BufferRange> uniform_ranges;
+        std::map<GLuint, VertexArray> vertex_arrays;
+        GLuint                        vertex_array;
+        GLuint                        draw_framebuffer;
+        GLuint                        read_framebuffer;
+        GLuint                        program;
+        std::set<GLenum>              enabled;
+        GLint                         viewport[4];
+        GLint                         scissor[4];
+        GLenum                        blend_source;
+        GLenum                        blend_destination;
+        GLenum                        depth_func;
+        GLboolean                     depth_mask;
+        GLboolean                     color_mask[4];
+
+        Mock() {
+            reset();
+        }
+
+        void reset() {
+            calls.clear();
+            work = MockWork();
+            objects.clear();
+            live.clear();
+            next_name = 1;
+            shader_sources.clear();
+            programs.clear();
+            buffer_sizes.clear();
+            buffer_bindings.clear();
+            uniform_ranges.clear();
+            vertex_arrays.clear();
+            vertex_arrays[0] = VertexArray();
+            vertex_array     = 0;
+            draw_framebuffer = 0;
+            read_framebuffer = 0;
+            program          = 0;
+            enabled.clear();
+            enabled.insert( GL_DITHER );
+            memset( viewport, 0, sizeof( viewport ) );
+            memset( scissor, 0, sizeof( scissor ) );
+            blend_source      = GL_ONE;
+            blend_destination = GL_ZERO;
+            depth_func        = GL_LESS;
+            depth_mask        = GL_TRUE;
+            for( int i = 0; i < 4; ++i ) {
+                color_mask[i] = GL_TRUE;
+            }
+        }
+
+        // Names are unique across kinds, so a name passed as the wrong kind of object isn't found.
+        GLuint create( MockObjectKind kind ) {
+            const GLuint     name   = next_name++;
+            const MockObject object = {kind, name, false};
+            live[std::make_pair( static_cast<int>( kind ), name )] = objects.size();
+            objects.push_back( object );
+            ++work.objects_created;
+            return name;
+        }
+
+        bool destroy( MockObjectKind kind, GLuint name ) {
+            auto found = live.find( std::make_pair( static_cast<int>( kind ), name ) );
+            if( found == live.end() ) {
+                return false;
+            }
+            objects[found->second].deleted = true;
+            live.erase( found );
+            return true;
+        }
+
+        VertexArray& bound_vertex_array() {
+            return vertex_arrays[vertex_array];
+        }
+
+        Uniform* uniform( GLint location ) {
+            auto found = programs.find( program );
+            if( ( location < 0 ) || ( found == programs.end() ) ) {
+                return nullptr;
+            }
+            Uniform& value = found->second.values[location];
+            return &value;
+        }
+    };
+
+    Mock& mock() {
+        static Mock instance;
+        return instance;
+    }
+
+    // Whether name appears in the source as a whole word.
+    bool source_declares( const std::string& source, const char* name ) {
+        const size_t length = strlen( name );
+        for( size_t at = source.find( name ); at != std::string::npos; at = source.find( name, at + 1 ) ) {
+            const char before = at ? source[at - 1] : ' ';
+            const char after  = ( at + length < source.size() ) ? source[at + length] : ' ';
+            if( !isalnum( before ) && ( before != '_' ) && !isalnum( after ) && ( after != '_' ) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t component_bytes( GLenum type ) {
+        switch( type ) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE: return 1;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT: return 2;
+        default: return 4;
+        }
+    }
+
+    size_t format_components( GLenum format ) {
+        switch( format ) {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_ALPHA:
+        case GL_LUMINANCE: return 1;
+        case GL_RG:
+        case GL_RG_INTEGER: return 2;
+        case GL_RGB:
+        case GL_RGB_INTEGER: return 3;
+        default: return 4;
+        }
+    }
+
+    void gen( MockObjectKind kind, const char* call, GLsizei n, GLuint* names ) {
+        mock_record( call, {static_cast<double>( n ), mock_pointer( names )} );
+        for( GLsizei i = 0; i < n; ++i ) {
+            names[i] = mock().create( kind );
+        }
+    }
+
+    void unbind_buffer( GLuint buffer ) {
+        Mock& m = mock();
+        for( auto& binding : m.buffer_bindings ) {
+            if( binding.second == buffer ) {
+                binding.second = 0;
+            }
+        }
+        for( auto& range : m.uniform_ranges ) {
+            if( range.second.buffer == buffer ) {
+                range.second.buffer = 0;
+                range.second.offset = 0;
+                range.second.size   = 0;
+            }
+        }
+        // Only the bound vertex array lets go of it, as in GL.
+        VertexArray& array = m.bound_vertex_array();
+        if( array.element_buffer == buffer ) {
+            array.element_buffer = 0;
+        }
+        for( int i = 0; i < MAX_ATTRIBS; ++i ) {
+            if( array.buffers[i] == buffer ) {
+                array.buffers[i] = 0;
+            }
+        }
+    }
+
+    void remove( MockObjectKind kind, const char* call, GLsizei n, const GLuint* names ) {
+        mock_record( call, {static_cast<double>( n ), mock_pointer( names )} );
+        Mock& m = mock();
+        for( GLsizei i = 0; i < n; ++i ) {
+            // Zero and names never made are silently ignored.
+            if( !names[i] || !m.destroy( kind, names[i] ) ) {
+                continue;
+            }
+            if( kind == MOCK_BUFFER ) {
+                unbind_buffer( names[i] );
+                m.buffer_sizes.erase( names[i] );
+            } else if( kind == MOCK_VERTEX_ARRAY ) {
+                if( m.vertex_array == names[i] ) {
+                    m.vertex_array = 0;
+                }
+                m.vertex_arrays.erase( names[i] );
+            } else if( kind == MOCK_FRAMEBUFFER ) {
+                if( m.draw_framebuffer == names[i] ) {
+                    m.draw_framebuffer = 0;
+                }
+                if( m.read_framebuffer == names[i] ) {
+                    m.read_framebuffer = 0;
+                }
+            }
+        }
+    }
+
+    void upload( size_t bytes ) {
+        mock().work.bytes_uploaded += bytes;
+    }
+
+    void draw() {
+        ++mock().work.draw_calls;
+    }
+}
+
+MockWork::MockWork()
+    : calls( 0 )
+    , draw_calls( 0 )
+    , objects_created( 0 )
+    , bytes_uploaded( 0 ) {
+}
+
+void mock_reset() {
+    mock().reset();
+}
+
+void mock_begin_frame() {
+    mock().calls.clear();
+    mock().work = MockWork();
+}
+
+const MockWork& mock_work() {
+    return mock().work;
+}
+
+const std::vector<MockCall>& mock_calls() {
+    return mock().calls;
+}
+
+unsigned int mock_count_calls( const char* name ) {
+    unsigned int count = 0;
+    for( const MockCall& call : mock().calls ) {
+        count += ( call.name == name );
+    }
+    return count;
+}
+
+const std::vector<MockObject>& mock_objects() {
+    return mock().objects;
+}
+
+size_t mock_live_objects( MockObjectKind kind ) {
+    size_t count = 0;
+    for( const auto& object : mock().live ) {
+        count += ( object.first.first == kind );
+    }
+    return count;
+}
+
+size_t mock_buffer_size( GLuint buffer ) {
+    auto found = mock().buffer_sizes.find( buffer );
+    return ( found != mock().buffer_sizes.end() ) ? found->second : 0;
+}
+
+void print_mock_calls() {
+    for( const MockCall& call : mock().calls ) {
+        printf( "  %s(", call.name.c_str() );
+        for( size_t i = 0; i < call.args.size(); ++i ) {
+            printf( "%s%.9g", i ? ", " : " ", call.args[i] );
+        }
+        printf( "%s)\n", call.args.empty() ? "" : " " );
+    }
+}
+
+void mock_record( const char* name, std::initializer_list<double> args ) {
+    MockCall call;
+    call.name = name;
+    call.args.assign( args.begin(), args.end() );
+    mock().calls.push_back( call );
+    ++mock().work.calls;
+}
+
+double mock_pointer( const void* pointer ) {
+    return static_cast<double>( reinterpret_cast<uintptr_t>( pointer ) );
+}
+
+extern "C" {
+
+// EGL, of which the app only sets up the one display, surface and context.
+
+EGLDisplay eglGetDisplay( EGLNativeDisplayType display_id ) {
+    mock_record( "eglGetDisplay", {mock_pointer( reinterpret_cast<const void*>( display_id ) )} );
+    return reinterpret_cast<EGLDisplay>( 1 );
+}
+
+EGLBoolean eglInitialize( EGLDisplay dpy, EGLint* major, EGLint* minor ) {
+    mock_record( "eglInitialize", {mock_pointer( dpy ), mock_pointer( major ), mock_pointer( minor )} );
+    *major = 1;
+    *minor = 4;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglGetConfigs( EGLDisplay dpy, EGLConfig* configs, EGLint config_size, EGLint* num_config ) {
+    mock_record( "eglGetConfigs", {mock_pointer( dpy ), mock_pointer( configs ), static_cast<double>( config_size ), mock_pointer( num_config )} );
+    if( configs && ( config_size > 0 ) ) {
+        configs[0] = reinterpret_cast<EGLConfig>( 1 );
+    }
+    *num_config = 1;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglChooseConfig( EGLDisplay dpy, const EGLint* attrib_list, EGLConfig* configs, EGLint config_size, EGLint* num_config ) {
+    mock_record( "eglChooseConfig", {mock_pointer( dpy ), mock_pointer( attrib_list ), mock_pointer( configs ), static_cast<double>( config_size ), mock_pointer( num_config )} );
+    return eglGetConfigs( dpy, configs, config_size, num_config );
+}
+
+EGLBoolean eglGetConfigAttrib( EGLDisplay dpy, EGLConfig config, EGLint attribute, EGLint* value ) {
+    mock_record( "eglGetConfigAttrib", {mock_pointer( dpy ), mock_pointer( config ), static_cast<double>( attribute ), mock_pointer( value )} );
+    *value = 0;
+    return EGL_TRUE;
+}
+
+EGLSurface eglCreateWindowSurface( EGLDisplay dpy, EGLConfig config, EGLNativeWindowType win, const EGLint* attrib_list ) {
+    mock_record( "eglCreateWindowSurface", {mock_pointer( dpy ), mock_pointer( config ), mock_pointer( reinterpret_cast<const void*>( win ) ), mock_pointer( attrib_list )} );
+    return reinterpret_cast<EGLSurface>( 1 );
+}
+
+EGLContext eglCreateContext( EGLDisplay dpy, EGLConfig config, EGLContext share_context, const EGLint* attrib_list ) {
+    mock_record( "eglCreateContext", {mock_pointer( dpy ), mock_pointer( config ), mock_pointer( share_context ), mock_pointer( attrib_list )} );
+    return reinterpret_cast<EGLContext>( 1 );
+}
+
+EGLBoolean eglMakeCurrent( EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx ) {
+    mock_record( "eglMakeCurrent", {mock_pointer( dpy ), mock_pointer( draw ), mock_pointer( read ), mock_pointer( ctx )} );
+    return EGL_TRUE;
+}
+
+EGLBoolean eglSwapBuffers( EGLDisplay dpy, EGLSurface surface ) {
+    mock_record( "eglSwapBuffers", {mock_pointer( dpy ), mock_pointer( surface )} );
+    return EGL_TRUE;
+}
+
+EGLint eglGetError( void ) {
+    mock_record( "eglGetError", {} );
+    return EGL_SUCCESS;
+}
+
+// Shaders and programs, which always compile and link. Attribute locations are read from the layout
+// qualifiers of the sources, and only names the sources mention have uniform locations.
+
+GLuint glCreateShader( GLenum type ) {
+    mock_record( "glCreateShader", {static_cast<double>( type )} );
+    return mock().create( MOCK_SHADER );
+}
+
+void glShaderSource( GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length ) {
+    mock_record( "glShaderSource", {static_cast<double>( shader ), static_cast<double>( count ), mock_pointer( string ), mock_pointer( length )} );
+    std::string& source = mock().shader_sources[shader];
+    source.clear();
+    for( GLsizei i = 0; i < count; ++i ) {
+        source.append( string[i], ( length && ( length[i] >= 0 ) ) ? length[i] : strlen( string[i] ) );
+    }
+}
+
+void glCompileShader( GLuint shader ) {
+    mock_record( "glCompileShader", {static_cast<double>( shader )} );
+}
+
+void glGetShaderiv( GLuint shader, GLenum pname, GLint* params ) {
+    mock_record( "glGetShaderiv", {static_cast<double>( shader ), static_cast<double>( pname ), mock_pointer( params )} );
+    *params = ( pname == GL_COMPILE_STATUS ) ? GL_TRUE : 0;
+}
+
+void glGetShaderInfoLog( GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog ) {
+    mock_record( "glGetShaderInfoLog", {static_cast<double>( shader ), static_cast<double>( bufSize ), mock_pointer( length ), mock_pointer( infoLog )} );
+    if( length ) {
+        *length = 0;
+    }
+    if( bufSize > 0 ) {
+        infoLog[0] = '\0';
+    }
+}
+
+void glDeleteShader( GLuint shader ) {
+    mock_record( "glDeleteShader", {static_cast<double>( shader )} );
+    mock().destroy( MOCK_SHADER, shader );
+}
+
+GLuint glCreateProgram( void ) {
+    mock_record( "glCreateProgram", {} );
+    const GLuint program    = mock().create( MOCK_PROGRAM );
+    mock().programs[program] = Program();
+    return program;
+}
+
+void glAttachShader( GLuint program, GLuint shader ) {
+    mock_record( "glAttachShader", {static_cast<double>( program ), static_cast<double>( shader )} );
+    mock().programs[program].shaders.push_back( shader );
+}
+
+void glLinkProgram( GLuint program ) {
+    mock_record( "glLinkProgram", {static_cast<double>( program )} );
+    Program& linked = mock().programs[program];
+    linked.source.clear();
+    for( GLuint shader : linked.shaders ) {
+        linked.source += mock().shader_sources[shader];
+    }
+}
+
+void glGetProgramiv( GLuint program, GLenum pname, GLint* params ) {
+    mock_record( "glGetProgramiv", {static_cast<double>( program ), static_cast<double>( pname ), mock_pointer( params )} );
+    *params = ( pname == GL_LINK_STATUS ) ? GL_TRUE : 0;
+}
+
+void glDeleteProgram( GLuint program ) {
+    mock_record( "glDeleteProgram", {static_cast<double>( program )} );
+    if( mock().destroy( MOCK_PROGRAM, program ) ) {
+        mock().programs.erase( program );
+    }
+}
+
+void glUseProgram( GLuint program ) {
+    mock_record( "glUseProgram", {static_cast<double>( program )} );
+    mock().program = program;
+}
+
+GLint glGetAttribLocation( GLuint program, const GLchar* name ) {
+    mock_record( "glGetAttribLocation", {static_cast<double>( program ), mock_pointer( name )} );
+    const std::string& source = mock().programs[program].source;
+    for( size_t at = source.find( "location" ); at != std::string::npos; at = source.find( "location", at + 1 ) ) {
+        const size_t end = source.find( ';', at );
+        int          location;
+        if( ( end != std::string::npos ) && ( sscanf( source.c_str() + at, "location = %d", &location ) == 1 ) &&
+            source_declares( source.substr( at, end - at ), name ) ) {
+            return location;
+        }
+    }
+    return -1;
+}
+
+GLint glGetUniformLocation( GLuint program, const GLchar* name ) {
+    mock_record( "glGetUniformLocation", {static_cast<double>( program ), mock_pointer( name )} );
+    Program& found = mock().programs[program];
+    if( !source_declares( found.source, name ) ) {
+        return -1;
+    }
+    auto inserted = found.uniforms.insert( std::make_pair( std::string( name ), static_cast<GLint>( found.uniforms.size() ) ) );
+    return inserted.first->second;
+}
+
+GLuint glGetUniformBlockIndex( GLuint program, const GLchar* uniformBlockName ) {
+    mock_record( "glGetUniformBlockIndex", {static_cast<double>( program ), mock_pointer( uniformBlockName )} );
+    Program& found = mock().programs[program];
+    if( !source_declares( found.source, uniformBlockName ) ) {
+        return GL_INVALID_INDEX;
+    }
+    auto inserted = found.blocks.insert( std::make_pair( std::string( uniformBlockName ), static_cast<GLuint>( found.blocks.size() ) ) );
+    return inserted.first->second;
+}
+
+void glUniformBlockBinding( GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding ) {
+    mock_record( "glUniformBlockBinding", {static_cast<double>( program ), static_cast<double>( uniformBlockIndex ), static_cast<double>( uniformBlockBinding )} );
+}
+
+void glUniform1i( GLint location, GLint v0 ) {
+    mock_record( "glUniform1i", {static_cast<double>( location ), static_cast<double>( v0 )} );
+    if( Uniform* uniform = mock().uniform( location ) ) {
+        uniform->i = v0;
+    }
+}
+
+void glUniform1f( GLint location, GLfloat v0 ) {
+    mock_record( "glUniform1f", {static_cast<double>( location ), v0} );
+    if( Uniform* uniform = mock().uniform( location ) ) {
+        uniform->f[0] = v0;
+    }
+}
+
+void glUniform4f( GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3 ) {
+    mock_record( "glUniform4f", {static_cast<double>( location ), v0, v1, v2, v3} );
+    if( Uniform* uniform = mock().uniform( location ) ) {
+        const GLfloat values[4] = {v0, v1, v2, v3};
+        memcpy( uniform->f, values, sizeof( values ) );
+    }
+}
+
+void glUniformMatrix4fv( GLint location, GLsizei count, GLboolean transpose, const GLfloat* value ) {
+    mock_record( "glUniformMatrix4fv", {static_cast<double>( location ), static_cast<double>( count ), static_cast<double>( transpose ), mock_pointer( value )} );
+    if( Uniform* uniform = mock().uniform( location ) ) {
+        for( int i = 0; i < 4 * 4; ++i ) {
+            uniform->f[i] = transpose ? value[4 * ( i % 4 ) + i / 4] : value[i];
+        }
+    }
+}
+
+void glGetUniformiv( GLuint program, GLint location, GLint* params ) {
+    mock_record( "glGetUniformiv", {static_cast<double>( program ), static_cast<double>( location ), mock_pointer( params )} );
+    *params = mock().programs[program].values[location].i;
+}
+
+void glGetUniformfv( GLuint program, GLint location, GLfloat* params ) {
+    mock_record( "glGetUniformfv", {static_cast<double>( program ), static_cast<double>( location ), mock_pointer( params )} );
+    memcpy( params, mock().programs[program].values[location].f, sizeof( Uniform::f ) );
+}
+
+// Buffers and vertex arrays.
+
+void glGenBuffers( GLsizei n, GLuint* buffers ) {
+    gen( MOCK_BUFFER, "glGenBuffers", n, buffers );
+}
+
+void glDeleteBuffers( GLsizei n, const GLuint* buffers ) {
+    remove( MOCK_BUFFER, "glDeleteBuffers", n, buffers );
+}
+
+void glBindBuffer( GLenum target, GLuint buffer ) {
+    mock_record( "glBindBuffer", {static_cast<double>( target ), static_cast<double>( buffer )} );
+    if( target == GL_ELEMENT_ARRAY_BUFFER ) {
+        mock().bound_vertex_array().element_buffer = buffer;
+    } else {
+        mock().buffer_bindings[target] = buffer;
+    }
+}
+
+void glBindBufferRange( GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size ) {
+    mock_record( "glBindBufferRange", {static_cast<double>( target ), static_cast<double>( index ), static_cast<double>( buffer ), static_cast<double>( offset ), static_cast<double>( size )} );
+    // Also binds the buffer to the generic binding point.
+    mock().buffer_bindings[target] = buffer;
+    if( target == GL_UNIFORM_BUFFER ) {
+        const BufferRange range      = {buffer, offset, size};
+        mock().uniform_ranges[index] = range;
+    }
+}
+
+void glBufferData( GLenum target, GLsizeiptr size, const void* data, GLenum usage ) {
+    mock_record( "glBufferData", {static_cast<double>( target ), static_cast<double>( size ), mock_pointer( data ), static_cast<double>( usage )} );
+    const GLuint buffer = ( target == GL_ELEMENT_ARRAY_BUFFER ) ? mock().bound_vertex_array().element_buffer : mock().buffer_bindings[target];
+    mock().buffer_sizes[buffer] = size;
+    if( data ) {
+        upload( size );
+    }
+}
+
+void glBufferSubData( GLenum target, GLintptr offset, GLsizeiptr size, const void* data ) {
+    mock_record( "glBufferSubData", {static_cast<double>( target ), static_cast<double>( offset ), static_cast<double>( size ), mock_pointer( data )} );
+    upload( size );
+}
+
+void glGenVertexArrays( GLsizei n, GLuint* arrays ) {
+    gen( MOCK_VERTEX_ARRAY, "glGenVertexArrays", n, arrays );
+}
+
+void glDeleteVertexArrays( GLsizei n, const GLuint* arrays ) {
+    remove( MOCK_VERTEX_ARRAY, "glDeleteVertexArrays", n, arrays );
+}
+
+void glBindVertexArray( GLuint array ) {
+    mock_record( "glBindVertexArray", {static_cast<double>( array )} );
+    mock().vertex_array = array;
+}
+
+void glEnableVertexAttribArray( GLuint index ) {
+    mock_record( "glEnableVertexAttribArray", {static_cast<double>( index )} );
+    mock().bound_vertex_array().enabled[index % MAX_ATTRIBS] = 1;
+}
+
+void glDisableVertexAttribArray( GLuint index ) {
+    mock_record( "glDisableVertexAttribArray", {static_cast<double>( index )} );
+    mock().bound_vertex_array().enabled[index % MAX_ATTRIBS] = 0;
+}
+
+void glVertexAttribPointer( GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer ) {
+    mock_record( "glVertexAttribPointer", {static_cast<double>( index ), static_cast<double>( size ), static_cast<double>( type ), static_cast<double>( normalized ), static_cast<double>( stride ), mock_pointer( pointer )} );
+    mock().bound_vertex_array().buffers[index % MAX_ATTRIBS] = mock().buffer_bindings[GL_ARRAY_BUFFER];
+}
+
+void glVertexAttribDivisor( GLuint index, GLuint divisor ) {
+    mock_record( "glVertexAttribDivisor", {static_cast<double>( index ), static_cast<double>( divisor )} );
+    mock().bound_vertex_array().divisors[index % MAX_ATTRIBS] = divisor;
+}
+
+void glGetVertexAttribiv( GLuint index, GLenum pname, GLint* params ) {
+    mock_record( "glGetVertexAttribiv", {static_cast<double>( index ), static_cast<double>( pname ), mock_pointer( params )} );
+    const VertexArray& array = mock().bound_vertex_array();
+    switch( pname ) {
+    case GL_VERTEX_ATTRIB_ARRAY_ENABLED: *params = array.enabled[index % MAX_ATTRIBS]; break;
+    case GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING: *params = array.buffers[index % MAX_ATTRIBS]; break;
+    case GL_VERTEX_ATTRIB_ARRAY_DIVISOR: *params = array.divisors[index % MAX_ATTRIBS]; break;
+    default: *params = 0; break;
+    }
+}
+
+// Textures, framebuffers and renderbuffers.
+
+void glGenTextures( GLsizei n, GLuint* textures ) {
+    gen( MOCK_TEXTURE, "glGenTextures", n, textures );
+}
+
+void glDeleteTextures( GLsizei n, const GLuint* textures ) {
+    remove( MOCK_TEXTURE, "glDeleteTextures", n, textures );
+}
+
+void glActiveTexture( GLenum texture ) {
+    mock_record( "glActiveTexture", {static_cast<double>( texture )} );
+}
+
+void glBindTexture( GLenum target, GLuint texture ) {
+    mock_record( "glBindTexture", {static_cast<double>( target ), static_cast<double>( texture )} );
+}
+
+void glTexParameteri( GLenum target, GLenum pname, GLint param ) {
+    mock_record( "glTexParameteri", {static_cast<double>( target ), static_cast<double>( pname ), static_cast<double>( param )} );
+}
+
+void glTexStorage2D( GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height ) {
+    mock_record( "glTexStorage2D", {static_cast<double>( target ), static_cast<double>( levels ), static_cast<double>( internalformat ), static_cast<double>( width ), static_cast<double>( height )} );
+}
+
+void glTexSubImage2D( GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels ) {
+    mock_record( "glTexSubImage2D", {static_cast<double>( target ), static_cast<double>( level ), static_cast<double>( xoffset ), static_cast<double>( yoffset ), static_cast<double>( width ), static_cast<double>( height ), static_cast<double>( format ), static_cast<double>( type ), mock_pointer( pixels )} );
+    upload( static_cast<size_t>( width ) * height * format_components( format ) * component_bytes( type ) );
+}
+
+void glCompressedTexSubImage2D( GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data ) {
+    mock_record( "glCompressedTexSubImage2D", {static_cast<double>( target ), static_cast<double>( level ), static_cast<double>( xoffset ), static_cast<double>( yoffset ), static_cast<double>( width ), static_cast<double>( height ), static_cast<double>( format ), static_cast<double>( imageSize ), mock_pointer( data )} );
+    upload( imageSize );
+}
+
+void glGenFramebuffers( GLsizei n, GLuint* framebuffers ) {
+    gen( MOCK_FRAMEBUFFER, "glGenFramebuffers", n, framebuffers );
+}
+
+void glDeleteFramebuffers( GLsizei n, const GLuint* framebuffers ) {
+    remove( MOCK_FRAMEBUFFER, "glDeleteFramebuffers", n, framebuffers );
+}
+
+void glBindFramebuffer( GLenum target, GLuint framebuffer ) {
+    mock_record( "glBindFramebuffer", {static_cast<double>( target ), static_cast<double>( framebuffer )} );
+    if( target != GL_READ_FRAMEBUFFER ) {
+        mock().draw_framebuffer = framebuffer;
+    }
+    if( target != GL_DRAW_FRAMEBUFFER ) {
+        mock().read_framebuffer = framebuffer;
+    }
+}
+
+void glFramebufferTexture2D( GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level ) {
+    mock_record( "glFramebufferTexture2D", {static_cast<double>( target ), static_cast<double>( attachment ), static_cast<double>( textarget ), static_cast<double>( texture ), static_cast<double>( level )} );
+}
+
+void glFramebufferRenderbuffer( GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer ) {
+    mock_record( "glFramebufferRenderbuffer", {static_cast<double>( target ), static_cast<double>( attachment ), static_cast<double>( renderbuffertarget ), static_cast<double>( renderbuffer )} );
+}
+
+GLenum glCheckFramebufferStatus( GLenum target ) {
+    mock_record( "glCheckFramebufferStatus", {static_cast<double>( target )} );
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+void glInvalidateFramebuffer( GLenum target, GLsizei numAttachments, const GLenum* attachments ) {
+    mock_record( "glInvalidateFramebuffer", {static_cast<double>( target ), static_cast<double>( numAttachments ), mock_pointer( attachments )} );
+}
+
+void glBlitFramebuffer( GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter ) {
+    mock_record( "glBlitFramebuffer", {static_cast<double>( srcX0 ), static_cast<double>( srcY0 ), static_cast<double>( srcX1 ), static_cast<double>( srcY1 ), static_cast<double>( dstX0 ), static_cast<double>( dstY0 ), static_cast<double>( dstX1 ), static_cast<double>( dstY1 ), static_cast<double>( mask ), static_cast<double>( filter )} );
+}
+
+void glGenRenderbuffers( GLsizei n, GLuint* renderbuffers ) {
+    gen( MOCK_RENDERBUFFER, "glGenRenderbuffers", n, renderbuffers );
+}
+
+void glDeleteRenderbuffers( GLsizei n, const GLuint* renderbuffers ) {
+    remove( MOCK_RENDERBUFFER, "glDeleteRenderbuffers", n, renderbuffers );
+}
+
+void glBindRenderbuffer( GLenum target, GLuint renderbuffer ) {
+    mock_record( "glBindRenderbuffer", {static_cast<double>( target ), static_cast<double>( renderbuffer )} );
+}
+
+void glRenderbufferStorageMultisample( GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height ) {
+    mock_record( "glRenderbufferStorageMultisample", {static_cast<double>( target ), static_cast<double>( samples ), static_cast<double>( internalformat ), static_cast<double>( width ), static_cast<double>( height )} );
+}
+
+// Queries, whose results are always available and a millisecond long.
+
+void glGenQueries( GLsizei n, GLuint* ids ) {
+    gen( MOCK_QUERY, "glGenQueries", n, ids );
+}
+
+void glDeleteQueries( GLsizei n, const GLuint* ids ) {
+    remove( MOCK_QUERY, "glDeleteQueries", n, ids );
+}
+
+void glBeginQuery( GLenum target, GLuint id ) {
+    mock_record( "glBeginQuery", {static_cast<double>( target ), static_cast<double>( id )} );
+}
+
+void glEndQuery( GLenum target ) {
+    mock_record( "glEndQuery", {static_cast<double>( target )} );
+}
+
+void glGetQueryObjectuiv( GLuint id, GLenum pname, GLuint* params ) {
+    mock_record( "glGetQueryObjectuiv", {static_cast<double>( id ), static_cast<double>( pname ), mock_pointer( params )} );
+    *params = ( pname == GL_QUERY_RESULT_AVAILABLE ) ? GL_TRUE : 1000000;
+}
+
+// Fixed function state.
+
+void glEnable( GLenum cap ) {
+    mock_record( "glEnable", {static_cast<double>( cap )} );
+    mock().enabled.insert( cap );
+}
+
+void glDisable( GLenum cap ) {
+    mock_record( "glDisable", {static_cast<double>( cap )} );
+    mock().enabled.erase( cap );
+}
+
+GLboolean glIsEnabled( GLenum cap ) {
+    mock_record( "glIsEnabled", {static_cast<double>( cap )} );
+    return mock().enabled.count( cap ) ? GL_TRUE : GL_FALSE;
+}
+
+void glViewport( GLint x, GLint y, GLsizei width, GLsizei height ) {
+    mock_record( "glViewport", {static_cast<double>( x ), static_cast<double>( y ), static_cast<double>( width ), static_cast<double>( height )} );
+    const GLint viewport[4] = {x, y, width, height};
+    memcpy( mock().viewport, viewport, sizeof( viewport ) );
+}
+
+void glScissor( GLint x, GLint y, GLsizei width, GLsizei height ) {
+    mock_record( "glScissor", {static_cast<double>( x ), static_cast<double>( y ), static_cast<double>( width ), static_cast<double>( height )} );
+    const GLint scissor[4] = {x, y, width, height};
+    memcpy( mock().scissor, scissor, sizeof( scissor ) );
+}
+
+void glBlendFunc( GLenum sfactor, GLenum dfactor ) {
+    mock_record( "glBlendFunc", {static_cast<double>( sfactor ), static_cast<double>( dfactor )} );
+    mock().blend_source      = sfactor;
+    mock().blend_destination = dfactor;
+}
+
+void glDepthFunc( GLenum func ) {
+    mock_record( "glDepthFunc", {static_cast<double>( func )} );
+    mock().depth_func = func;
+}
+
+void glDepthMask( GLboolean flag ) {
+    mock_record( "glDepthMask", {static_cast<double>( flag )} );
+    mock().depth_mask = flag;
+}
+
+void glColorMask( GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha ) {
+    mock_record( "glColorMask", {static_cast<double>( red ), static_cast<double>( green ), static_cast<double>( blue ), static_cast<double>( alpha )} );
+    const GLboolean mask[4] = {red, green, blue, alpha};
+    memcpy( mock().color_mask, mask, sizeof( mask ) );
+}
+
+void glClear( GLbitfield mask ) {
+    mock_record( "glClear", {static_cast<double>( mask )} );
+}
+
+void glGetBooleanv( GLenum pname, GLboolean* data ) {
+    mock_record( "glGetBooleanv", {static_cast<double>( pname ), mock_pointer( data )} );
+    if( pname == GL_DEPTH_WRITEMASK ) {
+        *data = mock().depth_mask;
+    } else if( pname == GL_COLOR_WRITEMASK ) {
+        memcpy( data, mock().color_mask, sizeof( mock().color_mask ) );
+    } else {
+        *data = GL_FALSE;
+    }
+}
+
+void glGetIntegerv( GLenum pname, GLint* data ) {
+    mock_record( "glGetIntegerv", {static_cast<double>( pname ), mock_pointer( data )} );
+    Mock& m = mock();
+    switch( pname ) {
+    case GL_VIEWPORT: memcpy( data, m.viewport, sizeof( m.viewport ) ); break;
+    case GL_SCISSOR_BOX: memcpy( data, m.scissor, sizeof( m.scissor ) ); break;
+    case GL_FRAMEBUFFER_BINDING: *data = m.draw_framebuffer; break;
+    case GL_READ_FRAMEBUFFER_BINDING: *data = m.read_framebuffer; break;
+    case GL_CURRENT_PROGRAM: *data = m.program; break;
+    case GL_VERTEX_ARRAY_BINDING: *data = m.vertex_array; break;
+    case GL_ELEMENT_ARRAY_BUFFER_BINDING: *data = m.bound_vertex_array().element_buffer; break;
+    case GL_ARRAY_BUFFER_BINDING: *data = m.buffer_bindings[GL_ARRAY_BUFFER]; break;
+    case GL_UNIFORM_BUFFER_BINDING: *data = m.buffer_bindings[GL_UNIFORM_BUFFER]; break;
+    case GL_COPY_READ_BUFFER_BINDING: *data = m.buffer_bindings[GL_COPY_READ_BUFFER]; break;
+    case GL_COPY_WRITE_BUFFER_BINDING: *data = m.buffer_bindings[GL_COPY_WRITE_BUFFER]; break;
+    case GL_PIXEL_PACK_BUFFER_BINDING: *data = m.buffer_bindings[GL_PIXEL_PACK_BUFFER]; break;
+    case GL_PIXEL_UNPACK_BUFFER_BINDING: *data = m.buffer_bindings[GL_PIXEL_UNPACK_BUFFER]; break;
+    case GL_TRANSFORM_FEEDBACK_BUFFER_BINDING: *data = m.buffer_bindings[GL_TRANSFORM_FEEDBACK_BUFFER]; break;
+    case GL_BLEND_SRC_RGB: *data = m.blend_source; break;
+    case GL_BLEND_DST_RGB: *data = m.blend_destination; break;
+    case GL_DEPTH_FUNC: *data = m.depth_func; break;
+    // What WebGL 2 typically reports.
+    case GL_MAX_SAMPLES: *data = 4; break;
+    case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: *data = 256; break;
+    case GL_MAX_TEXTURE_SIZE: *data = 4096; break;
+    default: *data = 0; break;
+    }
+}
+
+void glGetIntegeri_v( GLenum target, GLuint index, GLint* data ) {
+    mock_record( "glGetIntegeri_v", {static_cast<double>( target ), static_cast<double>( index ), mock_pointer( data )} );
+    *data = ( target == GL_UNIFORM_BUFFER_BINDING ) ? mock().uniform_ranges[index].buffer : 0;
+}
+
+void glGetInteger64i_v( GLenum target, GLuint index, GLint64* data ) {
+    mock_record( "glGetInteger64i_v", {static_cast<double>( target ), static_cast<double>( index ), mock_pointer( data )} );
+    const BufferRange& range = mock().uniform_ranges[index];
+    *data                    = ( target == GL_UNIFORM_BUFFER_START ) ? range.offset : ( target == GL_UNIFORM_BUFFER_SIZE ) ? range.size : 0;
+}
+
+// Draws, only counted.
+
+void glDrawArrays( GLenum mode, GLint first, GLsizei count ) {
+    mock_record( "glDrawArrays", {static_cast<double>( mode ), static_cast<double>( first ), static_cast<double>( count )} );
+    draw();
+}
+
+void glDrawArraysInstanced( GLenum mode, GLint first, GLsizei count, GLsizei instancecount ) {
+    mock_record( "glDrawArraysInstanced", {static_cast<double>( mode ), static_cast<double>( first ), static_cast<double>( count ), static_cast<double>( instancecount )} );
+    draw();
+}
+
+void glDrawElements( GLenum mode, GLsizei count, GLenum type, const void* indices ) {
+    mock_record( "glDrawElements", {static_cast<double>( mode ), static_cast<double>( count ), static_cast<double>( type ), mock_pointer( indices )} );
+    draw();
+}
+
+void glDrawElementsInstanced( GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount ) {
+    mock_record( "glDrawElementsInstanced", {static_cast<double>( mode ), static_cast<double>( count ), static_cast<double>( type ), mock_pointer( indices ), static_cast<double>( instancecount )} );
+    draw();
+}
+
+} // extern "C"
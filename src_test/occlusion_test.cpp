@@ -0,0 +1,334 @@
+// Checks OcclusionCuller against a brute force answer over fixed scenes of occluders and boxes, for both
+// eyes of a headset. The brute force casts a ray from the eye through every sample of a grid finer than the
+// occlusion buffer, and an eye sees a box if any ray enters the box before it hits an occluder. The culler
+// may keep more than that, but must never drop a box for an eye that sees it.
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "bvh.h"
+#include "camera.h"
+#include "frustum.h"
+#include "occlusion.h"
+#include "scene.h"
+#include "test.h"
+#include "util.h"
+
+namespace {
+    const GLfloat EYE_HEIGHT = 1.6f;
+    const GLfloat HALF_IPD   = 0.032f;
+    const GLfloat NEAR_PLANE = 0.1f;
+    const GLfloat FAR_PLANE  = 100.0f;
+    // Rays across and up each eye's field of view.
+    const int SAMPLES_X = 1024;
+    const int SAMPLES_Y = 512;
+
+    // A unit square facing the eyes, scaled and placed by its node.
+    const int     QUAD_VERTICES = 6;
+    const GLfloat quad_vertices[3 * QUAD_VERTICES] = {
+        -0.5f, -0.5f, 0.0f, 0.5f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f,
+        -0.5f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f, -0.5f, 0.5f, 0.0f};
+
+    struct Quad {
+        GLfloat center[3];
+        GLfloat size[2];
+    };
+
+    struct Box {
+        GLfloat min[3];
+        GLfloat max[3];
+        int     expected; // Eyes the culler has to keep the box for, or -1 to only compare with the brute force.
+    };
+
+    struct OcclusionScene {
+        const char*       name;
+        std::vector<Quad> occluders;
+        std::vector<Box>  boxes;
+    };
+
+    // Both eyes look down -z, with a headset's asymmetric fields of view that reach further outwards than
+    // towards the nose. Column major.
+    void eye_camera( int eye, CameraMatrices& camera ) {
+        const GLfloat outer = 1.39f;
+        const GLfloat inner = 1.24f;
+        const GLfloat l     = -( eye ? inner : outer );
+        const GLfloat r     = eye ? outer : inner;
+        const GLfloat b     = -1.47f;
+        const GLfloat t     = 1.47f;
+        const GLfloat x     = eye ? HALF_IPD : -HALF_IPD;
+        GLfloat       view[4 * 4];
+        GLfloat       projection[4 * 4];
+        memcpy( view, identity4, sizeof( view ) );
+        view[12] = -x;
+        view[13] = -EYE_HEIGHT;
+        memset( projection, 0, sizeof( projection ) );
+        projection[0]  = 2.0f / ( r - l );
+        projection[5]  = 2.0f / ( t - b );
+        projection[8]  = ( r + l ) / ( r - l );
+        projection[9]  = ( t + b ) / ( t - b );
+        projection[10] = -( FAR_PLANE + NEAR_PLANE ) / ( FAR_PLANE - NEAR_PLANE );
+        projection[11] = -1.0f;
+        projection[14] = -2.0f * FAR_PLANE * NEAR_PLANE / ( FAR_PLANE - NEAR_PLANE );
+        memcpy( camera.view, view, sizeof( view ) );
+        memcpy( camera.projection, projection, sizeof( projection ) );
+    }
+
+    void unproject( const GLfloat* inverse, GLfloat x, GLfloat y, GLfloat z, GLfloat* world ) {
+        GLfloat out[4];
+        for( int r = 0; r < 4; ++r ) {
+            out[r] = inverse[r] * x + inverse[4 + r] * y + inverse[8 + r] * z + inverse[12 + r];
+        }
+        for( int i = 0; i < 3; ++i ) {
+            world[i] = out[i] / out[3];
+        }
+    }
+
+    // Distance along the ray to where it enters the box, or a negative value if it misses.
+    GLfloat ray_box( const GLfloat* origin, const GLfloat* direction, const GLfloat* box ) {
+        GLfloat enter = 0.0f;
+        GLfloat leave = 1e30f;
+        for( int i = 0; i < 3; ++i ) {
+            if( fabsf( direction[i] ) < 1e-12f ) {
+                if( ( origin[i] < box[i] ) || ( origin[i] > box[3 + i] ) ) {
+                    return -1.0f;
+                }
+                continue;
+            }
+            GLfloat t0 = ( box[i] - origin[i] ) / direction[i];
+            GLfloat t1 = ( box[3 + i] - origin[i] ) / direction[i];
+            if( t0 > t1 ) {
+                std::swap( t0, t1 );
+            }
+            enter = std::max( enter, t0 );
+            leave = std::min( leave, t1 );
+        }
+        return ( enter <= leave ) ? enter : -1.0f;
+    }
+
+    // Distance along the ray to the triangle, or a negative value if it misses.
+    GLfloat ray_triangle( const GLfloat* origin, const GLfloat* direction, const GLfloat* a, const GLfloat* b, const GLfloat* c ) {
+        GLfloat e1[3], e2[3], p[3], s[3], q[3];
+        for( int i = 0; i < 3; ++i ) {
+            e1[i] = b[i] - a[i];
+            e2[i] = c[i] - a[i];
+            s[i]  = origin[i] - a[i];
+        }
+        p[0]              = direction[1] * e2[2] - direction[2] * e2[1];
+        p[1]              = direction[2] * e2[0] - direction[0] * e2[2];
+        p[2]              = direction[0] * e2[1] - direction[1] * e2[0];
+        const GLfloat det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if( fabsf( det ) < 1e-12f ) {
+            return -1.0f;
+        }
+        const GLfloat inverse = 1.0f / det;
+        const GLfloat u       = ( s[0] * p[0] + s[1] * p[1] + s[2] * p[2] ) * inverse;
+        if( ( u < 0.0f ) || ( u > 1.0f ) ) {
+            return -1.0f;
+        }
+        q[0]            = s[1] * e1[2] - s[2] * e1[1];
+        q[1]            = s[2] * e1[0] - s[0] * e1[2];
+        q[2]            = s[0] * e1[1] - s[1] * e1[0];
+        const GLfloat v = ( direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2] ) * inverse;
+        if( ( v < 0.0f ) || ( u + v > 1.0f ) ) {
+            return -1.0f;
+        }
+        return ( e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2] ) * inverse;
+    }
+
+    // Which boxes the eye sees any part of, from rays through a grid over its whole field of view.
+    std::vector<bool> brute_force_visible( const CameraMatrices& camera, const std::vector<GLfloat>& triangles, const std::vector<const GLfloat*>& boxes ) {
+        GLfloat view_projection[4 * 4];
+        GLfloat inverse[4 * 4];
+        gl_matrix4x4_multiply( view_projection, camera.projection, camera.view );
+        gl_matrix4x4_invert( inverse, view_projection );
+
+        std::vector<bool> visible( boxes.size(), false );
+        for( int y = 0; y < SAMPLES_Y; ++y ) {
+            for( int x = 0; x < SAMPLES_X; ++x ) {
+                const GLfloat ndc_x = ( x + 0.5f ) / SAMPLES_X * 2.0f - 1.0f;
+                const GLfloat ndc_y = ( y + 0.5f ) / SAMPLES_Y * 2.0f - 1.0f;
+                GLfloat       origin[3];
+                GLfloat       far_point[3];
+                GLfloat       direction[3];
+                unproject( inverse, ndc_x, ndc_y, -1.0f, origin );
+                unproject( inverse, ndc_x, ndc_y, 1.0f, far_point );
+                for( int i = 0; i < 3; ++i ) {
+                    direction[i] = far_point[i] - origin[i];
+                }
+
+                GLfloat nearest = 1.0f;
+                for( size_t t = 0; t + 9 <= triangles.size(); t += 9 ) {
+                    const GLfloat hit = ray_triangle( origin, direction, &triangles[t], &triangles[t + 3], &triangles[t + 6] );
+                    if( hit >= 0.0f ) {
+                        nearest = std::min( nearest, hit );
+                    }
+                }
+                for( size_t b = 0; b < boxes.size(); ++b ) {
+                    const GLfloat hit = ray_box( origin, direction, boxes[b] );
+                    if( ( hit >= 0.0f ) && ( hit < nearest ) ) {
+                        visible[b] = true;
+                    }
+                }
+            }
+        }
+        return visible;
+    }
+
+    void check_scene( const OcclusionScene& test ) {
+        Scene scene;
+        for( const Quad& quad : test.occluders ) {
+            const int node = scene.add_node( Scene::NONE );
+            scene.set_translation( node, quad.center[0], quad.center[1], quad.center[2] );
+            scene.set_scale( node, quad.size[0], quad.size[1], 1.0f );
+        }
+        std::vector<int> box_nodes;
+        for( const Box& box : test.boxes ) {
+            const int node = scene.add_node( Scene::NONE );
+            scene.set_bounds( node, box.min, box.max );
+            box_nodes.push_back( node );
+        }
+        scene.update();
+
+        // The occluders' triangles in world space, for the brute force. Scene matrices are row major.
+        OcclusionCuller             culler;
+        std::vector<GLfloat>        triangles;
+        std::vector<const GLfloat*> boxes;
+        for( size_t i = 0; i < test.occluders.size(); ++i ) {
+            const int node = static_cast<int>( i );
+            culler.add_occluder( node, quad_vertices, QUAD_VERTICES );
+            const GLfloat* m = scene.world_matrix( node );
+            for( int v = 0; v < QUAD_VERTICES; ++v ) {
+                const GLfloat* p = quad_vertices + 3 * v;
+                for( int r = 0; r < 3; ++r ) {
+                    triangles.push_back( m[4 * r] * p[0] + m[4 * r + 1] * p[1] + m[4 * r + 2] * p[2] + m[4 * r + 3] );
+                }
+            }
+        }
+        for( int node : box_nodes ) {
+            boxes.push_back( scene.world_bounds( node ) );
+        }
+
+        // What frustum culling would hand over: every box with the eyes whose frustum it is in.
+        CameraMatrices eyes[2];
+        Frustum        frusta[2];
+        for( int eye = 0; eye < 2; ++eye ) {
+            eye_camera( eye, eyes[eye] );
+            frustum_from_view_projection( eyes[eye].view, eyes[eye].projection, frusta[eye] );
+        }
+        CullResult input;
+        for( size_t b = 0; b < boxes.size(); ++b ) {
+            const uint8_t mask = ( frustum_intersects_box( frusta[0], boxes[b] ) ? 1 : 0 ) |
+                                 ( frustum_intersects_box( frusta[1], boxes[b] ) ? 2 : 0 );
+            if( mask ) {
+                input.nodes.push_back( box_nodes[b] );
+                input.eyes.push_back( mask );
+            }
+        }
+        culler.set_debug( true );
+        culler.cull( scene, eyes, input );
+
+        std::vector<int>  kept( scene.size(), 0 );
+        const CullResult& result = culler.result();
+        for( size_t i = 0; i < result.nodes.size(); ++i ) {
+            kept[result.nodes[i]] = result.eyes[i];
+        }
+        int seen     = 0;
+        int rejected = 0;
+        for( int eye = 0; eye < 2; ++eye ) {
+            const std::vector<bool> visible = brute_force_visible( eyes[eye], triangles, boxes );
+            for( size_t b = 0; b < boxes.size(); ++b ) {
+                const bool culled_visible = ( kept[box_nodes[b]] >> eye ) & 1;
+                if( visible[b] && !CHECK( culled_visible ) ) {
+                    fprintf( stderr, "%s: box %d is seen by eye %d but was culled.\n", test.name, static_cast<int>( b ), eye );
+                }
+                seen += visible[b] ? 1 : 0;
+                rejected += culled_visible ? 0 : 1;
+                // The pyramid may keep what scanning the whole buffer rejects, but not the other way around.
+                CHECK( culler.buffer( eye ).box_visible( boxes[b] ) || !culler.buffer( eye ).box_visible_reference( boxes[b] ) );
+            }
+        }
+        for( size_t b = 0; b < boxes.size(); ++b ) {
+            if( ( test.boxes[b].expected >= 0 ) && !CHECK_EQUAL( test.boxes[b].expected, kept[box_nodes[b]] ) ) {
+                fprintf( stderr, "%s: box %d was kept for the wrong eyes.\n", test.name, static_cast<int>( b ) );
+            }
+        }
+        CHECK_EQUAL( 0, culler.stats().mismatches );
+        printf( "%s: %d of %d box and eye pairs seen, %d culled.\n", test.name, seen, static_cast<int>( 2 * boxes.size() ), rejected );
+    }
+
+    Quad make_quad( GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height ) {
+        Quad quad = {{x, y, z}, {width, height}};
+        return quad;
+    }
+
+    Box make_box( GLfloat x, GLfloat y, GLfloat z, GLfloat half, int expected ) {
+        Box box = {{x - half, y - half, z - half}, {x + half, y + half, z + half}, expected};
+        return box;
+    }
+
+    std::vector<OcclusionScene> scenes() {
+        std::vector<OcclusionScene> scenes;
+
+        // Boxes fully behind a wall, in front of it and beside it.
+        OcclusionScene wall;
+        wall.name = "wall";
+        wall.occluders.push_back( make_quad( 0.0f, EYE_HEIGHT, -3.0f, 4.0f, 4.0f ) );
+        wall.boxes.push_back( make_box( 0.0f, EYE_HEIGHT, -6.0f, 0.2f, 0 ) );
+        wall.boxes.push_back( make_box( 0.3f, EYE_HEIGHT + 0.3f, -10.0f, 0.5f, 0 ) );
+        wall.boxes.push_back( make_box( 0.0f, EYE_HEIGHT, -2.0f, 0.2f, 3 ) );
+        wall.boxes.push_back( make_box( -5.0f, EYE_HEIGHT, -6.0f, 0.2f, 3 ) );
+        wall.boxes.push_back( make_box( 0.0f, EYE_HEIGHT + 5.0f, -6.0f, 0.2f, 3 ) );
+        scenes.push_back( wall );
+
+        // A wall ending straight ahead. Past its edge the right eye sees further left than the left eye, so
+        // what is just behind the edge is seen by the right eye alone, and by neither from between the eyes.
+        OcclusionScene edge;
+        edge.name = "edge";
+        edge.occluders.push_back( make_quad( -2.0f, EYE_HEIGHT, -1.0f, 4.0f, 4.0f ) );
+        edge.boxes.push_back( make_box( -0.07f, EYE_HEIGHT, -5.0f, 0.04f, 2 ) );
+        edge.boxes.push_back( make_box( 0.0f, EYE_HEIGHT, -5.0f, 0.05f, 2 ) );
+        edge.boxes.push_back( make_box( 0.5f, EYE_HEIGHT, -5.0f, 0.1f, 3 ) );
+        edge.boxes.push_back( make_box( -1.0f, EYE_HEIGHT, -5.0f, 0.1f, 0 ) );
+        scenes.push_back( edge );
+
+        // A gap between two walls that each eye sees a different part of the room through.
+        OcclusionScene gap;
+        gap.name = "gap";
+        gap.occluders.push_back( make_quad( -1.01f, EYE_HEIGHT, -1.0f, 2.0f, 4.0f ) );
+        gap.occluders.push_back( make_quad( 1.01f, EYE_HEIGHT, -1.0f, 2.0f, 4.0f ) );
+        gap.boxes.push_back( make_box( -0.15f, EYE_HEIGHT, -8.0f, 0.05f, 2 ) );
+        gap.boxes.push_back( make_box( 0.15f, EYE_HEIGHT, -8.0f, 0.05f, 1 ) );
+        gap.boxes.push_back( make_box( 0.0f, EYE_HEIGHT, -8.0f, 0.05f, 0 ) );
+        gap.boxes.push_back( make_box( 1.0f, EYE_HEIGHT, -8.0f, 0.05f, 0 ) );
+        scenes.push_back( gap );
+
+        // Boxes strewn behind and between staggered walls, only compared with the brute force.
+        OcclusionScene room;
+        room.name = "room";
+        room.occluders.push_back( make_quad( -0.8f, EYE_HEIGHT - 0.5f, -2.0f, 1.2f, 1.5f ) );
+        room.occluders.push_back( make_quad( 0.7f, EYE_HEIGHT + 0.2f, -3.0f, 1.5f, 1.0f ) );
+        room.occluders.push_back( make_quad( 0.0f, EYE_HEIGHT, -6.0f, 6.0f, 0.8f ) );
+        unsigned int seed = 1;
+        for( int i = 0; i < 200; ++i ) {
+            GLfloat r[4];
+            for( int k = 0; k < 4; ++k ) {
+                seed = seed * 1664525u + 1013904223u;
+                r[k] = ( seed >> 8 ) / 16777216.0f;
+            }
+            room.boxes.push_back( make_box( -3.0f + 6.0f * r[0], EYE_HEIGHT - 1.5f + 3.0f * r[1], -1.5f - 10.0f * r[2], 0.02f + 0.2f * r[3], -1 ) );
+        }
+        scenes.push_back( room );
+
+        return scenes;
+    }
+}
+
+int main() {
+    const std::vector<OcclusionScene> tests = scenes();
+    for( const OcclusionScene& test : tests ) {
+        check_scene( test );
+    }
+    return test_result( "occlusion_test" );
+}
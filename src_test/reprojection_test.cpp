@@ -0,0 +1,278 @@
+// Replays head pose traces through reprojection. The traces in src_test/data are head motions and frame
+// timings scripted at a 90 Hz headset's rate: for every frame when it began, when the app decided whether to
+// render it, when it finished, the head's position and orientation, and whether the frame has to be rendered
+// or reprojected.
+//
+// The decisions are replayed through frame_begin(), reprojection_should_reproject() and frame_end(). Every
+// frame is also reprojected from the last rendered one, and the matrices checked by projecting points in
+// front of the eyes: positional reprojection has to take each point to where the history camera saw it,
+// and rotation-only reprojection to where it would have been with the history camera's orientation alone.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "frame.h"
+#include "framebuffer_pool.h"
+#include "mock.h"
+#include "reprojection.h"
+#include "test.h"
+#include "user_context.h"
+#include "util.h"
+
+namespace {
+    const GLfloat HALF_IPD   = 0.032f;
+    const GLfloat NEAR_PLANE = 0.1f;
+    const GLfloat FAR_PLANE  = 100.0f;
+    const GLint   WIDTH      = 2160;
+    const GLint   HEIGHT     = 1200;
+    // NDC points are compared at this precision, about a pixel at the canvas size.
+    const double TOLERANCE = 1e-3;
+
+    struct TraceFrame {
+        double  begin_ms;
+        double  decide_ms;
+        double  end_ms;
+        GLfloat position[3];
+        GLfloat orientation[4]; // x, y, z, w, as WebVR orders them.
+        bool    reproject;
+    };
+
+    bool load_trace( const char* filename, std::vector<TraceFrame>& frames ) {
+        std::string contents;
+        if( !get_file_contents( filename, contents ) ) {
+            return false;
+        }
+        const char* line = contents.c_str();
+        while( *line ) {
+            const char* next = strchr( line, '\n' );
+            next             = next ? next + 1 : line + strlen( line );
+            TraceFrame frame;
+            char       decision[16];
+            if( ( *line != '#' ) &&
+                ( sscanf( line,
+                          "%lf %lf %lf %f %f %f %f %f %f %f %15s",
+                          &frame.begin_ms,
+                          &frame.decide_ms,
+                          &frame.end_ms,
+                          &frame.position[0],
+                          &frame.position[1],
+                          &frame.position[2],
+                          &frame.orientation[0],
+                          &frame.orientation[1],
+                          &frame.orientation[2],
+                          &frame.orientation[3],
+                          decision ) == 11 ) ) {
+                frame.reproject = !strcmp( decision, "reproject" );
+                frames.push_back( frame );
+            }
+            line = next;
+        }
+        return !frames.empty();
+    }
+
+    // Rotation of the head as a (row major) 3x3 matrix.
+    void head_rotation( const TraceFrame& frame, GLfloat* rotation ) {
+        const GLfloat* q      = frame.orientation;
+        const GLfloat  length = sqrtf( q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3] );
+        const GLfloat  x      = q[0] / length;
+        const GLfloat  y      = q[1] / length;
+        const GLfloat  z      = q[2] / length;
+        const GLfloat  w      = q[3] / length;
+        const GLfloat  m[9]   = {
+            1.0f - 2.0f * ( y * y + z * z ), 2.0f * ( x * y - w * z ), 2.0f * ( x * z + w * y ),
+            2.0f * ( x * y + w * z ), 1.0f - 2.0f * ( x * x + z * z ), 2.0f * ( y * z - w * x ),
+            2.0f * ( x * z - w * y ), 2.0f * ( y * z + w * x ), 1.0f - 2.0f * ( x * x + y * y )};
+        memcpy( rotation, m, sizeof( m ) );
+    }
+
+    // The eye's position in the world, half the eye separation to the side of the head.
+    void eye_position( const TraceFrame& frame, int eye, GLfloat* position ) {
+        GLfloat       rotation[9];
+        const GLfloat offset = eye ? HALF_IPD : -HALF_IPD;
+        head_rotation( frame, rotation );
+        for( int r = 0; r < 3; ++r ) {
+            position[r] = frame.position[r] + rotation[3 * r] * offset;
+        }
+    }
+
+    // The cameras WebVR would hand over for the frame's pose, with a headset's asymmetric fields of view
+    // that reach further outwards than towards the nose. Column major.
+    void eye_cameras( const TraceFrame& frame, CameraMatrices* cameras ) {
+        GLfloat rotation[9];
+        head_rotation( frame, rotation );
+        for( int eye = 0; eye < 2; ++eye ) {
+            CameraMatrices& camera = cameras[eye];
+            camera_identity( camera );
+            GLfloat position[3];
+            eye_position( frame, eye, position );
+            // The inverse of the eye's rigid transform: the transposed rotation, and the position rotated back.
+            for( int r = 0; r < 3; ++r ) {
+                for( int c = 0; c < 3; ++c ) {
+                    camera.view[4 * c + r] = rotation[3 * c + r];
+                }
+                camera.view[12 + r] = -( rotation[r] * position[0] + rotation[3 + r] * position[1] + rotation[6 + r] * position[2] );
+            }
+
+            const GLfloat l = eye ? -1.24f : -1.39f;
+            const GLfloat r = eye ? 1.39f : 1.24f;
+            const GLfloat b = -1.47f;
+            const GLfloat t = 1.47f;
+            memset( camera.projection, 0, sizeof( camera.projection ) );
+            camera.projection[0]  = 2.0f / ( r - l );
+            camera.projection[5]  = 2.0f / ( t - b );
+            camera.projection[8]  = ( r + l ) / ( r - l );
+            camera.projection[9]  = ( t + b ) / ( t - b );
+            camera.projection[10] = -( FAR_PLANE + NEAR_PLANE ) / ( FAR_PLANE - NEAR_PLANE );
+            camera.projection[11] = -1.0f;
+            camera.projection[14] = -2.0f * FAR_PLANE * NEAR_PLANE / ( FAR_PLANE - NEAR_PLANE );
+        }
+    }
+
+    void transform( const GLfloat* column_major, const double* point, double* out ) {
+        for( int r = 0; r < 4; ++r ) {
+            out[r] = column_major[r] * point[0] + column_major[4 + r] * point[1] + column_major[8 + r] * point[2] + column_major[12 + r] * point[3];
+        }
+    }
+
+    void check_ndc( const double* expected_clip, const double* actual_clip, const char* what, int frame ) {
+        bool passed = true;
+        for( int i = 0; i < 3; ++i ) {
+            passed &= CHECK_NEAR( expected_clip[i] / expected_clip[3], actual_clip[i] / actual_clip[3], TOLERANCE );
+        }
+        if( !passed ) {
+            fprintf( stderr, "In the %s reprojection of frame %d.\n", what, frame );
+        }
+    }
+
+    // Points across the eye's field of view, near and far, checked through both reprojections of the eye.
+    void check_matrices( const TraceFrame& history_frame, const TraceFrame& current_frame, int frame ) {
+        CameraMatrices history[2];
+        CameraMatrices current[2];
+        eye_cameras( history_frame, history );
+        eye_cameras( current_frame, current );
+        GLfloat history_rotation[9];
+        GLfloat current_rotation[9];
+        head_rotation( history_frame, history_rotation );
+        head_rotation( current_frame, current_rotation );
+
+        for( int eye = 0; eye < 2; ++eye ) {
+            GLfloat positional[4 * 4];
+            GLfloat rotational[4 * 4];
+            reprojection_matrix( history[eye], current[eye], true, positional );
+            reprojection_matrix( history[eye], current[eye], false, rotational );
+            GLfloat position[3];
+            eye_position( current_frame, eye, position );
+
+            const double depths[3] = {0.5, 2.0, 20.0};
+            for( int d = 0; d < 3; ++d ) {
+                for( int y = -2; y <= 2; ++y ) {
+                    for( int x = -2; x <= 2; ++x ) {
+                        // A point in the current eye's view, and where it is in the world.
+                        const double view_point[4] = {0.3 * x * depths[d], 0.3 * y * depths[d], -depths[d], 1.0};
+                        double       world[4]      = {0.0, 0.0, 0.0, 1.0};
+                        for( int r = 0; r < 3; ++r ) {
+                            for( int c = 0; c < 3; ++c ) {
+                                world[r] += current_rotation[3 * r + c] * view_point[c];
+                            }
+                            world[r] += position[r];
+                        }
+
+                        double current_clip[4];
+                        double current_ndc[4];
+                        double actual[4];
+                        double expected[4];
+                        transform( current[eye].projection, view_point, current_clip );
+                        for( int i = 0; i < 3; ++i ) {
+                            current_ndc[i] = current_clip[i] / current_clip[3];
+                        }
+                        current_ndc[3] = 1.0;
+
+                        // Where the history camera saw the point.
+                        double history_view[4];
+                        transform( history[eye].view, world, history_view );
+                        transform( history[eye].projection, history_view, expected );
+                        transform( positional, current_ndc, actual );
+                        check_ndc( expected, actual, "positional", frame );
+
+                        // Where the point would be had the head only turned, from the current view rotated
+                        // into the history view: the history rotation's inverse after the current rotation.
+                        double turned[4] = {0.0, 0.0, 0.0, 1.0};
+                        for( int r = 0; r < 3; ++r ) {
+                            for( int c = 0; c < 3; ++c ) {
+                                for( int k = 0; k < 3; ++k ) {
+                                    turned[r] += history_rotation[3 * k + r] * current_rotation[3 * k + c] * view_point[c];
+                                }
+                            }
+                        }
+                        transform( history[eye].projection, turned, expected );
+                        transform( rotational, current_ndc, actual );
+                        check_ndc( expected, actual, "rotational", frame );
+                    }
+                }
+            }
+        }
+    }
+
+    void check_trace( const char* filename ) {
+        std::vector<TraceFrame> frames;
+        if( !CHECK( load_trace( filename, frames ) ) ) {
+            fprintf( stderr, "Could not load %s.\n", filename );
+            return;
+        }
+
+        // A history frame of the canvas' size, as if captured before the trace started.
+        UserContext&     user_context = *( new UserContext() );
+        RenderTarget     history      = RenderTarget();
+        RenderTargetDesc desc;
+        desc.width                        = WIDTH;
+        desc.height                       = HEIGHT;
+        history.desc                      = desc;
+        user_context.width                = WIDTH;
+        user_context.height               = HEIGHT;
+        user_context.reprojection.enabled = true;
+        user_context.reprojection.history = &history;
+        if( !CHECK( reprojection_load_shaders( user_context ) ) ) {
+            return;
+        }
+
+        size_t       rendered    = 0;
+        unsigned int reprojected = 0;
+        for( size_t i = 0; i < frames.size(); ++i ) {
+            const TraceFrame& frame = frames[i];
+            mock_set_now( frame.begin_ms );
+            frame_begin( user_context );
+            mock_set_now( frame.decide_ms );
+            const bool reproject = reprojection_should_reproject( user_context );
+            if( !CHECK_EQUAL( frame.reproject, reproject ) ) {
+                fprintf( stderr, "%s: frame %d was %s, expected %s.\n", filename, static_cast<int>( i ),
+                         reproject ? "reprojected" : "rendered", frame.reproject ? "reprojected" : "rendered" );
+            }
+
+            CameraMatrices cameras[2];
+            eye_cameras( frame, cameras );
+            check_matrices( frames[rendered], frame, static_cast<int>( i ) );
+            if( reproject ) {
+                reprojection_draw( user_context, cameras );
+                ++reprojected;
+            } else {
+                rendered = i;
+            }
+            mock_set_now( frame.end_ms );
+            frame_end( user_context );
+        }
+        CHECK_EQUAL( reprojected, user_context.reprojection.reprojected_frames );
+        printf( "%s: %u of %d frames reprojected.\n", filename, reprojected, static_cast<int>( frames.size() ) );
+    }
+}
+
+int main() {
+    mock_reset();
+    check_trace( "src_test/data/pose_turn.txt" );
+    check_trace( "src_test/data/pose_walk.txt" );
+    check_trace( "src_test/data/pose_stall.txt" );
+    return test_result( "reprojection_test" );
+}
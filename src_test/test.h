@@ -0,0 +1,54 @@
+#ifndef WASMVR_TEST_H
+#define WASMVR_TEST_H
+
+#include <math.h>
+#include <stdio.h>
+
+// Checks for the native tests, see test.sh. A failed check is reported and the test goes on, so one run
+// shows every failure. main() returns test_result().
+
+#define CHECK( condition ) test_check( ( condition ), #condition, __FILE__, __LINE__ )
+#define CHECK_EQUAL( expected, actual ) test_check_equal( static_cast<double>( expected ), static_cast<double>( actual ), #expected, #actual, __FILE__, __LINE__ )
+#define CHECK_NEAR( expected, actual, tolerance ) test_check_near( ( expected ), ( actual ), ( tolerance ), #expected, #actual, __FILE__, __LINE__ )
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline bool test_check( bool passed, const char* condition, const char* file, int line ) {
+    if( !passed ) {
+        fprintf( stderr, "%s:%d: Failed: %s\n", file, line, condition );
+        ++test_failures();
+    }
+    return passed;
+}
+
+inline bool test_check_equal( double expected, double actual, const char* expected_text, const char* actual_text, const char* file, int line ) {
+    if( expected != actual ) {
+        fprintf( stderr, "%s:%d: Failed: %s is %.9g, expected %s = %.9g\n", file, line, actual_text, actual, expected_text, expected );
+        ++test_failures();
+        return false;
+    }
+    return true;
+}
+
+inline bool test_check_near( double expected, double actual, double tolerance, const char* expected_text, const char* actual_text, const char* file, int line ) {
+    if( !( fabs( expected - actual ) <= tolerance ) ) {
+        fprintf( stderr, "%s:%d: Failed: %s is %.9g, expected %s = %.9g within %g\n", file, line, actual_text, actual, expected_text, expected, tolerance );
+        ++test_failures();
+        return false;
+    }
+    return true;
+}
+
+inline int test_result( const char* name ) {
+    if( test_failures() ) {
+        fprintf( stderr, "%s: %d checks failed.\n", name, test_failures() );
+        return 1;
+    }
+    printf( "%s: passed.\n", name );
+    return 0;
+}
+
+#endif // WASMVR_TEST_H
@@ -0,0 +1,292 @@
+// Builds a model's levels of detail offline and writes them as a scene file, see src/scene_format.h, so the
+// app loads the whole chain in place instead of simplifying on the main thread. Built natively, not with
+// emscripten, after emscripten.sh has generated the schema's header:
+//
+//     g++ -std=c++11 -O2 -I$FLATBUFFERS/include -Ibuild_fbs_cpp -Isrc src_tool/mesh_lod.cpp src/mesh_build.cpp -o mesh_lod
+//     ./mesh_lod model.obj scene.wvrs [levels = 4] [ratio = 0.5] [float | quantized | quantized_small]
+//
+// The input is a Wavefront OBJ of one model. Faces are fanned into triangles and corners sharing a position,
+// UV and normal become one vertex, so the simplifier sees which triangles are connected. Models without
+// normals get smooth ones and models without UVs planar ones. The levels are built with mesh_build_lods(),
+// ordered with mesh_optimize() and laid out with mesh_pack() exactly as the app would, and the file holds
+// the one mesh under one node at the origin. Copy it next to the page as scene.wvrs and load it with W.
+
+#include <errno.h>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+#include "mesh.h"
+#include "scene_format.h"
+
+namespace {
+    struct ObjCorner {
+        int position;
+        int uv;
+        int normal;
+
+        bool operator<( const ObjCorner& other ) const {
+            if( position != other.position ) {
+                return position < other.position;
+            }
+            if( uv != other.uv ) {
+                return uv < other.uv;
+            }
+            return normal < other.normal;
+        }
+    };
+
+    // An OBJ index, one based or negative from the end, to a zero based one, -1 when absent or out of range.
+    int obj_index( const char* text, size_t count ) {
+        if( !*text ) {
+            return -1;
+        }
+        const long index = strtol( text, nullptr, 10 );
+        const long found = index < 0 ? static_cast<long>( count ) + index : index - 1;
+        return ( found >= 0 ) && ( found < static_cast<long>( count ) ) ? static_cast<int>( found ) : -1;
+    }
+
+    bool load_obj( const char* path, Mesh& mesh ) {
+        FILE* file = fopen( path, "r" );
+        if( !file ) {
+            fprintf( stderr, "Failed to open %s: %s\n", path, strerror( errno ) );
+            return false;
+        }
+        std::vector<GLfloat>          positions;
+        std::vector<GLfloat>          uvs;
+        std::vector<GLfloat>          normals;
+        std::map<ObjCorner, uint32_t> vertices;
+        std::vector<ObjCorner>        corners;
+        bool                          has_uvs     = true;
+        bool                          has_normals = true;
+        char                          line[4096];
+        while( fgets( line, sizeof( line ), file ) ) {
+            GLfloat v[3];
+            if( sscanf( line, "v %f %f %f", &v[0], &v[1], &v[2] ) == 3 ) {
+                positions.insert( positions.end(), v, v + 3 );
+            } else if( sscanf( line, "vt %f %f", &v[0], &v[1] ) == 2 ) {
+                uvs.insert( uvs.end(), v, v + 2 );
+            } else if( sscanf( line, "vn %f %f %f", &v[0], &v[1], &v[2] ) == 3 ) {
+                normals.insert( normals.end(), v, v + 3 );
+            } else if( ( line[0] == 'f' ) && ( line[1] == ' ' || line[1] == '\t' ) ) {
+                // Each corner is v, v/vt, v//vn or v/vt/vn.
+                corners.clear();
+                for( char* token = strtok( line + 2, " \t\r\n" ); token; token = strtok( nullptr, " \t\r\n" ) ) {
+                    char  fields[3][32] = {"", "", ""};
+                    int   field         = 0;
+                    char* out           = fields[0];
+                    for( const char* c = token; *c && ( field < 3 ); ++c ) {
+                        if( *c == '/' ) {
+                            *out = 0;
+                            out  = fields[++field < 3 ? field : 2];
+                        } else if( out < fields[field] + sizeof( fields[field] ) - 1 ) {
+                            *out++ = *c;
+                        }
+                    }
+                    *out = 0;
+                    ObjCorner corner;
+                    corner.position = obj_index( fields[0], positions.size() / 3 );
+                    corner.uv       = obj_index( fields[1], uvs.size() / 2 );
+                    corner.normal   = obj_index( fields[2], normals.size() / 3 );
+                    if( corner.position < 0 ) {
+                        fprintf( stderr, "Skipping a face of %s with a bad vertex: %s\n", path, token );
+                        corners.clear();
+                        break;
+                    }
+                    has_uvs &= corner.uv >= 0;
+                    has_normals &= corner.normal >= 0;
+                    corners.push_back( corner );
+                }
+                for( size_t i = 2; i < corners.size(); ++i ) {
+                    const ObjCorner triangle[3] = {corners[0], corners[i - 1], corners[i]};
+                    for( const ObjCorner& corner : triangle ) {
+                        auto found = vertices.find( corner );
+                        if( found == vertices.end() ) {
+                            found = vertices.insert( std::make_pair( corner, static_cast<uint32_t>( vertices.size() ) ) ).first;
+                        }
+                        mesh.indices.push_back( found->second );
+                    }
+                }
+            }
+        }
+        fclose( file );
+        if( mesh.indices.empty() ) {
+            fprintf( stderr, "No faces in %s.\n", path );
+            return false;
+        }
+
+        // Missing UVs or normals on any corner drop them everywhere, they're regenerated below.
+        const size_t vertex_count = vertices.size();
+        mesh.positions.resize( 3 * vertex_count );
+        mesh.uvs.assign( 2 * vertex_count, 0.0f );
+        mesh.normals.assign( 3 * vertex_count, 0.0f );
+        for( const auto& vertex : vertices ) {
+            const ObjCorner& corner = vertex.first;
+            const uint32_t   index  = vertex.second;
+            memcpy( &mesh.positions[3 * index], &positions[3 * corner.position], 3 * sizeof( GLfloat ) );
+            if( has_uvs ) {
+                memcpy( &mesh.uvs[2 * index], &uvs[2 * corner.uv], 2 * sizeof( GLfloat ) );
+            }
+            if( has_normals ) {
+                memcpy( &mesh.normals[3 * index], &normals[3 * corner.normal], 3 * sizeof( GLfloat ) );
+            }
+        }
+
+        for( int i = 0; i < 3; ++i ) {
+            mesh.bounds[i]     = mesh.positions[i];
+            mesh.bounds[3 + i] = mesh.positions[i];
+        }
+        for( size_t v = 0; v < vertex_count; ++v ) {
+            for( int i = 0; i < 3; ++i ) {
+                mesh.bounds[i]     = fminf( mesh.bounds[i], mesh.positions[3 * v + i] );
+                mesh.bounds[3 + i] = fmaxf( mesh.bounds[3 + i], mesh.positions[3 * v + i] );
+            }
+        }
+        if( !has_uvs ) {
+            // Planar over the bounds in x and y, like mesh_from_triangles().
+            for( size_t v = 0; v < vertex_count; ++v ) {
+                for( int i = 0; i < 2; ++i ) {
+                    const GLfloat extent = mesh.bounds[3 + i] - mesh.bounds[i];
+                    mesh.uvs[2 * v + i]  = extent > 0.0f ? ( mesh.positions[3 * v + i] - mesh.bounds[i] ) / extent : 0.0f;
+                }
+            }
+        }
+        if( !has_normals ) {
+            // Area weighted sums of the faces around each vertex.
+            for( size_t t = 0; t < mesh.indices.size(); t += 3 ) {
+                const GLfloat* a       = &mesh.positions[3 * mesh.indices[t]];
+                const GLfloat* b       = &mesh.positions[3 * mesh.indices[t + 1]];
+                const GLfloat* c       = &mesh.positions[3 * mesh.indices[t + 2]];
+                const GLfloat  u[3]    = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                const GLfloat  w[3]    = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+                const GLfloat  face[3] = {u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0]};
+                for( int k = 0; k < 3; ++k ) {
+                    for( int i = 0; i < 3; ++i ) {
+                        mesh.normals[3 * mesh.indices[t + k] + i] += face[i];
+                    }
+                }
+            }
+        }
+        for( size_t v = 0; v < vertex_count; ++v ) {
+            GLfloat*      normal = &mesh.normals[3 * v];
+            const GLfloat length = sqrtf( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+            if( length > 0.0f ) {
+                for( int i = 0; i < 3; ++i ) {
+                    normal[i] /= length;
+                }
+            } else {
+                normal[2] = 1.0f;
+            }
+        }
+
+        MeshLod lod;
+        lod.first_index = 0;
+        lod.index_count = static_cast<uint32_t>( mesh.indices.size() );
+        lod.error       = 0.0f;
+        mesh.lods.push_back( lod );
+        return true;
+    }
+
+    int write_scene( const char* path, const Mesh& mesh, MeshVertexFormat format ) {
+        MeshPacked packed;
+        mesh_pack( mesh, format, packed );
+
+        flatbuffers::FlatBufferBuilder builder;
+        std::vector<uint8_t>           blob;
+        const SceneFormat::Range       vertices = scene_format_append( blob, packed.vertices.data(), packed.vertices.size() );
+        const SceneFormat::Range       indices  = scene_format_append( blob, packed.indices.data(), packed.indices.size() );
+        std::vector<SceneFormat::Lod>  lods;
+        for( const MeshLod& lod : mesh.lods ) {
+            lods.push_back( SceneFormat::Lod( lod.first_index, lod.index_count, lod.error ) );
+        }
+        const SceneFormat::Bounds bounds( SceneFormat::Vec3( mesh.bounds[0], mesh.bounds[1], mesh.bounds[2] ),
+                                          SceneFormat::Vec3( mesh.bounds[3], mesh.bounds[4], mesh.bounds[5] ) );
+        std::vector<flatbuffers::Offset<SceneFormat::Mesh>> meshes( 1, SceneFormat::CreateMesh(
+                                                                           builder,
+                                                                           builder.CreateString( "model" ),
+                                                                           static_cast<SceneFormat::VertexFormat>( packed.format ),
+                                                                           builder.CreateVector( packed.dequantize, 4 * 4 ),
+                                                                           &vertices,
+                                                                           &indices,
+                                                                           packed.index_type == GL_UNSIGNED_SHORT,
+                                                                           builder.CreateVectorOfStructs( lods ),
+                                                                           &bounds ) );
+
+        // clang-format off
+        const float matrix[4 * 4] = {
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f};
+        // clang-format on
+        std::vector<flatbuffers::Offset<SceneFormat::Node>>     nodes( 1, SceneFormat::CreateNode( builder, 0, -1, builder.CreateVector( matrix, 4 * 4 ), 0, 0 ) );
+        const SceneFormat::Color                                color( 200, 200, 200, 255 );
+        std::vector<flatbuffers::Offset<SceneFormat::Material>> materials( 1, SceneFormat::CreateMaterial( builder, builder.CreateString( "grey" ), &color ) );
+        builder.ForceVectorAlignment( blob.size(), sizeof( uint8_t ), SCENE_BLOB_ALIGNMENT );
+        const auto blob_vector = builder.CreateVector( blob );
+        SceneFormat::FinishSceneBuffer( builder,
+                                        SceneFormat::CreateScene(
+                                            builder,
+                                            builder.CreateVector( nodes ),
+                                            builder.CreateVector( meshes ),
+                                            builder.CreateVector( materials ),
+                                            blob_vector ) );
+
+        FILE* file = fopen( path, "wb" );
+        if( !file ) {
+            fprintf( stderr, "Failed to create %s: %s\n", path, strerror( errno ) );
+            return 1;
+        }
+        const bool written = fwrite( builder.GetBufferPointer(), 1, builder.GetSize(), file ) == builder.GetSize();
+        if( ( fclose( file ) != 0 ) || !written ) {
+            fprintf( stderr, "Failed to write %s.\n", path );
+            return 1;
+        }
+        printf( "Wrote %s: %lu bytes, %s vertices, %lu of them, and %s indices.\n",
+                path,
+                static_cast<unsigned long>( builder.GetSize() ),
+                mesh_vertex_format_name( packed.format ),
+                static_cast<unsigned long>( mesh.positions.size() / 3 ),
+                packed.index_type == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit" );
+        return 0;
+    }
+
+    bool parse_format( const char* name, MeshVertexFormat& format ) {
+        const char* names[MESH_VERTEX_FORMATS] = {"float", "quantized", "quantized_small"};
+        for( int i = 0; i < MESH_VERTEX_FORMATS; ++i ) {
+            if( !strcmp( name, names[i] ) ) {
+                format = static_cast<MeshVertexFormat>( i );
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+int main( int argc, char** argv ) {
+    MeshVertexFormat format = MESH_VERTEX_QUANTIZED;
+    const int        levels = argc > 3 ? atoi( argv[3] ) : 4;
+    const GLfloat    ratio  = argc > 4 ? static_cast<GLfloat>( atof( argv[4] ) ) : 0.5f;
+    if( ( argc < 3 ) || ( argc > 6 ) || ( levels < 1 ) || !( ratio > 0.0f && ratio < 1.0f ) || ( ( argc > 5 ) && !parse_format( argv[5], format ) ) ) {
+        fprintf( stderr, "Usage: %s model.obj scene.wvrs [levels = 4] [ratio = 0.5] [float | quantized | quantized_small]\n", argv[0] );
+        return 2;
+    }
+
+    Mesh mesh;
+    if( !load_obj( argv[1], mesh ) ) {
+        return 1;
+    }
+    mesh_build_lods( mesh, levels, ratio );
+    mesh_optimize( mesh );
+    for( size_t i = 0; i < mesh.lods.size(); ++i ) {
+        printf( "Level %d: %lu triangles, error %g.\n",
+                static_cast<int>( i ),
+                static_cast<unsigned long>( mesh.triangles( static_cast<int>( i ) ) ),
+                mesh.lods[i].error );
+    }
+    return write_scene( argv[2], mesh, format );
+}
@@ -0,0 +1,299 @@
+// Converts a point cloud into the chunked octree that PointCloud streams, see src/pointcloud_format.h.
+// Built natively, not with emscripten:
+//
+//     g++ -std=c++11 -O2 -Isrc src_tool/pointcloud_convert.cpp -o pointcloud_convert
+//     ./pointcloud_convert scan.xyz /my/install/path/pointcloud [points per node] [grid]
+//
+// The input is text with a point per line, "x y z" optionally followed by "r g b" from 0 to 255.
+// It is read twice, once for the bounds and once to build the tree, and never held in memory: points go
+// into the first node down from the root with a free grid cell and room in its budget, and a node's points
+// are written out as soon as it is full. Only the points of nodes still filling up stay in memory.
+
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <sys/stat.h>
+#include <unordered_set>
+#include <vector>
+
+#include "pointcloud_format.h"
+
+namespace {
+    // Deeper nodes would have cells smaller than a float can tell apart in most scans.
+    const int MAX_DEPTH = 20;
+
+    struct InputPoint {
+        double  position[3];
+        uint8_t color[4];
+    };
+
+    struct Node {
+        PointCloudNode               record;
+        int                          depth;
+        std::vector<PointCloudPoint> pending; // Quantized but not written yet.
+        std::unordered_set<uint32_t> occupied;
+        bool                         full;
+    };
+
+    class Converter {
+    public:
+        Converter( const std::string& output, uint32_t budget, uint32_t grid )
+            : output_( output )
+            , budget_( budget )
+            , grid_( grid )
+            , dropped_( 0 )
+            , points_( 0 ) {
+        }
+
+        void begin( const double* min, const double* max ) {
+            // The root is the bounds' enclosing cube, around the origin once the offset is taken off.
+            double extent = 0.0;
+            for( int i = 0; i < 3; ++i ) {
+                offset_[i] = 0.5 * ( min[i] + max[i] );
+                extent     = std::max( extent, max[i] - min[i] );
+            }
+            const float center[3] = {0.0f, 0.0f, 0.0f};
+            // A little larger, so points on the bounds don't round to outside.
+            add_node( -1, 0, center, static_cast<float>( 0.5 * extent * 1.001 + 1e-6 ) );
+        }
+
+        void add( const InputPoint& point ) {
+            float position[3];
+            for( int i = 0; i < 3; ++i ) {
+                position[i] = static_cast<float>( point.position[i] - offset_[i] );
+            }
+
+            int node = 0;
+            while( true ) {
+                Node&    n    = nodes_[node];
+                uint32_t cell = 0;
+                for( int i = 0; i < 3; ++i ) {
+                    const float    t = ( position[i] - n.record.center[i] + n.record.half_size ) / ( 2.0f * n.record.half_size );
+                    const uint32_t c = std::min( static_cast<uint32_t>( std::max( t, 0.0f ) * grid_ ), grid_ - 1 );
+                    cell             = cell * grid_ + c;
+                }
+                // The deepest nodes take every point, up to their budget.
+                const bool deepest = n.depth == MAX_DEPTH;
+                if( !n.full && ( deepest || n.occupied.insert( cell ).second ) ) {
+                    store( node, position, point.color );
+                    return;
+                }
+                if( deepest ) {
+                    ++dropped_;
+                    return;
+                }
+
+                int child = 0;
+                for( int i = 0; i < 3; ++i ) {
+                    child |= ( position[i] >= n.record.center[i] ) ? ( 1 << i ) : 0;
+                }
+                if( n.record.children[child] < 0 ) {
+                    const float quarter = 0.5f * n.record.half_size;
+                    float       center[3];
+                    for( int i = 0; i < 3; ++i ) {
+                        center[i] = n.record.center[i] + ( ( child & ( 1 << i ) ) ? quarter : -quarter );
+                    }
+                    const int added = add_node( node, n.depth + 1, center, quarter );
+                    // add_node may have moved the nodes.
+                    nodes_[node].record.children[child] = added;
+                }
+                node = nodes_[node].record.children[child];
+            }
+        }
+
+        bool finish() {
+            for( size_t node = 0; node < nodes_.size(); ++node ) {
+                if( !flush( static_cast<int>( node ) ) ) {
+                    return false;
+                }
+            }
+
+            PointCloudHeader header;
+            header.magic   = POINT_CLOUD_MAGIC;
+            header.version = POINT_CLOUD_VERSION;
+            header.nodes   = static_cast<uint32_t>( nodes_.size() );
+            header.grid    = grid_;
+            header.points  = points_;
+            memcpy( header.offset, offset_, sizeof( header.offset ) );
+
+            const std::string path = output_ + "/index.bin";
+            FILE*             file = fopen( path.c_str(), "wb" );
+            if( !file ) {
+                fprintf( stderr, "Failed to create %s: %s\n", path.c_str(), strerror( errno ) );
+                return false;
+            }
+            bool written = fwrite( &header, sizeof( header ), 1, file ) == 1;
+            for( const Node& node : nodes_ ) {
+                written = written && ( fwrite( &node.record, sizeof( node.record ), 1, file ) == 1 );
+            }
+            written = ( fclose( file ) == 0 ) && written;
+            if( !written ) {
+                fprintf( stderr, "Failed to write %s.\n", path.c_str() );
+                return false;
+            }
+
+            printf( "Wrote %llu points in %lu nodes, dropped %llu duplicates at the deepest level.\n",
+                    static_cast<unsigned long long>( points_ ),
+                    static_cast<unsigned long>( nodes_.size() ),
+                    static_cast<unsigned long long>( dropped_ ) );
+            return true;
+        }
+
+        bool failed() const {
+            return !error_.empty();
+        }
+
+        const std::string& error() const {
+            return error_;
+        }
+
+    private:
+        int add_node( int parent, int depth, const float* center, float half_size ) {
+            Node node;
+            memcpy( node.record.center, center, sizeof( node.record.center ) );
+            node.record.half_size = half_size;
+            node.record.parent    = parent;
+            std::fill( node.record.children, node.record.children + 8, -1 );
+            node.record.points = 0;
+            node.depth         = depth;
+            node.full          = false;
+            nodes_.push_back( std::move( node ) );
+            return static_cast<int>( nodes_.size() ) - 1;
+        }
+
+        void store( int index, const float* position, const uint8_t* color ) {
+            Node&           node = nodes_[index];
+            PointCloudPoint point;
+            for( int i = 0; i < 3; ++i ) {
+                const float t     = ( position[i] - node.record.center[i] + node.record.half_size ) / ( 2.0f * node.record.half_size );
+                point.position[i] = static_cast<uint16_t>( std::min( std::max( t, 0.0f ), 1.0f ) * 65535.0f + 0.5f );
+            }
+            memcpy( point.color, color, sizeof( point.color ) );
+            node.pending.push_back( point );
+            ++node.record.points;
+            ++points_;
+
+            // A full node takes no more points, so what it holds can go to disk along with its grid.
+            if( node.record.points >= budget_ ) {
+                node.full = true;
+                std::unordered_set<uint32_t>().swap( node.occupied );
+                if( !flush( index ) ) {
+                    error_ = "Failed to write a node.";
+                }
+            }
+        }
+
+        bool flush( int index ) {
+            Node& node = nodes_[index];
+            if( node.pending.empty() ) {
+                return true;
+            }
+            // A node is written once, when it fills up or at the end, so a file left by an earlier
+            // conversion into the same directory is replaced rather than appended to.
+            const std::string path = output_ + "/nodes/" + std::to_string( index ) + ".bin";
+            FILE*             file = fopen( path.c_str(), "wb" );
+            if( !file ) {
+                fprintf( stderr, "Failed to open %s: %s\n", path.c_str(), strerror( errno ) );
+                return false;
+            }
+            const bool written = fwrite( node.pending.data(), sizeof( PointCloudPoint ), node.pending.size(), file ) == node.pending.size();
+            if( ( fclose( file ) != 0 ) || !written ) {
+                fprintf( stderr, "Failed to write %s.\n", path.c_str() );
+                return false;
+            }
+            std::vector<PointCloudPoint>().swap( node.pending );
+            return true;
+        }
+
+        std::string       output_;
+        uint32_t          budget_;
+        uint32_t          grid_;
+        double            offset_[3];
+        std::vector<Node> nodes_;
+        uint64_t          dropped_;
+        uint64_t          points_;
+        std::string       error_;
+    };
+
+    // Reads the next point, skipping lines that aren't one.
+    bool read_point( FILE* file, InputPoint& point ) {
+        char line[512];
+        while( fgets( line, sizeof( line ), file ) ) {
+            double rgb[3] = {255.0, 255.0, 255.0};
+            double* p     = point.position;
+            const int read = sscanf( line, "%lf %lf %lf %lf %lf %lf", &p[0], &p[1], &p[2], &rgb[0], &rgb[1], &rgb[2] );
+            if( read < 3 ) {
+                continue;
+            }
+            for( int i = 0; i < 3; ++i ) {
+                point.color[i] = static_cast<uint8_t>( std::min( std::max( rgb[i], 0.0 ), 255.0 ) );
+            }
+            point.color[3] = 255;
+            return true;
+        }
+        return false;
+    }
+}
+
+int main( int argc, char** argv ) {
+    if( argc < 3 ) {
+        fprintf( stderr, "Usage: %s input.xyz output_directory [points per node = 32768] [grid = 128]\n", argv[0] );
+        return 1;
+    }
+    const uint32_t budget = ( argc > 3 ) ? static_cast<uint32_t>( atoi( argv[3] ) ) : 32768;
+    const uint32_t grid   = ( argc > 4 ) ? static_cast<uint32_t>( atoi( argv[4] ) ) : 128;
+    if( !budget || !grid || ( grid > 1024 ) ) {
+        fprintf( stderr, "Need some points per node and a grid of 1 to 1024 cells.\n" );
+        return 1;
+    }
+
+    FILE* input = fopen( argv[1], "r" );
+    if( !input ) {
+        fprintf( stderr, "Failed to open %s: %s\n", argv[1], strerror( errno ) );
+        return 1;
+    }
+
+    double     min[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL};
+    double     max[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+    uint64_t   count  = 0;
+    InputPoint point;
+    while( read_point( input, point ) ) {
+        for( int i = 0; i < 3; ++i ) {
+            min[i] = std::min( min[i], point.position[i] );
+            max[i] = std::max( max[i], point.position[i] );
+        }
+        ++count;
+    }
+    if( !count ) {
+        fprintf( stderr, "No points in %s.\n", argv[1] );
+        fclose( input );
+        return 1;
+    }
+    printf( "Read %llu points.\n", static_cast<unsigned long long>( count ) );
+
+    const std::string output = argv[2];
+    for( const std::string& directory : {output, output + "/nodes"} ) {
+        if( ( mkdir( directory.c_str(), 0755 ) != 0 ) && ( errno != EEXIST ) ) {
+            fprintf( stderr, "Failed to create %s: %s\n", directory.c_str(), strerror( errno ) );
+            fclose( input );
+            return 1;
+        }
+    }
+
+    Converter converter( output, budget, grid );
+    converter.begin( min, max );
+    rewind( input );
+    while( read_point( input, point ) && !converter.failed() ) {
+        converter.add( point );
+    }
+    fclose( input );
+    if( converter.failed() ) {
+        fprintf( stderr, "%s\n", converter.error().c_str() );
+        return 1;
+    }
+    return converter.finish() ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+// Generates scene files, see src/scene_format.h, and compares loading them in place from a memory mapping with
+// loading them the usual way, reading the file and copying every mesh out of it. Built natively, not with
+// emscripten, after emscripten.sh has generated the schema's header:
+//
+//     g++ -std=c++11 -O2 -I$FLATBUFFERS/include -Ibuild_fbs_cpp -Isrc src_tool/scene_bench.cpp -o scene_bench
+//     ./scene_bench generate scene.wvrs [meshes = 64] [rings = 128]
+//     ./scene_bench mmap scene.wvrs
+//     ./scene_bench parse scene.wvrs
+//
+// Each load runs in a process of its own, so the peak resident memory reported is that load's alone. Both end
+// by reading every vertex and index byte once, as uploading them would, and print a checksum to compare.
+// The page cache is shared, so run each a few times or drop the caches in between for cold loads.
+
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <sys/resource.h>
+#include <vector>
+
+#include "scene_format.h"
+
+namespace {
+    // A mesh the way a parsing loader keeps it, owning copies of its vertices and indices.
+    struct ParsedMesh {
+        std::vector<uint8_t> vertices;
+        std::vector<uint8_t> indices;
+    };
+
+    double now_ms() {
+        return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    long peak_rss_kb() {
+        struct rusage usage;
+        getrusage( RUSAGE_SELF, &usage );
+        return usage.ru_maxrss;
+    }
+
+    uint64_t checksum( const uint8_t* bytes, size_t size, uint64_t sum ) {
+        for( size_t i = 0; i < size; ++i ) {
+            sum = sum * 31 + bytes[i];
+        }
+        return sum;
+    }
+
+    // A UV sphere in the float layout: position, normal and UV, 32 bytes a vertex.
+    void sphere( float radius, int rings, std::vector<float>& vertices, std::vector<uint32_t>& indices ) {
+        const int segments = 2 * rings;
+        for( int r = 0; r <= rings; ++r ) {
+            const float theta = 3.14159265f * r / rings;
+            for( int s = 0; s <= segments; ++s ) {
+                const float phi       = 6.2831853f * s / segments;
+                const float normal[3] = {sinf( theta ) * cosf( phi ), cosf( theta ), sinf( theta ) * sinf( phi )};
+                for( int i = 0; i < 3; ++i ) {
+                    vertices.push_back( radius * normal[i] );
+                }
+                vertices.insert( vertices.end(), normal, normal + 3 );
+                vertices.push_back( static_cast<float>( s ) / segments );
+                vertices.push_back( static_cast<float>( r ) / rings );
+            }
+        }
+        for( int r = 0; r < rings; ++r ) {
+            for( int s = 0; s < segments; ++s ) {
+                const uint32_t a       = r * ( segments + 1 ) + s;
+                const uint32_t b       = a + segments + 1;
+                const uint32_t quad[6] = {a, b, a + 1, a + 1, b, b + 1};
+                indices.insert( indices.end(), quad, quad + 6 );
+            }
+        }
+    }
+
+    int generate( const char* path, int mesh_count, int rings ) {
+        flatbuffers::FlatBufferBuilder                      builder;
+        std::vector<uint8_t>                                blob;
+        std::vector<flatbuffers::Offset<SceneFormat::Mesh>> meshes;
+        std::vector<flatbuffers::Offset<SceneFormat::Node>> nodes;
+        const int                                           side = static_cast<int>( ceil( sqrt( static_cast<double>( mesh_count ) ) ) );
+        for( int m = 0; m < mesh_count; ++m ) {
+            const float           radius = 0.1f + 0.002f * ( m % 16 );
+            std::vector<float>    vertices;
+            std::vector<uint32_t> indices;
+            sphere( radius, rings, vertices, indices );
+            const size_t vertex_count = vertices.size() / 8;
+
+            // 16-bit indices whenever every vertex can be addressed, like mesh_pack().
+            const bool               short_indices = vertex_count <= 0x10000;
+            const SceneFormat::Range vertex_range  = scene_format_append( blob, vertices.data(), vertices.size() * sizeof( float ) );
+            SceneFormat::Range       index_range;
+            if( short_indices ) {
+                std::vector<uint16_t> narrow( indices.begin(), indices.end() );
+                index_range = scene_format_append( blob, narrow.data(), narrow.size() * sizeof( uint16_t ) );
+            } else {
+                index_range = scene_format_append( blob, indices.data(), indices.size() * sizeof( uint32_t ) );
+            }
+            const SceneFormat::Lod    lod( 0, static_cast<uint32_t>( indices.size() ), 0.0f );
+            const SceneFormat::Bounds bounds( SceneFormat::Vec3( -radius, -radius, -radius ), SceneFormat::Vec3( radius, radius, radius ) );
+            meshes.push_back( SceneFormat::CreateMesh(
+                builder,
+                builder.CreateString( "sphere" + std::to_string( m ) ),
+                SceneFormat::VertexFormat_Float,
+                0,
+                &vertex_range,
+                &index_range,
+                short_indices,
+                builder.CreateVectorOfStructs( &lod, 1 ),
+                &bounds ) );
+
+            // A grid in front of the viewer, row major like the scene's matrices.
+            // clang-format off
+            const float matrix[4 * 4] = {
+                1.0f, 0.0f, 0.0f, 0.5f * ( m % side - 0.5f * ( side - 1 ) ),
+                0.0f, 1.0f, 0.0f, 0.5f * ( m / side - 0.5f * ( side - 1 ) ),
+                0.0f, 0.0f, 1.0f, -3.0f,
+                0.0f, 0.0f, 0.0f, 1.0f};
+            // clang-format on
+            nodes.push_back( SceneFormat::CreateNode( builder, 0, -1, builder.CreateVector( matrix, 4 * 4 ), m, 0 ) );
+        }
+
+        const SceneFormat::Color                                color( 200, 200, 200, 255 );
+        std::vector<flatbuffers::Offset<SceneFormat::Material>> materials( 1, SceneFormat::CreateMaterial( builder, builder.CreateString( "grey" ), &color ) );
+        builder.ForceVectorAlignment( blob.size(), sizeof( uint8_t ), SCENE_BLOB_ALIGNMENT );
+        const auto blob_vector = builder.CreateVector( blob );
+        SceneFormat::FinishSceneBuffer( builder,
+                                        SceneFormat::CreateScene(
+                                            builder,
+                                            builder.CreateVector( nodes ),
+                                            builder.CreateVector( meshes ),
+                                            builder.CreateVector( materials ),
+                                            blob_vector ) );
+
+        FILE* file = fopen( path, "wb" );
+        if( !file ) {
+            fprintf( stderr, "Failed to create %s: %s\n", path, strerror( errno ) );
+            return 1;
+        }
+        const bool written = fwrite( builder.GetBufferPointer(), 1, builder.GetSize(), file ) == builder.GetSize();
+        if( ( fclose( file ) != 0 ) || !written ) {
+            fprintf( stderr, "Failed to write %s.\n", path );
+            return 1;
+        }
+        printf( "Wrote %s: %d meshes of %d vertices, %.1lf MB of which %.1lf MB are vertices and indices.\n",
+                path,
+                mesh_count,
+                ( rings + 1 ) * ( 2 * rings + 1 ),
+                builder.GetSize() / ( 1024.0 * 1024.0 ),
+                blob.size() / ( 1024.0 * 1024.0 ) );
+        return 0;
+    }
+
+    // Verifies the file where it is mapped and reads the meshes straight out of the blob.
+    int load_mapped( const char* path ) {
+        const double   start_ms = now_ms();
+        SceneContainer container;
+        if( !scene_format_map( path, container ) ) {
+            fprintf( stderr, "Failed to map %s as a scene.\n", path );
+            return 1;
+        }
+        const double              load_ms = now_ms() - start_ms;
+        const SceneFormat::Scene& scene   = *container.view();
+        uint64_t                  sum     = 0;
+        size_t                    bytes   = 0;
+        if( !scene.meshes() ) {
+            fprintf( stderr, "%s has no meshes.\n", path );
+            return 1;
+        }
+        for( const SceneFormat::Mesh* mesh : *scene.meshes() ) {
+            const uint8_t* vertices = scene_format_range( scene, mesh->vertices() );
+            const uint8_t* indices  = scene_format_range( scene, mesh->indices() );
+            if( !vertices || !indices ) {
+                fprintf( stderr, "A mesh of %s lies outside the blob.\n", path );
+                return 1;
+            }
+            sum = checksum( vertices, mesh->vertices()->size(), sum );
+            sum = checksum( indices, mesh->indices()->size(), sum );
+            bytes += mesh->vertices()->size() + mesh->indices()->size();
+        }
+        const double total_ms = now_ms() - start_ms;
+        printf( "mmap:  %d bytes, %.3lf ms to load, %.3lf ms with every mesh read, %.1lf MB of meshes, peak RSS %.1lf MB, checksum %016llx.\n",
+                container.length(),
+                load_ms,
+                total_ms,
+                bytes / ( 1024.0 * 1024.0 ),
+                peak_rss_kb() / 1024.0,
+                static_cast<unsigned long long>( sum ) );
+        return 0;
+    }
+
+    // Reads the whole file, verifies it and copies every mesh into buffers of its own, as a loader building
+    // its own structures would, before letting go of the file.
+    int load_parsed( const char* path ) {
+        const double start_ms = now_ms();
+        FILE*        file     = fopen( path, "rb" );
+        if( !file ) {
+            fprintf( stderr, "Failed to open %s: %s\n", path, strerror( errno ) );
+            return 1;
+        }
+        fseek( file, 0, SEEK_END );
+        const long size = ftell( file );
+        fseek( file, 0, SEEK_SET );
+        std::vector<uint8_t> data( size > 0 ? size : 0 );
+        const bool           read = ( size > 0 ) && ( fread( data.data(), 1, data.size(), file ) == data.size() );
+        fclose( file );
+        flatbuffers::Verifier verifier( data.data(), data.size() );
+        if( !read || !SceneFormat::VerifySceneBuffer( verifier ) ) {
+            fprintf( stderr, "Failed to read %s as a scene.\n", path );
+            return 1;
+        }
+        const SceneFormat::Scene& scene = *SceneFormat::GetScene( data.data() );
+        std::vector<ParsedMesh>   meshes;
+        if( !scene.meshes() ) {
+            fprintf( stderr, "%s has no meshes.\n", path );
+            return 1;
+        }
+        for( const SceneFormat::Mesh* mesh : *scene.meshes() ) {
+            const uint8_t* vertices = scene_format_range( scene, mesh->vertices() );
+            const uint8_t* indices  = scene_format_range( scene, mesh->indices() );
+            if( !vertices || !indices ) {
+                fprintf( stderr, "A mesh of %s lies outside the blob.\n", path );
+                return 1;
+            }
+            ParsedMesh parsed;
+            parsed.vertices.assign( vertices, vertices + mesh->vertices()->size() );
+            parsed.indices.assign( indices, indices + mesh->indices()->size() );
+            meshes.push_back( std::move( parsed ) );
+        }
+        std::vector<uint8_t>().swap( data );
+        const double load_ms = now_ms() - start_ms;
+
+        uint64_t sum   = 0;
+        size_t   bytes = 0;
+        for( const ParsedMesh& mesh : meshes ) {
+            sum = checksum( mesh.vertices.data(), mesh.vertices.size(), sum );
+            sum = checksum( mesh.indices.data(), mesh.indices.size(), sum );
+            bytes += mesh.vertices.size() + mesh.indices.size();
+        }
+        const double total_ms = now_ms() - start_ms;
+        printf( "parse: %ld bytes, %.3lf ms to load, %.3lf ms with every mesh read, %.1lf MB of meshes, peak RSS %.1lf MB, checksum %016llx.\n",
+                size,
+                load_ms,
+                total_ms,
+                bytes / ( 1024.0 * 1024.0 ),
+                peak_rss_kb() / 1024.0,
+                static_cast<unsigned long long>( sum ) );
+        return 0;
+    }
+}
+
+int main( int argc, char** argv ) {
+    if( ( argc >= 3 ) && !strcmp( argv[1], "generate" ) ) {
+        const int meshes = ( argc > 3 ) ? atoi( argv[3] ) : 64;
+        const int rings  = ( argc > 4 ) ? atoi( argv[4] ) : 128;
+        if( ( meshes <= 0 ) || ( rings < 2 ) ) {
+            fprintf( stderr, "Need some meshes and at least 2 rings.\n" );
+            return 1;
+        }
+        return generate( argv[2], meshes, rings );
+    }
+    if( ( argc == 3 ) && !strcmp( argv[1], "mmap" ) ) {
+        return load_mapped( argv[2] );
+    }
+    if( ( argc == 3 ) && !strcmp( argv[1], "parse" ) ) {
+        return load_parsed( argv[2] );
+    }
+    fprintf( stderr, "Usage: %s generate scene.wvrs [meshes = 64] [rings = 128]\n"
+                     "       %s mmap|parse scene.wvrs\n",
+             argv[0],
+             argv[0] );
+    return 1;
+}
@@ -18,4 +18,39 @@ function impl_set_canvas_size(width, height) {
     if (c.height !== height) {
         c.height = height;
     }
-}
\ No newline at end of file
+}
+
+function impl_save_file(name, bytes) {
+    var link = document.createElement('a');
+    link.href = URL.createObjectURL(new Blob([bytes]));
+    link.download = name;
+    link.click();
+    setTimeout(function() { URL.revokeObjectURL(link.href); }, 0);
+}
+
+// Draws each of count characters from first, centred in a cell of size by size pixels, and writes their
+// coverage, one byte per pixel, to coverage cell after cell. Returns the font's advance in pixels, 0 on failure.
+function impl_rasterize_glyphs(first, count, size, coverage) {
+    var canvas = document.createElement('canvas');
+    canvas.width = size;
+    canvas.height = size;
+    var context = canvas.getContext('2d');
+    if (!context) {
+        return 0;
+    }
+    context.font = 'bold ' + Math.round(0.75 * size) + 'px monospace';
+    context.textAlign = 'center';
+    context.textBaseline = 'middle';
+    context.fillStyle = 'white';
+    var cell = new Uint8Array(size * size);
+    for (var i = 0; i < count; ++i) {
+        context.clearRect(0, 0, size, size);
+        context.fillText(String.fromCharCode(first + i), size / 2, size / 2);
+        var pixels = context.getImageData(0, 0, size, size).data;
+        for (var p = 0; p < size * size; ++p) {
+            cell[p] = pixels[4 * p + 3];
+        }
+        Module.HEAPU8.set(cell, coverage + i * size * size);
+    }
+    return Math.round(context.measureText('M').width);
+}
@@ -224,4 +224,33 @@ function impl_get_vr_state(vr_state, vr_display_handle) {
 
     setValue(vr_state, uchar_array, 'uint8_t**'); // Set the char double-pointer to point at the array of chars.
     return array.length;
+}
+
+var hmd_frame_data = null;
+
+// A cheaper alternative to impl_get_vr_state that only copies the HMD's matrices,
+// in the order left view, left projection, right view, right projection.
+function impl_get_vr_hmd_matrices(matrices, vr_display_handle) {
+    try {
+        var vr_display = WebVR.dereferenceDisplayHandle(vr_display_handle); // Defined by Emscripten.
+        if (!ok(hmd_frame_data)) {
+            hmd_frame_data = new VRFrameData();
+        }
+        vr_display.getFrameData(hmd_frame_data);
+    } catch (err) {
+        return -1;
+    }
+
+    if (!ok(hmd_frame_data.leftViewMatrix) || !ok(hmd_frame_data.leftProjectionMatrix) ||
+        !ok(hmd_frame_data.rightViewMatrix) || !ok(hmd_frame_data.rightProjectionMatrix)) {
+        return -1;
+    }
+
+    var offset = matrices >> 2; // Byte address to float index.
+    Module.HEAPF32.set(hmd_frame_data.leftViewMatrix, offset);
+    Module.HEAPF32.set(hmd_frame_data.leftProjectionMatrix, offset + 16);
+    Module.HEAPF32.set(hmd_frame_data.rightViewMatrix, offset + 32);
+    Module.HEAPF32.set(hmd_frame_data.rightProjectionMatrix, offset + 48);
+
+    return window.performance.now();
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#!/bin/bash
+set -euo pipefail
+IFS=$'\n\t'
+
+# Builds the app's sources natively against src_test/mock, which stands in for emscripten, WebGL 2 and
+# WebVR, and runs every src_test/*_test.cpp. Only the GLES 3 and EGL headers are needed, e.g. from
+# libgles-dev and libegl-dev, and flatbuffers from $FLATBUFFERS or the system.
+
+mkdir -p build_fbs_cpp
+flatc -c -o build_fbs_cpp src_fbs/*.fbs
+
+FLAGS=(
+  --std=c++11
+  -Werror
+  -O1
+  -g
+  -DEGL_NO_X11
+  -DMESA_EGL_NO_X11_HEADERS
+  -I src_test/mock
+  -I "${FLATBUFFERS:-/usr}/include"
+  -I build_fbs_cpp
+  -I src
+)
+
+mkdir -p build_test/obj
+OBJECTS=()
+for SOURCE in $(ls src/*.cpp src_test/mock/*.cpp | grep -v '^src/main.cpp$'); do
+  OBJECT=build_test/obj/$(echo "$SOURCE" | tr / _ | sed 's/\.cpp$/.o/')
+  g++ "${FLAGS[@]}" -c "$SOURCE" -o "$OBJECT"
+  OBJECTS+=("$OBJECT")
+done
+
+# Run from the top, where the shaders are found under src_asset as in the preloaded file system.
+for TEST in src_test/*_test.cpp; do
+  NAME=$(basename "$TEST" .cpp)
+  g++ "${FLAGS[@]}" "$TEST" "${OBJECTS[@]}" -o "build_test/$NAME"
+  echo "Running $NAME."
+  "./build_test/$NAME"
+done